@@ -196,6 +196,10 @@ typedef struct SBC_ENC_PARAMS_TAG
     UINT16 u16PacketLength;
     /* BK4BTSTACK_CHANGE START */
     UINT8  mSBCEnabled;
+    /* analysis filter state, kept per encoder instance */
+    SINT32 s32X[ENC_VX_BUFFER_SIZE/2];              /* s16X view must be 32 bits aligned cf SHIFTUP_X8_2 */
+    SINT16 s16ShiftCounter;
+    SINT16 s16EncMaxShiftCounter;
     /* BK4BTSTACK_CHANGE END */
 }SBC_ENC_PARAMS;
 
@@ -157,8 +157,9 @@
 #pragma arm section zidata = "sbc_s32_analysis_section"
 #endif
 static SINT32   s32DCTY[16]  = {0};
-static SINT32   s32X[ENC_VX_BUFFER_SIZE/2];
-static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  SHIFTUP_X8_2*/
+/* BK4BTSTACK_CHANGE START */
+/* s32X, ShiftCounter and EncMaxShiftCounter moved into SBC_ENC_PARAMS to support multiple encoder instances */
+/* BK4BTSTACK_CHANGE END */
 #if (SBC_USE_ARM_PRAGMA==TRUE)
 #pragma arm section zidata
 #endif
@@ -897,8 +898,6 @@ static SINT16   *s16X=(SINT16*) s32X;      /* s16X must be 32 bits aligned cf  S
 #endif
 #endif
 
-static SINT16 ShiftCounter=0;
-extern SINT16 EncMaxShiftCounter;
 /****************************************************************************
 * SbcAnalysisFilter - performs Analysis of the input audio stream
 *
@@ -906,6 +905,11 @@ extern SINT16 EncMaxShiftCounter;
 */
 void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
 {
+    /* BK4BTSTACK_CHANGE START */
+    SINT16 *s16X = (SINT16*) pstrEncParams->s32X;
+    SINT16 ShiftCounter = pstrEncParams->s16ShiftCounter;
+    SINT16 EncMaxShiftCounter = pstrEncParams->s16EncMaxShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
     SINT16 *ps16PcmBuf;
     SINT32 *ps32SbBuf;
     SINT32  s32Blk,s32Ch;
@@ -995,11 +999,19 @@ void SbcAnalysisFilter4(SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    pstrEncParams->s16ShiftCounter = ShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 }
 
 /* //////////////////////////////////////////////////////////////////////////////////////////////////////////////////// */
 void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
 {
+    /* BK4BTSTACK_CHANGE START */
+    SINT16 *s16X = (SINT16*) pstrEncParams->s32X;
+    SINT16 ShiftCounter = pstrEncParams->s16ShiftCounter;
+    SINT16 EncMaxShiftCounter = pstrEncParams->s16EncMaxShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
     SINT16 *ps16PcmBuf;
     SINT32 *ps32SbBuf;
     SINT32  s32Blk,s32Ch;                                     /* counter for block*/
@@ -1099,10 +1111,13 @@ void SbcAnalysisFilter8 (SBC_ENC_PARAMS *pstrEncParams)
             }
         }
     }
+    /* BK4BTSTACK_CHANGE START */
+    pstrEncParams->s16ShiftCounter = ShiftCounter;
+    /* BK4BTSTACK_CHANGE END */
 }
 
-void SbcAnalysisInit (void)
+void SbcAnalysisInit (SBC_ENC_PARAMS *pstrEncParams)
 {
-    memset(s16X,0,ENC_VX_BUFFER_SIZE*sizeof(SINT16));
-    ShiftCounter=0;
+    memset(pstrEncParams->s32X,0,sizeof(pstrEncParams->s32X));
+    pstrEncParams->s16ShiftCounter=0;
 }
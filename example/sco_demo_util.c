@@ -555,10 +555,21 @@ void sco_demo_send(hci_con_handle_t sco_handle){
                 int num_samples = hfp_msbc_num_audio_samples_per_frame();
                 if (num_samples > MAX_NUM_MSBC_SAMPLES) return; // assert
                 if (hfp_msbc_can_encode_audio_frame_now() && btstack_ring_buffer_bytes_available(&audio_input_ring_buffer) >= (unsigned int)(num_samples * BYTES_PER_FRAME)){
-                    int16_t sample_buffer[MAX_NUM_MSBC_SAMPLES];
-                    uint32_t bytes_read;
-                    btstack_ring_buffer_read(&audio_input_ring_buffer, (uint8_t*) sample_buffer, num_samples * BYTES_PER_FRAME, &bytes_read);
-                    hfp_msbc_encode_audio_frame(sample_buffer);
+                    uint8_t * span_0;
+                    uint8_t * span_1;
+                    uint32_t span_0_length;
+                    uint32_t span_1_length;
+                    btstack_ring_buffer_read_spans(&audio_input_ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length);
+                    if (span_0_length >= (unsigned int)(num_samples * BYTES_PER_FRAME) && (((uintptr_t) span_0) & 1) == 0){
+                        // encode directly from ring buffer
+                        hfp_msbc_encode_audio_frame((int16_t *) span_0);
+                        btstack_ring_buffer_read_commit(&audio_input_ring_buffer, num_samples * BYTES_PER_FRAME);
+                    } else {
+                        int16_t sample_buffer[MAX_NUM_MSBC_SAMPLES];
+                        uint32_t bytes_read;
+                        btstack_ring_buffer_read(&audio_input_ring_buffer, (uint8_t*) sample_buffer, num_samples * BYTES_PER_FRAME, &bytes_read);
+                        hfp_msbc_encode_audio_frame(sample_buffer);
+                    }
                     num_audio_frames++;
                 }
                 if (hfp_msbc_num_bytes_in_stream() < sco_payload_length){
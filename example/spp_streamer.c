@@ -46,7 +46,8 @@
  * 
  * @text After RFCOMM connections gets open, request a
  * RFCOMM_EVENT_CAN_SEND_NOW via rfcomm_request_can_send_now_event().
- * @text When we get the RFCOMM_EVENT_CAN_SEND_NOW, send data and request another one.
+ * @text When we get the RFCOMM_EVENT_CAN_SEND_NOW, send as many frames as possible 
+ * via rfcomm_send_stream() and request another one.
  *
  * @text Note: To test, run the example, pair from a remote 
  * device, and open the Virtual Serial Port.
@@ -77,7 +78,7 @@ static uint8_t  test_data[NUM_ROWS * NUM_COLS];
 // SPP
 static uint8_t   spp_service_buffer[150];
 
-static uint16_t  spp_test_data_len;
+static uint32_t  spp_test_data_offset;
 static uint16_t  rfcomm_mtu;
 static uint16_t  rfcomm_cid = 0;
 // static uint32_t  data_to_send =  DATA_VOLUME;
@@ -159,17 +160,22 @@ static void spp_create_test_data(void){
 }
 
 static void spp_send_packet(void){
-    rfcomm_send(rfcomm_cid, (uint8_t*) test_data, spp_test_data_len);
+    // send frames until out of credits or ACL buffers, continue with remaining test data next time
+    uint32_t bytes_sent = rfcomm_send_stream(rfcomm_cid, &test_data[spp_test_data_offset], sizeof(test_data) - spp_test_data_offset);
+    spp_test_data_offset += bytes_sent;
+    if (spp_test_data_offset == sizeof(test_data)){
+        spp_test_data_offset = 0;
+    }
 
-    test_track_transferred(spp_test_data_len);
+    test_track_transferred(bytes_sent);
 #if 0
-    if (data_to_send <= spp_test_data_len){
+    if (data_to_send <= bytes_sent){
         printf("SPP Streamer: enough data send, closing channel\n");
         rfcomm_disconnect(rfcomm_cid);
         rfcomm_cid = 0;
         return;
     }
-    data_to_send -= spp_test_data_len;
+    data_to_send -= bytes_sent;
 #endif
     rfcomm_request_can_send_now_event(rfcomm_cid);
 }
@@ -221,10 +227,7 @@ static void packet_handler (uint8_t packet_type, uint16_t channel, uint8_t *pack
                         rfcomm_mtu = rfcomm_event_channel_opened_get_max_frame_size(packet);
                         printf("RFCOMM channel open succeeded. New RFCOMM Channel ID %u, max frame size %u\n", rfcomm_cid, rfcomm_mtu);
 
-                        spp_test_data_len = rfcomm_mtu;
-                        if (spp_test_data_len > sizeof(test_data)){
-                            spp_test_data_len = sizeof(test_data);
-                        }
+                        spp_test_data_offset = 0;
 
                         // disable page/inquiry scan to get max performance
                         gap_discoverable_control(0);
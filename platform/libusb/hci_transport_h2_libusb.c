@@ -519,6 +519,13 @@ static void handle_completed_transfer(struct libusb_transfer *transfer){
     }   
 }
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+static void usb_emit_packet_batch(uint8_t active){
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_BATCH, 1, active};
+    packet_handler(HCI_EVENT_PACKET, &event[0], sizeof(event));
+}
+#endif
+
 static void usb_process_ds(btstack_data_source_t *ds, btstack_data_source_callback_type_t callback_type) {
 
     UNUSED(ds);
@@ -532,6 +539,14 @@ static void usb_process_ds(btstack_data_source_t *ds, btstack_data_source_callba
     memset(&tv, 0, sizeof(struct timeval));
     libusb_handle_events_timeout(NULL, &tv);
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // deliver multiple completed transfers as batch
+    int batch = handle_packet && handle_packet->user_data;
+    if (batch){
+        usb_emit_packet_batch(1);
+    }
+#endif
+
     // Handle any packet in the order that they were received
     while (handle_packet) {
         // log_info("handle packet %p, endpoint %x, status %x", handle_packet, handle_packet->endpoint, handle_packet->status);
@@ -547,6 +562,11 @@ static void usb_process_ds(btstack_data_source_t *ds, btstack_data_source_callba
             handle_packet = NULL;
         }
     }
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    if (batch){
+        usb_emit_packet_batch(0);
+    }
+#endif
     // log_info("end usb_process_ds");
 }
 
@@ -43,6 +43,7 @@
 #include "btstack_debug.h"
 #include "btstack_audio.h"
 #include "btstack_run_loop.h"
+#include "btstack_spsc_ring_buffer.h"
 
 #ifdef HAVE_PORTAUDIO
 
@@ -50,8 +51,9 @@
 #define NUM_FRAMES_PER_PA_BUFFER       512
 #define NUM_OUTPUT_BUFFERS               3
 #define NUM_INPUT_BUFFERS                2
-#define DRIVER_POLL_INTERVAL_MS          5
 
+#include <fcntl.h>
+#include <unistd.h>
 #include <portaudio.h>
 
 // config
@@ -75,25 +77,25 @@ static PaStream * stream_sink;
 static void (*playback_callback)(int16_t * buffer, uint16_t num_samples);
 static void (*recording_callback)(const int16_t * buffer, uint16_t num_samples);
 
-// output buffer
-static int16_t               output_buffer_a[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t               output_buffer_b[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t               output_buffer_c[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t             * output_buffers[NUM_OUTPUT_BUFFERS] = { output_buffer_a, output_buffer_b, output_buffer_c};
-static int                   output_buffer_to_play;
-static int                   output_buffer_to_fill;
+// output ring buffer: filled by run loop, drained by portaudio thread
+static int16_t                    output_storage[NUM_OUTPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
+static btstack_spsc_ring_buffer_t output_ring_buffer;
 
-// input buffer
-static int16_t               input_buffer_a[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t               input_buffer_b[NUM_FRAMES_PER_PA_BUFFER * 2];   // stereo
-static int16_t             * input_buffers[NUM_INPUT_BUFFERS] = { input_buffer_a, input_buffer_b};
-static int                   input_buffer_to_record;
-static int                   input_buffer_to_fill;
+// input ring buffer: filled by portaudio thread, drained by run loop
+static int16_t                    input_storage[NUM_INPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * 2];     // stereo
+static btstack_spsc_ring_buffer_t input_ring_buffer;
 
+// pipe to wake up run loop from portaudio thread
+static int                        driver_wakeup_pipe[2] = { -1, -1 };
+static btstack_data_source_t      driver_data_source;
+static int                        driver_data_source_active;
 
-// timer to fill output ring buffer
-static btstack_timer_source_t  driver_timer_sink;
-static btstack_timer_source_t  driver_timer_source;
+static void btstack_audio_portaudio_wakeup_run_loop(void){
+    // non-blocking, a full pipe already guarantees a wakeup
+    uint8_t wakeup = 0;
+    ssize_t res = write(driver_wakeup_pipe[1], &wakeup, 1);
+    (void) res;
+}
 
 static int portaudio_callback_sink( const void *                     inputBuffer, 
                                     void *                           outputBuffer,
@@ -107,14 +109,20 @@ static int portaudio_callback_sink( const void *                     inputBuffer
     (void) timeInfo; /* Prevent unused variable warnings. */
     (void) statusFlags;
     (void) userData;
-    (void) samples_per_buffer;
     (void) inputBuffer;
 
-    // fill from one of our buffers
-    memcpy(outputBuffer, output_buffers[output_buffer_to_play], NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink);
+    // fill from output ring buffer
+    uint32_t bytes_requested = samples_per_buffer * num_bytes_per_sample_sink;
+    uint32_t bytes_read;
+    btstack_spsc_ring_buffer_read(&output_ring_buffer, (uint8_t *) outputBuffer, bytes_requested, &bytes_read);
+
+    // underrun: play silence, never wait for the run loop
+    if (bytes_read < bytes_requested){
+        memset(((uint8_t *) outputBuffer) + bytes_read, 0, bytes_requested - bytes_read);
+    }
 
-    // next
-    output_buffer_to_play = (output_buffer_to_play + 1 ) % NUM_OUTPUT_BUFFERS;
+    // space for new audio available
+    btstack_audio_portaudio_wakeup_run_loop();
 
     return 0;
 }
@@ -131,47 +139,91 @@ static int portaudio_callback_source( const void *                     inputBuff
     (void) timeInfo; /* Prevent unused variable warnings. */
     (void) statusFlags;
     (void) userData;
-    (void) samples_per_buffer;
     (void) outputBuffer;
 
-    // store in one of our buffers
-    memcpy(input_buffers[input_buffer_to_fill], inputBuffer, NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source);
+    // store in input ring buffer, drop audio on overrun instead of blocking
+    uint32_t bytes_recorded = samples_per_buffer * num_bytes_per_sample_source;
+    btstack_spsc_ring_buffer_write(&input_ring_buffer, (const uint8_t *) inputBuffer, bytes_recorded);
 
-    // next
-    input_buffer_to_fill = (input_buffer_to_fill + 1 ) % NUM_INPUT_BUFFERS;
+    // recorded audio available
+    btstack_audio_portaudio_wakeup_run_loop();
 
     return 0;
 }
 
-static void driver_timer_handler_sink(btstack_timer_source_t * ts){
-
-    // playback buffer ready to fill
-    if (output_buffer_to_play != output_buffer_to_fill){
-        (*playback_callback)(output_buffers[output_buffer_to_fill], NUM_FRAMES_PER_PA_BUFFER);
-
-        // next
-        output_buffer_to_fill = (output_buffer_to_fill + 1 ) % NUM_OUTPUT_BUFFERS;
+static void btstack_audio_portaudio_fill_output(void){
+    uint32_t bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink;
+    while (1){
+        // ring buffer size is a multiple of bytes_per_buffer, let client fill ring buffer in place
+        uint32_t span_length;
+        uint8_t * span = btstack_spsc_ring_buffer_write_span(&output_ring_buffer, &span_length);
+        if (span_length < bytes_per_buffer) break;
+        (*playback_callback)((int16_t *) span, NUM_FRAMES_PER_PA_BUFFER);
+        btstack_spsc_ring_buffer_write_commit(&output_ring_buffer, bytes_per_buffer);
     }
+}
 
-    // re-set timer
-    btstack_run_loop_set_timer(ts, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(ts);
+static void btstack_audio_portaudio_process_input(void){
+    uint32_t bytes_per_buffer = NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source;
+    while (1){
+        // ring buffer size is a multiple of bytes_per_buffer, provide recorded audio in place
+        uint32_t span_length;
+        const uint8_t * span = btstack_spsc_ring_buffer_read_span(&input_ring_buffer, &span_length);
+        if (span_length < bytes_per_buffer) break;
+        (*recording_callback)((const int16_t *) span, NUM_FRAMES_PER_PA_BUFFER);
+        btstack_spsc_ring_buffer_read_commit(&input_ring_buffer, bytes_per_buffer);
+    }
 }
 
-static void driver_timer_handler_source(btstack_timer_source_t * ts){
+static void driver_data_source_handler(btstack_data_source_t * ds, btstack_data_source_callback_type_t callback_type){
+    (void) callback_type;
+
+    // drain wakeup pipe
+    uint8_t buffer[16];
+    while (read(btstack_run_loop_get_data_source_fd(ds), buffer, sizeof(buffer)) > 0);
+
+    if (sink_active){
+        btstack_audio_portaudio_fill_output();
+    }
+    if (source_active){
+        btstack_audio_portaudio_process_input();
+    }
+}
 
-    // recording buffer ready to process
-    if (input_buffer_to_record != input_buffer_to_fill){
+static int btstack_audio_portaudio_open_wakeup_pipe(void){
+    if (driver_wakeup_pipe[0] >= 0) return 0;
+    if (pipe(driver_wakeup_pipe) != 0){
+        log_error("PortAudio: cannot create wakeup pipe");
+        return 1;
+    }
+    fcntl(driver_wakeup_pipe[0], F_SETFL, fcntl(driver_wakeup_pipe[0], F_GETFL) | O_NONBLOCK);
+    fcntl(driver_wakeup_pipe[1], F_SETFL, fcntl(driver_wakeup_pipe[1], F_GETFL) | O_NONBLOCK);
+    return 0;
+}
 
-        (*recording_callback)(input_buffers[input_buffer_to_record], NUM_FRAMES_PER_PA_BUFFER);
+static void btstack_audio_portaudio_close_wakeup_pipe(void){
+    if (driver_wakeup_pipe[0] < 0) return;
+    close(driver_wakeup_pipe[0]);
+    close(driver_wakeup_pipe[1]);
+    driver_wakeup_pipe[0] = -1;
+    driver_wakeup_pipe[1] = -1;
+}
 
-        // next
-        input_buffer_to_record = (input_buffer_to_record + 1 ) % NUM_INPUT_BUFFERS;
-    }    
+static void btstack_audio_portaudio_add_data_source(void){
+    if (driver_data_source_active) return;
+    btstack_run_loop_set_data_source_fd(&driver_data_source, driver_wakeup_pipe[0]);
+    btstack_run_loop_set_data_source_handler(&driver_data_source, &driver_data_source_handler);
+    btstack_run_loop_enable_data_source_callbacks(&driver_data_source, DATA_SOURCE_CALLBACK_READ);
+    btstack_run_loop_add_data_source(&driver_data_source);
+    driver_data_source_active = 1;
+}
 
-    // re-set timer
-    btstack_run_loop_set_timer(ts, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(ts);
+static void btstack_audio_portaudio_remove_data_source_if_not_needed(void){
+    if (!driver_data_source_active) return;
+    if (sink_active)   return;
+    if (source_active) return;
+    btstack_run_loop_remove_data_source(&driver_data_source);
+    driver_data_source_active = 0;
 }
 
 static int btstack_audio_portaudio_sink_init(
@@ -189,6 +241,8 @@ static int btstack_audio_portaudio_sink_init(
         return 1;
     }
 
+    if (btstack_audio_portaudio_open_wakeup_pipe()) return 1;
+
     /* -- initialize PortAudio -- */
     if (!portaudio_initialized){
         err = Pa_Initialize();
@@ -253,6 +307,8 @@ static int btstack_audio_portaudio_source_init(
         return 1;
     }
 
+    if (btstack_audio_portaudio_open_wakeup_pipe()) return 1;
+
     /* -- initialize PortAudio -- */
     if (!portaudio_initialized){
         err = Pa_Initialize();
@@ -307,10 +363,8 @@ static void btstack_audio_portaudio_sink_start_stream(void){
     if (!playback_callback) return;
 
     // fill buffer once
-    (*playback_callback)(output_buffer_a, NUM_FRAMES_PER_PA_BUFFER);
-    (*playback_callback)(output_buffer_b, NUM_FRAMES_PER_PA_BUFFER);
-    output_buffer_to_play = 0;
-    output_buffer_to_fill = 2;
+    btstack_spsc_ring_buffer_init(&output_ring_buffer, (uint8_t *) output_storage, NUM_OUTPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_sink);
+    btstack_audio_portaudio_fill_output();
 
     /* -- start stream -- */
     PaError err = Pa_StartStream(stream_sink);
@@ -319,10 +373,8 @@ static void btstack_audio_portaudio_sink_start_stream(void){
         return;
     }
 
-    // start timer
-    btstack_run_loop_set_timer_handler(&driver_timer_sink, &driver_timer_handler_sink);
-    btstack_run_loop_set_timer(&driver_timer_sink, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(&driver_timer_sink);
+    // wait for portaudio callbacks
+    btstack_audio_portaudio_add_data_source();
 
     sink_active = 1;
 }
@@ -331,6 +383,8 @@ static void btstack_audio_portaudio_source_start_stream(void){
 
     if (!recording_callback) return;
 
+    btstack_spsc_ring_buffer_init(&input_ring_buffer, (uint8_t *) input_storage, NUM_INPUT_BUFFERS * NUM_FRAMES_PER_PA_BUFFER * num_bytes_per_sample_source);
+
     /* -- start stream -- */
     PaError err = Pa_StartStream(stream_source);
     if (err != paNoError){
@@ -338,10 +392,8 @@ static void btstack_audio_portaudio_source_start_stream(void){
         return;
     }
 
-    // start timer
-    btstack_run_loop_set_timer_handler(&driver_timer_source, &driver_timer_handler_source);
-    btstack_run_loop_set_timer(&driver_timer_source, DRIVER_POLL_INTERVAL_MS);
-    btstack_run_loop_add_timer(&driver_timer_source);
+    // wait for portaudio callbacks
+    btstack_audio_portaudio_add_data_source();
 
     source_active = 1;
 }
@@ -351,9 +403,6 @@ static void btstack_audio_portaudio_sink_stop_stream(void){
     if (!playback_callback) return;
     if (!sink_active)       return;
 
-    // stop timer
-    btstack_run_loop_remove_timer(&driver_timer_sink);
-
     PaError err = Pa_StopStream(stream_sink);
     if (err != paNoError){
         log_error("PortAudio: error stopping sink stream: \"%s\"",  Pa_GetErrorText(err));
@@ -361,6 +410,7 @@ static void btstack_audio_portaudio_sink_stop_stream(void){
     } 
 
     sink_active = 0;
+    btstack_audio_portaudio_remove_data_source_if_not_needed();
 }
 
 static void btstack_audio_portaudio_source_stop_stream(void){
@@ -368,9 +418,6 @@ static void btstack_audio_portaudio_source_stop_stream(void){
     if (!recording_callback) return;
     if (!source_active)      return;
 
-    // stop timer
-    btstack_run_loop_remove_timer(&driver_timer_source);
-
     PaError err = Pa_StopStream(stream_source);
     if (err != paNoError){
         log_error("PortAudio: error stopping source stream: \"%s\"",  Pa_GetErrorText(err));
@@ -378,11 +425,13 @@ static void btstack_audio_portaudio_source_stop_stream(void){
     } 
 
     source_active = 0;
+    btstack_audio_portaudio_remove_data_source_if_not_needed();
 }
 
 static void btstack_audio_portaudio_close_pa_if_not_needed(void){
     if (source_initialized) return;
     if (sink_initialized) return;
+    btstack_audio_portaudio_close_wakeup_pipe();
     PaError err = Pa_Terminate();
     if (err != paNoError){
         log_error("Portudio: Error terminating portaudio: \"%s\"",  Pa_GetErrorText(err));
@@ -415,7 +464,7 @@ static void btstack_audio_portaudio_source_close(void){
     if (!recording_callback) return;
 
     if (source_active){
-        btstack_audio_portaudio_sink_stop_stream();
+        btstack_audio_portaudio_source_stop_stream();
     }
 
     PaError err = Pa_CloseStream(stream_source);
@@ -0,0 +1,119 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define __BTSTACK_FILE__ "btstack_ring_buffer_mirrored.c"
+
+/*
+ *  btstack_ring_buffer_mirrored.c
+ *
+ */
+
+#ifdef __linux__
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+
+#include "btstack_ring_buffer_mirrored.h"
+#include "bluetooth.h"
+#include "btstack_debug.h"
+
+#ifdef __linux__
+
+int btstack_ring_buffer_mirrored_init(btstack_ring_buffer_t * ring_buffer, uint32_t min_size){
+    long page_size = sysconf(_SC_PAGESIZE);
+    if (page_size <= 0) return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    size_t size = ((min_size + page_size - 1) / page_size) * page_size;
+    if (size == 0){
+        size = page_size;
+    }
+
+    int fd = memfd_create("btstack_ring_buffer", MFD_CLOEXEC);
+    if (fd < 0){
+        log_error("ring buffer mirrored: memfd_create failed");
+        return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+    }
+    if (ftruncate(fd, size) != 0){
+        close(fd);
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // reserve address range for both mappings, then map file twice into it
+    uint8_t * storage = (uint8_t *) mmap(NULL, 2 * size, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (storage == MAP_FAILED){
+        close(fd);
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+    if ((mmap(storage,        size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)
+    ||  (mmap(storage + size, size, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED)){
+        log_error("ring buffer mirrored: mmap failed");
+        munmap(storage, 2 * size);
+        close(fd);
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+
+    // mappings keep memory alive
+    close(fd);
+
+    btstack_ring_buffer_init(ring_buffer, storage, (uint32_t) size);
+    ring_buffer->mirrored = 1;
+    return 0;
+}
+
+void btstack_ring_buffer_mirrored_deinit(btstack_ring_buffer_t * ring_buffer){
+    if (!ring_buffer->mirrored) return;
+    munmap(ring_buffer->storage, 2 * (size_t) ring_buffer->size);
+    ring_buffer->storage = NULL;
+    ring_buffer->size = 0;
+    ring_buffer->mirrored = 0;
+}
+
+#else
+
+int btstack_ring_buffer_mirrored_init(btstack_ring_buffer_t * ring_buffer, uint32_t min_size){
+    UNUSED(ring_buffer);
+    UNUSED(min_size);
+    return ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE;
+}
+
+void btstack_ring_buffer_mirrored_deinit(btstack_ring_buffer_t * ring_buffer){
+    UNUSED(ring_buffer);
+}
+
+#endif
@@ -0,0 +1,75 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  btstack_ring_buffer_mirrored.h
+ *
+ *  Ring buffer with storage mapped twice back-to-back (Linux memfd), so that
+ *  data and free space are always a single contiguous region, even when they
+ *  wrap around. Read/write spans and btstack_ring_buffer_read/write then never
+ *  split accesses.
+ */
+
+#ifndef __BTSTACK_RING_BUFFER_MIRRORED_H
+#define __BTSTACK_RING_BUFFER_MIRRORED_H
+
+#include <stdint.h>
+#include "btstack_ring_buffer.h"
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Init mirrored ring buffer
+ * @param ring_buffer object
+ * @param min_size in bytes, rounded up to multiple of page size
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if mapping failed, ERROR_CODE_UNSUPPORTED_FEATURE_OR_PARAMETER_VALUE if not supported on platform
+ */
+int btstack_ring_buffer_mirrored_init(btstack_ring_buffer_t * ring_buffer, uint32_t min_size);
+
+/**
+ * Release storage of mirrored ring buffer
+ * @param ring_buffer object
+ */
+void btstack_ring_buffer_mirrored_deinit(btstack_ring_buffer_t * ring_buffer);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __BTSTACK_RING_BUFFER_MIRRORED_H
@@ -149,6 +149,7 @@ CSRCS += \
 	${BTSTACK_ROOT_CONFIG}/src/btstack_ring_buffer.c \
 	${BTSTACK_ROOT_CONFIG}/src/btstack_run_loop.c \
 	${BTSTACK_ROOT_CONFIG}/src/btstack_util.c \
+	${BTSTACK_ROOT_CONFIG}/src/btstack_crc.c  \
 	${BTSTACK_ROOT_CONFIG}/src/btstack_tlv.c \
 	${BTSTACK_ROOT_CONFIG}/src/hci.c \
 	${BTSTACK_ROOT_CONFIG}/src/hci_cmd.c \
@@ -51,6 +51,7 @@ $(NAME)_SOURCES += \
 	../../src/btstack_run_loop.c          \
 	../../src/btstack_tlv.c               \
 	../../src/btstack_util.c              \
+	../../src/btstack_crc.c               \
 	../../src/hci.c                       \
 	../../src/hci_cmd.c                   \
 	../../src/hci_dump.c                  \
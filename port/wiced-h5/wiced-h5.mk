@@ -50,6 +50,7 @@ $(NAME)_SOURCES += \
 	../../src/btstack_resample.c          \
 	../../src/btstack_run_loop.c          \
 	../../src/btstack_util.c              \
+	../../src/btstack_crc.c               \
 	../../src/btstack_slip.c              \
 	../../src/btstack_tlv.c               \
 	../../src/hci.c                       \
@@ -192,6 +192,8 @@ void le_device_db_local_counter_set(int index, uint32_t counter);
 
 /**
  * @brief free device
+ * @note With ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION, the Controller resolving list is not updated. It gets reloaded
+ *       on the next bonding with identity information or on power on
  * @param index
  */
 void le_device_db_remove(int index);
@@ -247,6 +247,10 @@ static bd_addr_t sm_address_resolution_address;
 static void *    sm_address_resolution_context;
 static address_resolution_mode_t sm_address_resolution_mode;
 static btstack_linked_list_t sm_address_resolution_general_queue;
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+// address already resolved by Controller, only compare identity addresses
+static int       sm_address_resolution_identity_only;
+#endif
 
 // aes128 crypto engine.
 static sm_aes128_state_t  sm_aes128_state;
@@ -1329,6 +1333,11 @@ static void sm_key_distribution_handle_all_received(sm_connection_t * sm_conn){
 
             }
         }
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+        if (le_db_index >= 0 && (setup->sm_key_distribution_received_set & SM_KEYDIST_FLAG_IDENTITY_INFORMATION)){
+            hci_le_resolving_list_load(sm_persistent_irk);
+        }
+#endif
     } else {
         log_info("Ignoring received keys, bonding not enabled");
     }
@@ -1889,6 +1898,9 @@ static void sm_run(void){
             hci_connection_t * hci_connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
             sm_connection_t  * sm_connection  = &hci_connection->sm_connection;
             if (sm_connection->sm_irk_lookup_state == IRK_LOOKUP_W4_READY){
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+                sm_address_resolution_identity_only = hci_connection->le_peer_address_resolved;
+#endif
                 // and start lookup
                 sm_address_resolution_start_lookup(sm_connection->sm_peer_addr_type, sm_connection->sm_handle, sm_connection->sm_peer_address, ADDRESS_RESOLUTION_FOR_CONNECTION, sm_connection);
                 sm_connection->sm_irk_lookup_state = IRK_LOOKUP_STARTED;
@@ -1902,6 +1914,9 @@ static void sm_run(void){
         if (!btstack_linked_list_empty(&sm_address_resolution_general_queue)){
             sm_lookup_entry_t * entry = (sm_lookup_entry_t *) sm_address_resolution_general_queue;
             btstack_linked_list_remove(&sm_address_resolution_general_queue, (btstack_linked_item_t *) entry);
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+            sm_address_resolution_identity_only = 0;
+#endif
             sm_address_resolution_start_lookup(entry->address_type, 0, entry->address, ADDRESS_RESOLUTION_GENERAL, NULL);
             btstack_memory_sm_lookup_entry_free(entry);
         }
@@ -1935,6 +1950,14 @@ static void sm_run(void){
                 continue;
             }
 
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+            // Controller reported identity address, no need to calculate ah()
+            if (sm_address_resolution_identity_only){
+                sm_address_resolution_test++;
+                continue;
+            }
+#endif
+
             if (sm_aes128_state == SM_AES128_ACTIVE) break;
 
             log_info("LE Device Lookup: calculate AH");
@@ -2807,6 +2830,10 @@ static void sm_handle_encryption_result_dkg_irk(void *arg){
     sm_aes128_state = SM_AES128_IDLE;
     log_info_key("irk", sm_persistent_irk);
     dkg_state = DKG_CALC_DHK;
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    // local IRK known, load bonded devices into Controller
+    hci_le_resolving_list_load(sm_persistent_irk);
+#endif
     sm_run();
 }
 
@@ -3215,6 +3242,9 @@ static void sm_event_packet_handler (uint8_t packet_type, uint16_t channel, uint
                         && sm_conn->sm_engine_state == SM_INITIATOR_PH0_W4_CONNECTION_ENCRYPTED
                         && packet[2] == ERROR_CODE_AUTHENTICATION_FAILURE){
                         le_device_db_remove(sm_conn->sm_le_db_index);
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+                        hci_le_resolving_list_load(sm_persistent_irk);
+#endif
                     }
 
                     // pairing failed, if it was ongoing
@@ -243,6 +243,8 @@ typedef enum {
 #define ERROR_CODE_CONNECTION_FAILED_TO_BE_ESTABLISHED     0x3E
 #define ERROR_CODE_MAC_CONNECTION_FAILED                   0x3F
 #define ERROR_CODE_COARSE_CLOCK_ADJUSTMENT_REJECTED_BUT_WILL_TRY_TO_ADJUST_USING_CLOCK_DRAGGING 0x40
+#define ERROR_CODE_TYPE0_SUBMAP_NOT_DEFINED                0x41
+#define ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER          0x42
 /* ENUM_END */
 
 /* ENUM_START: AVRCP_BROWSING_ERROR_CODE */
@@ -534,6 +536,13 @@ typedef enum {
  */
 #define HCI_EVENT_CONNECTION_PACKET_TYPE_CHANGED           0x1D
 
+/**
+ * @format B1
+ * @param bd_addr
+ * @param page_scan_repetition_mode
+ */
+#define HCI_EVENT_PAGE_SCAN_REPETITION_MODE_CHANGE         0x20
+
 /** 
  * @format 1B11321
  * @param num_responses
@@ -721,6 +730,35 @@ typedef enum {
 // array of advertisements, not handled by event accessor generator
 #define HCI_SUBEVENT_LE_DIRECT_ADVERTISING_REPORT          0x0B
 
+/**
+ * @format 11H11
+ * @param subevent_code
+ * @param status
+ * @param connection_handle
+ * @param tx_phy
+ * @param rx_phy
+ */
+#define HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE                0x0C
+
+// array of extended advertisements, not handled by event accessor generator
+#define HCI_SUBEVENT_LE_EXTENDED_ADVERTISING_REPORT        0x0D
+
+/**
+ * @format 1
+ * @param subevent_code
+ */
+#define HCI_SUBEVENT_LE_SCAN_TIMEOUT                       0x11
+
+/**
+ * @format 111H1
+ * @param subevent_code
+ * @param status
+ * @param advertising_handle
+ * @param connection_handle
+ * @param num_completed_extended_advertising_events
+ */
+#define HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED         0x12
+
 /** 
  * L2CAP Layer
  */
@@ -0,0 +1,242 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define __BTSTACK_FILE__ "btstack_crc.c"
+
+/*
+ *  btstack_crc.c
+ *
+ *  Both CRCs are reflected (LSB first), so the same strategies apply:
+ *  - default: byte-wise table for L2CAP FCS, nibble-wise table for H5 to keep the footprint small
+ *  - ENABLE_CRC16_SLICING_BY_8: eight bytes per step using 8 x 256 entry tables, built on first use
+ *  - ENABLE_CRC16_CLMUL: carry-less multiply (PCLMULQDQ on x86-64, PMULL on ARMv8) if targeted by the compiler,
+ *    eight bytes per step with Barrett reduction and without tables. Opt-in, as it is slower than slicing-by-8
+ *    on current x86-64 cores. Falls back to slicing-by-8 or the default tables if not targeted.
+ */
+
+#include "btstack_config.h"
+#include "btstack_crc.h"
+
+#include <string.h>
+
+#ifdef ENABLE_CRC16_CLMUL
+#if defined(__x86_64__) && defined(__PCLMUL__)
+#define CRC16_USE_CLMUL
+#include <wmmintrin.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define CRC16_USE_CLMUL
+#include <arm_neon.h>
+#endif
+#endif
+
+// reflected generator polynomials without x^16
+#define CRC16_L2CAP_POLYNOMIAL 0xa001
+#define CRC16_CCITT_POLYNOMIAL 0x8408
+
+/*
+ * CRC lookup table for generator polynom D^16 + D^15 + D^2 + 1
+ */
+static const uint16_t crc16_l2cap_table[256] = {
+    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
+    0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
+    0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
+    0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
+    0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240, 0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
+    0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
+    0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
+    0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
+    0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
+    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
+    0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
+    0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
+    0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
+    0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40, 0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
+    0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
+    0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040, 
+};
+
+// CRC16-CCITT Calculation - compromise: use 32 byte table - 512 byte table would be faster, but that's too large
+static const uint16_t crc16_ccitt_table[] ={
+    0x0000, 0x1081, 0x2102, 0x3183,
+    0x4204, 0x5285, 0x6306, 0x7387,
+    0x8408, 0x9489, 0xa50a, 0xb58b,
+    0xc60c, 0xd68d, 0xe70e, 0xf78f
+};
+
+static uint16_t crc16_l2cap_update_bytes(uint16_t crc, const uint8_t * data, uint32_t len){
+    while (len--){
+        crc = (crc >> 8) ^ crc16_l2cap_table[ (crc ^ ((uint16_t) *data++)) & 0x00FF ];
+    }
+    return crc;
+}
+
+static uint16_t crc16_ccitt_update_bytes(uint16_t crc, const uint8_t * data, uint32_t len){
+    while (len--){
+        uint8_t ch = *data++;
+        crc = (crc >> 4) ^ crc16_ccitt_table[(crc ^ ch) & 0x000f];
+        crc = (crc >> 4) ^ crc16_ccitt_table[(crc ^ (ch >> 4)) & 0x000f];
+    }
+    return crc;
+}
+
+#ifdef CRC16_USE_CLMUL
+
+// Barrett constants: bit-reversed floor(x^80 / P) without x^64
+#define CRC16_L2CAP_BARRETT 0xf87ff5ffe7ffdfffULL
+#define CRC16_CCITT_BARRETT 0xc2cd82058e2c0c88ULL
+
+#ifdef __aarch64__
+static inline void crc16_clmul(uint64_t a, uint64_t b, uint64_t * lo, uint64_t * hi){
+    uint64x2_t product = vreinterpretq_u64_p128(vmull_p64((poly64_t) a, (poly64_t) b));
+    *lo = vgetq_lane_u64(product, 0);
+    *hi = vgetq_lane_u64(product, 1);
+}
+#else
+static inline void crc16_clmul(uint64_t a, uint64_t b, uint64_t * lo, uint64_t * hi){
+    __m128i product = _mm_clmulepi64_si128(_mm_cvtsi64_si128((long long) a), _mm_cvtsi64_si128((long long) b), 0x00);
+    *lo = (uint64_t) _mm_cvtsi128_si64(product);
+    *hi = (uint64_t) _mm_cvtsi128_si64(_mm_srli_si128(product, 8));
+}
+#endif
+
+// process 8 byte blocks in bit-reflected domain: crc = (block(x) * x^16) mod P with q = floor(block(x) * x^16 / P) via Barrett
+static uint16_t crc16_update_clmul(uint16_t crc, const uint8_t * data, uint32_t num_blocks, uint64_t barrett, uint64_t polynomial){
+    uint64_t lo;
+    uint64_t hi;
+    while (num_blocks--){
+        uint64_t block;
+        memcpy(&block, data, 8);    // little endian only
+        data += 8;
+        block ^= crc;
+        crc16_clmul(block, barrett, &lo, &hi);
+        uint64_t quotient = block ^ (lo << 1);
+        crc16_clmul(quotient, polynomial, &lo, &hi);
+        crc = (uint16_t) ((lo >> 63) | (hi << 1));
+    }
+    return crc;
+}
+
+#elif defined(ENABLE_CRC16_SLICING_BY_8)
+
+static uint16_t crc16_l2cap_slicing_table[8][256];
+static uint16_t crc16_ccitt_slicing_table[8][256];
+static int      crc16_slicing_tables_ready;
+
+static void crc16_slicing_table_init(uint16_t table[8][256], uint16_t polynomial){
+    int i;
+    int j;
+    for (i=0;i<256;i++){
+        uint16_t crc = (uint16_t) i;
+        for (j=0;j<8;j++){
+            crc = (crc & 1) ? ((crc >> 1) ^ polynomial) : (crc >> 1);
+        }
+        table[0][i] = crc;
+    }
+    for (j=1;j<8;j++){
+        for (i=0;i<256;i++){
+            uint16_t crc = table[j-1][i];
+            table[j][i] = (crc >> 8) ^ table[0][crc & 0xff];
+        }
+    }
+}
+
+static void crc16_slicing_tables_init(void){
+    if (crc16_slicing_tables_ready) return;
+    crc16_slicing_table_init(crc16_l2cap_slicing_table, CRC16_L2CAP_POLYNOMIAL);
+    crc16_slicing_table_init(crc16_ccitt_slicing_table, CRC16_CCITT_POLYNOMIAL);
+    crc16_slicing_tables_ready = 1;
+}
+
+static inline uint32_t crc16_read_32(const uint8_t * data){
+    return ((uint32_t) data[0]) | (((uint32_t) data[1]) << 8) | (((uint32_t) data[2]) << 16) | (((uint32_t) data[3]) << 24);
+}
+
+static uint16_t crc16_update_slicing_by_8(uint16_t crc, const uint8_t * data, uint32_t num_blocks, uint16_t table[8][256]){
+    while (num_blocks--){
+        uint32_t lo = crc16_read_32(data) ^ crc;
+        uint32_t hi = crc16_read_32(data + 4);
+        data += 8;
+        crc = table[7][lo & 0xff] ^ table[6][(lo >> 8) & 0xff] ^ table[5][(lo >> 16) & 0xff] ^ table[4][lo >> 24]
+            ^ table[3][hi & 0xff] ^ table[2][(hi >> 8) & 0xff] ^ table[1][(hi >> 16) & 0xff] ^ table[0][hi >> 24];
+    }
+    return crc;
+}
+
+#endif
+
+uint16_t btstack_crc16_l2cap_update(uint16_t crc, const uint8_t * data, uint32_t len){
+    uint32_t num_blocks = len >> 3;
+#if defined(CRC16_USE_CLMUL)
+    crc = crc16_update_clmul(crc, data, num_blocks, CRC16_L2CAP_BARRETT, CRC16_L2CAP_POLYNOMIAL);
+#elif defined(ENABLE_CRC16_SLICING_BY_8)
+    crc16_slicing_tables_init();
+    crc = crc16_update_slicing_by_8(crc, data, num_blocks, crc16_l2cap_slicing_table);
+#else
+    num_blocks = 0;
+#endif
+    data += num_blocks << 3;
+    len  -= num_blocks << 3;
+    return crc16_l2cap_update_bytes(crc, data, len);
+}
+
+uint16_t btstack_crc16_l2cap_calc(const uint8_t * data, uint32_t len){
+    return btstack_crc16_l2cap_update(0, data, len);
+}
+
+uint16_t btstack_crc16_ccitt_update(uint16_t crc, const uint8_t * data, uint32_t len){
+    uint32_t num_blocks = len >> 3;
+#if defined(CRC16_USE_CLMUL)
+    crc = crc16_update_clmul(crc, data, num_blocks, CRC16_CCITT_BARRETT, CRC16_CCITT_POLYNOMIAL);
+#elif defined(ENABLE_CRC16_SLICING_BY_8)
+    crc16_slicing_tables_init();
+    crc = crc16_update_slicing_by_8(crc, data, num_blocks, crc16_ccitt_slicing_table);
+#else
+    num_blocks = 0;
+#endif
+    data += num_blocks << 3;
+    len  -= num_blocks << 3;
+    return crc16_ccitt_update_bytes(crc, data, len);
+}
+
+uint16_t btstack_reverse_bits_16(uint16_t value){
+    uint32_t v = value;
+    v = ((v >> 1) & 0x5555) | ((v & 0x5555) << 1);
+    v = ((v >> 2) & 0x3333) | ((v & 0x3333) << 2);
+    v = ((v >> 4) & 0x0f0f) | ((v & 0x0f0f) << 4);
+    v = ((v >> 8) & 0x00ff) | ((v & 0x00ff) << 8);
+    return (uint16_t) v;
+}
@@ -0,0 +1,95 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  btstack_crc.h
+ *
+ *  CRC-16 variants used by L2CAP ERTM (FCS) and H5 (Data Integrity Check)
+ */
+
+#ifndef __BTSTACK_CRC_H
+#define __BTSTACK_CRC_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+/* API_START */
+
+/**
+ * @brief Update CRC-16 for L2CAP FCS, polynomial x^16 + x^15 + x^2 + 1, LSB first
+ * @param crc value from previous call or 0
+ * @param data
+ * @param len
+ * @return crc
+ */
+uint16_t btstack_crc16_l2cap_update(uint16_t crc, const uint8_t * data, uint32_t len);
+
+/**
+ * @brief Calculate L2CAP FCS
+ * @param data
+ * @param len
+ * @return fcs
+ */
+uint16_t btstack_crc16_l2cap_calc(const uint8_t * data, uint32_t len);
+
+/**
+ * @brief Update CRC-CCITT for H5 Data Integrity Check, polynomial x^16 + x^12 + x^5 + 1, LSB first
+ * @note H5 starts with 0xffff and sends the bit-reversed result, see btstack_reverse_bits_16
+ * @param crc value from previous call or 0xffff
+ * @param data
+ * @param len
+ * @return crc
+ */
+uint16_t btstack_crc16_ccitt_update(uint16_t crc, const uint8_t * data, uint32_t len);
+
+/**
+ * @brief Reverse bit order of 16-bit value
+ * @param value
+ * @return reversed value
+ */
+uint16_t btstack_reverse_bits_16(uint16_t value);
+
+/* API_END */
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __BTSTACK_CRC_H
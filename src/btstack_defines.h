@@ -420,6 +420,13 @@ typedef uint8_t sm_key_t[16];
  */
 #define HCI_EVENT_TRANSPORT_SLEEP_MODE                     0x69
 
+/**
+ * @brief Indicates start/end of a batch of incoming packets delivered by HCI transport
+ * @format 1
+ * @param active
+ */
+#define HCI_EVENT_TRANSPORT_PACKET_BATCH                   0x6A
+
 /**
  * @brief Outgoing packet 
  */
@@ -1015,6 +1022,48 @@ typedef uint8_t sm_key_t[16];
  */
 #define GAP_EVENT_INQUIRY_COMPLETE                            0xE4
 
+/**
+ * @brief Summary for a single device seen during the last scan aggregation interval
+ * @format 1B11144444
+ * @param address_type
+ * @param address
+ * @param rssi_min
+ * @param rssi_max
+ * @param rssi_avg
+ * @param report_count
+ * @param first_seen_ms
+ * @param last_seen_ms
+ * @param data_hash
+ */
+#define GAP_EVENT_SCAN_AGGREGATE_DEVICE                       0xE5
+
+/**
+ * @brief Indicates end of scan aggregation summary
+ * @format 12
+ * @param num_devices
+ * @param num_reports_dropped
+ */
+#define GAP_EVENT_SCAN_AGGREGATE_COMPLETE                     0xE6
+
+/**
+ * @brief Reassembled LE Extended Advertising Report. Event length field is capped at 255, use data_length or packet size
+ * @format 21B1111121BLV
+ * @param advertising_event_type
+ * @param address_type
+ * @param address
+ * @param primary_phy
+ * @param secondary_phy
+ * @param advertising_sid
+ * @param tx_power
+ * @param rssi
+ * @param periodic_advertising_interval
+ * @param direct_address_type
+ * @param direct_address
+ * @param data_length
+ * @param data
+ */
+#define GAP_EVENT_EXTENDED_ADVERTISING_REPORT                 0xE7
+
 
 // Meta Events, see below for sub events
 #define HCI_EVENT_HSP_META                                 0xE8
@@ -699,6 +699,25 @@ static inline uint16_t hci_event_connection_packet_type_changed_get_packet_types
     return little_endian_read_16(event, 5);
 }
 
+/**
+ * @brief Get field bd_addr from event HCI_EVENT_PAGE_SCAN_REPETITION_MODE_CHANGE
+ * @param event packet
+ * @param Pointer to storage for bd_addr
+ * @note: btstack_type B
+ */
+static inline void hci_event_page_scan_repetition_mode_change_get_bd_addr(const uint8_t * event, bd_addr_t bd_addr){
+    reverse_bd_addr(&event[2], bd_addr);
+}
+/**
+ * @brief Get field page_scan_repetition_mode from event HCI_EVENT_PAGE_SCAN_REPETITION_MODE_CHANGE
+ * @param event packet
+ * @return page_scan_repetition_mode
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_event_page_scan_repetition_mode_change_get_page_scan_repetition_mode(const uint8_t * event){
+    return event[8];
+}
+
 /**
  * @brief Get field num_responses from event HCI_EVENT_INQUIRY_RESULT_WITH_RSSI
  * @param event packet
@@ -1027,6 +1046,16 @@ static inline uint8_t hci_event_transport_sleep_mode_get_active(const uint8_t *
     return event[2];
 }
 
+/**
+ * @brief Get field active from event HCI_EVENT_TRANSPORT_PACKET_BATCH
+ * @param event packet
+ * @return active
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_event_transport_packet_batch_get_active(const uint8_t * event){
+    return event[2];
+}
+
 /**
  * @brief Get field handle from event HCI_EVENT_SCO_CAN_SEND_NOW
  * @param event packet
@@ -3149,6 +3178,225 @@ static inline uint8_t gap_event_inquiry_complete_get_status(const uint8_t * even
     return event[2];
 }
 
+/**
+ * @brief Get field address_type from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return address_type
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_scan_aggregate_device_get_address_type(const uint8_t * event){
+    return event[2];
+}
+/**
+ * @brief Get field address from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @param Pointer to storage for address
+ * @note: btstack_type B
+ */
+static inline void gap_event_scan_aggregate_device_get_address(const uint8_t * event, bd_addr_t address){
+    reverse_bd_addr(&event[3], address);
+}
+/**
+ * @brief Get field rssi_min from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return rssi_min
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_scan_aggregate_device_get_rssi_min(const uint8_t * event){
+    return event[9];
+}
+/**
+ * @brief Get field rssi_max from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return rssi_max
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_scan_aggregate_device_get_rssi_max(const uint8_t * event){
+    return event[10];
+}
+/**
+ * @brief Get field rssi_avg from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return rssi_avg
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_scan_aggregate_device_get_rssi_avg(const uint8_t * event){
+    return event[11];
+}
+/**
+ * @brief Get field report_count from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return report_count
+ * @note: btstack_type 4
+ */
+static inline uint32_t gap_event_scan_aggregate_device_get_report_count(const uint8_t * event){
+    return little_endian_read_32(event, 12);
+}
+/**
+ * @brief Get field first_seen_ms from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return first_seen_ms
+ * @note: btstack_type 4
+ */
+static inline uint32_t gap_event_scan_aggregate_device_get_first_seen_ms(const uint8_t * event){
+    return little_endian_read_32(event, 16);
+}
+/**
+ * @brief Get field last_seen_ms from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return last_seen_ms
+ * @note: btstack_type 4
+ */
+static inline uint32_t gap_event_scan_aggregate_device_get_last_seen_ms(const uint8_t * event){
+    return little_endian_read_32(event, 20);
+}
+/**
+ * @brief Get field data_hash from event GAP_EVENT_SCAN_AGGREGATE_DEVICE
+ * @param event packet
+ * @return data_hash
+ * @note: btstack_type 4
+ */
+static inline uint32_t gap_event_scan_aggregate_device_get_data_hash(const uint8_t * event){
+    return little_endian_read_32(event, 24);
+}
+
+/**
+ * @brief Get field num_devices from event GAP_EVENT_SCAN_AGGREGATE_COMPLETE
+ * @param event packet
+ * @return num_devices
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_scan_aggregate_complete_get_num_devices(const uint8_t * event){
+    return event[2];
+}
+/**
+ * @brief Get field num_reports_dropped from event GAP_EVENT_SCAN_AGGREGATE_COMPLETE
+ * @param event packet
+ * @return num_reports_dropped
+ * @note: btstack_type 2
+ */
+static inline uint16_t gap_event_scan_aggregate_complete_get_num_reports_dropped(const uint8_t * event){
+    return little_endian_read_16(event, 3);
+}
+
+/**
+ * @brief Get field advertising_event_type from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return advertising_event_type
+ * @note: btstack_type 2
+ */
+static inline uint16_t gap_event_extended_advertising_report_get_advertising_event_type(const uint8_t * event){
+    return little_endian_read_16(event, 2);
+}
+/**
+ * @brief Get field address_type from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return address_type
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_address_type(const uint8_t * event){
+    return event[4];
+}
+/**
+ * @brief Get field address from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @param Pointer to storage for address
+ * @note: btstack_type B
+ */
+static inline void gap_event_extended_advertising_report_get_address(const uint8_t * event, bd_addr_t address){
+    reverse_bd_addr(&event[5], address);
+}
+/**
+ * @brief Get field primary_phy from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return primary_phy
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_primary_phy(const uint8_t * event){
+    return event[11];
+}
+/**
+ * @brief Get field secondary_phy from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return secondary_phy
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_secondary_phy(const uint8_t * event){
+    return event[12];
+}
+/**
+ * @brief Get field advertising_sid from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return advertising_sid
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_advertising_sid(const uint8_t * event){
+    return event[13];
+}
+/**
+ * @brief Get field tx_power from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return tx_power
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_tx_power(const uint8_t * event){
+    return event[14];
+}
+/**
+ * @brief Get field rssi from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return rssi
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_rssi(const uint8_t * event){
+    return event[15];
+}
+/**
+ * @brief Get field periodic_advertising_interval from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return periodic_advertising_interval
+ * @note: btstack_type 2
+ */
+static inline uint16_t gap_event_extended_advertising_report_get_periodic_advertising_interval(const uint8_t * event){
+    return little_endian_read_16(event, 16);
+}
+/**
+ * @brief Get field direct_address_type from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return direct_address_type
+ * @note: btstack_type 1
+ */
+static inline uint8_t gap_event_extended_advertising_report_get_direct_address_type(const uint8_t * event){
+    return event[18];
+}
+/**
+ * @brief Get field direct_address from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @param Pointer to storage for direct_address
+ * @note: btstack_type B
+ */
+static inline void gap_event_extended_advertising_report_get_direct_address(const uint8_t * event, bd_addr_t direct_address){
+    reverse_bd_addr(&event[19], direct_address);
+}
+/**
+ * @brief Get field data_length from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return data_length
+ * @note: btstack_type L
+ */
+static inline int gap_event_extended_advertising_report_get_data_length(const uint8_t * event){
+    return little_endian_read_16(event, 25);
+}
+/**
+ * @brief Get field data from event GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+ * @param event packet
+ * @return data
+ * @note: btstack_type V
+ */
+static inline const uint8_t * gap_event_extended_advertising_report_get_data(const uint8_t * event){
+    return &event[27];
+}
+
 /**
  * @brief Get field status from event HCI_SUBEVENT_LE_CONNECTION_COMPLETE
  * @param event packet
@@ -3572,6 +3820,80 @@ static inline uint8_t hci_subevent_le_enhanced_connection_complete_get_master_cl
     return event[32];
 }
 
+/**
+ * @brief Get field status from event HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_phy_update_complete_get_status(const uint8_t * event){
+    return event[3];
+}
+/**
+ * @brief Get field connection_handle from event HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE
+ * @param event packet
+ * @return connection_handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t hci_subevent_le_phy_update_complete_get_connection_handle(const uint8_t * event){
+    return little_endian_read_16(event, 4);
+}
+/**
+ * @brief Get field tx_phy from event HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE
+ * @param event packet
+ * @return tx_phy
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_phy_update_complete_get_tx_phy(const uint8_t * event){
+    return event[6];
+}
+/**
+ * @brief Get field rx_phy from event HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE
+ * @param event packet
+ * @return rx_phy
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_phy_update_complete_get_rx_phy(const uint8_t * event){
+    return event[7];
+}
+
+/**
+ * @brief Get field status from event HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED
+ * @param event packet
+ * @return status
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_advertising_set_terminated_get_status(const uint8_t * event){
+    return event[3];
+}
+/**
+ * @brief Get field advertising_handle from event HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED
+ * @param event packet
+ * @return advertising_handle
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_advertising_set_terminated_get_advertising_handle(const uint8_t * event){
+    return event[4];
+}
+/**
+ * @brief Get field connection_handle from event HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED
+ * @param event packet
+ * @return connection_handle
+ * @note: btstack_type H
+ */
+static inline hci_con_handle_t hci_subevent_le_advertising_set_terminated_get_connection_handle(const uint8_t * event){
+    return little_endian_read_16(event, 5);
+}
+/**
+ * @brief Get field num_completed_extended_advertising_events from event HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED
+ * @param event packet
+ * @return num_completed_extended_advertising_events
+ * @note: btstack_type 1
+ */
+static inline uint8_t hci_subevent_le_advertising_set_terminated_get_num_completed_extended_advertising_events(const uint8_t * event){
+    return event[7];
+}
+
 /**
  * @brief Get field status from event HSP_SUBEVENT_RFCOMM_CONNECTION_COMPLETE
  * @param event packet
@@ -59,6 +59,7 @@ void btstack_ring_buffer_init(btstack_ring_buffer_t * ring_buffer, uint8_t * sto
     ring_buffer->last_read_index = 0;
     ring_buffer->last_written_index = 0;   
     ring_buffer->full = 0;
+    ring_buffer->mirrored = 0;
 }
 
 uint32_t btstack_ring_buffer_bytes_available(btstack_ring_buffer_t * ring_buffer){
@@ -78,6 +79,51 @@ uint32_t btstack_ring_buffer_bytes_free(btstack_ring_buffer_t * ring_buffer){
     return ring_buffer->size - btstack_ring_buffer_bytes_available(ring_buffer);
 }
 
+// get regions with data or free space starting at index
+static uint32_t btstack_ring_buffer_spans(btstack_ring_buffer_t * ring_buffer, uint32_t index, uint32_t length, uint8_t ** span_0, uint32_t * span_0_length, uint8_t ** span_1, uint32_t * span_1_length){
+    uint32_t bytes_until_end = ring_buffer->size - index;
+    *span_0 = &ring_buffer->storage[index];
+    *span_1 = &ring_buffer->storage[0];
+    if (ring_buffer->mirrored || length <= bytes_until_end){
+        *span_0_length = length;
+        *span_1_length = 0;
+    } else {
+        *span_0_length = bytes_until_end;
+        *span_1_length = length - bytes_until_end;
+    }
+    return length;
+}
+
+static uint32_t btstack_ring_buffer_advance(btstack_ring_buffer_t * ring_buffer, uint32_t index, uint32_t length){
+    index += length;
+    if (index >= ring_buffer->size){
+        index -= ring_buffer->size;
+    }
+    return index;
+}
+
+uint32_t btstack_ring_buffer_read_spans(btstack_ring_buffer_t * ring_buffer, uint8_t ** span_0, uint32_t * span_0_length, uint8_t ** span_1, uint32_t * span_1_length){
+    return btstack_ring_buffer_spans(ring_buffer, ring_buffer->last_read_index, btstack_ring_buffer_bytes_available(ring_buffer), span_0, span_0_length, span_1, span_1_length);
+}
+
+void btstack_ring_buffer_read_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length){
+    if (length == 0) return;
+    ring_buffer->last_read_index = btstack_ring_buffer_advance(ring_buffer, ring_buffer->last_read_index, length);
+    ring_buffer->full = 0;
+}
+
+uint32_t btstack_ring_buffer_write_spans(btstack_ring_buffer_t * ring_buffer, uint8_t ** span_0, uint32_t * span_0_length, uint8_t ** span_1, uint32_t * span_1_length){
+    return btstack_ring_buffer_spans(ring_buffer, ring_buffer->last_written_index, btstack_ring_buffer_bytes_free(ring_buffer), span_0, span_0_length, span_1, span_1_length);
+}
+
+void btstack_ring_buffer_write_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length){
+    if (length == 0) return;
+    ring_buffer->last_written_index = btstack_ring_buffer_advance(ring_buffer, ring_buffer->last_written_index, length);
+    if (ring_buffer->last_written_index == ring_buffer->last_read_index){
+        ring_buffer->full = 1;
+    }
+}
+
 // add byte block to ring buffer, 
 int btstack_ring_buffer_write(btstack_ring_buffer_t * ring_buffer, uint8_t * data, uint32_t data_length){
     if (btstack_ring_buffer_bytes_free(ring_buffer) < data_length){
@@ -87,29 +133,18 @@ int btstack_ring_buffer_write(btstack_ring_buffer_t * ring_buffer, uint8_t * dat
     // simplify logic below by asserting data_length > 0
     if (data_length == 0) return 0;
 
-    // copy first chunk
-    unsigned int bytes_until_end = ring_buffer->size - ring_buffer->last_written_index;
-    unsigned int bytes_to_copy = btstack_min(bytes_until_end, data_length);
-    memcpy(&ring_buffer->storage[ring_buffer->last_written_index], data, bytes_to_copy);
-    data_length -= bytes_to_copy;
-    data += bytes_to_copy;
-
-    // update last written index
-    ring_buffer->last_written_index += bytes_to_copy;
-    if (ring_buffer->last_written_index == ring_buffer->size){
-        ring_buffer->last_written_index = 0;
+    // copy into one or two chunks
+    uint8_t * span_0;
+    uint8_t * span_1;
+    uint32_t span_0_length;
+    uint32_t span_1_length;
+    btstack_ring_buffer_spans(ring_buffer, ring_buffer->last_written_index, data_length, &span_0, &span_0_length, &span_1, &span_1_length);
+    memcpy(span_0, data, span_0_length);
+    if (span_1_length){
+        memcpy(span_1, data + span_0_length, span_1_length);
     }
 
-    // copy second chunk
-    if (data_length) {
-        memcpy(&ring_buffer->storage[0], data, data_length);
-        ring_buffer->last_written_index += data_length;
-    }
-
-    // mark buffer as full
-    if (ring_buffer->last_written_index == ring_buffer->last_read_index){
-        ring_buffer->full = 1;
-    }
+    btstack_ring_buffer_write_commit(ring_buffer, data_length);
     return 0;
 } 
 
@@ -122,26 +157,17 @@ void btstack_ring_buffer_read(btstack_ring_buffer_t * ring_buffer, uint8_t * dat
     // simplify logic below by asserting data_length > 0
     if (data_length == 0) return;
 
-    // copy first chunk
-    unsigned int bytes_until_end = ring_buffer->size - ring_buffer->last_read_index;
-    unsigned int bytes_to_copy = btstack_min(bytes_until_end, data_length);
-    memcpy(data, &ring_buffer->storage[ring_buffer->last_read_index], bytes_to_copy);
-    data_length -= bytes_to_copy;
-    data += bytes_to_copy;
-
-    // update last read index
-    ring_buffer->last_read_index += bytes_to_copy;
-    if (ring_buffer->last_read_index == ring_buffer->size){
-        ring_buffer->last_read_index = 0;
-    }
-
-    // copy second chunk
-    if (data_length) {
-        memcpy(data, &ring_buffer->storage[0], data_length);
-        ring_buffer->last_read_index += data_length;
+    // copy from one or two chunks
+    uint8_t * span_0;
+    uint8_t * span_1;
+    uint32_t span_0_length;
+    uint32_t span_1_length;
+    btstack_ring_buffer_spans(ring_buffer, ring_buffer->last_read_index, data_length, &span_0, &span_0_length, &span_1, &span_1_length);
+    memcpy(data, span_0, span_0_length);
+    if (span_1_length){
+        memcpy(data + span_0_length, span_1, span_1_length);
     }
 
-    // clear full flag
-    ring_buffer->full = 0;
-} 
+    btstack_ring_buffer_read_commit(ring_buffer, data_length);
+}
 
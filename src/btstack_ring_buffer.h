@@ -54,6 +54,7 @@ typedef struct btstack_ring_buffer {
     uint32_t last_read_index;
     uint32_t last_written_index;
     uint8_t  full;
+    uint8_t  mirrored;      // storage is mapped twice back-to-back, see btstack_ring_buffer_mirrored.h
 } btstack_ring_buffer_t;
 
 /**
@@ -103,6 +104,44 @@ int btstack_ring_buffer_write(btstack_ring_buffer_t * ring_buffer, uint8_t * dat
  */
 void btstack_ring_buffer_read(btstack_ring_buffer_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read); 
 
+/**
+ * Get data available for read in place as up to two contiguous regions without consuming it
+ * @note second region is empty if data does not wrap around or if ring buffer is mirrored
+ * @param ring_buffer object
+ * @param span_0 first region
+ * @param span_0_length
+ * @param span_1 second region starting at begin of storage
+ * @param span_1_length
+ * @return number of bytes available for read = span_0_length + span_1_length
+ */
+uint32_t btstack_ring_buffer_read_spans(btstack_ring_buffer_t * ring_buffer, uint8_t ** span_0, uint32_t * span_0_length, uint8_t ** span_1, uint32_t * span_1_length);
+
+/**
+ * Consume data provided by btstack_ring_buffer_read_spans
+ * @param ring_buffer object
+ * @param length <= number of bytes available for read
+ */
+void btstack_ring_buffer_read_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length);
+
+/**
+ * Get free space for write in place as up to two contiguous regions
+ * @note second region is empty if free space does not wrap around or if ring buffer is mirrored
+ * @param ring_buffer object
+ * @param span_0 first region
+ * @param span_0_length
+ * @param span_1 second region starting at begin of storage
+ * @param span_1_length
+ * @return number of bytes available for write = span_0_length + span_1_length
+ */
+uint32_t btstack_ring_buffer_write_spans(btstack_ring_buffer_t * ring_buffer, uint8_t ** span_0, uint32_t * span_0_length, uint8_t ** span_1, uint32_t * span_1_length);
+
+/**
+ * Store data written into regions provided by btstack_ring_buffer_write_spans
+ * @param ring_buffer object
+ * @param length <= number of bytes available for write
+ */
+void btstack_ring_buffer_write_commit(btstack_ring_buffer_t * ring_buffer, uint32_t length);
+
 #if defined __cplusplus
 }
 #endif
@@ -0,0 +1,164 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+#define __BTSTACK_FILE__ "btstack_spsc_ring_buffer.c"
+
+/*
+ *  btstack_spsc_ring_buffer.c
+ *
+ */
+
+#include <string.h>
+
+#include "btstack_spsc_ring_buffer.h"
+
+#define ERROR_CODE_MEMORY_CAPACITY_EXCEEDED 0x07
+
+// acquire/release access to the indices shared between producer and consumer
+#if defined(__GNUC__) || defined(__clang__)
+#define SPSC_LOAD_ACQUIRE(index)           __atomic_load_n(index, __ATOMIC_ACQUIRE)
+#define SPSC_STORE_RELEASE(index, value)   __atomic_store_n(index, value, __ATOMIC_RELEASE)
+#else
+// other compilers: volatile access only, sufficient for single core MCUs with producer or consumer in IRQ
+#define SPSC_LOAD_ACQUIRE(index)           (*(index))
+#define SPSC_STORE_RELEASE(index, value)   (*(index) = (value))
+#endif
+
+static inline uint32_t btstack_spsc_ring_buffer_fill(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t write_index, uint32_t read_index){
+    if (write_index >= read_index) return write_index - read_index;
+    return write_index + 2 * ring_buffer->size - read_index;
+}
+
+static inline uint32_t btstack_spsc_ring_buffer_advance(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t index, uint32_t data_length){
+    index += data_length;
+    if (index >= 2 * ring_buffer->size){
+        index -= 2 * ring_buffer->size;
+    }
+    return index;
+}
+
+static inline uint32_t btstack_spsc_ring_buffer_offset(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t index){
+    if (index >= ring_buffer->size) return index - ring_buffer->size;
+    return index;
+}
+
+void btstack_spsc_ring_buffer_init(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size){
+    ring_buffer->storage = storage;
+    ring_buffer->size = storage_size;
+    ring_buffer->read_index = 0;
+    ring_buffer->write_index = 0;
+}
+
+uint32_t btstack_spsc_ring_buffer_bytes_available(btstack_spsc_ring_buffer_t * ring_buffer){
+    uint32_t write_index = SPSC_LOAD_ACQUIRE(&ring_buffer->write_index);
+    uint32_t read_index  = SPSC_LOAD_ACQUIRE(&ring_buffer->read_index);
+    return btstack_spsc_ring_buffer_fill(ring_buffer, write_index, read_index);
+}
+
+uint32_t btstack_spsc_ring_buffer_bytes_free(btstack_spsc_ring_buffer_t * ring_buffer){
+    return ring_buffer->size - btstack_spsc_ring_buffer_bytes_available(ring_buffer);
+}
+
+// producer
+
+uint8_t * btstack_spsc_ring_buffer_write_span(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length){
+    uint32_t write_index = ring_buffer->write_index;
+    uint32_t read_index  = SPSC_LOAD_ACQUIRE(&ring_buffer->read_index);
+    uint32_t bytes_free  = ring_buffer->size - btstack_spsc_ring_buffer_fill(ring_buffer, write_index, read_index);
+    uint32_t offset      = btstack_spsc_ring_buffer_offset(ring_buffer, write_index);
+    uint32_t bytes_until_end = ring_buffer->size - offset;
+    *span_length = bytes_free < bytes_until_end ? bytes_free : bytes_until_end;
+    return &ring_buffer->storage[offset];
+}
+
+void btstack_spsc_ring_buffer_write_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t data_length){
+    uint32_t write_index = btstack_spsc_ring_buffer_advance(ring_buffer, ring_buffer->write_index, data_length);
+    SPSC_STORE_RELEASE(&ring_buffer->write_index, write_index);
+}
+
+int btstack_spsc_ring_buffer_write(btstack_spsc_ring_buffer_t * ring_buffer, const uint8_t * data, uint32_t data_length){
+    if (btstack_spsc_ring_buffer_bytes_free(ring_buffer) < data_length){
+        return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    }
+    uint32_t bytes_written = 0;
+    while (bytes_written < data_length){
+        uint32_t span_length;
+        uint8_t * span = btstack_spsc_ring_buffer_write_span(ring_buffer, &span_length);
+        uint32_t bytes_to_copy = data_length - bytes_written;
+        if (bytes_to_copy > span_length){
+            bytes_to_copy = span_length;
+        }
+        memcpy(span, &data[bytes_written], bytes_to_copy);
+        btstack_spsc_ring_buffer_write_commit(ring_buffer, bytes_to_copy);
+        bytes_written += bytes_to_copy;
+    }
+    return 0;
+}
+
+// consumer
+
+const uint8_t * btstack_spsc_ring_buffer_read_span(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length){
+    uint32_t read_index  = ring_buffer->read_index;
+    uint32_t write_index = SPSC_LOAD_ACQUIRE(&ring_buffer->write_index);
+    uint32_t bytes_available = btstack_spsc_ring_buffer_fill(ring_buffer, write_index, read_index);
+    uint32_t offset      = btstack_spsc_ring_buffer_offset(ring_buffer, read_index);
+    uint32_t bytes_until_end = ring_buffer->size - offset;
+    *span_length = bytes_available < bytes_until_end ? bytes_available : bytes_until_end;
+    return &ring_buffer->storage[offset];
+}
+
+void btstack_spsc_ring_buffer_read_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t data_length){
+    uint32_t read_index = btstack_spsc_ring_buffer_advance(ring_buffer, ring_buffer->read_index, data_length);
+    SPSC_STORE_RELEASE(&ring_buffer->read_index, read_index);
+}
+
+void btstack_spsc_ring_buffer_read(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * data, uint32_t data_length, uint32_t * number_of_bytes_read){
+    uint32_t bytes_read = 0;
+    while (bytes_read < data_length){
+        uint32_t span_length;
+        const uint8_t * span = btstack_spsc_ring_buffer_read_span(ring_buffer, &span_length);
+        if (span_length == 0) break;
+        uint32_t bytes_to_copy = data_length - bytes_read;
+        if (bytes_to_copy > span_length){
+            bytes_to_copy = span_length;
+        }
+        memcpy(&data[bytes_read], span, bytes_to_copy);
+        btstack_spsc_ring_buffer_read_commit(ring_buffer, bytes_to_copy);
+        bytes_read += bytes_to_copy;
+    }
+    *number_of_bytes_read = bytes_read;
+}
@@ -0,0 +1,144 @@
+/*
+ * Copyright (C) 2019 BlueKitchen GmbH
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ *
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the copyright holders nor the names of
+ *    contributors may be used to endorse or promote products derived
+ *    from this software without specific prior written permission.
+ * 4. Any redistribution, use, or modification is done solely for
+ *    personal benefit and not for any commercial purpose or for
+ *    monetary gain.
+ *
+ * THIS SOFTWARE IS PROVIDED BY BLUEKITCHEN GMBH AND CONTRIBUTORS
+ * ``AS IS'' AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT
+ * LIMITED TO, THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS
+ * FOR A PARTICULAR PURPOSE ARE DISCLAIMED. IN NO EVENT SHALL MATTHIAS
+ * RINGWALD OR CONTRIBUTORS BE LIABLE FOR ANY DIRECT, INDIRECT,
+ * INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL DAMAGES (INCLUDING,
+ * BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR SERVICES; LOSS
+ * OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER CAUSED
+ * AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT LIABILITY,
+ * OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY OUT OF
+ * THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ *
+ * Please inquire about commercial licensing options at 
+ * contact@bluekitchen-gmbh.com
+ *
+ */
+
+/*
+ *  btstack_spsc_ring_buffer.h
+ *
+ *  Lock-free single-producer/single-consumer ring buffer
+ *
+ *  Producer and consumer may run in different threads or in IRQ and main context
+ *  without additional locking. Each side only modifies its own index. Data is
+ *  published by storing the index with release semantics after the data has
+ *  been written, and observed by loading the other index with acquire semantics.
+ *
+ *  Read and write spans provide direct access to the storage to avoid copies.
+ */
+
+#ifndef __BTSTACK_SPSC_RING_BUFFER_H
+#define __BTSTACK_SPSC_RING_BUFFER_H
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+#include <stdint.h>
+
+typedef struct btstack_spsc_ring_buffer {
+    uint8_t  * storage;
+    uint32_t size;
+    // indices run in [0, 2 * size) to distinguish full from empty without a flag
+    volatile uint32_t read_index;       // modified by consumer only
+    volatile uint32_t write_index;      // modified by producer only
+} btstack_spsc_ring_buffer_t;
+
+/**
+ * Init ring buffer. Must be called before producer and consumer start using it
+ * @param ring_buffer object
+ * @param storage
+ * @param storage_size in bytes
+ */
+void btstack_spsc_ring_buffer_init(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * storage, uint32_t storage_size);
+
+/**
+ * Get number of bytes available for read. Exact for consumer, lower bound for producer
+ * @param ring_buffer object
+ * @return number of bytes available for read
+ */
+uint32_t btstack_spsc_ring_buffer_bytes_available(btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Get free space available for write. Exact for producer, lower bound for consumer
+ * @param ring_buffer object
+ * @return number of bytes available for write
+ */
+uint32_t btstack_spsc_ring_buffer_bytes_free(btstack_spsc_ring_buffer_t * ring_buffer);
+
+/**
+ * Producer: write bytes into ring buffer
+ * @param ring_buffer object
+ * @param data to store
+ * @param data_length
+ * @return 0 if ok, ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if not enough space in buffer
+ */
+int btstack_spsc_ring_buffer_write(btstack_spsc_ring_buffer_t * ring_buffer, const uint8_t * data, uint32_t data_length);
+
+/**
+ * Producer: get contiguous free region at write position
+ * @note region may be smaller than btstack_spsc_ring_buffer_bytes_free if it wraps around
+ * @param ring_buffer object
+ * @param span_length of free region
+ * @return pointer to free region
+ */
+uint8_t * btstack_spsc_ring_buffer_write_span(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length);
+
+/**
+ * Producer: publish data written into region returned by btstack_spsc_ring_buffer_write_span
+ * @param ring_buffer object
+ * @param data_length <= span_length
+ */
+void btstack_spsc_ring_buffer_write_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t data_length);
+
+/**
+ * Consumer: read from ring buffer
+ * @param ring_buffer object
+ * @param buffer to store read data
+ * @param length to read
+ * @param number_of_bytes_read
+ */
+void btstack_spsc_ring_buffer_read(btstack_spsc_ring_buffer_t * ring_buffer, uint8_t * buffer, uint32_t length, uint32_t * number_of_bytes_read);
+
+/**
+ * Consumer: get contiguous region of available data at read position
+ * @note region may be smaller than btstack_spsc_ring_buffer_bytes_available if it wraps around
+ * @param ring_buffer object
+ * @param span_length of available data
+ * @return pointer to available data
+ */
+const uint8_t * btstack_spsc_ring_buffer_read_span(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t * span_length);
+
+/**
+ * Consumer: release data returned by btstack_spsc_ring_buffer_read_span
+ * @param ring_buffer object
+ * @param data_length <= span_length
+ */
+void btstack_spsc_ring_buffer_read_commit(btstack_spsc_ring_buffer_t * ring_buffer, uint32_t data_length);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif // __BTSTACK_SPSC_RING_BUFFER_H
@@ -61,6 +61,9 @@ static avdtp_sep_t remote_seps[AVDTP_MAX_SEP_NUM];
 static int remote_seps_index = 0;
 
 static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+static void a2dp_source_send_media_packet(avdtp_stream_endpoint_t * stream_endpoint, const uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
+static int  a2dp_source_broadcast_handle_can_send_now(avdtp_stream_endpoint_t * stream_endpoint);
+static void a2dp_source_broadcast_emit_can_send_now(void);
 
 void a2dp_source_create_sdp_record(uint8_t * service, uint32_t service_record_handle, uint16_t supported_features, const char * service_name, const char * service_provider_name){
     uint8_t* attribute;
@@ -324,6 +327,8 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
        
         case AVDTP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW: 
             cid = avdtp_subevent_streaming_can_send_media_packet_now_get_avdtp_cid(packet);
+            local_seid = avdtp_subevent_streaming_can_send_media_packet_now_get_local_seid(packet);
+            if (a2dp_source_broadcast_handle_can_send_now(avdtp_stream_endpoint_for_seid(local_seid, &a2dp_source_context))) break;
             a2dp_streaming_emit_can_send_media_packet_now(a2dp_source_context.a2dp_callback, cid, 0);
             break;
         
@@ -432,6 +437,8 @@ static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packe
         }
         case AVDTP_SUBEVENT_STREAMING_CONNECTION_RELEASED:{
             app_state = A2DP_IDLE;
+            // released stream endpoint might have been the last one a broadcast was waiting for
+            a2dp_source_broadcast_emit_can_send_now();
             uint8_t event[6];
             int pos = 0;
             event[pos++] = HCI_EVENT_A2DP_META;
@@ -575,30 +582,29 @@ static void a2dp_source_setup_media_header(uint8_t * media_packet, int size, int
     *offset = pos;
 }
 
-void a2dp_source_stream_endpoint_request_can_send_now(uint16_t a2dp_cid, uint8_t local_seid){
+static avdtp_stream_endpoint_t * a2dp_source_stream_endpoint_for_cid_and_seid(uint16_t a2dp_cid, uint8_t local_seid){
     avdtp_stream_endpoint_t * stream_endpoint = avdtp_stream_endpoint_for_seid(local_seid, &a2dp_source_context);
     if (!stream_endpoint) {
         log_error("A2DP source: no stream_endpoint with seid %d", local_seid);
-        return;
+        return NULL;
     }
-    if (a2dp_source_context.avdtp_cid != a2dp_cid){
-        log_error("A2DP source: a2dp cid 0x%02x not known, expected 0x%02x", a2dp_cid, a2dp_source_context.avdtp_cid);
-        return;
+    if (!stream_endpoint->connection || stream_endpoint->connection->avdtp_cid != a2dp_cid){
+        log_error("A2DP source: a2dp cid 0x%02x not known for seid %d", a2dp_cid, local_seid);
+        return NULL;
     }
+    return stream_endpoint;
+}
+
+void a2dp_source_stream_endpoint_request_can_send_now(uint16_t a2dp_cid, uint8_t local_seid){
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_stream_endpoint_for_cid_and_seid(a2dp_cid, local_seid);
+    if (!stream_endpoint) return;
     stream_endpoint->send_stream = 1;
     avdtp_request_can_send_now_initiator(stream_endpoint->connection, stream_endpoint->l2cap_media_cid);
 }
 
 int a2dp_max_media_payload_size(uint16_t a2dp_cid, uint8_t local_seid){
-    avdtp_stream_endpoint_t * stream_endpoint = avdtp_stream_endpoint_for_seid(local_seid, &a2dp_source_context);
-    if (!stream_endpoint) {
-        log_error("A2DP source: no stream_endpoint with seid %d", local_seid);
-        return 0;
-    }
-    if (a2dp_source_context.avdtp_cid != a2dp_cid){
-        log_error("A2DP source: a2dp cid 0x%02x not known, expected 0x%02x", a2dp_cid, a2dp_source_context.avdtp_cid);
-        return 0;
-    }
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_stream_endpoint_for_cid_and_seid(a2dp_cid, local_seid);
+    if (!stream_endpoint) return 0;
 
     if (stream_endpoint->l2cap_media_cid == 0){
         log_error("A2DP source: no media connection for seid %d", local_seid);
@@ -607,7 +613,7 @@ int a2dp_max_media_payload_size(uint16_t a2dp_cid, uint8_t local_seid){
     return l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid) - AVDTP_MEDIA_PAYLOAD_HEADER_SIZE;
 }
 
-static void a2dp_source_copy_media_payload(uint8_t * media_packet, int size, int * offset, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames){
+static void a2dp_source_copy_media_payload(uint8_t * media_packet, int size, int * offset, const uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames){
     if (size < num_bytes_to_copy + 1){
         log_error("small outgoing buffer: buffer size %u, but need %u", size, num_bytes_to_copy + 1);
         return;
@@ -620,31 +626,120 @@ static void a2dp_source_copy_media_payload(uint8_t * media_packet, int size, int
     *offset = pos;
 }
 
-int a2dp_source_stream_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
-    avdtp_stream_endpoint_t * stream_endpoint = avdtp_stream_endpoint_for_seid(local_seid, &a2dp_source_context);
-    if (!stream_endpoint) {
-        log_error("A2DP source: no stream_endpoint with seid %d", local_seid);
-        return 0;
-    }
-    if (a2dp_source_context.avdtp_cid != a2dp_cid){
-        log_error("A2DP source: a2dp cid 0x%02x not known, expected 0x%02x", a2dp_cid, a2dp_source_context.avdtp_cid);
-        return 0;
-    }
-
-    if (stream_endpoint->l2cap_media_cid == 0){
-        log_error("A2DP source: no media connection for seid %d", local_seid);
-        return 0;
-    } 
-
+static void a2dp_source_send_media_packet(avdtp_stream_endpoint_t * stream_endpoint, const uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
     int size = l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid);
     int offset = 0;
 
     l2cap_reserve_packet_buffer();
     uint8_t * media_packet = l2cap_get_outgoing_buffer();
-    //int size = l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid);
     a2dp_source_setup_media_header(media_packet, size, &offset, marker, stream_endpoint->sequence_number);
     a2dp_source_copy_media_payload(media_packet, size, &offset, storage, num_bytes_to_copy, num_frames);
     stream_endpoint->sequence_number++;
     l2cap_send_prepared(stream_endpoint->l2cap_media_cid, offset);
-    return size;
+}
+
+int a2dp_source_stream_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_stream_endpoint_for_cid_and_seid(a2dp_cid, local_seid);
+    if (!stream_endpoint) return 0;
+
+    if (stream_endpoint->l2cap_media_cid == 0){
+        log_error("A2DP source: no media connection for seid %d", local_seid);
+        return 0;
+    } 
+
+    a2dp_source_send_media_packet(stream_endpoint, storage, num_bytes_to_copy, num_frames, marker);
+    return l2cap_get_remote_mtu_for_local_cid(stream_endpoint->l2cap_media_cid);
+}
+
+// Broadcast: all local source stream endpoints that stream with the configuration of the one used 
+// by the application share the same encoded payload. Each sink has its own sequence number and 
+// L2CAP flow control, the application gets a single can send now for the whole group.
+
+static int a2dp_source_broadcast_is_member(avdtp_stream_endpoint_t * stream_endpoint, avdtp_stream_endpoint_t * reference){
+    if (stream_endpoint->sep.type != AVDTP_SOURCE) return 0;
+    if (stream_endpoint->state != AVDTP_STREAM_ENDPOINT_STREAMING) return 0;
+    if (stream_endpoint->l2cap_media_cid == 0) return 0;
+    if (stream_endpoint == reference) return 1;
+    adtvp_media_codec_capabilities_t * config_a = &stream_endpoint->remote_sep.configuration.media_codec;
+    adtvp_media_codec_capabilities_t * config_b = &reference->remote_sep.configuration.media_codec;
+    if (config_a->media_type != config_b->media_type) return 0;
+    if (config_a->media_codec_type != config_b->media_codec_type) return 0;
+    if (config_a->media_codec_information_len != config_b->media_codec_information_len) return 0;
+    if (!config_a->media_codec_information || !config_b->media_codec_information) return 0;
+    return memcmp(config_a->media_codec_information, config_b->media_codec_information, config_a->media_codec_information_len) == 0;
+}
+
+static int a2dp_source_broadcast_pending(avdtp_stream_endpoint_t * reference){
+    btstack_linked_list_iterator_t it;    
+    btstack_linked_list_iterator_init(&it, &a2dp_source_context.stream_endpoints);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        avdtp_stream_endpoint_t * stream_endpoint = (avdtp_stream_endpoint_t *)btstack_linked_list_iterator_next(&it);
+        if (!stream_endpoint->broadcast_payload) continue;
+        if (a2dp_source_broadcast_is_member(stream_endpoint, reference)) return 1;
+    }
+    return 0;
+}
+
+static void a2dp_source_broadcast_emit_can_send_now(void){
+    btstack_linked_list_iterator_t it;    
+    btstack_linked_list_iterator_init(&it, &a2dp_source_context.stream_endpoints);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        avdtp_stream_endpoint_t * stream_endpoint = (avdtp_stream_endpoint_t *)btstack_linked_list_iterator_next(&it);
+        if (!stream_endpoint->broadcast_can_send_now) continue;
+        if (a2dp_source_broadcast_pending(stream_endpoint)) continue;
+        stream_endpoint->broadcast_can_send_now = 0;
+        if (!stream_endpoint->connection) continue;
+        a2dp_streaming_emit_can_send_media_packet_now(a2dp_source_context.a2dp_callback, stream_endpoint->connection->avdtp_cid, avdtp_stream_endpoint_seid(stream_endpoint));
+    }
+}
+
+static int a2dp_source_broadcast_handle_can_send_now(avdtp_stream_endpoint_t * stream_endpoint){
+    if (!stream_endpoint) return 0;
+    if (!stream_endpoint->broadcast_payload && !stream_endpoint->broadcast_can_send_now) return 0;
+    if (stream_endpoint->broadcast_payload){
+        const uint8_t * payload = stream_endpoint->broadcast_payload;
+        stream_endpoint->broadcast_payload = NULL;
+        a2dp_source_send_media_packet(stream_endpoint, payload, stream_endpoint->broadcast_payload_len, 
+            stream_endpoint->broadcast_num_frames, stream_endpoint->broadcast_marker);
+    }
+    a2dp_source_broadcast_emit_can_send_now();
+    return 1;
+}
+
+void a2dp_source_broadcast_request_can_send_now(uint16_t a2dp_cid, uint8_t local_seid){
+    avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_stream_endpoint_for_cid_and_seid(a2dp_cid, local_seid);
+    if (!stream_endpoint) return;
+    stream_endpoint->broadcast_can_send_now = 1;
+    if (a2dp_source_broadcast_pending(stream_endpoint)) return;
+    // nothing pending, emit from own can send now to avoid recursion
+    stream_endpoint->send_stream = 1;
+    avdtp_request_can_send_now_initiator(stream_endpoint->connection, stream_endpoint->l2cap_media_cid);
+}
+
+int a2dp_source_broadcast_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, const uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker){
+    avdtp_stream_endpoint_t * reference = a2dp_source_stream_endpoint_for_cid_and_seid(a2dp_cid, local_seid);
+    if (!reference) return 0;
+
+    int num_sinks = 0;
+    btstack_linked_list_iterator_t it;    
+    btstack_linked_list_iterator_init(&it, &a2dp_source_context.stream_endpoints);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        avdtp_stream_endpoint_t * stream_endpoint = (avdtp_stream_endpoint_t *)btstack_linked_list_iterator_next(&it);
+        if (!a2dp_source_broadcast_is_member(stream_endpoint, reference)) continue;
+        if (num_bytes_to_copy + 1 > a2dp_max_media_payload_size(stream_endpoint->connection->avdtp_cid, avdtp_stream_endpoint_seid(stream_endpoint))){
+            log_error("A2DP source: broadcast payload %u too large for seid %d", num_bytes_to_copy, avdtp_stream_endpoint_seid(stream_endpoint));
+            continue;
+        }
+        if (stream_endpoint->broadcast_payload){
+            log_error("A2DP source: broadcast payload for seid %d not sent yet, dropped", avdtp_stream_endpoint_seid(stream_endpoint));
+        }
+        stream_endpoint->broadcast_payload     = storage;
+        stream_endpoint->broadcast_payload_len = num_bytes_to_copy;
+        stream_endpoint->broadcast_num_frames  = num_frames;
+        stream_endpoint->broadcast_marker      = marker;
+        stream_endpoint->send_stream = 1;
+        avdtp_request_can_send_now_initiator(stream_endpoint->connection, stream_endpoint->l2cap_media_cid);
+        num_sinks++;
+    }
+    return num_sinks;
 }
@@ -163,6 +163,29 @@ int 	a2dp_max_media_payload_size(uint16_t a2dp_cid, uint8_t local_seid);
  */
 int  	a2dp_source_stream_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
 
+/**
+ * @brief Request to send a media packet to all sinks that stream with the same media codec configuration as the given stream endpoint.
+ * A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW is emitted for this a2dp_cid and local_seid after the previous 
+ * broadcast payload was sent to all of them.
+ * @param a2dp_cid 			A2DP channel identifyer.
+ * @param local_seid  		ID of a local stream endpoint.
+ */
+void 	a2dp_source_broadcast_request_can_send_now(uint16_t a2dp_cid, uint8_t local_seid);
+
+/**
+ * @brief Send the same encoded media payload to all sinks that stream with the same media codec configuration as the given stream endpoint.
+ * Each sink uses its own sequence number and the payload is sent as soon as its media channel can send. 
+ * @note storage must stay valid until the next A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW for this stream endpoint.
+ * @param a2dp_cid 			A2DP channel identifyer.
+ * @param local_seid  		ID of a local stream endpoint.
+ * @param storage
+ * @param num_bytes_to_copy
+ * @param num_frames
+ * @param marker
+ * @return number of sinks the payload was queued for
+ */
+int  	a2dp_source_broadcast_send_media_payload(uint16_t a2dp_cid, uint8_t local_seid, const uint8_t * storage, int num_bytes_to_copy, uint8_t num_frames, uint8_t marker);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -492,6 +492,13 @@ typedef struct avdtp_stream_endpoint {
     uint8_t abort_stream;
     uint8_t suspend_stream;
     uint16_t sequence_number;
+
+    // A2DP Source broadcast: payload shared with all stream endpoints using the same configuration
+    const uint8_t * broadcast_payload;
+    uint16_t broadcast_payload_len;
+    uint8_t  broadcast_num_frames;
+    uint8_t  broadcast_marker;
+    uint8_t  broadcast_can_send_now;
 } avdtp_stream_endpoint_t;
 
 typedef struct {
@@ -79,7 +79,7 @@ void avdtp_initiator_stream_config_subsm(avdtp_connection_t * connection, uint8_
     if (connection->initiator_connection_state == AVDTP_SIGNALING_CONNECTION_INITIATOR_W4_ANSWER) {
         connection->initiator_connection_state = AVDTP_SIGNALING_CONNECTION_INITIATOR_IDLE;
     } else {
-        stream_endpoint = avdtp_stream_endpoint_associated_with_acp_seid(connection->remote_seid, context);
+        stream_endpoint = avdtp_stream_endpoint_associated_with_acp_seid(connection->remote_seid, connection, context);
         if (!stream_endpoint){
             stream_endpoint = avdtp_stream_endpoint_with_seid(connection->local_seid, context);
         }
@@ -315,7 +315,7 @@ void avdtp_initiator_stream_config_subsm_run(avdtp_connection_t * connection, av
     
     avdtp_stream_endpoint_t * stream_endpoint = NULL;
     
-    stream_endpoint = avdtp_stream_endpoint_associated_with_acp_seid(connection->remote_seid, context);
+    stream_endpoint = avdtp_stream_endpoint_associated_with_acp_seid(connection->remote_seid, connection, context);
     if (!stream_endpoint){
         stream_endpoint = avdtp_stream_endpoint_with_seid(connection->local_seid, context);
     }
@@ -97,6 +97,9 @@ void avdtp_reset_stream_endpoint(avdtp_stream_endpoint_t * stream_endpoint){
     stream_endpoint->abort_stream = 0;
     stream_endpoint->suspend_stream = 0;
     stream_endpoint->sequence_number = 0;
+
+    stream_endpoint->broadcast_payload = NULL;
+    stream_endpoint->broadcast_can_send_now = 0;
 }
 
 avdtp_stream_endpoint_t * avdtp_stream_endpoint_for_seid(uint16_t seid, avdtp_context_t * context){
@@ -188,11 +191,13 @@ avdtp_stream_endpoint_t * avdtp_stream_endpoint_with_seid(uint8_t seid, avdtp_co
     return NULL;
 }
 
-avdtp_stream_endpoint_t * avdtp_stream_endpoint_associated_with_acp_seid(uint16_t acp_seid, avdtp_context_t * context){
+avdtp_stream_endpoint_t * avdtp_stream_endpoint_associated_with_acp_seid(uint16_t acp_seid, avdtp_connection_t * connection, avdtp_context_t * context){
     btstack_linked_list_iterator_t it;    
     btstack_linked_list_iterator_init(&it, &context->stream_endpoints);
     while (btstack_linked_list_iterator_has_next(&it)){
         avdtp_stream_endpoint_t * stream_endpoint = (avdtp_stream_endpoint_t *)btstack_linked_list_iterator_next(&it);
+        // stream endpoints in use by other connections have the same remote seid, e.g. when streaming to several sinks
+        if (stream_endpoint->connection && stream_endpoint->connection != connection) continue;
         if (stream_endpoint->remote_sep.seid == acp_seid){
             return stream_endpoint;
         }
@@ -50,6 +50,17 @@
 #include "btstack_cvsd_plc.h"
 #include "btstack_debug.h"
 
+// SIMD kernels for fixed-point pattern matching, selected by compiler target
+#ifdef ENABLE_PLC_FIXED_POINT
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define CVSD_PLC_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define CVSD_PLC_USE_SSE2
+#endif
+#endif
+
 // static float rcos[CVSD_OLAL] = {
 //     0.99148655f,0.96623611f,0.92510857f,0.86950446f,
 //     0.80131732f,0.72286918f,0.63683150f,0.54613418f, 
@@ -105,7 +116,7 @@ static float btstack_cvsd_plc_cross_correlation(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *
     return num/den;
 }
 
-int btstack_cvsd_plc_pattern_match(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
+int btstack_cvsd_plc_pattern_match_float(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
     float maxCn = -999999.0;  // large negative number
     int   bestmatch = 0;
     float Cn;
@@ -120,6 +131,108 @@ int btstack_cvsd_plc_pattern_match(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
     return bestmatch;
 }
 
+// exact dot product of CVSD_M samples. pattern x must not contain -32768, 
+// so that two products always fit into an int32 (required for SSE2 madd)
+static int64_t btstack_cvsd_plc_dot_product(const int16_t *x, const int16_t *y){
+    int m;
+#if defined(CVSD_PLC_USE_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (m=0;m<CVSD_M;m+=4){
+        acc = vpadalq_s32(acc, vmull_s16(vld1_s16(&x[m]), vld1_s16(&y[m])));
+    }
+    return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+#elif defined(CVSD_PLC_USE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (m=0;m<CVSD_M;m+=8){
+        __m128i prod = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &x[m]), _mm_loadu_si128((const __m128i *) &y[m]));
+        __m128i sign = _mm_srai_epi32(prod, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(prod, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(prod, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, acc);
+    return lanes[0] + lanes[1];
+#else
+    int64_t sum = 0;
+    for (m=0;m<CVSD_M;m++){
+        sum += (int32_t) x[m] * y[m];
+    }
+    return sum;
+#endif
+}
+
+// floor(sqrt(x)), bitwise
+static uint32_t btstack_cvsd_plc_isqrt(uint64_t x){
+    uint64_t res = 0;
+    uint64_t bit = ((uint64_t) 1) << 62;
+    while (bit > x){
+        bit >>= 2;
+    }
+    while (bit){
+        if (x >= res + bit){
+            x  -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) res;
+}
+
+// The template energy x2 is the same for all lags, so maximizing num / sqrt(x2*y2) is the same as
+// maximizing num / sqrt(y2). Candidates are compared by cross multiplication, which needs no division:
+// |num| < 2^35 and sqrt(y2 << 8) < 2^22, so the products fit into an int64
+int btstack_cvsd_plc_pattern_match_fixed_point(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
+    int16_t pattern[CVSD_M];
+    int64_t x2 = 0;
+    int64_t y2 = 0;
+    int64_t num;
+    int64_t den;
+    int64_t max_num = 0;
+    int64_t max_den = 1;
+    int   bestmatch = 0;
+    int   m;
+    int   n;
+
+    // copy template and compute its energy once
+    for (m=0;m<CVSD_M;m++){
+        int16_t sample = y[CVSD_LHIST-CVSD_M+m];
+        if (sample == -32768) sample = -32767;
+        pattern[m] = sample;
+        x2 += (int32_t) sample * sample;
+        y2 += (int32_t) y[m] * y[m];
+    }
+
+    for (n=0;n<CVSD_N;n++){
+        // energy of window y[n..n+M-1] is updated incrementally
+        if (n > 0){
+            y2 += (int32_t) y[n+CVSD_M-1] * y[n+CVSD_M-1] - (int32_t) y[n-1] * y[n-1];
+        }
+        // correlation is 0 if template or window is silent
+        num = 0;
+        den = 1;
+        if ((x2 > 0) && (y2 > 0)){
+            num = btstack_cvsd_plc_dot_product(pattern, &y[n]);
+            den = btstack_cvsd_plc_isqrt(((uint64_t) y2) << 8);
+        }
+        if ((n == 0) || (num * max_den > max_num * den)){
+            bestmatch = n;
+            max_num = num;
+            max_den = den;
+        }
+    }
+    return bestmatch;
+}
+
+int btstack_cvsd_plc_pattern_match(BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y){
+#ifdef ENABLE_PLC_FIXED_POINT
+    return btstack_cvsd_plc_pattern_match_fixed_point(y);
+#else
+    return btstack_cvsd_plc_pattern_match_float(y);
+#endif
+}
+
 float btstack_cvsd_plc_amplitude_match(btstack_cvsd_plc_state_t *plc_state, uint16_t num_samples, BTSTACK_CVSD_PLC_SAMPLE_FORMAT *y, BTSTACK_CVSD_PLC_SAMPLE_FORMAT bestmatch){
     UNUSED(plc_state);
     int   i;
@@ -319,7 +432,7 @@ void btstack_cvsd_plc_bad_frame(btstack_cvsd_plc_state_t *plc_state, uint16_t nu
 #endif
 
     if (plc_state->nbf==1){
-        // the replication begins after the template match
+        // the replication begins after the pattern match
         plc_state->bestlag += CVSD_M; 
         
         // Compute Scale Factor to Match Amplitude of Substitution Packet to that of Preceding Packet
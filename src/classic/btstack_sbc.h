@@ -150,6 +150,31 @@ uint16_t  btstack_sbc_encoder_sbc_buffer_length(void);
  */
 int  btstack_sbc_encoder_num_audio_frames(void);
 
+/**
+ * @brief Encode PCM data with encoder instance initialized by btstack_sbc_encoder_instance_init
+ * @param state
+ * @param buffer with samples in host endianess
+ */
+void btstack_sbc_encoder_instance_process_data(btstack_sbc_encoder_state_t * state, int16_t * input_buffer);
+
+/**
+ * @brief Return SBC frame of encoder instance
+ * @param state
+ */
+uint8_t * btstack_sbc_encoder_instance_sbc_buffer(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Return SBC frame length of encoder instance
+ * @param state
+ */
+uint16_t  btstack_sbc_encoder_instance_sbc_buffer_length(btstack_sbc_encoder_state_t * state);
+
+/**
+ * @brief Return number of audio frames required for one SBC packet of encoder instance
+ * @param state
+ */
+int  btstack_sbc_encoder_instance_num_audio_frames(btstack_sbc_encoder_state_t * state);
+
 /* API_END */
 
 // testing only
@@ -51,6 +51,7 @@
 #include <string.h>
 
 #include "btstack_sbc.h"
+#include "btstack_sbc_bludroid.h"
 #include "btstack_sbc_plc.h"
 
 #include "oi_codec_sbc.h"
@@ -59,25 +60,8 @@
 
 #define mSBC_SYNCWORD 0xad
 #define SBC_SYNCWORD 0x9c
-#define SBC_MAX_CHANNELS 2
 // #define LOG_FRAME_STATUS
 
-#define DECODER_DATA_SIZE (SBC_MAX_CHANNELS*SBC_MAX_BLOCKS*SBC_MAX_BANDS * 4 + SBC_CODEC_MIN_FILTER_BUFFERS*SBC_MAX_BANDS*SBC_MAX_CHANNELS * 2)
-
-typedef struct {
-    OI_UINT32 bytes_in_frame_buffer;
-    OI_CODEC_SBC_DECODER_CONTEXT decoder_context;
-    
-    uint8_t   frame_buffer[SBC_MAX_FRAME_LEN];
-    int16_t   pcm_plc_data[SBC_MAX_CHANNELS * SBC_MAX_BANDS * SBC_MAX_BLOCKS];
-    int16_t   pcm_data[SBC_MAX_CHANNELS * SBC_MAX_BANDS * SBC_MAX_BLOCKS];
-    uint32_t  pcm_bytes;
-    OI_UINT32 decoder_data[(DECODER_DATA_SIZE+3)/4]; 
-    int       first_good_frame_found; 
-    int       h2_sequence_nr;
-    uint16_t  msbc_bad_bytes;
-} bludroid_decoder_state_t;
-
 static btstack_sbc_decoder_state_t * sbc_decoder_state_singleton = NULL;
 static bludroid_decoder_state_t bd_decoder_state;
 
@@ -158,18 +142,16 @@ void OI_AssertFail(const char* file, int line, const char* reason){
 }
 #endif
 
-void btstack_sbc_decoder_init(btstack_sbc_decoder_state_t * state, btstack_sbc_mode_t mode, void (*callback)(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context), void * context){
-    if (sbc_decoder_state_singleton && sbc_decoder_state_singleton != state ){
-        log_error("SBC decoder: different sbc decoder state is allready registered");
-    } 
+void btstack_sbc_decoder_instance_init(btstack_sbc_decoder_state_t * state, bludroid_decoder_state_t * storage, btstack_sbc_mode_t mode,
+                        void (*callback)(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context), void * context){
     OI_STATUS status = OI_STATUS_SUCCESS;
     switch (mode){
         case SBC_MODE_STANDARD:
             // note: we always request stereo output, even for mono input
-            status = OI_CODEC_SBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data), 2, 2, FALSE);
+            status = OI_CODEC_SBC_DecoderReset(&(storage->decoder_context), storage->decoder_data, sizeof(storage->decoder_data), 2, 2, FALSE);
             break;
         case SBC_MODE_mSBC:
-            status = OI_CODEC_mSBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data));
+            status = OI_CODEC_mSBC_DecoderReset(&(storage->decoder_context), storage->decoder_data, sizeof(storage->decoder_data));
             break;
         default:
             break;
@@ -179,21 +161,27 @@ void btstack_sbc_decoder_init(btstack_sbc_decoder_state_t * state, btstack_sbc_m
         log_error("SBC decoder: error during reset %d\n", status);
     }
     
-    sbc_decoder_state_singleton = state;
-    
-    bd_decoder_state.bytes_in_frame_buffer = 0;
-    bd_decoder_state.pcm_bytes = sizeof(bd_decoder_state.pcm_data);
-    bd_decoder_state.h2_sequence_nr = -1;
-    bd_decoder_state.first_good_frame_found = 0;
+    storage->bytes_in_frame_buffer = 0;
+    storage->pcm_bytes = sizeof(storage->pcm_data);
+    storage->h2_sequence_nr = -1;
+    storage->first_good_frame_found = 0;
 
     memset(state, 0, sizeof(btstack_sbc_decoder_state_t));
     state->handle_pcm_data = callback;
     state->mode = mode;
     state->context = context;
-    state->decoder_state = &bd_decoder_state;
+    state->decoder_state = storage;
     btstack_sbc_plc_init(&state->plc_state);
 }
 
+void btstack_sbc_decoder_init(btstack_sbc_decoder_state_t * state, btstack_sbc_mode_t mode, void (*callback)(int16_t * data, int num_samples, int num_channels, int sample_rate, void * context), void * context){
+    if (sbc_decoder_state_singleton && sbc_decoder_state_singleton != state ){
+        log_error("SBC decoder: different sbc decoder state is allready registered");
+    } 
+    sbc_decoder_state_singleton = state;
+    btstack_sbc_decoder_instance_init(state, &bd_decoder_state, mode, callback, context);
+}
+
 static void append_received_sbc_data(bludroid_decoder_state_t * state, uint8_t * buffer, int size){
     int numFreeBytes = sizeof(state->frame_buffer) - state->bytes_in_frame_buffer;
 
@@ -295,7 +283,7 @@ static void btstack_sbc_decoder_process_sbc_data(btstack_sbc_decoder_state_t * s
                 // The codec apparently does not recover from this.
                 // Re-initialize the codec.
                 log_info("SBC decode: invalid parameters: resetting codec");
-                if (OI_CODEC_SBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data), 2, 2, FALSE) != OI_STATUS_SUCCESS){
+                if (OI_CODEC_SBC_DecoderReset(&(decoder_state->decoder_context), decoder_state->decoder_data, sizeof(decoder_state->decoder_data), 2, 2, FALSE) != OI_STATUS_SUCCESS){
                     log_info("SBC decode: resetting codec failed");
                     
                 }
@@ -514,7 +502,7 @@ static void btstack_sbc_decoder_process_msbc_data(btstack_sbc_decoder_state_t *
                 // The codec apparently does not recover from this.
                 // Re-initialize the codec.
                 log_info("SBC decode: invalid parameters: resetting codec");
-                if (OI_CODEC_mSBC_DecoderReset(&(bd_decoder_state.decoder_context), bd_decoder_state.decoder_data, sizeof(bd_decoder_state.decoder_data)) != OI_STATUS_SUCCESS){
+                if (OI_CODEC_mSBC_DecoderReset(&(decoder_state->decoder_context), decoder_state->decoder_data, sizeof(decoder_state->decoder_data)) != OI_STATUS_SUCCESS){
                     log_info("SBC decode: resetting codec failed");
                 }
                 break;
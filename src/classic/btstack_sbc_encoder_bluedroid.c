@@ -51,86 +51,64 @@
 #include <string.h>
 
 #include "btstack_sbc.h"
+#include "btstack_sbc_bludroid.h"
 #include "btstack_sbc_plc.h"
 
 #include "sbc_encoder.h"
 #include "btstack.h"
 
-#define mSBC_SYNCWORD 0xad
-#define SBC_SYNCWORD 0x9c
-#define SBC_MAX_CHANNELS 2
-// #define LOG_FRAME_STATUS
-
-
-typedef struct {
-    SBC_ENC_PARAMS context;
-    int num_data_bytes;
-    uint8_t sbc_packet[1000];
-} bludroid_encoder_state_t;
-
 static btstack_sbc_encoder_state_t * sbc_encoder_state_singleton = NULL;
 static bludroid_encoder_state_t bd_encoder_state;
 
-
-void btstack_sbc_encoder_init(btstack_sbc_encoder_state_t * state, btstack_sbc_mode_t mode, 
+void btstack_sbc_encoder_instance_init(btstack_sbc_encoder_state_t * state, bludroid_encoder_state_t * storage, btstack_sbc_mode_t mode, 
                         int blocks, int subbands, int allmethod, int sample_rate, int bitpool, int channel_mode){
 
-    if (sbc_encoder_state_singleton && sbc_encoder_state_singleton != state ){
-        log_error("SBC encoder: different sbc decoder state is allready registered");
-    } 
-    
-    sbc_encoder_state_singleton = state;
-
-    if (!sbc_encoder_state_singleton){
+    if (!state || !storage){
         log_error("SBC encoder init: sbc state is NULL");
+        return;
     }
 
-    sbc_encoder_state_singleton->mode = mode;
+    state->mode = mode;
 
-    switch (sbc_encoder_state_singleton->mode){
+    switch (state->mode){
         case SBC_MODE_STANDARD:
-            bd_encoder_state.context.s16NumOfBlocks = blocks;                          
-            bd_encoder_state.context.s16NumOfSubBands = subbands;                       
-            bd_encoder_state.context.s16AllocationMethod = allmethod;                     
-            bd_encoder_state.context.s16BitPool = bitpool;  
-            bd_encoder_state.context.mSBCEnabled = 0;
-            bd_encoder_state.context.s16ChannelMode = channel_mode;
-            bd_encoder_state.context.s16NumOfChannels = 2;
-            if (bd_encoder_state.context.s16ChannelMode == SBC_MONO){
-                bd_encoder_state.context.s16NumOfChannels = 1;
+            storage->context.s16NumOfBlocks = blocks;                          
+            storage->context.s16NumOfSubBands = subbands;                       
+            storage->context.s16AllocationMethod = allmethod;                     
+            storage->context.s16BitPool = bitpool;  
+            storage->context.mSBCEnabled = 0;
+            storage->context.s16ChannelMode = channel_mode;
+            storage->context.s16NumOfChannels = 2;
+            if (storage->context.s16ChannelMode == SBC_MONO){
+                storage->context.s16NumOfChannels = 1;
             }
             switch(sample_rate){
-                case 16000: bd_encoder_state.context.s16SamplingFreq = SBC_sf16000; break;
-                case 32000: bd_encoder_state.context.s16SamplingFreq = SBC_sf32000; break;
-                case 44100: bd_encoder_state.context.s16SamplingFreq = SBC_sf44100; break;
-                case 48000: bd_encoder_state.context.s16SamplingFreq = SBC_sf48000; break;
-                default: bd_encoder_state.context.s16SamplingFreq = 0; break;
+                case 16000: storage->context.s16SamplingFreq = SBC_sf16000; break;
+                case 32000: storage->context.s16SamplingFreq = SBC_sf32000; break;
+                case 44100: storage->context.s16SamplingFreq = SBC_sf44100; break;
+                case 48000: storage->context.s16SamplingFreq = SBC_sf48000; break;
+                default: storage->context.s16SamplingFreq = 0; break;
             }
             break;
         case SBC_MODE_mSBC:
-            bd_encoder_state.context.s16NumOfBlocks    = 15;
-            bd_encoder_state.context.s16NumOfSubBands  = 8;
-            bd_encoder_state.context.s16AllocationMethod = SBC_LOUDNESS;
-            bd_encoder_state.context.s16BitPool   = 26;
-            bd_encoder_state.context.s16ChannelMode = SBC_MONO;
-            bd_encoder_state.context.s16NumOfChannels = 1;
-            bd_encoder_state.context.mSBCEnabled = 1;
-            bd_encoder_state.context.s16SamplingFreq = SBC_sf16000;
+            storage->context.s16NumOfBlocks    = 15;
+            storage->context.s16NumOfSubBands  = 8;
+            storage->context.s16AllocationMethod = SBC_LOUDNESS;
+            storage->context.s16BitPool   = 26;
+            storage->context.s16ChannelMode = SBC_MONO;
+            storage->context.s16NumOfChannels = 1;
+            storage->context.mSBCEnabled = 1;
+            storage->context.s16SamplingFreq = SBC_sf16000;
             break;
     }
-    bd_encoder_state.context.pu8Packet = bd_encoder_state.sbc_packet;
+    storage->context.pu8Packet = storage->sbc_packet;
     
-    sbc_encoder_state_singleton->encoder_state = &bd_encoder_state;
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
-    SBC_Encoder_Init(context);
+    state->encoder_state = storage;
+    SBC_Encoder_Init(&storage->context);
 }
 
-
-void btstack_sbc_encoder_process_data(int16_t * input_buffer){
-    if (!sbc_encoder_state_singleton){
-        log_error("SBC encoder: sbc state is NULL, call btstack_sbc_encoder_init to initialize it");
-    }
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+void btstack_sbc_encoder_instance_process_data(btstack_sbc_encoder_state_t * state, int16_t * input_buffer){
+    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)state->encoder_state)->context;
     context->ps16PcmBuffer = input_buffer;
     if (context->mSBCEnabled){
         context->pu8Packet[0] = 0xad;
@@ -138,17 +116,51 @@ void btstack_sbc_encoder_process_data(int16_t * input_buffer){
     SBC_Encoder(context);
 }
 
-int btstack_sbc_encoder_num_audio_frames(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+int btstack_sbc_encoder_instance_num_audio_frames(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)state->encoder_state)->context;
     return context->s16NumOfSubBands * context->s16NumOfBlocks;
 }
 
-uint8_t * btstack_sbc_encoder_sbc_buffer(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint8_t * btstack_sbc_encoder_instance_sbc_buffer(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)state->encoder_state)->context;
     return context->pu8Packet;
 }
 
-uint16_t  btstack_sbc_encoder_sbc_buffer_length(void){
-    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)sbc_encoder_state_singleton->encoder_state)->context;
+uint16_t  btstack_sbc_encoder_instance_sbc_buffer_length(btstack_sbc_encoder_state_t * state){
+    SBC_ENC_PARAMS * context = &((bludroid_encoder_state_t *)state->encoder_state)->context;
     return context->u16PacketLength;
 }
+
+// single instance API using internal storage
+
+void btstack_sbc_encoder_init(btstack_sbc_encoder_state_t * state, btstack_sbc_mode_t mode, 
+                        int blocks, int subbands, int allmethod, int sample_rate, int bitpool, int channel_mode){
+
+    if (sbc_encoder_state_singleton && sbc_encoder_state_singleton != state ){
+        log_error("SBC encoder: different sbc decoder state is allready registered");
+    } 
+    
+    sbc_encoder_state_singleton = state;
+
+    btstack_sbc_encoder_instance_init(state, &bd_encoder_state, mode, blocks, subbands, allmethod, sample_rate, bitpool, channel_mode);
+}
+
+void btstack_sbc_encoder_process_data(int16_t * input_buffer){
+    if (!sbc_encoder_state_singleton){
+        log_error("SBC encoder: sbc state is NULL, call btstack_sbc_encoder_init to initialize it");
+        return;
+    }
+    btstack_sbc_encoder_instance_process_data(sbc_encoder_state_singleton, input_buffer);
+}
+
+int btstack_sbc_encoder_num_audio_frames(void){
+    return btstack_sbc_encoder_instance_num_audio_frames(sbc_encoder_state_singleton);
+}
+
+uint8_t * btstack_sbc_encoder_sbc_buffer(void){
+    return btstack_sbc_encoder_instance_sbc_buffer(sbc_encoder_state_singleton);
+}
+
+uint16_t  btstack_sbc_encoder_sbc_buffer_length(void){
+    return btstack_sbc_encoder_instance_sbc_buffer_length(sbc_encoder_state_singleton);
+}
@@ -50,6 +50,17 @@
 #include "btstack_sbc_plc.h"
 #include "btstack_debug.h"
 
+// SIMD kernels for fixed-point pattern matching, selected by compiler target
+#ifdef ENABLE_PLC_FIXED_POINT
+#if defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#define SBC_PLC_USE_NEON
+#elif defined(__SSE2__)
+#include <emmintrin.h>
+#define SBC_PLC_USE_SSE2
+#endif
+#endif
+
 #define SAMPLE_FORMAT int16_t
 
 static uint8_t indices0[] = { 0xad, 0x00, 0x00, 0xc5, 0x00, 0x00, 0x00, 0x00, 0x77, 0x6d,
@@ -104,7 +115,7 @@ static float CrossCorrelation(SAMPLE_FORMAT *x, SAMPLE_FORMAT *y){
     return num/den;
 }
 
-static int PatternMatch(SAMPLE_FORMAT *y){
+int btstack_sbc_plc_pattern_match_float(SAMPLE_FORMAT *y){
     float maxCn = -999999.0;  // large negative number
     int   bestmatch = 0;
     float Cn;
@@ -119,6 +130,108 @@ static int PatternMatch(SAMPLE_FORMAT *y){
     return bestmatch;
 }
 
+// exact dot product of SBC_M samples. template x must not contain -32768,
+// so that two products always fit into an int32 (required for SSE2 madd)
+static int64_t DotProduct(const SAMPLE_FORMAT *x, const SAMPLE_FORMAT *y){
+    int m;
+#if defined(SBC_PLC_USE_NEON)
+    int64x2_t acc = vdupq_n_s64(0);
+    for (m=0;m<SBC_M;m+=4){
+        acc = vpadalq_s32(acc, vmull_s16(vld1_s16(&x[m]), vld1_s16(&y[m])));
+    }
+    return vgetq_lane_s64(acc, 0) + vgetq_lane_s64(acc, 1);
+#elif defined(SBC_PLC_USE_SSE2)
+    __m128i acc = _mm_setzero_si128();
+    for (m=0;m<SBC_M;m+=8){
+        __m128i prod = _mm_madd_epi16(_mm_loadu_si128((const __m128i *) &x[m]), _mm_loadu_si128((const __m128i *) &y[m]));
+        __m128i sign = _mm_srai_epi32(prod, 31);
+        acc = _mm_add_epi64(acc, _mm_unpacklo_epi32(prod, sign));
+        acc = _mm_add_epi64(acc, _mm_unpackhi_epi32(prod, sign));
+    }
+    int64_t lanes[2];
+    _mm_storeu_si128((__m128i *) lanes, acc);
+    return lanes[0] + lanes[1];
+#else
+    int64_t sum = 0;
+    for (m=0;m<SBC_M;m++){
+        sum += (int32_t) x[m] * y[m];
+    }
+    return sum;
+#endif
+}
+
+// floor(sqrt(x)), bitwise
+static uint32_t IntegerSqrt(uint64_t x){
+    uint64_t res = 0;
+    uint64_t bit = ((uint64_t) 1) << 62;
+    while (bit > x){
+        bit >>= 2;
+    }
+    while (bit){
+        if (x >= res + bit){
+            x  -= res + bit;
+            res = (res >> 1) + bit;
+        } else {
+            res >>= 1;
+        }
+        bit >>= 2;
+    }
+    return (uint32_t) res;
+}
+
+// The template energy x2 is the same for all lags, so maximizing num / sqrt(x2*y2) is the same as
+// maximizing num / sqrt(y2). Candidates are compared by cross multiplication, which needs no division:
+// |num| <= 2^36 and sqrt(y2 << 8) <= 2^22, so the products fit into an int64
+int btstack_sbc_plc_pattern_match_fixed_point(SAMPLE_FORMAT *y){
+    SAMPLE_FORMAT pattern[SBC_M];
+    int64_t x2 = 0;
+    int64_t y2 = 0;
+    int64_t num;
+    int64_t den;
+    int64_t max_num = 0;
+    int64_t max_den = 1;
+    int   bestmatch = 0;
+    int   m;
+    int   n;
+
+    // copy template and compute its energy once
+    for (m=0;m<SBC_M;m++){
+        SAMPLE_FORMAT sample = y[SBC_LHIST-SBC_M+m];
+        if (sample == -32768) sample = -32767;
+        pattern[m] = sample;
+        x2 += (int32_t) sample * sample;
+        y2 += (int32_t) y[m] * y[m];
+    }
+
+    for (n=0;n<SBC_N;n++){
+        // energy of window y[n..n+M-1] is updated incrementally
+        if (n > 0){
+            y2 += (int32_t) y[n+SBC_M-1] * y[n+SBC_M-1] - (int32_t) y[n-1] * y[n-1];
+        }
+        // correlation is 0 if template or window is silent
+        num = 0;
+        den = 1;
+        if ((x2 > 0) && (y2 > 0)){
+            num = DotProduct(pattern, &y[n]);
+            den = IntegerSqrt(((uint64_t) y2) << 8);
+        }
+        if ((n == 0) || (num * max_den > max_num * den)){
+            bestmatch = n;
+            max_num = num;
+            max_den = den;
+        }
+    }
+    return bestmatch;
+}
+
+static int PatternMatch(SAMPLE_FORMAT *y){
+#ifdef ENABLE_PLC_FIXED_POINT
+    return btstack_sbc_plc_pattern_match_fixed_point(y);
+#else
+    return btstack_sbc_plc_pattern_match_float(y);
+#endif
+}
+
 static float AmplitudeMatch(SAMPLE_FORMAT *y, SAMPLE_FORMAT bestmatch) {
     int   i;
     float sumx = 0;
@@ -80,6 +80,10 @@ void btstack_sbc_dump_statistics(btstack_sbc_plc_state_t * state);
 void btstack_sbc_plc_octave_set_base_name(const char * name);
 #endif
 
+// testing only
+int btstack_sbc_plc_pattern_match_float(int16_t *y);
+int btstack_sbc_plc_pattern_match_fixed_point(int16_t *y);
+
 #if defined __cplusplus
 }
 #endif
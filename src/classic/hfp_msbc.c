@@ -49,68 +49,90 @@
 
 #include "btstack_debug.h"
 #include "btstack_sbc.h"
+#include "btstack_sbc_bludroid.h"
 #include "hfp_msbc.h"
 
-#define MSBC_FRAME_SIZE 57
-#define MSBC_HEADER_H2_SIZE 2
-#define MSBC_PADDING_SIZE 1
-#define MSBC_EXTRA_SIZE (MSBC_HEADER_H2_SIZE + MSBC_PADDING_SIZE)
+#define MSBC_FRAME_SIZE     HFP_MSBC_FRAME_SIZE
+#define MSBC_EXTRA_SIZE     HFP_MSBC_EXTRA_SIZE
 
 static const uint8_t msbc_header_h2_byte_0         = 1;
 static const uint8_t msbc_header_h2_byte_1_table[] = { 0x08, 0x38, 0xc8, 0xf8 };
 
-static btstack_sbc_encoder_state_t state;
-static int msbc_sequence_number;
+// encoder used by single instance API
+static hfp_msbc_encoder_t       hfp_msbc_default_encoder;
+static bludroid_encoder_state_t hfp_msbc_default_encoder_storage;
 
-static uint8_t msbc_buffer[2*(MSBC_FRAME_SIZE + MSBC_EXTRA_SIZE)];
-static int msbc_buffer_offset = 0; 
-
-void hfp_msbc_init(void){
-    btstack_sbc_encoder_init(&state, SBC_MODE_mSBC, 16, 8, 0, 16000, 26, 0);
-    msbc_buffer_offset = 0;
-    msbc_sequence_number = 0;
+void hfp_msbc_encoder_init(hfp_msbc_encoder_t * encoder, struct bludroid_encoder_state * sbc_encoder_storage){
+    encoder->sbc_encoder_storage = sbc_encoder_storage;
+    btstack_sbc_encoder_instance_init(&encoder->sbc_encoder_state, sbc_encoder_storage, SBC_MODE_mSBC, 16, 8, 0, 16000, 26, 0);
+    encoder->stream_buffer_offset = 0;
+    encoder->sequence_number = 0;
 }
 
-int hfp_msbc_can_encode_audio_frame_now(void){
-    return sizeof(msbc_buffer) - msbc_buffer_offset >= MSBC_FRAME_SIZE + MSBC_EXTRA_SIZE; 
+int hfp_msbc_encoder_can_encode_audio_frame_now(hfp_msbc_encoder_t * encoder){
+    return sizeof(encoder->stream_buffer) - encoder->stream_buffer_offset >= MSBC_FRAME_SIZE + MSBC_EXTRA_SIZE; 
 }
 
-void hfp_msbc_encode_audio_frame(int16_t * pcm_samples){
-    if (!hfp_msbc_can_encode_audio_frame_now()) return;
+void hfp_msbc_encoder_encode_audio_frame(hfp_msbc_encoder_t * encoder, int16_t * pcm_samples){
+    if (!hfp_msbc_encoder_can_encode_audio_frame_now(encoder)) return;
 
     // Synchronization Header H2
-    msbc_buffer[msbc_buffer_offset++] = msbc_header_h2_byte_0;
-    msbc_buffer[msbc_buffer_offset++] = msbc_header_h2_byte_1_table[msbc_sequence_number];
-    msbc_sequence_number = (msbc_sequence_number + 1) & 3;
+    encoder->stream_buffer[encoder->stream_buffer_offset++] = msbc_header_h2_byte_0;
+    encoder->stream_buffer[encoder->stream_buffer_offset++] = msbc_header_h2_byte_1_table[encoder->sequence_number];
+    encoder->sequence_number = (encoder->sequence_number + 1) & 3;
 
     // SBC Frame
-    btstack_sbc_encoder_process_data(pcm_samples);
-    memcpy(msbc_buffer + msbc_buffer_offset, btstack_sbc_encoder_sbc_buffer(), MSBC_FRAME_SIZE);
-    msbc_buffer_offset += MSBC_FRAME_SIZE;
+    btstack_sbc_encoder_instance_process_data(&encoder->sbc_encoder_state, pcm_samples);
+    memcpy(encoder->stream_buffer + encoder->stream_buffer_offset, btstack_sbc_encoder_instance_sbc_buffer(&encoder->sbc_encoder_state), MSBC_FRAME_SIZE);
+    encoder->stream_buffer_offset += MSBC_FRAME_SIZE;
 
     // Final padding to use 60 bytes for 120 audio samples
-    msbc_buffer[msbc_buffer_offset++] = 0;
+    encoder->stream_buffer[encoder->stream_buffer_offset++] = 0;
 }
 
-void hfp_msbc_read_from_stream(uint8_t * buf, int size){
+void hfp_msbc_encoder_read_from_stream(hfp_msbc_encoder_t * encoder, uint8_t * buf, int size){
     int bytes_to_copy = size;
-    if (size > msbc_buffer_offset){
-        bytes_to_copy = msbc_buffer_offset;
+    if (size > encoder->stream_buffer_offset){
+        bytes_to_copy = encoder->stream_buffer_offset;
         log_error("sbc frame storage is smaller then the output buffer");
         return;
     }
 
-    memcpy(buf, msbc_buffer, bytes_to_copy);
-    memmove(msbc_buffer, msbc_buffer + bytes_to_copy, sizeof(msbc_buffer) - bytes_to_copy);
-    msbc_buffer_offset -= bytes_to_copy;
+    memcpy(buf, encoder->stream_buffer, bytes_to_copy);
+    memmove(encoder->stream_buffer, encoder->stream_buffer + bytes_to_copy, sizeof(encoder->stream_buffer) - bytes_to_copy);
+    encoder->stream_buffer_offset -= bytes_to_copy;
 }
 
-int hfp_msbc_num_bytes_in_stream(void){
-    return msbc_buffer_offset;
+int hfp_msbc_encoder_num_bytes_in_stream(hfp_msbc_encoder_t * encoder){
+    return encoder->stream_buffer_offset;
 }
 
-int hfp_msbc_num_audio_samples_per_frame(void){
-    return btstack_sbc_encoder_num_audio_frames();
+int hfp_msbc_encoder_num_audio_samples_per_frame(hfp_msbc_encoder_t * encoder){
+    return btstack_sbc_encoder_instance_num_audio_frames(&encoder->sbc_encoder_state);
+}
+
+// single instance API
+
+void hfp_msbc_init(void){
+    hfp_msbc_encoder_init(&hfp_msbc_default_encoder, &hfp_msbc_default_encoder_storage);
+}
+
+int hfp_msbc_can_encode_audio_frame_now(void){
+    return hfp_msbc_encoder_can_encode_audio_frame_now(&hfp_msbc_default_encoder);
+}
+
+void hfp_msbc_encode_audio_frame(int16_t * pcm_samples){
+    hfp_msbc_encoder_encode_audio_frame(&hfp_msbc_default_encoder, pcm_samples);
+}
+
+void hfp_msbc_read_from_stream(uint8_t * buf, int size){
+    hfp_msbc_encoder_read_from_stream(&hfp_msbc_default_encoder, buf, size);
 }
 
+int hfp_msbc_num_bytes_in_stream(void){
+    return hfp_msbc_encoder_num_bytes_in_stream(&hfp_msbc_default_encoder);
+}
 
+int hfp_msbc_num_audio_samples_per_frame(void){
+    return hfp_msbc_encoder_num_audio_samples_per_frame(&hfp_msbc_default_encoder);
+}
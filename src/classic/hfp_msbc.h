@@ -48,10 +48,29 @@
 
 #include <stdint.h>
 
+#include "btstack_sbc.h"
+
 #if defined __cplusplus
 extern "C" {
 #endif
 
+#define HFP_MSBC_FRAME_SIZE       57
+#define HFP_MSBC_EXTRA_SIZE       3     // H2 header (2) + padding (1)
+#define HFP_MSBC_STREAM_SIZE      (2*(HFP_MSBC_FRAME_SIZE + HFP_MSBC_EXTRA_SIZE))
+
+// codec storage, see btstack_sbc_bludroid.h
+struct bludroid_encoder_state;
+
+// mSBC encoder instance, e.g. one per eSCO connection
+// for decoding, use btstack_sbc_decoder_instance_init with SBC_MODE_mSBC and a bludroid_decoder_state_t per connection
+typedef struct {
+    btstack_sbc_encoder_state_t     sbc_encoder_state;
+    struct bludroid_encoder_state * sbc_encoder_storage;
+    int     sequence_number;
+    uint8_t stream_buffer[HFP_MSBC_STREAM_SIZE];
+    int     stream_buffer_offset;
+} hfp_msbc_encoder_t;
+
 /* API_START */
 
 /**
@@ -86,6 +105,41 @@ int  hfp_msbc_num_bytes_in_stream(void);
  */
 void hfp_msbc_read_from_stream(uint8_t * buffer, int size);
 
+/**
+ * @brief Init mSBC encoder instance. Instances are independent and allow to encode several wideband streams concurrently
+ * @param encoder
+ * @param sbc_encoder_storage bludroid_encoder_state_t for codec state, must stay valid while the encoder is in use
+ */
+void hfp_msbc_encoder_init(hfp_msbc_encoder_t * encoder, struct bludroid_encoder_state * sbc_encoder_storage);
+
+/**
+ * @param encoder
+ */
+int  hfp_msbc_encoder_num_audio_samples_per_frame(hfp_msbc_encoder_t * encoder);
+
+/**
+ * @param encoder
+ */
+int  hfp_msbc_encoder_can_encode_audio_frame_now(hfp_msbc_encoder_t * encoder);
+
+/**
+ * @param encoder
+ * @param pcm_samples - complete audio frame of hfp_msbc_encoder_num_audio_samples_per_frame int16 samples
+ */
+void hfp_msbc_encoder_encode_audio_frame(hfp_msbc_encoder_t * encoder, int16_t * pcm_samples);
+
+/**
+ * @param encoder
+ */
+int  hfp_msbc_encoder_num_bytes_in_stream(hfp_msbc_encoder_t * encoder);
+
+/**
+ * @param encoder
+ * @param buffer to store stream
+ * @param size num bytes to read from stream
+ */
+void hfp_msbc_encoder_read_from_stream(hfp_msbc_encoder_t * encoder, uint8_t * buffer, int size);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -83,6 +83,14 @@
 
 #define RFCOMM_CREDITS 10
 
+// automatic credits: window doubles each time the remote runs out of credits, up to this limit
+#define RFCOMM_CREDITS_MAX 80
+
+// number of hash buckets for rfcomm_cid and l2cap_cid lookups, entries with the same hash are chained
+#ifndef RFCOMM_CID_INDEX_SIZE
+#define RFCOMM_CID_INDEX_SIZE 8
+#endif
+
 // FCS calc 
 #define BT_RFCOMM_CODE_WORD         0xE0 // pol = x8+x2+x1+1
 #define BT_RFCOMM_CRC_CHECK_LEN     3
@@ -144,6 +152,10 @@ static btstack_linked_list_t rfcomm_multiplexers = NULL;
 static btstack_linked_list_t rfcomm_channels = NULL;
 static btstack_linked_list_t rfcomm_services = NULL;
 
+// cid % RFCOMM_CID_INDEX_SIZE -> chain of channels / multiplexers
+static rfcomm_channel_t     * rfcomm_channel_cid_index[RFCOMM_CID_INDEX_SIZE];
+static rfcomm_multiplexer_t * rfcomm_multiplexer_cid_index[RFCOMM_CID_INDEX_SIZE];
+
 static gap_security_level_t rfcomm_security_level;
 
 #ifdef RFCOMM_USE_ERTM
@@ -344,16 +356,35 @@ static rfcomm_multiplexer_t * rfcomm_multiplexer_for_addr(bd_addr_t addr){
 }
 
 static rfcomm_multiplexer_t * rfcomm_multiplexer_for_l2cap_cid(uint16_t l2cap_cid) {
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) rfcomm_multiplexers; it ; it = it->next){
-        rfcomm_multiplexer_t * multiplexer = ((rfcomm_multiplexer_t *) it);
-        if (multiplexer->l2cap_cid == l2cap_cid) {
-            return multiplexer;
-        };
+    rfcomm_multiplexer_t * multiplexer = rfcomm_multiplexer_cid_index[l2cap_cid % RFCOMM_CID_INDEX_SIZE];
+    while (multiplexer){
+        if (multiplexer->l2cap_cid == l2cap_cid) return multiplexer;
+        multiplexer = multiplexer->next_for_l2cap_cid;
     }
     return NULL;
 }
 
+static void rfcomm_multiplexer_index_remove(rfcomm_multiplexer_t * multiplexer){
+    rfcomm_multiplexer_t ** it = &rfcomm_multiplexer_cid_index[multiplexer->l2cap_cid % RFCOMM_CID_INDEX_SIZE];
+    while (*it){
+        if (*it == multiplexer){
+            *it = multiplexer->next_for_l2cap_cid;
+            break;
+        }
+        it = &(*it)->next_for_l2cap_cid;
+    }
+    multiplexer->next_for_l2cap_cid = NULL;
+}
+
+// l2cap_cid must only be set through this to keep the index up to date
+static void rfcomm_multiplexer_set_l2cap_cid(rfcomm_multiplexer_t * multiplexer, uint16_t l2cap_cid){
+    rfcomm_multiplexer_index_remove(multiplexer);
+    multiplexer->l2cap_cid = l2cap_cid;
+    uint16_t index = l2cap_cid % RFCOMM_CID_INDEX_SIZE;
+    multiplexer->next_for_l2cap_cid = rfcomm_multiplexer_cid_index[index];
+    rfcomm_multiplexer_cid_index[index] = multiplexer;
+}
+
 static int rfcomm_multiplexer_has_channels(rfcomm_multiplexer_t * multiplexer){
     btstack_linked_item_t *it;
     for (it = (btstack_linked_item_t *) rfcomm_channels; it ; it = it->next){
@@ -399,6 +430,8 @@ static void rfcomm_channel_initialize(rfcomm_channel_t *channel, rfcomm_multiple
     // incoming flow control not active
     channel->new_credits_incoming  = RFCOMM_CREDITS;
     channel->incoming_flow_control = 0;
+    channel->automatic_credits_window = RFCOMM_CREDITS;
+    channel->data_frames_carry_credits = 0;
 
     channel->rls_line_status       = RFCOMM_RLS_STATUS_INVALID;
 
@@ -434,10 +467,37 @@ static rfcomm_channel_t * rfcomm_channel_create(rfcomm_multiplexer_t * multiplex
     
     // add to services list
     btstack_linked_list_add(&rfcomm_channels, (btstack_linked_item_t *) channel);
+
+    // add to indices
+    if (channel->dlci < RFCOMM_MULTIPLEXER_NUM_DLCIS){
+        multiplexer->channel_for_dlci[channel->dlci] = channel;
+    }
+    uint16_t index = channel->rfcomm_cid % RFCOMM_CID_INDEX_SIZE;
+    channel->next_for_rfcomm_cid = rfcomm_channel_cid_index[index];
+    rfcomm_channel_cid_index[index] = channel;
     
     return channel;
 }
 
+static void rfcomm_channel_free(rfcomm_channel_t * channel){
+    // remove from indices
+    rfcomm_multiplexer_t * multiplexer = channel->multiplexer;
+    if (channel->dlci < RFCOMM_MULTIPLEXER_NUM_DLCIS && multiplexer->channel_for_dlci[channel->dlci] == channel){
+        multiplexer->channel_for_dlci[channel->dlci] = NULL;
+    }
+    rfcomm_channel_t ** it = &rfcomm_channel_cid_index[channel->rfcomm_cid % RFCOMM_CID_INDEX_SIZE];
+    while (*it){
+        if (*it == channel){
+            *it = channel->next_for_rfcomm_cid;
+            break;
+        }
+        it = &(*it)->next_for_rfcomm_cid;
+    }
+
+    btstack_linked_list_remove(&rfcomm_channels, (btstack_linked_item_t *) channel);
+    btstack_memory_rfcomm_channel_free(channel);
+}
+
 static void rfcomm_notify_channel_can_send(void){
     btstack_linked_list_iterator_t it;
     btstack_linked_list_iterator_init(&it, &rfcomm_channels);
@@ -452,25 +512,17 @@ static void rfcomm_notify_channel_can_send(void){
 }
 
 static rfcomm_channel_t * rfcomm_channel_for_rfcomm_cid(uint16_t rfcomm_cid){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) rfcomm_channels; it ; it = it->next){
-        rfcomm_channel_t * channel = ((rfcomm_channel_t *) it);
-        if (channel->rfcomm_cid == rfcomm_cid) {
-            return channel;
-        };
+    rfcomm_channel_t * channel = rfcomm_channel_cid_index[rfcomm_cid % RFCOMM_CID_INDEX_SIZE];
+    while (channel){
+        if (channel->rfcomm_cid == rfcomm_cid) return channel;
+        channel = channel->next_for_rfcomm_cid;
     }
     return NULL;
 }
 
 static rfcomm_channel_t * rfcomm_channel_for_multiplexer_and_dlci(rfcomm_multiplexer_t * multiplexer, uint8_t dlci){
-    btstack_linked_item_t *it;
-    for (it = (btstack_linked_item_t *) rfcomm_channels; it ; it = it->next){
-        rfcomm_channel_t * channel = ((rfcomm_channel_t *) it);
-        if (channel->dlci == dlci && channel->multiplexer == multiplexer) {
-            return channel;
-        };
-    }
-    return NULL;
+    if (dlci >= RFCOMM_MULTIPLEXER_NUM_DLCIS) return NULL;
+    return multiplexer->channel_for_dlci[dlci];
 }
 
 static rfcomm_service_t * rfcomm_service_for_channel(uint8_t server_channel){
@@ -489,7 +541,7 @@ static rfcomm_service_t * rfcomm_service_for_channel(uint8_t server_channel){
 /**
  * @param credits - only used for RFCOMM flow control in UIH wiht P/F = 1
  */
-static int rfcomm_send_packet_for_multiplexer(rfcomm_multiplexer_t *multiplexer, uint8_t address, uint8_t control, uint8_t credits, uint8_t *data, uint16_t len){
+static int rfcomm_send_packet_for_multiplexer(rfcomm_multiplexer_t *multiplexer, uint8_t address, uint8_t control, uint8_t credits, const uint8_t *data, uint16_t len){
 
     if (!l2cap_can_send_packet_now(multiplexer->l2cap_cid)) return BTSTACK_ACL_BUFFERS_FULL;
     
@@ -542,10 +594,10 @@ static int rfcomm_send_packet_for_multiplexer(rfcomm_multiplexer_t *multiplexer,
 }
 
 // simplified version of rfcomm_send_packet_for_multiplexer for prepared rfcomm packet (UIH, 2 byte len, no credits)
-static int rfcomm_send_uih_prepared(rfcomm_multiplexer_t *multiplexer, uint8_t dlci, uint16_t len){
+// - credits can be piggybacked for len < 128 by using UIH_PF with 1 byte len, payload stays at offset 4
+static int rfcomm_send_uih_prepared(rfcomm_multiplexer_t *multiplexer, uint8_t dlci, uint8_t credits, uint16_t len){
 
     uint8_t address = (1 << 0) | (multiplexer->outgoing << 1) | (dlci << 2); 
-    uint8_t control = BT_RFCOMM_UIH;
 
 #ifdef RFCOMM_USE_OUTGOING_BUFFER
     uint8_t * rfcomm_out_buffer = outgoing_buffer;
@@ -555,9 +607,15 @@ static int rfcomm_send_uih_prepared(rfcomm_multiplexer_t *multiplexer, uint8_t d
 
     uint16_t pos = 0;
     rfcomm_out_buffer[pos++] = address;
-    rfcomm_out_buffer[pos++] = control;
-    rfcomm_out_buffer[pos++] = (len & 0x7f) << 1; // bits 0-6
-    rfcomm_out_buffer[pos++] = len >> 7;          // bits 7-14
+    if (credits){
+        rfcomm_out_buffer[pos++] = BT_RFCOMM_UIH_PF;
+        rfcomm_out_buffer[pos++] = (len << 1) | 1;    // bits 0-6
+        rfcomm_out_buffer[pos++] = credits;
+    } else {
+        rfcomm_out_buffer[pos++] = BT_RFCOMM_UIH;
+        rfcomm_out_buffer[pos++] = (len & 0x7f) << 1; // bits 0-6
+        rfcomm_out_buffer[pos++] = len >> 7;          // bits 7-14
+    }
 
     // actual data is already in place
     pos += len;
@@ -811,6 +869,7 @@ static void rfcomm_multiplexer_stop_timer(rfcomm_multiplexer_t * multiplexer){
     }
 }
 static void rfcomm_multiplexer_free(rfcomm_multiplexer_t * multiplexer){
+    rfcomm_multiplexer_index_remove(multiplexer);
     btstack_linked_list_remove( &rfcomm_multiplexers, (btstack_linked_item_t *) multiplexer);
     btstack_memory_rfcomm_multiplexer_free(multiplexer);
 }
@@ -826,10 +885,8 @@ static void rfcomm_multiplexer_finalize(rfcomm_multiplexer_t * multiplexer){
         if (channel->multiplexer == multiplexer) {
             // emit open with status or closed
             rfcomm_channel_emit_final_event(channel, RFCOMM_MULTIPLEXER_STOPPED);
-            // remove from list
-            it->next = it->next->next;
-            // free channel struct
-            btstack_memory_rfcomm_channel_free(channel);
+            // remove from list and free channel struct
+            rfcomm_channel_free(channel);
         } else {
             it = it->next;
         }
@@ -998,7 +1055,7 @@ static int rfcomm_hci_event_handler(uint8_t *packet, uint16_t size){
             }
             
             multiplexer->con_handle = con_handle;
-            multiplexer->l2cap_cid = l2cap_cid;
+            rfcomm_multiplexer_set_l2cap_cid(multiplexer, l2cap_cid);
             // 
             multiplexer->state = RFCOMM_MULTIPLEXER_W4_SABM_0;
             log_info("L2CAP_EVENT_INCOMING_CONNECTION (l2cap_cid 0x%02x) for BLUETOOTH_PROTOCOL_RFCOMM => accept", l2cap_cid);
@@ -1060,8 +1117,7 @@ static int rfcomm_hci_event_handler(uint8_t *packet, uint16_t size){
                         if (channel->multiplexer == multiplexer){
                             done = 0;
                             rfcomm_emit_channel_opened(channel, status);
-                            btstack_linked_list_remove(&rfcomm_channels, (btstack_linked_item_t *) channel);
-                            btstack_memory_rfcomm_channel_free(channel);
+                            rfcomm_channel_free(channel);
                             break;
                         } else {
                             it = it->next;
@@ -1080,7 +1136,7 @@ static int rfcomm_hci_event_handler(uint8_t *packet, uint16_t size){
                 log_info("L2CAP_EVENT_CHANNEL_OPENED: outgoing connection");
                 // wrong remote addr
                 if (bd_addr_cmp(event_addr, multiplexer->remote_addr)) break;
-                multiplexer->l2cap_cid = l2cap_cid;
+                rfcomm_multiplexer_set_l2cap_cid(multiplexer, l2cap_cid);
                 multiplexer->con_handle = con_handle;
                 // send SABM #0
                 rfcomm_multiplexer_set_state_and_request_can_send_now_event(multiplexer, RFCOMM_MULTIPLEXER_SEND_SABM_0);
@@ -1324,6 +1380,81 @@ static void rfcomm_channel_send_credits(rfcomm_channel_t *channel, uint8_t credi
     rfcomm_send_uih_credits(channel->multiplexer, channel->dlci, credits);
 }
 
+// the additional credit field of a data frame only fits if the frame is smaller than the L2CAP MTU allows
+static int rfcomm_channel_data_frame_has_room_for_credits(rfcomm_channel_t *channel, uint16_t len){
+    if (len >= channel->multiplexer->max_frame_size) return 0;
+#ifdef RFCOMM_USE_OUTGOING_BUFFER
+    // address + control + length (16) + credits + fcs
+    if (len + 6 > sizeof(outgoing_buffer)) return 0;
+#endif
+    return 1;
+}
+
+// pending credits are piggybacked on a data frame if there's room for them
+static uint8_t rfcomm_channel_credits_for_data_frame(rfcomm_channel_t *channel, uint16_t len){
+    if (channel->state != RFCOMM_CHANNEL_OPEN) return 0;
+    if (!rfcomm_channel_data_frame_has_room_for_credits(channel, len)) return 0;
+    return channel->new_credits_incoming;
+}
+
+static void rfcomm_channel_credits_sent_with_data_frame(rfcomm_channel_t *channel, uint8_t credits){
+    channel->new_credits_incoming -= credits;
+    channel->credits_incoming     += credits;
+}
+
+// remote used its last credit before the pending credits were sent: it's faster than our batches, grow window
+static void rfcomm_channel_grow_automatic_credits_window(rfcomm_channel_t *channel){
+    if (channel->automatic_credits_window >= RFCOMM_CREDITS_MAX) return;
+    uint16_t window = channel->automatic_credits_window * 2;
+    if (window > RFCOMM_CREDITS_MAX){
+        window = RFCOMM_CREDITS_MAX;
+    }
+    channel->automatic_credits_window = (uint8_t) window;
+    log_info("RFCOMM automatic credits window channel 0x%02x now %u", channel->rfcomm_cid, window);
+}
+
+// top up remote credits once half of the window has been used
+// @return 1 if new credits need to be sent
+static int rfcomm_channel_update_automatic_credits(rfcomm_channel_t *channel){
+    uint16_t outstanding_credits = channel->credits_incoming + channel->new_credits_incoming;
+    if (outstanding_credits > (channel->automatic_credits_window / 2)) return 0;
+    channel->new_credits_incoming += channel->automatic_credits_window - outstanding_credits;
+    return 1;
+}
+
+// pre: rfcomm_assert_send_valid
+static int rfcomm_channel_send_uih_data(rfcomm_channel_t *channel, const uint8_t *data, uint16_t len){
+    rfcomm_multiplexer_t * multiplexer = channel->multiplexer;
+
+    // check before packet buffer gets reserved, only a reserved buffer may be released below
+    if (!l2cap_can_send_packet_now(multiplexer->l2cap_cid)) return BTSTACK_ACL_BUFFERS_FULL;
+
+    uint8_t address = (1 << 0) | (multiplexer->outgoing << 1) | (channel->dlci << 2);
+    uint8_t credits = rfcomm_channel_credits_for_data_frame(channel, len);
+    uint8_t control = credits ? BT_RFCOMM_UIH_PF : BT_RFCOMM_UIH;
+    channel->data_frames_carry_credits = rfcomm_channel_data_frame_has_room_for_credits(channel, len);
+
+    // send might cause l2cap to emit new credits, update counters first
+    if (len){
+        channel->credits_outgoing--;
+    }
+    int err = rfcomm_send_packet_for_multiplexer(multiplexer, address, control, credits, data, len);
+    if (err){
+        if (len){
+            channel->credits_outgoing++;
+        }
+#ifdef RFCOMM_USE_OUTGOING_BUFFER
+#else
+        rfcomm_release_packet_buffer();
+#endif
+        return err;
+    }
+    if (credits){
+        rfcomm_channel_credits_sent_with_data_frame(channel, credits);
+    }
+    return 0;
+}
+
 static int rfcomm_channel_can_send(rfcomm_channel_t * channel){
     if (!channel->credits_outgoing) return 0;
     if ((channel->multiplexer->fcon & 1) == 0) return 0;
@@ -1391,6 +1522,9 @@ static void rfcomm_channel_packet_handler_uih(rfcomm_multiplexer_t *multiplexer,
         // decrease incoming credit counter
         if (channel->credits_incoming > 0){
             channel->credits_incoming--;
+            if (channel->credits_incoming == 0 && !channel->incoming_flow_control){
+                rfcomm_channel_grow_automatic_credits_window(channel);
+            }
         }
         
         // deliver payload
@@ -1399,8 +1533,7 @@ static void rfcomm_channel_packet_handler_uih(rfcomm_multiplexer_t *multiplexer,
     }
     
     // automatically provide new credits to remote device, if no incoming flow control
-    if (!channel->incoming_flow_control && channel->credits_incoming < 5){
-        channel->new_credits_incoming = RFCOMM_CREDITS;
+    if (!channel->incoming_flow_control && rfcomm_channel_update_automatic_credits(channel)){
         request_can_send_now = 1;
     }    
 
@@ -1430,11 +1563,8 @@ static void rfcomm_channel_finalize(rfcomm_channel_t *channel){
 
     rfcomm_multiplexer_t *multiplexer = channel->multiplexer;
 
-    // remove from list
-    btstack_linked_list_remove( &rfcomm_channels, (btstack_linked_item_t *) channel);
-
-    // free channel
-    btstack_memory_rfcomm_channel_free(channel);
+    // remove from list and free channel
+    rfcomm_channel_free(channel);
     
     // update multiplexer timeout after channel was removed from list
     rfcomm_multiplexer_prepare_idle_timer(multiplexer);
@@ -1735,6 +1865,11 @@ static int rfcomm_channel_ready_to_send(rfcomm_channel_t * channel){
             return 1;
         case RFCOMM_CHANNEL_OPEN:
             if (channel->new_credits_incoming) { 
+                // piggyback credits on data from client if remote did not run out of credits yet and client data frames have room for them
+                if (channel->waiting_for_can_send_now && channel->data_frames_carry_credits && channel->credits_outgoing && channel->credits_incoming && (channel->multiplexer->fcon & 1)){
+                    log_debug("ch-ready: channel open & new_credits_incoming, wait for client data") ;
+                    break;
+                }
                 log_debug("ch-ready: channel open & new_credits_incoming") ; 
                 return 1;
             }
@@ -2123,6 +2258,8 @@ void rfcomm_init(void){
     rfcomm_services     = NULL;
     rfcomm_channels     = NULL;
     rfcomm_security_level = LEVEL_2;
+    memset(rfcomm_channel_cid_index, 0, sizeof(rfcomm_channel_cid_index));
+    memset(rfcomm_multiplexer_cid_index, 0, sizeof(rfcomm_multiplexer_cid_index));
 }
 
 void rfcomm_set_required_security_level(gap_security_level_t security_level){
@@ -2149,6 +2286,11 @@ void rfcomm_request_can_send_now_event(uint16_t rfcomm_cid){
 }
 
 static int rfcomm_assert_send_valid(rfcomm_channel_t * channel , uint16_t len){
+    if (channel->state != RFCOMM_CHANNEL_OPEN){
+        log_error("rfcomm_send cid 0x%02x, channel not open", channel->rfcomm_cid);
+        return ERROR_CODE_COMMAND_DISALLOWED;
+    }
+
     if (len > channel->max_frame_size){
         log_error("rfcomm_send cid 0x%02x, rfcomm data lenght exceeds MTU!", channel->rfcomm_cid);
         return RFCOMM_DATA_LEN_EXCEEDS_MTU;
@@ -2238,8 +2380,12 @@ int rfcomm_send_prepared(uint16_t rfcomm_cid, uint16_t len){
     } else {
         log_info("sending empty RFCOMM packet for cid %02x", rfcomm_cid);
     }
+
+    // piggyback credits only with 1 byte length field
+    uint8_t credits = (len < 128) ? rfcomm_channel_credits_for_data_frame(channel, len) : 0;
+    channel->data_frames_carry_credits = (len < 128) && rfcomm_channel_data_frame_has_room_for_credits(channel, len);
         
-    int result = rfcomm_send_uih_prepared(channel->multiplexer, channel->dlci, len);
+    int result = rfcomm_send_uih_prepared(channel->multiplexer, channel->dlci, credits, len);
     
     if (result != 0) {
         if (len) {
@@ -2248,6 +2394,10 @@ int rfcomm_send_prepared(uint16_t rfcomm_cid, uint16_t len){
         log_error("rfcomm_send_prepared: error %d", result);
         return result;
     }
+
+    if (credits){
+        rfcomm_channel_credits_sent_with_data_frame(channel, credits);
+    }
     
     return result;
 }
@@ -2266,23 +2416,39 @@ int rfcomm_send(uint16_t rfcomm_cid, uint8_t *data, uint16_t len){
         return BTSTACK_ACL_BUFFERS_FULL;
     }
 
-#ifdef RFCOMM_USE_OUTGOING_BUFFER
-#else
-    rfcomm_reserve_packet_buffer();
-#endif
-    uint8_t * rfcomm_payload = rfcomm_get_outgoing_buffer();
+    err = rfcomm_channel_send_uih_data(channel, data, len);
+    if (err){
+        log_error("rfcomm_send: error %d", err);
+    }
+    return err;
+}
 
-    memcpy(rfcomm_payload, data, len);
-    err = rfcomm_send_prepared(rfcomm_cid, len);    
+uint32_t rfcomm_send_stream(uint16_t rfcomm_cid, const uint8_t *data, uint32_t len){
+    rfcomm_channel_t * channel = rfcomm_channel_for_rfcomm_cid(rfcomm_cid);
+    if (!channel){
+        log_error("rfcomm_send_stream cid 0x%02x doesn't exist!", rfcomm_cid);
+        return 0;
+    }
 
+    if (rfcomm_assert_send_valid(channel, 0)) return 0;
+
+    uint16_t max_frame_size = channel->max_frame_size;
 #ifdef RFCOMM_USE_OUTGOING_BUFFER
-#else
-    if (err){
-        rfcomm_release_packet_buffer();
-    }
+    max_frame_size = (uint16_t) btstack_min(max_frame_size, sizeof(outgoing_buffer) - 5);
 #endif
 
-    return err;
+    uint32_t bytes_sent = 0;
+    while (bytes_sent < len){
+        if (!rfcomm_channel_can_send(channel)) break;
+        uint16_t frame_len = (uint16_t) btstack_min(len - bytes_sent, max_frame_size);
+        int err = rfcomm_channel_send_uih_data(channel, &data[bytes_sent], frame_len);
+        if (err){
+            log_error("rfcomm_send_stream: error %d", err);
+            break;
+        }
+        bytes_sent += frame_len;
+    }
+    return bytes_sent;
 }
 
 // Sends Local Lnie Status, see LINE_STATUS_..
@@ -2356,8 +2522,7 @@ static uint8_t rfcomm_channel_create_internal(btstack_packet_handler_t packet_ha
     
     // check if channel for this remote service already exists
     dlci = (server_channel << 1) | (multiplexer->outgoing ^ 1);
-    channel = rfcomm_channel_for_multiplexer_and_dlci(multiplexer, dlci);
-    if (channel){
+    if (rfcomm_channel_for_multiplexer_and_dlci(multiplexer, dlci)){
         status = RFCOMM_CHANNEL_ALREADY_REGISTERED;
         goto fail;
     }
@@ -2403,7 +2568,7 @@ static uint8_t rfcomm_channel_create_internal(btstack_packet_handler_t packet_ha
             status = l2cap_create_channel(rfcomm_packet_handler, addr, BLUETOOTH_PROTOCOL_RFCOMM, l2cap_max_mtu(), &l2cap_cid);
         }
         if (status) goto fail;
-        multiplexer->l2cap_cid = l2cap_cid;
+        rfcomm_multiplexer_set_l2cap_cid(multiplexer, l2cap_cid);
         return 0;
     }
     
@@ -2414,8 +2579,8 @@ static uint8_t rfcomm_channel_create_internal(btstack_packet_handler_t packet_ha
     return 0;
 
 fail:
-    if (new_multiplexer) btstack_memory_rfcomm_multiplexer_free(multiplexer);
-    if (channel)         btstack_memory_rfcomm_channel_free(channel);
+    if (channel)         rfcomm_channel_free(channel);
+    if (new_multiplexer) rfcomm_multiplexer_free(multiplexer);
     return status;
 }
 
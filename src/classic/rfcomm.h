@@ -150,9 +150,14 @@ typedef struct {
     
 } rfcomm_service_t;
 
+// DLCI 2..61 are used for server channels 1..30
+#define RFCOMM_MULTIPLEXER_NUM_DLCIS 62
+
+struct rfcomm_channel;
+
 // info regarding multiplexer
 // note: spec mandates single multiplexer per device combination
-typedef struct {
+typedef struct rfcomm_multiplexer {
     // linked list - assert: first field
     btstack_linked_item_t    item;
     
@@ -188,10 +193,16 @@ typedef struct {
     uint8_t test_data_len;
     uint8_t test_data[RFCOMM_TEST_DATA_MAX_LEN];
 
+    // channels indexed by DLCI
+    struct rfcomm_channel * channel_for_dlci[RFCOMM_MULTIPLEXER_NUM_DLCIS];
+
+    // next multiplexer in l2cap_cid hash chain
+    struct rfcomm_multiplexer * next_for_l2cap_cid;
+
 } rfcomm_multiplexer_t;
 
 // info regarding an actual connection
-typedef struct {
+typedef struct rfcomm_channel {
 
     // linked list - assert: first field
     btstack_linked_item_t    item;
@@ -207,6 +218,9 @@ typedef struct {
 	
     // RFCOMM Channel ID
     uint16_t rfcomm_cid;
+
+    // next channel in rfcomm_cid hash chain
+    struct rfcomm_channel * next_for_rfcomm_cid;
         
     // 
     uint8_t  dlci; 
@@ -219,9 +233,15 @@ typedef struct {
 
     // credits for incoming traffic
     uint8_t credits_incoming;
+
+    // number of credits remote gets without incoming flow control, adapted to incoming traffic
+    uint8_t automatic_credits_window;
     
     // use incoming flow control
     uint8_t incoming_flow_control;
+
+    // last data frame from client had room for credits
+    uint8_t data_frames_carry_credits;
     
     // channel state
     RFCOMM_CHANNEL_STATE state;
@@ -363,6 +383,17 @@ void rfcomm_request_can_send_now_event(uint16_t rfcomm_cid);
  */
 int  rfcomm_send(uint16_t rfcomm_cid, uint8_t *data, uint16_t len);
 
+/**
+ * @brief Sends as much data as possible split into frames of max frame size, limited by available credits and ACL buffers
+ * @note Pending credits for the remote side are sent with the data. When used with btstack_ring_buffer_read_spans,
+ *       call for each span and commit the number of bytes sent. If not all data was sent, request can send now event.
+ * @param rfcomm_cid
+ * @param data
+ * @param len
+ * @return number of bytes sent
+ */
+uint32_t rfcomm_send_stream(uint16_t rfcomm_cid, const uint8_t *data, uint32_t len);
+
 /** 
  * @brief Sends Local Line Status, see LINE_STATUS_..
  * @param rfcomm_cid
@@ -41,10 +41,13 @@
  *  sdp_client.c
  */
 
+#include <string.h>
+
 #include "bluetooth_sdp.h"
 #include "btstack_config.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
+#include "btstack_linked_list.h"
 #include "classic/core.h"
 #include "classic/sdp_client.h"
 #include "classic/sdp_server.h"
@@ -52,6 +55,9 @@
 #include "hci_cmd.h"
 #include "l2cap.h"
 
+// DES with a single UUID128
+#define SDP_CLIENT_SERVICE_SEARCH_PATTERN_BUFFER_SIZE 19
+
 // Types SDP Parser - Data Element stream helper
 typedef enum { 
     GET_LIST_LENGTH = 1,
@@ -64,9 +70,47 @@ typedef enum {
 
 // Types SDP Client 
 typedef enum {
-    INIT, W4_CONNECT, W2_SEND, W4_RESPONSE, QUERY_COMPLETE
+    INIT, W2_CONNECT, W4_CONNECT, W2_SEND, W4_RESPONSE, QUERY_COMPLETE
 } sdp_client_state_t;
 
+typedef struct {
+    // linked list for queued queries - assert: first field
+    btstack_linked_item_t item;
+
+    // State SDP Client
+    sdp_client_state_t state;
+    uint16_t  query_id;
+    bd_addr_t remote;
+    uint16_t  mtu;
+    uint16_t  sdp_cid;
+    const uint8_t * service_search_pattern;
+    uint8_t   service_search_pattern_buffer[SDP_CLIENT_SERVICE_SEARCH_PATTERN_BUFFER_SIZE];
+    const uint8_t * attribute_id_list;
+    uint16_t  transactionID;
+    uint8_t   continuationState[16];
+    uint8_t   continuationStateLen;
+    SDP_PDU_ID_t PDU_ID;
+#ifdef ENABLE_SDP_EXTRA_QUERIES
+    uint32_t serviceRecordHandle;
+    uint32_t record_handle;
+#endif
+
+    // State DES Parser
+    de_state_t de_header_state;
+
+    // State SDP Parser
+    sdp_parser_state_t  state_parser;
+    uint16_t attribute_id;
+    uint16_t attribute_bytes_received;
+    uint16_t attribute_bytes_delivered;
+    uint16_t list_offset;
+    uint16_t list_size;
+    uint16_t record_offset;
+    uint16_t record_size;
+    uint16_t attribute_value_size;
+    int record_counter;
+    btstack_packet_handler_t sdp_parser_callback;
+} sdp_client_query_t;
 
 // Prototypes SDP Parser
 void sdp_parser_init(btstack_packet_handler_t callback);
@@ -89,36 +133,12 @@ static void     sdp_client_parse_service_attribute_response(uint8_t* packet, uin
 
 static uint8_t des_attributeIDList[] = { 0x35, 0x05, 0x0A, 0x00, 0x01, 0xff, 0xff};  // Attribute: 0x0001 - 0x0100
 
-// State DES Parser
-static de_state_t de_header_state;
-
-// State SDP Parser
-static sdp_parser_state_t  state = GET_LIST_LENGTH;
-static uint16_t attribute_id = 0;
-static uint16_t attribute_bytes_received = 0;
-static uint16_t attribute_bytes_delivered = 0;
-static uint16_t list_offset = 0;
-static uint16_t list_size;
-static uint16_t record_offset = 0;
-static uint16_t record_size;
-static uint16_t attribute_value_size;
-static int record_counter = 0;
-static btstack_packet_handler_t sdp_parser_callback;
-
-// State SDP Client
-static uint16_t  mtu;
-static uint16_t  sdp_cid = 0x40;
-static const uint8_t * service_search_pattern;
-static const uint8_t * attribute_id_list;
-static uint16_t  transactionID = 0;
-static uint8_t   continuationState[16];
-static uint8_t   continuationStateLen;
-static sdp_client_state_t sdp_client_state = INIT;
-static SDP_PDU_ID_t PDU_ID = SDP_Invalid;
-#ifdef ENABLE_SDP_EXTRA_QUERIES
-static uint32_t serviceRecordHandle;
-static uint32_t record_handle;
-#endif
+static sdp_client_query_t   sdp_client_queries[SDP_CLIENT_MAX_QUERIES];
+static btstack_linked_list_t sdp_client_queued_queries;
+static uint16_t             sdp_client_next_query_id;
+
+// query processed by SDP Parser and request setup
+static sdp_client_query_t * sdp_client_query_current = &sdp_client_queries[0];
 
 // DES Parser
 void de_state_init(de_state_t * de_state){
@@ -158,100 +178,103 @@ int de_state_size(uint8_t eventByte, de_state_t *de_state){
 
 // SDP Parser
 static void sdp_parser_emit_value_byte(uint8_t event_byte){
+    sdp_client_query_t * query = sdp_client_query_current;
     uint8_t event[11];
     event[0] = SDP_EVENT_QUERY_ATTRIBUTE_VALUE;
     event[1] = 9;
-    little_endian_store_16(event, 2, record_counter);
-    little_endian_store_16(event, 4, attribute_id);
-    little_endian_store_16(event, 6, attribute_value_size);
-    little_endian_store_16(event, 8, attribute_bytes_delivered);
+    little_endian_store_16(event, 2, query->record_counter);
+    little_endian_store_16(event, 4, query->attribute_id);
+    little_endian_store_16(event, 6, query->attribute_value_size);
+    little_endian_store_16(event, 8, query->attribute_bytes_delivered);
     event[10] = event_byte;
-    (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+    (*query->sdp_parser_callback)(HCI_EVENT_PACKET, query->query_id, event, sizeof(event)); 
 }
 
 static void sdp_parser_process_byte(uint8_t eventByte){
+    sdp_client_query_t * query = sdp_client_query_current;
+
     // count all bytes
-    list_offset++;
-    record_offset++;
+    query->list_offset++;
+    query->record_offset++;
 
     // log_info(" parse BYTE_RECEIVED %02x", eventByte);
-    switch(state){
+    switch(query->state_parser){
         case GET_LIST_LENGTH:
-            if (!de_state_size(eventByte, &de_header_state)) break;
-            list_offset = de_header_state.de_offset;
-            list_size = de_header_state.de_size;
+            if (!de_state_size(eventByte, &query->de_header_state)) break;
+            query->list_offset = query->de_header_state.de_offset;
+            query->list_size = query->de_header_state.de_size;
             // log_info("parser: List offset %u, list size %u", list_offset, list_size);
             
-            record_counter = 0;
-            state = GET_RECORD_LENGTH;
+            query->record_counter = 0;
+            query->state_parser = GET_RECORD_LENGTH;
             break;
 
         case GET_RECORD_LENGTH:
             // check size
-            if (!de_state_size(eventByte, &de_header_state)) break;
+            if (!de_state_size(eventByte, &query->de_header_state)) break;
             // log_info("parser: Record payload is %d bytes.", de_header_state.de_size);
-            record_offset = de_header_state.de_offset;
-            record_size = de_header_state.de_size;
-            state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
+            query->record_offset = query->de_header_state.de_offset;
+            query->record_size = query->de_header_state.de_size;
+            query->state_parser = GET_ATTRIBUTE_ID_HEADER_LENGTH;
             break;
 
         case GET_ATTRIBUTE_ID_HEADER_LENGTH:
-            if (!de_state_size(eventByte, &de_header_state)) break;
-            attribute_id = 0;
-            log_debug("ID data is stored in %d bytes.", (int) de_header_state.de_size);
-            state = GET_ATTRIBUTE_ID;
+            if (!de_state_size(eventByte, &query->de_header_state)) break;
+            query->attribute_id = 0;
+            log_debug("ID data is stored in %d bytes.", (int) query->de_header_state.de_size);
+            query->state_parser = GET_ATTRIBUTE_ID;
             break;
         
         case GET_ATTRIBUTE_ID:
-            attribute_id = (attribute_id << 8) | eventByte;
-            de_header_state.de_size--;
-            if (de_header_state.de_size > 0) break;
-            log_debug("parser: Attribute ID: %04x.", attribute_id);
-
-            state = GET_ATTRIBUTE_VALUE_LENGTH;
-            attribute_bytes_received  = 0;
-            attribute_bytes_delivered = 0;
-            attribute_value_size      = 0;
-            de_state_init(&de_header_state);
+            query->attribute_id = (query->attribute_id << 8) | eventByte;
+            query->de_header_state.de_size--;
+            if (query->de_header_state.de_size > 0) break;
+            log_debug("parser: Attribute ID: %04x.", query->attribute_id);
+
+            query->state_parser = GET_ATTRIBUTE_VALUE_LENGTH;
+            query->attribute_bytes_received  = 0;
+            query->attribute_bytes_delivered = 0;
+            query->attribute_value_size      = 0;
+            de_state_init(&query->de_header_state);
             break;
         
         case GET_ATTRIBUTE_VALUE_LENGTH:
-            attribute_bytes_received++;
+            query->attribute_bytes_received++;
             sdp_parser_emit_value_byte(eventByte);
-            attribute_bytes_delivered++;
-            if (!de_state_size(eventByte, &de_header_state)) break;
+            query->attribute_bytes_delivered++;
+            if (!de_state_size(eventByte, &query->de_header_state)) break;
 
-            attribute_value_size = de_header_state.de_size + attribute_bytes_received;
+            query->attribute_value_size = query->de_header_state.de_size + query->attribute_bytes_received;
 
-            state = GET_ATTRIBUTE_VALUE;
+            query->state_parser = GET_ATTRIBUTE_VALUE;
             break;
         
         case GET_ATTRIBUTE_VALUE: 
-            attribute_bytes_received++;
+            query->attribute_bytes_received++;
             sdp_parser_emit_value_byte(eventByte);
-            attribute_bytes_delivered++;
+            query->attribute_bytes_delivered++;
             // log_debug("paser: attribute_bytes_received %u, attribute_value_size %u", attribute_bytes_received, attribute_value_size);
 
-            if (attribute_bytes_received < attribute_value_size) break;
+            if (query->attribute_bytes_received < query->attribute_value_size) break;
             // log_debug("parser: Record offset %u, record size %u", record_offset, record_size);
-            if (record_offset != record_size){
-                state = GET_ATTRIBUTE_ID_HEADER_LENGTH;
+            if (query->record_offset != query->record_size){
+                query->state_parser = GET_ATTRIBUTE_ID_HEADER_LENGTH;
                 // log_debug("Get next attribute");
                 break;
             } 
-            record_offset = 0;
+            query->record_offset = 0;
             // log_debug("parser: List offset %u, list size %u", list_offset, list_size);
             
-            if (list_size > 0 && list_offset != list_size){
-                record_counter++;
-                state = GET_RECORD_LENGTH;
+            if (query->list_size > 0 && query->list_offset != query->list_size){
+                query->record_counter++;
+                query->state_parser = GET_RECORD_LENGTH;
                 log_debug("parser: END_OF_RECORD");
                 break;
             }
-            list_offset = 0;
-            de_state_init(&de_header_state);
-            state = GET_LIST_LENGTH;
-            record_counter = 0;
+            query->list_offset = 0;
+            de_state_init(&query->de_header_state);
+            query->state_parser = GET_LIST_LENGTH;
+            query->record_counter = 0;
             log_debug("parser: END_OF_RECORD & DONE");
             break;
         default:
@@ -260,13 +283,14 @@ static void sdp_parser_process_byte(uint8_t eventByte){
 }
 
 void sdp_parser_init(btstack_packet_handler_t callback){
+    sdp_client_query_t * query = sdp_client_query_current;
     // init
-    sdp_parser_callback = callback;
-    de_state_init(&de_header_state);
-    state = GET_LIST_LENGTH;
-    list_offset = 0;
-    record_offset = 0;
-    record_counter = 0;
+    query->sdp_parser_callback = callback;
+    de_state_init(&query->de_header_state);
+    query->state_parser = GET_LIST_LENGTH;
+    query->list_offset = 0;
+    query->record_offset = 0;
+    query->record_counter = 0;
 }
 
 void sdp_parser_handle_chunk(uint8_t * data, uint16_t size){
@@ -278,44 +302,141 @@ void sdp_parser_handle_chunk(uint8_t * data, uint16_t size){
 
 #ifdef ENABLE_SDP_EXTRA_QUERIES
 void sdp_parser_init_service_attribute_search(void){
+    sdp_client_query_t * query = sdp_client_query_current;
     // init
-    de_state_init(&de_header_state);
-    state = GET_RECORD_LENGTH;
-    list_offset = 0;
-    record_offset = 0;
-    record_counter = 0;
+    de_state_init(&query->de_header_state);
+    query->state_parser = GET_RECORD_LENGTH;
+    query->list_offset = 0;
+    query->record_offset = 0;
+    query->record_counter = 0;
 }
 
 void sdp_parser_init_service_search(void){
-    record_offset = 0;
+    sdp_client_query_current->record_offset = 0;
 }
 
 void sdp_parser_handle_service_search(uint8_t * data, uint16_t total_count, uint16_t record_handle_count){
+    sdp_client_query_t * query = sdp_client_query_current;
     int i;
     for (i=0;i<record_handle_count;i++){
-        record_handle = big_endian_read_32(data, i*4);
-        record_counter++;
+        query->record_handle = big_endian_read_32(data, i*4);
+        query->record_counter++;
         uint8_t event[10];
         event[0] = SDP_EVENT_QUERY_SERVICE_RECORD_HANDLE;
         event[1] = 8;
         little_endian_store_16(event, 2, total_count);
-        little_endian_store_16(event, 4, record_counter);
-        little_endian_store_32(event, 6, record_handle);
-        (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+        little_endian_store_16(event, 4, query->record_counter);
+        little_endian_store_32(event, 6, query->record_handle);
+        (*query->sdp_parser_callback)(HCI_EVENT_PACKET, query->query_id, event, sizeof(event)); 
     }        
 }
 #endif
 
 void sdp_parser_handle_done(uint8_t status){
+    sdp_client_query_t * query = sdp_client_query_current;
     uint8_t event[3];
     event[0] = SDP_EVENT_QUERY_COMPLETE;
     event[1] = 1;
     event[2] = status;
-    (*sdp_parser_callback)(HCI_EVENT_PACKET, 0, event, sizeof(event)); 
+    (*query->sdp_parser_callback)(HCI_EVENT_PACKET, query->query_id, event, sizeof(event)); 
 }
 
 // SDP Client
 
+static sdp_client_query_t * sdp_client_query_for_cid(uint16_t cid){
+    int i;
+    for (i=0;i<SDP_CLIENT_MAX_QUERIES;i++){
+        sdp_client_query_t * query = &sdp_client_queries[i];
+        if (query->state == INIT || query->state == W2_CONNECT) continue;
+        if (query->sdp_cid == cid) return query;
+    }
+    return NULL;
+}
+
+static int sdp_client_num_active_queries(void){
+    int num_active = 0;
+    int i;
+    for (i=0;i<SDP_CLIENT_MAX_QUERIES;i++){
+        if (sdp_client_queries[i].state == INIT || sdp_client_queries[i].state == W2_CONNECT) continue;
+        num_active++;
+    }
+    return num_active;
+}
+
+static uint8_t sdp_client_query_connect(sdp_client_query_t * query){
+    query->state = W4_CONNECT;
+    uint8_t status = l2cap_create_channel(sdp_client_packet_handler, query->remote, BLUETOOTH_PROTOCOL_SDP, l2cap_max_mtu(), &query->sdp_cid);
+    if (status){
+        query->state = INIT;
+    }
+    return status;
+}
+
+// mark query as free before emitting done, allows to start a new query from the callback
+static void sdp_client_query_finalize(sdp_client_query_t * query, uint8_t status){
+    query->state = INIT;
+    sdp_client_query_current = query;
+    sdp_parser_handle_done(status);
+}
+
+static void sdp_client_start_queued_queries(void){
+    while (sdp_client_queued_queries && sdp_client_num_active_queries() < SDP_CLIENT_MAX_PARALLEL_QUERIES){
+        sdp_client_query_t * query = (sdp_client_query_t *) btstack_linked_list_pop(&sdp_client_queued_queries);
+        uint8_t status = sdp_client_query_connect(query);
+        if (status){
+            log_info("SDP Client query 0x%04x failed to connect, status 0x%02x", query->query_id, status);
+            sdp_client_query_finalize(query, status);
+        }
+    }
+}
+
+// allocate query context, parser is initialized by caller
+static sdp_client_query_t * sdp_client_query_create(bd_addr_t remote, SDP_PDU_ID_t pdu_id){
+    int i;
+    for (i=0;i<SDP_CLIENT_MAX_QUERIES;i++){
+        sdp_client_query_t * query = &sdp_client_queries[i];
+        if (query->state != INIT) continue;
+        sdp_client_next_query_id++;
+        if (sdp_client_next_query_id == 0){
+            sdp_client_next_query_id = 1;
+        }
+        query->query_id = sdp_client_next_query_id;
+        memcpy(query->remote, remote, 6);
+        query->continuationStateLen = 0;
+        query->PDU_ID = pdu_id;
+        query->service_search_pattern = NULL;
+        query->attribute_id_list = NULL;
+        sdp_client_query_current = query;
+        return query;
+    }
+    return NULL;
+}
+
+// copy short patterns, e.g. from sdp_service_search_pattern_for_uuid16, as the global buffer might be reused by another query
+static void sdp_client_query_set_service_search_pattern(sdp_client_query_t * query, const uint8_t * des_service_search_pattern){
+    uint16_t service_search_pattern_len = de_get_len(des_service_search_pattern);
+    if (service_search_pattern_len > SDP_CLIENT_SERVICE_SEARCH_PATTERN_BUFFER_SIZE){
+        query->service_search_pattern = des_service_search_pattern;
+        return;
+    }
+    memcpy(query->service_search_pattern_buffer, des_service_search_pattern, service_search_pattern_len);
+    query->service_search_pattern = query->service_search_pattern_buffer;
+}
+
+// connect now or queue query if max number of parallel queries is reached
+static uint8_t sdp_client_query_start(sdp_client_query_t * query, uint16_t * out_query_id){
+    if (out_query_id){
+        *out_query_id = query->query_id;
+    }
+    if (sdp_client_num_active_queries() < SDP_CLIENT_MAX_PARALLEL_QUERIES){
+        return sdp_client_query_connect(query);
+    }
+    log_info("SDP Client query 0x%04x queued", query->query_id);
+    query->state = W2_CONNECT;
+    btstack_linked_list_add_tail(&sdp_client_queued_queries, (btstack_linked_item_t *) query);
+    return 0;
+}
+
 // TODO: inline if not needed (des(des))
 
 static void sdp_client_parse_attribute_lists(uint8_t* packet, uint16_t length){
@@ -323,15 +444,17 @@ static void sdp_client_parse_attribute_lists(uint8_t* packet, uint16_t length){
 }
 
 
-static void sdp_client_send_request(uint16_t channel){
+static void sdp_client_send_request(sdp_client_query_t * query){
 
-    if (sdp_client_state != W2_SEND) return;
+    if (query->state != W2_SEND) return;
+
+    sdp_client_query_current = query;
 
     l2cap_reserve_packet_buffer();
     uint8_t * data = l2cap_get_outgoing_buffer();
     uint16_t request_len = 0;
 
-    switch (PDU_ID){
+    switch (query->PDU_ID){
 #ifdef ENABLE_SDP_EXTRA_QUERIES
         case SDP_ServiceSearchResponse:
             request_len = sdp_client_setup_service_search_request(data);
@@ -344,18 +467,19 @@ static void sdp_client_send_request(uint16_t channel){
             request_len = sdp_client_setup_service_search_attribute_request(data);
             break;
         default:
-            log_error("SDP Client sdp_client_send_request :: PDU ID invalid. %u", PDU_ID);
+            log_error("SDP Client sdp_client_send_request :: PDU ID invalid. %u", query->PDU_ID);
             return;
     }
 
     // prevent re-entrance
-    sdp_client_state = W4_RESPONSE;
-    PDU_ID = SDP_Invalid;
-    l2cap_send_prepared(channel, request_len);
+    query->state = W4_RESPONSE;
+    query->PDU_ID = SDP_Invalid;
+    l2cap_send_prepared(query->sdp_cid, request_len);
 }
 
 
 static void sdp_client_parse_service_search_attribute_response(uint8_t* packet, uint16_t size){
+    sdp_client_query_t * query = sdp_client_query_current;
 
     uint16_t offset = 3;
     if (offset + 2 + 2 > size) return;  // parameterLength + attributeListByteCount
@@ -366,7 +490,7 @@ static void sdp_client_parse_service_search_attribute_response(uint8_t* packet,
     // AttributeListByteCount <= mtu
     uint16_t attributeListByteCount = big_endian_read_16(packet,offset);
     offset+=2;
-    if (attributeListByteCount > mtu){
+    if (attributeListByteCount > query->mtu){
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in found attribute list is larger then the MaximumAttributeByteCount.");
         return;
     }
@@ -378,36 +502,41 @@ static void sdp_client_parse_service_search_attribute_response(uint8_t* packet,
 
     // continuation state len
     if (offset + 1 > size) return;
-    continuationStateLen = packet[offset];
+    query->continuationStateLen = packet[offset];
     offset++;
-    if (continuationStateLen > 16){
-        continuationStateLen = 0;
+    if (query->continuationStateLen > 16){
+        query->continuationStateLen = 0;
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
 
     // continuation state
-    if (offset + continuationStateLen > size) return;
-    memcpy(continuationState, packet+offset, continuationStateLen);
+    if (offset + query->continuationStateLen > size) return;
+    memcpy(query->continuationState, packet+offset, query->continuationStateLen);
     // offset+=continuationStateLen;
 }
 
 void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
     
+    sdp_client_query_t * query;
+
     // uint16_t handle;
     if (packet_type == L2CAP_DATA_PACKET){
+        query = sdp_client_query_for_cid(channel);
+        if (!query) return;
         if (size < 3) return;
         uint16_t responseTransactionID = big_endian_read_16(packet,1);
-        if (responseTransactionID != transactionID){
-            log_error("Mismatching transaction ID, expected %u, found %u.", transactionID, responseTransactionID);
+        if (responseTransactionID != query->transactionID){
+            log_error("Mismatching transaction ID, expected %u, found %u.", query->transactionID, responseTransactionID);
             return;
         } 
         
-        PDU_ID = (SDP_PDU_ID_t)packet[0];
-        switch (PDU_ID){
+        sdp_client_query_current = query;
+        query->PDU_ID = (SDP_PDU_ID_t)packet[0];
+        switch (query->PDU_ID){
             case SDP_ErrorResponse:
                 log_error("Received error response with code %u, disconnecting", packet[2]);
-                l2cap_disconnect(sdp_cid, 0);
+                l2cap_disconnect(query->sdp_cid, 0);
                 return;
 #ifdef ENABLE_SDP_EXTRA_QUERIES
             case SDP_ServiceSearchResponse:
@@ -421,20 +550,20 @@ void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
                 sdp_client_parse_service_search_attribute_response(packet, size);
                 break;
             default:
-                log_error("PDU ID %u unexpected/invalid", PDU_ID);
+                log_error("PDU ID %u unexpected/invalid", query->PDU_ID);
                 return;
         }
 
         // continuation set or DONE?
-        if (continuationStateLen == 0){
+        if (query->continuationStateLen == 0){
             log_debug("SDP Client Query DONE! ");
-            sdp_client_state = QUERY_COMPLETE;
-            l2cap_disconnect(sdp_cid, 0);
+            query->state = QUERY_COMPLETE;
+            l2cap_disconnect(query->sdp_cid, 0);
             return;
         }
         // prepare next request and send
-        sdp_client_state = W2_SEND;
-        l2cap_request_can_send_now_event(sdp_cid);
+        query->state = W2_SEND;
+        l2cap_request_can_send_now_event(query->sdp_cid);
         return;
     }
     
@@ -442,37 +571,39 @@ void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
     
     switch(hci_event_packet_get_type(packet)){
         case L2CAP_EVENT_CHANNEL_OPENED:
-            if (sdp_client_state != W4_CONNECT) break;
+            query = sdp_client_query_for_cid(l2cap_event_channel_opened_get_local_cid(packet));
+            if (!query) break;
+            if (query->state != W4_CONNECT) break;
             // data: event (8), len(8), status (8), address(48), handle (16), psm (16), local_cid(16), remote_cid (16), local_mtu(16), remote_mtu(16) 
             if (packet[2]) {
                 log_info("SDP Client Connection failed, status 0x%02x.", packet[2]);
-                sdp_client_state = INIT;
-                sdp_parser_handle_done(packet[2]);
+                sdp_client_query_finalize(query, packet[2]);
+                sdp_client_start_queued_queries();
                 break;
             }
-            sdp_cid = channel;
-            mtu = little_endian_read_16(packet, 17);
+            query->mtu = little_endian_read_16(packet, 17);
             // handle = little_endian_read_16(packet, 9);
-            log_debug("SDP Client Connected, cid %x, mtu %u.", sdp_cid, mtu);
+            log_debug("SDP Client Connected, cid %x, mtu %u.", query->sdp_cid, query->mtu);
 
-            sdp_client_state = W2_SEND;
-            l2cap_request_can_send_now_event(sdp_cid);
+            query->state = W2_SEND;
+            l2cap_request_can_send_now_event(query->sdp_cid);
             break;
 
         case L2CAP_EVENT_CAN_SEND_NOW:
-            if(l2cap_event_can_send_now_get_local_cid(packet) == sdp_cid){
-                sdp_client_send_request(sdp_cid);
-            }
+            query = sdp_client_query_for_cid(l2cap_event_can_send_now_get_local_cid(packet));
+            if (!query) break;
+            sdp_client_send_request(query);
             break;
         case L2CAP_EVENT_CHANNEL_CLOSED: {
-            if (sdp_cid != little_endian_read_16(packet, 2)) {
-                // log_info("Received L2CAP_EVENT_CHANNEL_CLOSED for cid %x, current cid %x\n",  little_endian_read_16(packet, 2),sdp_cid);
+            query = sdp_client_query_for_cid(l2cap_event_channel_closed_get_local_cid(packet));
+            if (!query) {
+                // log_info("Received L2CAP_EVENT_CHANNEL_CLOSED for cid %x\n",  little_endian_read_16(packet, 2));
                 break;
             }
             log_info("SDP Client disconnected.");
-            uint8_t status = sdp_client_state == QUERY_COMPLETE ? 0 : SDP_QUERY_INCOMPLETE;
-            sdp_client_state = INIT;
-            sdp_parser_handle_done(status);
+            uint8_t status = query->state == QUERY_COMPLETE ? 0 : SDP_QUERY_INCOMPLETE;
+            sdp_client_query_finalize(query, status);
+            sdp_client_start_queued_queries();
             break;
         }
         default:
@@ -482,13 +613,14 @@ void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
 
 
 static uint16_t sdp_client_setup_service_search_attribute_request(uint8_t * data){
+    sdp_client_query_t * query = sdp_client_query_current;
 
     uint16_t offset = 0;
-    transactionID++;
+    query->transactionID++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceSearchAttributeRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, transactionID);
+    big_endian_store_16(data, offset, query->transactionID);
     offset += 2;
 
     // param legnth
@@ -496,24 +628,24 @@ static uint16_t sdp_client_setup_service_search_attribute_request(uint8_t * data
 
     // parameters: 
     //     Service_search_pattern - DES (min 1 UUID, max 12)
-    uint16_t service_search_pattern_len = de_get_len(service_search_pattern);
-    memcpy(data + offset, service_search_pattern, service_search_pattern_len);
+    uint16_t service_search_pattern_len = de_get_len(query->service_search_pattern);
+    memcpy(data + offset, query->service_search_pattern, service_search_pattern_len);
     offset += service_search_pattern_len;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, mtu);
+    big_endian_store_16(data, offset, query->mtu);
     offset += 2;
 
     //     AttibuteIDList  
-    uint16_t attribute_id_list_len = de_get_len(attribute_id_list);
-    memcpy(data + offset, attribute_id_list, attribute_id_list_len);
+    uint16_t attribute_id_list_len = de_get_len(query->attribute_id_list);
+    memcpy(data + offset, query->attribute_id_list, attribute_id_list_len);
     offset += attribute_id_list_len;
 
     //     ContinuationState - uint8_t number of cont. bytes N<=16 
-    data[offset++] = continuationStateLen;
+    data[offset++] = query->continuationStateLen;
     //                       - N-bytes previous response from server
-    memcpy(data + offset, continuationState, continuationStateLen);
-    offset += continuationStateLen;
+    memcpy(data + offset, query->continuationState, query->continuationStateLen);
+    offset += query->continuationStateLen;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -527,12 +659,14 @@ void sdp_client_parse_service_record_handle_list(uint8_t* packet, uint16_t total
 }
 
 static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
+    sdp_client_query_t * query = sdp_client_query_current;
+
     uint16_t offset = 0;
-    transactionID++;
+    query->transactionID++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceSearchRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, transactionID);
+    big_endian_store_16(data, offset, query->transactionID);
     offset += 2;
 
     // param legnth
@@ -540,19 +674,19 @@ static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
 
     // parameters: 
     //     Service_search_pattern - DES (min 1 UUID, max 12)
-    uint16_t service_search_pattern_len = de_get_len(service_search_pattern);
-    memcpy(data + offset, service_search_pattern, service_search_pattern_len);
+    uint16_t service_search_pattern_len = de_get_len(query->service_search_pattern);
+    memcpy(data + offset, query->service_search_pattern, service_search_pattern_len);
     offset += service_search_pattern_len;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, mtu);
+    big_endian_store_16(data, offset, query->mtu);
     offset += 2;
 
     //     ContinuationState - uint8_t number of cont. bytes N<=16 
-    data[offset++] = continuationStateLen;
+    data[offset++] = query->continuationStateLen;
     //                       - N-bytes previous response from server
-    memcpy(data + offset, continuationState, continuationStateLen);
-    offset += continuationStateLen;
+    memcpy(data + offset, query->continuationState, query->continuationStateLen);
+    offset += query->continuationStateLen;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -562,13 +696,14 @@ static uint16_t sdp_client_setup_service_search_request(uint8_t * data){
 
 
 static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
+    sdp_client_query_t * query = sdp_client_query_current;
 
     uint16_t offset = 0;
-    transactionID++;
+    query->transactionID++;
     // uint8_t SDP_PDU_ID_t.SDP_ServiceSearchRequest;
     data[offset++] = SDP_ServiceAttributeRequest;
     // uint16_t transactionID
-    big_endian_store_16(data, offset, transactionID);
+    big_endian_store_16(data, offset, query->transactionID);
     offset += 2;
 
     // param legnth
@@ -576,23 +711,23 @@ static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
 
     // parameters: 
     //     ServiceRecordHandle
-    big_endian_store_32(data, offset, serviceRecordHandle);
+    big_endian_store_32(data, offset, query->serviceRecordHandle);
     offset += 4;
 
     //     MaximumAttributeByteCount - uint16_t  0x0007 - 0xffff -> mtu
-    big_endian_store_16(data, offset, mtu);
+    big_endian_store_16(data, offset, query->mtu);
     offset += 2;
 
     //     AttibuteIDList  
-    uint16_t attribute_id_list_len = de_get_len(attribute_id_list);
-    memcpy(data + offset, attribute_id_list, attribute_id_list_len);
+    uint16_t attribute_id_list_len = de_get_len(query->attribute_id_list);
+    memcpy(data + offset, query->attribute_id_list, attribute_id_list_len);
     offset += attribute_id_list_len;
 
     //     ContinuationState - uint8_t number of cont. bytes N<=16 
-    data[offset++] = continuationStateLen;
+    data[offset++] = query->continuationStateLen;
     //                       - N-bytes previous response from server
-    memcpy(data + offset, continuationState, continuationStateLen);
-    offset += continuationStateLen;
+    memcpy(data + offset, query->continuationState, query->continuationStateLen);
+    offset += query->continuationStateLen;
 
     // uint16_t paramLength 
     big_endian_store_16(data, 3, offset - 5);
@@ -601,6 +736,7 @@ static uint16_t sdp_client_setup_service_attribute_request(uint8_t * data){
 }
 
 static void sdp_client_parse_service_search_response(uint8_t* packet, uint16_t size){
+    sdp_client_query_t * query = sdp_client_query_current;
 
     uint16_t offset = 3;
     if (offset + 2 + 2 + 2 > size) return;  // parameterLength, totalServiceRecordCount, currentServiceRecordCount
@@ -624,19 +760,20 @@ static void sdp_client_parse_service_search_response(uint8_t* packet, uint16_t s
     offset+= currentServiceRecordCount * 4;
 
     if (offset + 1 > size) return;
-    continuationStateLen = packet[offset];
+    query->continuationStateLen = packet[offset];
     offset++;
-    if (continuationStateLen > 16){
-        continuationStateLen = 0;
+    if (query->continuationStateLen > 16){
+        query->continuationStateLen = 0;
         log_error("Error parsing ServiceSearchResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
-    if (offset + continuationStateLen > size) return;
-    memcpy(continuationState, packet+offset, continuationStateLen);
+    if (offset + query->continuationStateLen > size) return;
+    memcpy(query->continuationState, packet+offset, query->continuationStateLen);
     // offset+=continuationStateLen;
 }
 
 static void sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_t size){
+    sdp_client_query_t * query = sdp_client_query_current;
 
     uint16_t offset = 3;
     if (offset + 2 + 2 > size) return;  // parameterLength, attributeListByteCount
@@ -647,7 +784,7 @@ static void sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_
     // AttributeListByteCount <= mtu
     uint16_t attributeListByteCount = big_endian_read_16(packet,offset);
     offset+=2;
-    if (attributeListByteCount > mtu){
+    if (attributeListByteCount > query->mtu){
         log_error("Error parsing ServiceSearchAttributeResponse: Number of bytes in found attribute list is larger then the MaximumAttributeByteCount.");
         return;
     }
@@ -659,41 +796,51 @@ static void sdp_client_parse_service_attribute_response(uint8_t* packet, uint16_
 
     // continuationStateLen
     if (offset + 1 > size) return;
-    continuationStateLen = packet[offset];
+    query->continuationStateLen = packet[offset];
     offset++;
-    if (continuationStateLen > 16){
-        continuationStateLen = 0;
+    if (query->continuationStateLen > 16){
+        query->continuationStateLen = 0;
         log_error("Error parsing ServiceAttributeResponse: Number of bytes in continuation state exceedes 16.");
         return;
     }
-    if (offset + continuationStateLen > size) return;
-    memcpy(continuationState, packet+offset, continuationStateLen);
+    if (offset + query->continuationStateLen > size) return;
+    memcpy(query->continuationState, packet+offset, query->continuationStateLen);
     // offset+=continuationStateLen;
 }
 #endif
 
 // for testing only
 void sdp_client_reset(void){
-    sdp_client_state = INIT;
+    int i;
+    for (i=0;i<SDP_CLIENT_MAX_QUERIES;i++){
+        sdp_client_queries[i].state = INIT;
+    }
+    sdp_client_queued_queries = NULL;
+    sdp_client_query_current = &sdp_client_queries[0];
 }
 
 // Public API
 
 int sdp_client_ready(void){
-    return sdp_client_state == INIT;
+    int i;
+    for (i=0;i<SDP_CLIENT_MAX_QUERIES;i++){
+        if (sdp_client_queries[i].state == INIT) return 1;
+    }
+    return 0;
 }
 
-uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list){
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+uint8_t sdp_client_query_with_id(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list, uint16_t * out_query_id){
+    sdp_client_query_t * query = sdp_client_query_create(remote, SDP_ServiceSearchAttributeResponse);
+    if (!query) return SDP_QUERY_BUSY;
 
     sdp_parser_init(callback);
-    service_search_pattern = des_service_search_pattern;
-    attribute_id_list = des_attribute_id_list;
-    continuationStateLen = 0;
-    PDU_ID = SDP_ServiceSearchAttributeResponse;
+    sdp_client_query_set_service_search_pattern(query, des_service_search_pattern);
+    query->attribute_id_list = des_attribute_id_list;
+    return sdp_client_query_start(query, out_query_id);
+}
 
-    sdp_client_state = W4_CONNECT;
-    return l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PROTOCOL_SDP, l2cap_max_mtu(), NULL);
+uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list){
+    return sdp_client_query_with_id(callback, remote, des_service_search_pattern, des_attribute_id_list, NULL);
 }
 
 uint8_t sdp_client_query_uuid16(btstack_packet_handler_t callback, bd_addr_t remote, uint16_t uuid){
@@ -708,31 +855,23 @@ uint8_t sdp_client_query_uuid128(btstack_packet_handler_t callback, bd_addr_t re
 
 #ifdef ENABLE_SDP_EXTRA_QUERIES
 uint8_t sdp_client_service_attribute_search(btstack_packet_handler_t callback, bd_addr_t remote, uint32_t search_service_record_handle, const uint8_t * des_attribute_id_list){
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+    sdp_client_query_t * query = sdp_client_query_create(remote, SDP_ServiceAttributeResponse);
+    if (!query) return SDP_QUERY_BUSY;
 
     sdp_parser_init(callback);
-    serviceRecordHandle = search_service_record_handle;
-    attribute_id_list = des_attribute_id_list;
-    continuationStateLen = 0;
-    PDU_ID = SDP_ServiceAttributeResponse;
-
-    sdp_client_state = W4_CONNECT;
-    l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PROTOCOL_SDP, l2cap_max_mtu(), NULL);
+    query->serviceRecordHandle = search_service_record_handle;
+    query->attribute_id_list = des_attribute_id_list;
+    sdp_client_query_start(query, NULL);
     return 0;
 }
 
 uint8_t sdp_client_service_search(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern){
-
-    if (!sdp_client_ready()) return SDP_QUERY_BUSY;
+    sdp_client_query_t * query = sdp_client_query_create(remote, SDP_ServiceSearchResponse);
+    if (!query) return SDP_QUERY_BUSY;
 
     sdp_parser_init(callback);
-    service_search_pattern = des_service_search_pattern;
-    continuationStateLen = 0;
-    PDU_ID = SDP_ServiceSearchResponse;
-
-    sdp_client_state = W4_CONNECT;
-    l2cap_create_channel(sdp_client_packet_handler, remote, BLUETOOTH_PROTOCOL_SDP, l2cap_max_mtu(), NULL);
+    sdp_client_query_set_service_search_pattern(query, des_service_search_pattern);
+    sdp_client_query_start(query, NULL);
     return 0;
 }
 #endif
-
@@ -46,6 +46,16 @@
 
 #include "btstack_util.h"
 
+// number of queries that can be started, queries exceeding SDP_CLIENT_MAX_PARALLEL_QUERIES are queued
+#ifndef SDP_CLIENT_MAX_QUERIES
+#define SDP_CLIENT_MAX_QUERIES 1
+#endif
+
+// number of queries with an active L2CAP channel
+#ifndef SDP_CLIENT_MAX_PARALLEL_QUERIES
+#define SDP_CLIENT_MAX_PARALLEL_QUERIES SDP_CLIENT_MAX_QUERIES
+#endif
+
 #if defined __cplusplus
 extern "C" {
 #endif
@@ -64,7 +74,9 @@ int  de_state_size(uint8_t eventByte, de_state_t *de_state);
 
 /** 
  * @brief Checks if the SDP Client is ready
- * @return 1 when no query is active
+ * @return 1 when a new query can be started
+ * @note up to SDP_CLIENT_MAX_QUERIES queries can be started, at most SDP_CLIENT_MAX_PARALLEL_QUERIES are
+ *       connected at the same time and additional queries are queued
  */
 int sdp_client_ready(void);
 
@@ -78,6 +90,17 @@ int sdp_client_ready(void);
  */
 uint8_t sdp_client_query(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list);
 
+/** 
+ * @brief Same as sdp_client_query, but provides the query id passed as channel to the callback for all events of this query.
+ * Allows to tell apart parallel queries using the same callback.
+ * @param callback for attributes values and done event
+ * @param remote address
+ * @param des_service_search_pattern 
+ * @param des_attribute_id_list
+ * @param out_query_id
+ */
+uint8_t sdp_client_query_with_id(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_service_search_pattern, const uint8_t * des_attribute_id_list, uint16_t * out_query_id);
+
 /*
  * @brief Searches SDP records on a remote device for all services with a given UUID.
  * @note calls sdp_client_query with service search pattern based on uuid16
@@ -69,6 +69,12 @@ uint8_t sdp_client_query_rfcomm_channel_and_name_for_uuid128(btstack_packet_hand
  */
 uint8_t sdp_client_query_rfcomm_channel_and_name_for_search_pattern(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_serviceSearchPattern);
 
+/** 
+ * @brief Same as sdp_client_query_rfcomm_channel_and_name_for_search_pattern, but provides the query id passed as channel to the callback.
+ * Allows to tell apart parallel queries using the same callback.
+ */
+uint8_t sdp_client_query_rfcomm_channel_and_name_for_search_pattern_with_id(btstack_packet_handler_t callback, bd_addr_t remote, const uint8_t * des_serviceSearchPattern, uint16_t * out_query_id);
+
 /* API_END */
 
 #if defined __cplusplus
@@ -56,6 +56,12 @@
 #include "hci.h"
 #include "l2cap.h"
 
+// max number of incoming l2cap connections that are served concurrently, each with its own response buffer
+// default: single connection, e.g. gateways serving many devices can opt in to more
+#ifndef SDP_SERVER_MAX_CONNECTIONS
+#define SDP_SERVER_MAX_CONNECTIONS 1
+#endif
+
 // max number of incoming l2cap connections that can be queued instead of getting rejected
 #ifndef SDP_WAITING_LIST_MAX_COUNT
 #define SDP_WAITING_LIST_MAX_COUNT 8
@@ -69,6 +75,55 @@
 #define SDP_RESPONSE_BUFFER_SIZE (HCI_ACL_PAYLOAD_SIZE-L2CAP_HEADER_SIZE)
 #endif
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+// number of cached Service Search Attribute responses
+#ifndef SDP_RESPONSE_CACHE_NUM_ENTRIES
+#define SDP_RESPONSE_CACHE_NUM_ENTRIES 2
+#endif
+// max size of complete AttributeLists in a cached response
+#ifndef SDP_RESPONSE_CACHE_ENTRY_SIZE
+#define SDP_RESPONSE_CACHE_ENTRY_SIZE 1024
+#endif
+// max size of ServiceSearchPattern + AttributeIDList used as key
+#ifndef SDP_RESPONSE_CACHE_KEY_SIZE
+#define SDP_RESPONSE_CACHE_KEY_SIZE 64
+#endif
+#endif
+
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+// number of indexed service records, additional records are searched by traversal
+#ifndef SDP_RECORD_INDEX_NUM_ENTRIES
+#define SDP_RECORD_INDEX_NUM_ENTRIES 8
+#endif
+#endif
+
+// response context for each incoming connection
+typedef struct {
+    uint16_t l2cap_cid;
+    uint16_t response_size;
+    uint8_t  response_buffer[SDP_RESPONSE_BUFFER_SIZE];
+} sdp_server_connection_t;
+
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+typedef struct {
+    // 0 = unused
+    uint16_t key_len;
+    uint16_t data_len;
+    uint32_t last_used;
+    uint8_t  key[SDP_RESPONSE_CACHE_KEY_SIZE];
+    uint8_t  data[SDP_RESPONSE_CACHE_ENTRY_SIZE];
+} sdp_response_cache_entry_t;
+#endif
+
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+typedef struct {
+    // 0 = unused
+    uint32_t service_record_handle;
+    // UUIDs and attribute offsets, built on registration
+    sdp_record_index_t index;
+} sdp_record_index_entry_t;
+#endif
+
 static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
 
 // registered service records
@@ -77,17 +132,28 @@ static btstack_linked_list_t sdp_service_records = NULL;
 // our handles start after the reserved range
 static uint32_t sdp_next_service_record_handle = ((uint32_t) maxReservedServiceRecordHandle) + 2;
 
-static uint8_t sdp_response_buffer[SDP_RESPONSE_BUFFER_SIZE];
+static sdp_server_connection_t sdp_server_connections[SDP_SERVER_MAX_CONNECTIONS];
 
-static uint16_t l2cap_cid = 0;
-static uint16_t sdp_response_size = 0;
 static uint16_t l2cap_waiting_list_cids[SDP_WAITING_LIST_MAX_COUNT];
 static int      l2cap_waiting_list_count;
 
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+static sdp_response_cache_entry_t sdp_response_cache[SDP_RESPONSE_CACHE_NUM_ENTRIES];
+static uint32_t                   sdp_response_cache_time;
+#endif
+
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+static sdp_record_index_entry_t sdp_record_indices[SDP_RECORD_INDEX_NUM_ENTRIES];
+#endif
+
+static void sdp_response_cache_invalidate(void);
+
 void sdp_init(void){
     // register with l2cap psm sevices - max MTU
     l2cap_register_service(sdp_packet_handler, BLUETOOTH_PROTOCOL_SDP, 0xffff, LEVEL_0);
     l2cap_waiting_list_count = 0;
+    memset(sdp_server_connections, 0, sizeof(sdp_server_connections));
+    sdp_response_cache_invalidate();
 }
 
 uint32_t sdp_get_service_record_handle(const uint8_t * record){
@@ -110,6 +176,36 @@ static service_record_item_t * sdp_get_record_item_for_handle(uint32_t handle){
     return NULL;
 }
 
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+static sdp_record_index_entry_t * sdp_record_index_entry_for_handle(uint32_t handle){
+    int i;
+    for (i=0;i<SDP_RECORD_INDEX_NUM_ENTRIES;i++){
+        if (sdp_record_indices[i].service_record_handle == handle) return &sdp_record_indices[i];
+    }
+    return NULL;
+}
+
+static void sdp_record_index_add(uint32_t handle, uint8_t * record){
+    sdp_record_index_entry_t * entry = sdp_record_index_entry_for_handle(0);
+    if (!entry){
+        log_info("no free index entry for record 0x%08x, using traversal", (int) handle);
+        return;
+    }
+    sdp_record_index_init(&entry->index, record);
+    if (!entry->index.valid){
+        log_info("record 0x%08x exceeds index limits, using traversal", (int) handle);
+        return;
+    }
+    entry->service_record_handle = handle;
+}
+
+static void sdp_record_index_remove(uint32_t handle){
+    sdp_record_index_entry_t * entry = sdp_record_index_entry_for_handle(handle);
+    if (!entry) return;
+    entry->service_record_handle = 0;
+}
+#endif
+
 uint8_t * sdp_get_record_for_handle(uint32_t handle){
     service_record_item_t * record_item =  sdp_get_record_item_for_handle(handle);
     if (!record_item) return 0;
@@ -148,9 +244,14 @@ uint8_t sdp_register_service(const uint8_t * record){
     // set handle and record
     newRecordItem->service_record_handle = record_handle;
     newRecordItem->service_record = (uint8_t*) record;
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+    sdp_record_index_add(record_handle, newRecordItem->service_record);
+#endif
     
     // add to linked list
     btstack_linked_list_add(&sdp_service_records, (btstack_linked_item_t *) newRecordItem);
+
+    sdp_response_cache_invalidate();
     
     return 0;
 }
@@ -163,12 +264,41 @@ void sdp_unregister_service(uint32_t service_record_handle){
     if (!record_item) return;
     btstack_linked_list_remove(&sdp_service_records, (btstack_linked_item_t *) record_item);
     btstack_memory_service_record_item_free(record_item);
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+    sdp_record_index_remove(service_record_handle);
+#endif
+    sdp_response_cache_invalidate();
+}
+
+// access to service records, via record index if enabled and available
+static int sdp_record_item_matches_service_search_pattern(service_record_item_t * item, uint8_t * serviceSearchPattern){
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+    sdp_record_index_entry_t * entry = sdp_record_index_entry_for_handle(item->service_record_handle);
+    if (entry) return sdp_record_index_matches_service_search_pattern(&entry->index, item->service_record, serviceSearchPattern);
+#endif
+    return sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern);
+}
+
+static int sdp_record_item_get_filtered_size(service_record_item_t * item, uint8_t * attributeIDList){
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+    sdp_record_index_entry_t * entry = sdp_record_index_entry_for_handle(item->service_record_handle);
+    if (entry) return sdp_record_index_get_filtered_size(&entry->index, item->service_record, attributeIDList);
+#endif
+    return spd_get_filtered_size(item->service_record, attributeIDList);
+}
+
+static int sdp_record_item_filter_attributes_in_attributeIDList(service_record_item_t * item, uint8_t * attributeIDList, uint16_t startOffset, uint16_t maxBytes, uint16_t * usedBytes, uint8_t * buffer){
+#ifdef ENABLE_SDP_SERVER_RECORD_INDEX
+    sdp_record_index_entry_t * entry = sdp_record_index_entry_for_handle(item->service_record_handle);
+    if (entry) return sdp_record_index_filter_attributes_in_attributeIDList(&entry->index, item->service_record, attributeIDList, startOffset, maxBytes, usedBytes, buffer);
+#endif
+    return sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, startOffset, maxBytes, usedBytes, buffer);
 }
 
 // PDU
 // PDU ID (1), Transaction ID (2), Param Length (2), Param 1, Param 2, ..
 
-static int sdp_create_error_response(uint16_t transaction_id, uint16_t error_code){
+static int sdp_create_error_response(uint8_t * sdp_response_buffer, uint16_t transaction_id, uint16_t error_code){
     sdp_response_buffer[0] = SDP_ErrorResponse;
     big_endian_store_16(sdp_response_buffer, 1, transaction_id);
     big_endian_store_16(sdp_response_buffer, 3, 2);
@@ -176,7 +306,7 @@ static int sdp_create_error_response(uint16_t transaction_id, uint16_t error_cod
     return 7;
 }
 
-int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
+int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer){
     
     // get request details
     uint16_t  transaction_id = big_endian_read_16(packet, 1);
@@ -211,7 +341,7 @@ int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
     uint16_t total_service_count   = 0;
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
         service_record_item_t * item = (service_record_item_t *) it;
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         total_service_count++;
     }
     if (total_service_count > maximumServiceRecordCount){
@@ -226,7 +356,7 @@ int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next, ++current_service_index){
         service_record_item_t * item = (service_record_item_t *) it;
 
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         matching_service_count++;
         
         if (current_service_index < continuation_index) continue;
@@ -263,7 +393,7 @@ int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu){
     return pos;
 }
 
-int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
+int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer){
     
     // get request details
     uint16_t  transaction_id = big_endian_read_16(packet, 1);
@@ -300,7 +430,7 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
     service_record_item_t * item = sdp_get_record_item_for_handle(serviceRecordHandle);
     if (!item){
         // service record handle doesn't exist
-        return sdp_create_error_response(transaction_id, 0x0002); /// invalid Service Record Handle
+        return sdp_create_error_response(sdp_response_buffer, transaction_id, 0x0002); /// invalid Service Record Handle
     }
     
     
@@ -310,7 +440,7 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
     if (continuation_offset == 0){
         
         // get size of this record
-        uint16_t filtered_attributes_size = spd_get_filtered_size(item->service_record, attributeIDList);
+        uint16_t filtered_attributes_size = sdp_record_item_get_filtered_size(item, attributeIDList);
         
         // store DES
         de_store_descriptor_with_len(&sdp_response_buffer[pos], DE_DES, DE_SIZE_VAR_16, filtered_attributes_size);
@@ -320,7 +450,7 @@ int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu){
 
     // copy maximumAttributeByteCount from record
     uint16_t bytes_used;
-    int complete = sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
+    int complete = sdp_record_item_filter_attributes_in_attributeIDList(item, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
     pos += bytes_used;
     
     uint16_t attributeListByteCount = pos - 7;
@@ -349,15 +479,119 @@ static uint16_t sdp_get_size_for_service_search_attribute_response(uint8_t * ser
     for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
         service_record_item_t * item = (service_record_item_t *) it;
         
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
         
         // for all service records that match
-        total_response_size += 3 + spd_get_filtered_size(item->service_record, attributeIDList);
+        total_response_size += 3 + sdp_record_item_get_filtered_size(item, attributeIDList);
     }
     return total_response_size;
 }
 
-int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remote_mtu){
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+
+static void sdp_response_cache_invalidate(void){
+    int i;
+    for (i=0;i<SDP_RESPONSE_CACHE_NUM_ENTRIES;i++){
+        sdp_response_cache[i].key_len = 0;
+    }
+}
+
+// serialize complete AttributeLists for all matching records, @return size or 0 if it doesn't fit
+static uint16_t sdp_response_cache_serialize(uint8_t * serviceSearchPattern, uint8_t * attributeIDList, uint8_t * buffer, uint16_t buffer_size){
+    uint16_t total_response_size = sdp_get_size_for_service_search_attribute_response(serviceSearchPattern, attributeIDList);
+    if (total_response_size + 3 > buffer_size) return 0;
+
+    de_store_descriptor_with_len(buffer, DE_DES, DE_SIZE_VAR_16, total_response_size);
+    uint16_t pos = 3;
+    btstack_linked_item_t *it;
+    for (it = (btstack_linked_item_t *) sdp_service_records; it ; it = it->next){
+        service_record_item_t * item = (service_record_item_t *) it;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
+        uint16_t filtered_attributes_size = sdp_record_item_get_filtered_size(item, attributeIDList);
+        de_store_descriptor_with_len(&buffer[pos], DE_DES, DE_SIZE_VAR_16, filtered_attributes_size);
+        pos += 3;
+        uint16_t bytes_used;
+        sdp_record_item_filter_attributes_in_attributeIDList(item, attributeIDList, 0, buffer_size - pos, &bytes_used, &buffer[pos]);
+        pos += bytes_used;
+    }
+    return pos;
+}
+
+// get cached response for (ServiceSearchPattern, AttributeIDList), create it if needed
+static sdp_response_cache_entry_t * sdp_response_cache_get(uint8_t * serviceSearchPattern, uint16_t serviceSearchPatternLen,
+                                                           uint8_t * attributeIDList, uint16_t attributeIDListLen){
+    uint16_t key_len = serviceSearchPatternLen + attributeIDListLen;
+    if (key_len > SDP_RESPONSE_CACHE_KEY_SIZE) return NULL;
+
+    // lookup, ServiceSearchPattern is a data element with its own length, so concatenation is unique
+    int i;
+    sdp_response_cache_entry_t * lru_entry = &sdp_response_cache[0];
+    for (i=0;i<SDP_RESPONSE_CACHE_NUM_ENTRIES;i++){
+        sdp_response_cache_entry_t * entry = &sdp_response_cache[i];
+        if (entry->key_len == key_len
+        && memcmp(entry->key, serviceSearchPattern, serviceSearchPatternLen) == 0
+        && memcmp(&entry->key[serviceSearchPatternLen], attributeIDList, attributeIDListLen) == 0){
+            entry->last_used = ++sdp_response_cache_time;
+            return entry;
+        }
+        if (lru_entry->key_len == 0) continue;
+        if (entry->key_len == 0 || entry->last_used < lru_entry->last_used){
+            lru_entry = entry;
+        }
+    }
+
+    // create in least recently used entry
+    uint16_t data_len = sdp_response_cache_serialize(serviceSearchPattern, attributeIDList, lru_entry->data, SDP_RESPONSE_CACHE_ENTRY_SIZE);
+    if (data_len == 0) return NULL;
+    lru_entry->key_len   = key_len;
+    lru_entry->data_len  = data_len;
+    lru_entry->last_used = ++sdp_response_cache_time;
+    memcpy(lru_entry->key, serviceSearchPattern, serviceSearchPatternLen);
+    memcpy(&lru_entry->key[serviceSearchPatternLen], attributeIDList, attributeIDListLen);
+    return lru_entry;
+}
+
+// continuation state contains byte offset into cached AttributeLists
+static int sdp_create_service_search_attribute_response_from_cache(sdp_response_cache_entry_t * entry, uint16_t transaction_id,
+                                                                   uint16_t continuation_offset, uint16_t maximumAttributeByteCount, uint8_t * sdp_response_buffer){
+    if (continuation_offset >= entry->data_len){
+        return sdp_create_error_response(sdp_response_buffer, transaction_id, 0x0005); // invalid continuation state
+    }
+
+    // AttributeLists - starts at offset 7
+    uint16_t pos = 7;
+    uint16_t attributeListsByteCount = btstack_min(entry->data_len - continuation_offset, maximumAttributeByteCount);
+    memcpy(&sdp_response_buffer[pos], &entry->data[continuation_offset], attributeListsByteCount);
+    pos += attributeListsByteCount;
+    continuation_offset += attributeListsByteCount;
+
+    // Continuation State
+    if (continuation_offset < entry->data_len){
+        sdp_response_buffer[pos++] = 2;
+        big_endian_store_16(sdp_response_buffer, pos, continuation_offset);
+        pos += 2;
+    } else {
+        // complete
+        sdp_response_buffer[pos++] = 0;
+    }
+
+    // create SDP header
+    sdp_response_buffer[0] = SDP_ServiceSearchAttributeResponse;
+    big_endian_store_16(sdp_response_buffer, 1, transaction_id);
+    big_endian_store_16(sdp_response_buffer, 3, pos - 5);  // size of variable payload
+    big_endian_store_16(sdp_response_buffer, 5, attributeListsByteCount);
+
+    return pos;
+}
+
+#else
+
+static void sdp_response_cache_invalidate(void){
+}
+
+#endif
+
+int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer){
     
     // SDP header before attribute sevice list: 7
     // Continuation, worst case: 5
@@ -390,6 +624,20 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
         maximumAttributeByteCount = maximumAttributeByteCount2;
     }
     
+#ifdef ENABLE_SDP_SERVER_RESPONSE_CACHE
+    // serve from cache if possible, continuation state with 2 bytes is used for cached responses
+    if (continuationState[0] == 0 || continuationState[0] == 2){
+        sdp_response_cache_entry_t * entry = sdp_response_cache_get(serviceSearchPattern, serviceSearchPatternLen, attributeIDList, attributeIDListLen);
+        if (entry){
+            uint16_t cache_offset = (continuationState[0] == 2) ? big_endian_read_16(continuationState, 1) : 0;
+            return sdp_create_service_search_attribute_response_from_cache(entry, transaction_id, cache_offset, maximumAttributeByteCount, sdp_response_buffer);
+        }
+        if (continuationState[0] == 2){
+            return sdp_create_error_response(sdp_response_buffer, transaction_id, 0x0005); // invalid continuation state
+        }
+    }
+#endif
+
     // continuation state contains: index of next service record to examine
     // continuation state contains: byte offset into this service record
     uint16_t continuation_service_index = 0;
@@ -422,12 +670,12 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
         service_record_item_t * item = (service_record_item_t *) it;
         
         if (current_service_index < continuation_service_index ) continue;
-        if (!sdp_record_matches_service_search_pattern(item->service_record, serviceSearchPattern)) continue;
+        if (!sdp_record_item_matches_service_search_pattern(item, serviceSearchPattern)) continue;
 
         if (continuation_offset == 0){
             
             // get size of this record
-            uint16_t filtered_attributes_size = spd_get_filtered_size(item->service_record, attributeIDList);
+            uint16_t filtered_attributes_size = sdp_record_item_get_filtered_size(item, attributeIDList);
             
             // stop if complete record doesn't fits into response but we already have a partial response
             if ((filtered_attributes_size + 3 > maximumAttributeByteCount) && !first_answer) {
@@ -445,7 +693,7 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
     
         // copy maximumAttributeByteCount from record
         uint16_t bytes_used;
-        int complete = sdp_filter_attributes_in_attributeIDList(item->service_record, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
+        int complete = sdp_record_item_filter_attributes_in_attributeIDList(item, attributeIDList, continuation_offset, maximumAttributeByteCount, &bytes_used, &sdp_response_buffer[pos]);
         pos += bytes_used;
         maximumAttributeByteCount -= bytes_used;
         
@@ -482,14 +730,21 @@ int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remot
     return pos;
 }
 
-static void sdp_respond(void){
-    if (!sdp_response_size ) return;
-    if (!l2cap_cid) return;
+static sdp_server_connection_t * sdp_server_connection_for_cid(uint16_t cid){
+    int i;
+    for (i=0;i<SDP_SERVER_MAX_CONNECTIONS;i++){
+        if (sdp_server_connections[i].l2cap_cid == cid) return &sdp_server_connections[i];
+    }
+    return NULL;
+}
+
+static void sdp_respond(sdp_server_connection_t * connection){
+    if (!connection->response_size ) return;
     
     // update state before sending packet (avoid getting called when new l2cap credit gets emitted)
-    uint16_t size = sdp_response_size;
-    sdp_response_size = 0;
-    l2cap_send(l2cap_cid, sdp_response_buffer, size);
+    uint16_t size = connection->response_size;
+    connection->response_size = 0;
+    l2cap_send(connection->l2cap_cid, connection->response_buffer, size);
 }
 
 // @pre space in list
@@ -507,16 +762,34 @@ static uint16_t sdp_waiting_list_get(void){
     return cid;
 }
 
-// we assume that we don't get two requests in a row
+static void sdp_server_connection_accept(sdp_server_connection_t * connection, uint16_t cid){
+    connection->l2cap_cid = cid;
+    connection->response_size = 0;
+    l2cap_accept_connection(cid);
+}
+
+// free connection and accept queued connection if any
+static void sdp_server_connection_release(sdp_server_connection_t * connection){
+    connection->l2cap_cid = 0;
+    if (!l2cap_waiting_list_count) return;
+    uint16_t cid = sdp_waiting_list_get();
+    log_info("disconnect, accept queued cid 0x%04x, now %u waiting", cid, l2cap_waiting_list_count);
+    sdp_server_connection_accept(connection, cid);
+}
+
+// we assume that we don't get two requests in a row on a single connection
 static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
 	uint16_t transaction_id;
     SDP_PDU_ID_t pdu_id;
     uint16_t remote_mtu;
     uint16_t param_len;
+    sdp_server_connection_t * connection;
     
 	switch (packet_type) {
 			
 		case L2CAP_DATA_PACKET:
+            connection = sdp_server_connection_for_cid(channel);
+            if (!connection) break;
             pdu_id = (SDP_PDU_ID_t) packet[0];
             transaction_id = big_endian_read_16(packet, 1);
             param_len = big_endian_read_16(packet, 3);
@@ -535,23 +808,23 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
             switch (pdu_id){
                     
                 case SDP_ServiceSearchRequest:
-                    sdp_response_size = sdp_handle_service_search_request(packet, remote_mtu);
+                    connection->response_size = sdp_handle_service_search_request(packet, remote_mtu, connection->response_buffer);
                     break;
                                         
                 case SDP_ServiceAttributeRequest:
-                    sdp_response_size = sdp_handle_service_attribute_request(packet, remote_mtu);
+                    connection->response_size = sdp_handle_service_attribute_request(packet, remote_mtu, connection->response_buffer);
                     break;
                     
                 case SDP_ServiceSearchAttributeRequest:
-                    sdp_response_size = sdp_handle_service_search_attribute_request(packet, remote_mtu);
+                    connection->response_size = sdp_handle_service_search_attribute_request(packet, remote_mtu, connection->response_buffer);
                     break;
                     
                 default:
-                    sdp_response_size = sdp_create_error_response(transaction_id, 0x0003); // invalid syntax
+                    connection->response_size = sdp_create_error_response(connection->response_buffer, transaction_id, 0x0003); // invalid syntax
                     break;
             }
-            if (!sdp_response_size) break;
-            l2cap_request_can_send_now_event(l2cap_cid);
+            if (!connection->response_size) break;
+            l2cap_request_can_send_now_event(channel);
 			break;
 			
 		case HCI_EVENT_PACKET:
@@ -559,7 +832,8 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
 			switch (hci_event_packet_get_type(packet)) {
 
 				case L2CAP_EVENT_INCOMING_CONNECTION:
-                    if (l2cap_cid) {
+                    connection = sdp_server_connection_for_cid(0);
+                    if (!connection) {
                         // try to queue up
                         if (l2cap_waiting_list_count < SDP_WAITING_LIST_MAX_COUNT){
                             sdp_waiting_list_add(channel);
@@ -572,39 +846,28 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
                         break;
                     }
                     // accept
-                    l2cap_cid = channel;
-                    sdp_response_size = 0;
-                    l2cap_accept_connection(l2cap_cid);
+                    sdp_server_connection_accept(connection, channel);
 					break;
                     
                 case L2CAP_EVENT_CHANNEL_OPENED:
                     if (packet[2]) {
                         // open failed -> reset
-                        l2cap_cid = 0;
+                        connection = sdp_server_connection_for_cid(l2cap_event_channel_opened_get_local_cid(packet));
+                        if (!connection) break;
+                        sdp_server_connection_release(connection);
                     }
                     break;
 
                 case L2CAP_EVENT_CAN_SEND_NOW:
-                    sdp_respond();
+                    connection = sdp_server_connection_for_cid(channel);
+                    if (!connection) break;
+                    sdp_respond(connection);
                     break;
                 
                 case L2CAP_EVENT_CHANNEL_CLOSED:
-                    if (channel == l2cap_cid){
-                        // reset
-                        l2cap_cid = 0;
-
-                        // other request queued?
-                        if (!l2cap_waiting_list_count) break;
-
-                        // get first item 
-                        l2cap_cid = sdp_waiting_list_get();
-
-                        log_info("disconnect, accept queued cid 0x%04x, now %u waiting", l2cap_cid, l2cap_waiting_list_count);
-
-                        // accept connection
-                        sdp_response_size = 0;
-                        l2cap_accept_connection(l2cap_cid);
-                    }
+                    connection = sdp_server_connection_for_cid(channel);
+                    if (!connection) break;
+                    sdp_server_connection_release(connection);
                     break;
 					                    
 				default:
@@ -618,4 +881,3 @@ static void sdp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *p
 			break;
 	}
 }
-
@@ -54,9 +54,9 @@ typedef struct {
     uint8_t *       service_record;
 } service_record_item_t;
 
-int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu);
-int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu);
-int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remote_mtu);
+int sdp_handle_service_search_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer);
+int sdp_handle_service_attribute_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer);
+int sdp_handle_service_search_attribute_request(uint8_t * packet, uint16_t remote_mtu, uint8_t * sdp_response_buffer);
 
 /* API_START */
 
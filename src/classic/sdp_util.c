@@ -654,6 +654,144 @@ int sdp_record_matches_service_search_pattern(uint8_t *record, uint8_t *serviceS
     return context.result;
 }
 
+// MARK: SDP Record Index
+struct sdp_context_record_index {
+    sdp_record_index_t * index;
+    uint8_t * record;
+};
+
+static void sdp_record_index_add_uuid32(sdp_record_index_t * index, uint32_t uuid32){
+    // insert sorted, ignore duplicates
+    int pos = 0;
+    while (pos < index->num_uuids && index->uuids[pos] < uuid32) pos++;
+    if (pos < index->num_uuids && index->uuids[pos] == uuid32) return;
+    if (index->num_uuids == SDP_RECORD_INDEX_MAX_UUIDS){
+        index->valid = 0;
+        return;
+    }
+    memmove(&index->uuids[pos+1], &index->uuids[pos], (index->num_uuids - pos) * sizeof(uint32_t));
+    index->uuids[pos] = uuid32;
+    index->num_uuids++;
+}
+
+// collect UUIDs in same way as sdp_record_contains_UUID128
+static int sdp_traversal_record_index_uuids(uint8_t * element, de_type_t type, de_size_t de_size, void *my_context){
+    UNUSED(de_size);
+
+    sdp_record_index_t * index = (sdp_record_index_t *) my_context;
+    uint8_t normalizedUUID[16];
+    if (type == DE_UUID && de_get_normalized_uuid(normalizedUUID, element)){
+        if (uuid_has_bluetooth_prefix(normalizedUUID)){
+            sdp_record_index_add_uuid32(index, big_endian_read_32(normalizedUUID, 0));
+        } else {
+            index->has_custom_uuids = 1;
+        }
+    }
+    if (type == DE_DES){
+        de_traverse_sequence(element, sdp_traversal_record_index_uuids, index);
+    }
+    return index->valid == 0;
+}
+
+static int sdp_traversal_record_index_attributes(uint16_t attributeID, uint8_t * attributeValue, de_type_t de_type, de_size_t de_size, void *my_context){
+    UNUSED(de_type);
+    UNUSED(de_size);
+
+    struct sdp_context_record_index * context = (struct sdp_context_record_index *) my_context;
+    sdp_record_index_t * index = context->index;
+    uint16_t num_attributes = index->num_attributes;
+    // attribute IDs have to be in ascending order for binary search
+    if (num_attributes == SDP_RECORD_INDEX_MAX_ATTRIBUTES || (num_attributes && index->attribute_ids[num_attributes-1] >= attributeID)){
+        index->valid = 0;
+        return 1;
+    }
+    index->attribute_ids[num_attributes] = attributeID;
+    index->attribute_value_offsets[num_attributes] = (uint16_t) (attributeValue - context->record);
+    index->num_attributes++;
+    return 0;
+}
+
+void sdp_record_index_init(sdp_record_index_t * index, uint8_t * record){
+    memset(index, 0, sizeof(sdp_record_index_t));
+    index->valid = 1;
+    de_traverse_sequence(record, sdp_traversal_record_index_uuids, index);
+    if (!index->valid) return;
+    struct sdp_context_record_index context;
+    context.index  = index;
+    context.record = record;
+    sdp_attribute_list_traverse_sequence(record, sdp_traversal_record_index_attributes, &context);
+}
+
+static int sdp_record_index_contains_uuid32(const sdp_record_index_t * index, uint32_t uuid32){
+    int left  = 0;
+    int right = index->num_uuids - 1;
+    while (left <= right){
+        int middle = (left + right) / 2;
+        if (index->uuids[middle] == uuid32) return 1;
+        if (index->uuids[middle] < uuid32){
+            left = middle + 1;
+        } else {
+            right = middle - 1;
+        }
+    }
+    return 0;
+}
+
+int sdp_record_index_matches_service_search_pattern(const sdp_record_index_t * index, uint8_t * record, uint8_t * serviceSearchPattern){
+    if (!index->valid) return sdp_record_matches_service_search_pattern(record, serviceSearchPattern);
+
+    // all UUIDs of the pattern have to be in the record
+    des_iterator_t it;
+    if (!des_iterator_init(&it, serviceSearchPattern)) return 1;
+    for ( ; des_iterator_has_more(&it) ; des_iterator_next(&it)){
+        uint8_t normalizedUUID[16];
+        if (!de_get_normalized_uuid(normalizedUUID, des_iterator_get_element(&it))) return 0;
+        if (uuid_has_bluetooth_prefix(normalizedUUID)){
+            if (!sdp_record_index_contains_uuid32(index, big_endian_read_32(normalizedUUID, 0))) return 0;
+        } else {
+            if (!index->has_custom_uuids) return 0;
+            if (!sdp_record_contains_UUID128(record, normalizedUUID)) return 0;
+        }
+    }
+    return 1;
+}
+
+int sdp_record_index_get_filtered_size(const sdp_record_index_t * index, uint8_t * record, uint8_t * attributeIDList){
+    if (!index->valid) return spd_get_filtered_size(record, attributeIDList);
+
+    int size = 0;
+    int i;
+    for (i=0;i<index->num_attributes;i++){
+        if (!sdp_attribute_list_constains_id(attributeIDList, index->attribute_ids[i])) continue;
+        size += 3 + de_get_len(&record[index->attribute_value_offsets[i]]);
+    }
+    return size;
+}
+
+int sdp_record_index_filter_attributes_in_attributeIDList(const sdp_record_index_t * index, uint8_t * record, uint8_t * attributeIDList,
+                                                          uint16_t startOffset, uint16_t maxBytes, uint16_t * usedBytes, uint8_t * buffer){
+    if (!index->valid) return sdp_filter_attributes_in_attributeIDList(record, attributeIDList, startOffset, maxBytes, usedBytes, buffer);
+
+    struct sdp_context_filter_attributes context;
+    context.buffer = buffer;
+    context.maxBytes = maxBytes;
+    context.usedBytes = 0;
+    context.startOffset = startOffset;
+    context.attributeIDList = attributeIDList;
+    context.complete = 1;
+
+    int i;
+    for (i=0;i<index->num_attributes;i++){
+        uint8_t * attributeValue = &record[index->attribute_value_offsets[i]];
+        int done = sdp_traversal_filter_attributes(index->attribute_ids[i], attributeValue,
+            de_get_element_type(attributeValue), de_get_size_type(attributeValue), &context);
+        if (done) break;
+    }
+
+    *usedBytes = context.usedBytes;
+    return context.complete;
+}
+
 // MARK: Dump DataElement
 // context { indent }
 #ifdef ENABLE_SDP_DES_DUMP
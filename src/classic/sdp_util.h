@@ -124,6 +124,31 @@ int       sdp_filter_attributes_in_attributeIDList(uint8_t *record, uint8_t *att
 int       sdp_attribute_list_constains_id(uint8_t *attributeIDList, uint16_t attributeID);
 int       sdp_traversal_match_pattern(uint8_t * element, de_type_t attributeType, de_size_t size, void *my_context);
 
+// MARK: SDP Record Index
+#define SDP_RECORD_INDEX_MAX_UUIDS      16
+#define SDP_RECORD_INDEX_MAX_ATTRIBUTES 24
+
+// pre-computed UUIDs and attribute offsets of a service record, record structure must not change afterwards
+typedef struct {
+    // index covers complete record, functions fall back to record traversal otherwise
+    uint8_t  valid;
+    // record contains UUIDs not based on Bluetooth Base UUID, these are not listed in uuids
+    uint8_t  has_custom_uuids;
+    uint8_t  num_uuids;
+    uint8_t  num_attributes;
+    // UUIDs based on Bluetooth Base UUID as UUID32 in ascending order
+    uint32_t uuids[SDP_RECORD_INDEX_MAX_UUIDS];
+    // attribute IDs in ascending order and offset of attribute value in record
+    uint16_t attribute_ids[SDP_RECORD_INDEX_MAX_ATTRIBUTES];
+    uint16_t attribute_value_offsets[SDP_RECORD_INDEX_MAX_ATTRIBUTES];
+} sdp_record_index_t;
+
+void      sdp_record_index_init(sdp_record_index_t * index, uint8_t * record);
+int       sdp_record_index_matches_service_search_pattern(const sdp_record_index_t * index, uint8_t * record, uint8_t * serviceSearchPattern);
+int       sdp_record_index_get_filtered_size(const sdp_record_index_t * index, uint8_t * record, uint8_t * attributeIDList);
+int       sdp_record_index_filter_attributes_in_attributeIDList(const sdp_record_index_t * index, uint8_t * record, uint8_t * attributeIDList,
+                                                                uint16_t startOffset, uint16_t maxBytes, uint16_t * usedBytes, uint8_t * buffer);
+
 /*
  * @brief Returns service search pattern for given UUID-16
  * @note Uses fixed buffer
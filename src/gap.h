@@ -43,6 +43,7 @@ extern "C" {
 #endif
 
 #include "btstack_defines.h"
+#include "btstack_linked_list.h"
 #include "btstack_util.h"
 #include "classic/btstack_link_key_db.h"
 
@@ -97,6 +98,17 @@ typedef struct le_connection_parameter_range{
     uint16_t le_supervision_timeout_max;
 } le_connection_parameter_range_t;
 
+// LE connection parameter profiles
+typedef enum {
+    // parameters are managed by application
+    GAP_LE_CONNECTION_PROFILE_MANUAL = 0,
+    GAP_LE_CONNECTION_PROFILE_LOW_LATENCY,
+    GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER,
+    GAP_LE_CONNECTION_PROFILE_POWER_SAVE,
+    // bulk transfer while data is exchanged, power save when idle
+    GAP_LE_CONNECTION_PROFILE_ADAPTIVE,
+} gap_le_connection_profile_t;
+
 typedef enum {
     GAP_RANDOM_ADDRESS_TYPE_OFF = 0,
     GAP_RANDOM_ADDRESS_TYPE_STATIC,
@@ -104,6 +116,65 @@ typedef enum {
     GAP_RANDOM_ADDRESS_RESOLVABLE,
 } gap_random_address_type_t;
 
+// LE Extended Advertising
+typedef struct {
+    uint16_t  advertising_event_properties;
+    // unit: 0.625 ms
+    uint32_t  primary_advertising_interval_min;
+    uint32_t  primary_advertising_interval_max;
+    uint8_t   primary_advertising_channel_map;
+    uint8_t   own_address_type;
+    uint8_t   peer_address_type;
+    bd_addr_t peer_address;
+    uint8_t   advertising_filter_policy;
+    // 127 = no preference
+    int8_t    advertising_tx_power;
+    uint8_t   primary_advertising_phy;
+    uint8_t   secondary_advertising_max_skip;
+    uint8_t   secondary_advertising_phy;
+    uint8_t   advertising_sid;
+    uint8_t   scan_request_notification_enable;
+} le_extended_advertising_parameters_t;
+
+typedef struct {
+    btstack_linked_item_t item;
+    le_extended_advertising_parameters_t params;
+    const uint8_t * adv_data;
+    uint16_t        adv_data_len;
+    const uint8_t * scan_data;
+    uint16_t        scan_data_len;
+    // offset of next data fragment to send
+    uint16_t        fragment_pos;
+    // unit: 10 ms, 0 = until disabled
+    uint16_t        enable_duration;
+    uint8_t         enable_max_events;
+    uint8_t         advertising_handle;
+    uint8_t         tasks;
+    uint8_t         state;
+} le_advertising_set_t;
+
+// LE Advertising Scheduler
+typedef struct {
+    btstack_linked_item_t item;
+    // max 31 bytes each
+    const uint8_t * adv_data;
+    uint8_t         adv_data_len;
+    const uint8_t * scan_data;
+    uint8_t         scan_data_len;
+    // entry should be on air at least once per period
+    uint16_t        period_ms;
+    // overdue entries with higher priority are scheduled first
+    uint8_t         priority;
+    uint32_t        deadline_ms;
+    // prepared HCI LE Set Advertising Data / Scan Response Data commands
+    uint8_t         commands_valid;
+    uint8_t         adv_data_command[35];
+    uint8_t         scan_data_command[35];
+    // storage if advertising set is used instead
+    le_advertising_set_t advertising_set;
+    uint8_t         advertising_handle;
+} le_advertising_scheduler_entry_t;
+
 // Authorization state
 typedef enum {
     AUTHORIZATION_UNKNOWN,
@@ -221,6 +292,13 @@ int  gap_mitm_protection_required_for_security_level(gap_security_level_t level)
  */
 void gap_set_scan_parameters(uint8_t scan_type, uint16_t scan_interval, uint16_t scan_window);
 
+/**
+ * @brief Set PHYs used for LE Extended Scanning and outgoing connections, default: LE 1M
+ * @note requires ENABLE_LE_EXTENDED_ADVERTISING, scan PHYs are applied with next gap_set_scan_parameters
+ * @param scan_phys bitmask of LE 1M (1) and LE Coded (4)
+ */
+void gap_set_scan_phys(uint8_t scan_phys);
+
 /**
  * @brief Start LE Scan 
  */
@@ -231,6 +309,65 @@ void gap_start_scan(void);
  */
 void gap_stop_scan(void);
 
+/**
+ * @brief Add rule to host-side filter for LE Advertising Reports. Reports matching any rule are forwarded, all if no rule is set.
+ * @note requires ENABLE_LE_ADVERTISING_REPORT_FILTER
+ * @param address_type
+ * @param address
+ * @return status ERROR_CODE_MEMORY_CAPACITY_EXCEEDED if LE_ADVERTISING_REPORT_FILTER_MAX_RULES reached
+ */
+uint8_t gap_advertising_report_filter_add_address(bd_addr_type_t address_type, const bd_addr_t address);
+
+/**
+ * @brief Add filter rule for 16-bit Service UUID in advertising data
+ * @param uuid16
+ * @return status
+ */
+uint8_t gap_advertising_report_filter_add_uuid16(uint16_t uuid16);
+
+/**
+ * @brief Add filter rule for 128-bit Service UUID in advertising data
+ * @note UUIDs based on the Bluetooth Base UUID also match 16-bit and 32-bit Service UUIDs
+ * @param uuid128 in big endian
+ * @return status
+ */
+uint8_t gap_advertising_report_filter_add_uuid128(const uint8_t * uuid128);
+
+/**
+ * @brief Add filter rule for Manufacturer Specific Data starting with company id and given prefix
+ * @param company_id
+ * @param prefix
+ * @param prefix_len up to 14 bytes
+ * @return status
+ */
+uint8_t gap_advertising_report_filter_add_manufacturer_prefix(uint16_t company_id, const uint8_t * prefix, uint8_t prefix_len);
+
+/**
+ * @brief Remove all filter rules
+ */
+void gap_advertising_report_filter_clear(void);
+
+/**
+ * @brief Drop advertising reports with RSSI below threshold
+ * @param rssi_min in dBm, -128 = off
+ */
+void gap_advertising_report_filter_set_rssi_threshold(int8_t rssi_min);
+
+/**
+ * @brief Drop advertising reports with identical address and data received within given time window
+ * @param window_ms, 0 = off
+ */
+void gap_advertising_report_set_duplicate_window(uint16_t window_ms);
+
+/**
+ * @brief Aggregate advertising reports per device and report them as GAP_EVENT_SCAN_AGGREGATE_DEVICE events
+ *        followed by GAP_EVENT_SCAN_AGGREGATE_COMPLETE every flush interval and on gap_stop_scan.
+ *        GAP_EVENT_ADVERTISING_REPORT events are not emitted while active.
+ * @note requires ENABLE_LE_SCAN_AGGREGATOR
+ * @param flush_interval_ms, 0 = off
+ */
+void gap_scan_aggregator_set_flush_interval(uint32_t flush_interval_ms);
+
 /**
  * @brief Enable privacy by using random addresses
  * @param random_address_type to use (incl. OFF)
@@ -296,6 +433,110 @@ void gap_advertisements_enable(int enabled);
  */
 void gap_scan_response_set_data(uint8_t scan_response_data_length, uint8_t * scan_response_data);
 
+/**
+ * @brief Setup advertising set with LE Extended Advertising. Advertising handle 0 is used by gap_advertisements_* functions
+ * @note requires ENABLE_LE_EXTENDED_ADVERTISING
+ * @param storage for advertising set, has to stay valid until gap_extended_advertising_remove
+ * @param advertising_parameters are copied
+ * @param out_advertising_handle
+ * @return status
+ */
+uint8_t gap_extended_advertising_setup(le_advertising_set_t * storage, const le_extended_advertising_parameters_t * advertising_parameters, uint8_t * out_advertising_handle);
+
+/**
+ * @brief Update parameters of advertising set. Set is stopped and restarted if active
+ * @param advertising_handle
+ * @param advertising_parameters are copied
+ * @return status
+ */
+uint8_t gap_extended_advertising_set_params(uint8_t advertising_handle, const le_extended_advertising_parameters_t * advertising_parameters);
+
+/**
+ * @brief Set advertising data of advertising set
+ * @param advertising_handle
+ * @param advertising_data_length up to 1650 bytes, sent in fragments of 251 bytes
+ * @param advertising_data is not copied, pointer has to stay valid
+ * @return status
+ */
+uint8_t gap_extended_advertising_set_adv_data(uint8_t advertising_handle, uint16_t advertising_data_length, const uint8_t * advertising_data);
+
+/**
+ * @brief Set scan response data of advertising set
+ * @param advertising_handle
+ * @param scan_response_data_length up to 1650 bytes, sent in fragments of 251 bytes
+ * @param scan_response_data is not copied, pointer has to stay valid
+ * @return status
+ */
+uint8_t gap_extended_advertising_set_scan_response_data(uint8_t advertising_handle, uint16_t scan_response_data_length, const uint8_t * scan_response_data);
+
+/**
+ * @brief Start advertising set
+ * @param advertising_handle
+ * @param timeout in 10 ms units, 0 = until stopped
+ * @param num_extended_advertising_events, 0 = no maximum
+ * @return status
+ * @result HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED if timeout or max events reached or connection was created
+ */
+uint8_t gap_extended_advertising_start(uint8_t advertising_handle, uint16_t timeout, uint8_t num_extended_advertising_events);
+
+/**
+ * @brief Stop advertising set
+ * @param advertising_handle
+ * @return status
+ */
+uint8_t gap_extended_advertising_stop(uint8_t advertising_handle);
+
+/**
+ * @brief Stop and remove advertising set. Storage can be reused immediately
+ * @param advertising_handle
+ * @return status
+ */
+uint8_t gap_extended_advertising_remove(uint8_t advertising_handle);
+
+/**
+ * @brief Add advertising payload to advertising scheduler. Payloads are time-multiplexed using the parameters
+ *        from gap_advertisements_set_params or, with ENABLE_LE_EXTENDED_ADVERTISING, by one advertising set each
+ * @note requires ENABLE_LE_ADVERTISING_SCHEDULER. The scheduler owns advertising and scan response data while started
+ * @param entry storage, has to stay valid until gap_advertising_scheduler_remove
+ * @param period_ms payload should be advertised at least once per period
+ * @param priority of overdue payload, higher wins. Not used with advertising sets
+ * @param adv_data_length (max 31 octets)
+ * @param adv_data is not copied, pointer has to stay valid
+ * @param scan_data_length (max 31 octets)
+ * @param scan_data is not copied, pointer has to stay valid
+ * @return status
+ */
+uint8_t gap_advertising_scheduler_add(le_advertising_scheduler_entry_t * entry, uint16_t period_ms, uint8_t priority,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data);
+
+/**
+ * @brief Update advertising and scan response data of scheduler entry
+ * @param entry
+ * @param adv_data_length (max 31 octets)
+ * @param adv_data is not copied, pointer has to stay valid
+ * @param scan_data_length (max 31 octets)
+ * @param scan_data is not copied, pointer has to stay valid
+ * @return status
+ */
+uint8_t gap_advertising_scheduler_set_data(le_advertising_scheduler_entry_t * entry,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data);
+
+/**
+ * @brief Remove entry from advertising scheduler
+ * @param entry
+ */
+void gap_advertising_scheduler_remove(le_advertising_scheduler_entry_t * entry);
+
+/**
+ * @brief Start advertising scheduler
+ */
+void gap_advertising_scheduler_start(void);
+
+/**
+ * @brief Stop advertising scheduler
+ */
+void gap_advertising_scheduler_stop(void);
+
 /**
  * @brief Set connection parameters for outgoing connections
  * @param conn_scan_interval (unit: 0.625 msec), default: 60 ms
@@ -335,6 +576,34 @@ int gap_request_connection_parameter_update(hci_con_handle_t con_handle, uint16_
 int gap_update_connection_parameters(hci_con_handle_t con_handle, uint16_t conn_interval_min,
 	uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout);
 
+/**
+ * @brief Select connection parameter profile for LE connection. Parameters are requested from the peer
+ *        as Peripheral or applied directly as Central
+ * @note requires ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+ * @param con_handle
+ * @param profile
+ * @returns status
+ */
+uint8_t gap_le_connection_set_profile(hci_con_handle_t con_handle, gap_le_connection_profile_t profile);
+
+/**
+ * @brief Set profile used for new LE connections, default: GAP_LE_CONNECTION_PROFILE_MANUAL
+ * @param profile
+ */
+void gap_le_connection_set_default_profile(gap_le_connection_profile_t profile);
+
+/**
+ * @brief Set connection parameters used by profile
+ * @param profile GAP_LE_CONNECTION_PROFILE_LOW_LATENCY, _BULK_TRANSFER, or _POWER_SAVE
+ * @param conn_interval_min (unit: 1.25ms)
+ * @param conn_interval_max (unit: 1.25ms)
+ * @param conn_latency
+ * @param supervision_timeout (unit: 10ms)
+ * @returns status
+ */
+uint8_t gap_le_connection_profile_set_parameters(gap_le_connection_profile_t profile, uint16_t conn_interval_min,
+    uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout);
+
 /**
  * @brief Set accepted connection parameter range
  * @param range
@@ -413,6 +682,24 @@ uint8_t gap_le_set_phy(hci_con_handle_t con_handle, uint8_t all_phys, uint8_t tx
  */
 uint16_t gap_le_connection_interval(hci_con_handle_t connection_handle);
 
+/**
+ * @brief Get max LL payload size negotiated via LE Data Length Update
+ * @param connection_handle
+ * @param out_max_tx_octets
+ * @param out_max_rx_octets
+ * @return status
+ */
+uint8_t gap_le_connection_data_length(hci_con_handle_t connection_handle, uint16_t * out_max_tx_octets, uint16_t * out_max_rx_octets);
+
+/**
+ * @brief Get current LE PHYs
+ * @param connection_handle
+ * @param out_tx_phy 1 = 1M, 2 = 2M, 3 = Coded
+ * @param out_rx_phy 1 = 1M, 2 = 2M, 3 = Coded
+ * @return status
+ */
+uint8_t gap_le_connection_phy(hci_con_handle_t connection_handle, uint8_t * out_tx_phy, uint8_t * out_rx_phy);
+
 /**
  *
  * @brief Get encryption key size.
@@ -529,6 +816,25 @@ int gap_inquiry_stop(void);
  */
 int gap_remote_name_request(bd_addr_t addr, uint8_t page_scan_repetition_mode, uint16_t clock_offset);
 
+/**
+ * @brief Start GAP Classic Discovery: inquiry with remote name resolution
+ * @note Requires ENABLE_CLASSIC_INQUIRY_CACHE. The inquiry is split into slices of GAP_DISCOVERY_INQUIRY_SLICE.
+ *       Between slices, up to GAP_DISCOVERY_NAME_REQUESTS_PER_PAUSE names of found devices without EIR name are requested.
+ *       Each device is reported once per discovery, and again if its name becomes known via EIR.
+ *       Use gap_inquiry_stop to stop discovery, an ongoing remote name request of the discovery is cancelled.
+ * @param duration in 1.28s units
+ * @return 0 if ok
+ * @events: GAP_EVENT_INQUIRY_RESULT, HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE, GAP_EVENT_INQUIRY_COMPLETE after all names have been requested
+ */
+int gap_discovery_start(uint8_t duration_in_1280ms_units);
+
+/**
+ * @brief Clear Classic inquiry cache
+ * @note Page scan repetition mode and clock offset of cached devices are used for Create Connection and
+ *       Remote Name Request if the caller does not provide a valid clock offset
+ */
+void gap_inquiry_cache_clear(void);
+
 /**
  * @brief Legacy Pairing Pin Code Response
  * @param addr
@@ -78,6 +78,14 @@
 #include "hci_dump.h"
 #include "ad_parser.h"
 
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+#include "btstack_tlv.h"
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+#include "ble/le_device_db.h"
+#endif
+
 #ifdef ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL
 #ifndef HCI_HOST_ACL_PACKET_NUM
 #error "ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL requires to define HCI_HOST_ACL_PACKET_NUM"
@@ -96,11 +104,6 @@
 #define HCI_CONNECTION_TIMEOUT_MS 10000
 #define HCI_RESET_RESEND_TIMEOUT_MS 200
 
-// Names are arbitrarily shortened to 32 bytes if not requested otherwise
-#ifndef GAP_INQUIRY_MAX_NAME_LEN
-#define GAP_INQUIRY_MAX_NAME_LEN 32
-#endif
-
 // GAP inquiry state: 0 = off, 0x01 - 0x30 = requested duration, 0xfe = active, 0xff = stop requested
 #define GAP_INQUIRY_DURATION_MIN 0x01
 #define GAP_INQUIRY_DURATION_MAX 0x30
@@ -113,6 +116,38 @@
 #define GAP_REMOTE_NAME_STATE_IDLE 0
 #define GAP_REMOTE_NAME_STATE_W2_SEND 1
 #define GAP_REMOTE_NAME_STATE_W4_COMPLETE 2
+#define GAP_REMOTE_NAME_STATE_W2_CANCEL 3
+
+// GAP Inquiry Cache
+#define GAP_INQUIRY_CACHE_FLAG_VALID          0x01
+#define GAP_INQUIRY_CACHE_FLAG_RSSI           0x02
+#define GAP_INQUIRY_CACHE_FLAG_NAME           0x04
+#define GAP_INQUIRY_CACHE_FLAG_NAME_FAILED    0x08
+// reported in current inquiry/discovery
+#define GAP_INQUIRY_CACHE_FLAG_REPORTED       0x10
+
+// GAP Discovery
+#define GAP_DISCOVERY_STATE_IDLE    0
+#define GAP_DISCOVERY_STATE_INQUIRY 1
+#define GAP_DISCOVERY_STATE_NAMES   2
+#define GAP_DISCOVERY_STATE_W4_NAME 3
+
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+// NVM_NUM_PAGE_PARAMETERS defines number of devices with stored clock offset
+#ifndef NVM_NUM_PAGE_PARAMETERS
+#define NVM_NUM_PAGE_PARAMETERS 8
+#endif
+
+// page scan repetition mode R1 used if not known
+#define PAGE_SCAN_REPETITION_MODE_R1 1
+
+typedef struct {
+    uint32_t  seq_nr;    // used for "least recently stored" eviction strategy
+    bd_addr_t bd_addr;
+    uint16_t  clock_offset;
+    uint8_t   page_scan_repetition_mode;
+} page_parameters_nvm_t;
+#endif
 
 // GAP Pairing
 #define GAP_PAIRING_STATE_IDLE                       0
@@ -138,6 +173,21 @@ static void hci_connection_timeout_handler(btstack_timer_source_t *timer);
 static void hci_connection_timestamp(hci_connection_t *connection);
 static void hci_emit_l2cap_check_timeout(hci_connection_t *conn);
 static void gap_inquiry_explode(uint8_t * packet);
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+static int  gap_inquiry_cache_update(const uint8_t * event);
+static void gap_inquiry_cache_remote_name_complete(const uint8_t * packet);
+static void gap_inquiry_cache_set_page_parameters(uint8_t * packet, const bd_addr_t addr, int psrm_pos, int clock_offset_pos);
+static void gap_discovery_start_inquiry_slice(void);
+static void gap_inquiry_cache_reset_reported(void);
+static int  gap_discovery_run(void);
+#endif
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+static void hci_page_parameters_store(const bd_addr_t addr, uint16_t clock_offset, int page_scan_repetition_mode);
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+static gap_inquiry_cache_entry_t * gap_inquiry_cache_for_address(const bd_addr_t address);
+#endif
+static void hci_page_parameters_set_page_parameters(uint8_t * packet, const bd_addr_t addr, int psrm_pos, int clock_offset_pos);
+#endif
 #endif
 
 static int  hci_power_control_on(void);
@@ -161,6 +211,12 @@ void le_handle_advertisement_report(uint8_t *packet, uint16_t size);
 static void hci_remove_from_whitelist(bd_addr_type_t address_type, bd_addr_t address);
 static hci_connection_t * gap_get_outgoing_connection(void);
 #endif
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_ADVERTISING_SCHEDULER) && !defined(ENABLE_LE_EXTENDED_ADVERTISING)
+static int hci_send_prepared_cmd_packet(const uint8_t * command, uint16_t size);
+#endif
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+static void hci_le_resolving_list_done(void);
+#endif
 #endif
 
 // the STACK is here
@@ -197,6 +253,10 @@ static hci_connection_t * create_connection_for_bd_addr_and_type(bd_addr_t addr,
     btstack_run_loop_set_timer_context(&conn->timeout, conn);
     hci_connection_timestamp(conn);
     conn->num_sco_bytes_sent = 0;
+#endif
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+    conn->read_clock_offset = 0;
+    conn->page_scan_repetition_mode = 0xff;
 #endif
     conn->acl_recombination_length = 0;
     conn->acl_recombination_pos = 0;
@@ -205,6 +265,10 @@ static hci_connection_t * create_connection_for_bd_addr_and_type(bd_addr_t addr,
     conn->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
 #ifdef ENABLE_BLE
     conn->le_phy_update_all_phys = 0xff;
+    conn->le_tx_phy = 1;
+    conn->le_rx_phy = 1;
+    conn->le_max_tx_octets = 27;
+    conn->le_max_rx_octets = 27;
 #endif    
     btstack_linked_list_add(&hci_stack->connections, (btstack_linked_item_t *) conn);
     return conn;
@@ -613,6 +677,31 @@ int hci_is_packet_buffer_reserved(void){
     return hci_stack->hci_packet_buffer_reserved;
 }
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+int hci_packet_batch_active(void){
+    return hci_stack->packet_batch_active;
+}
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+void hci_le_resolving_list_load(const sm_key_t local_irk){
+    memcpy(hci_stack->le_resolving_list_local_irk, local_irk, 16);
+    switch (hci_stack->le_resolving_list_state){
+        case LE_RESOLVING_LIST_UNSUPPORTED:
+        case LE_RESOLVING_LIST_W4_READ_SIZE:
+            return;
+        case LE_RESOLVING_LIST_IDLE:
+        case LE_RESOLVING_LIST_SEND_READ_SIZE:
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_READ_SIZE;
+            break;
+        default:
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_DISABLE_ADDRESS_RESOLUTION;
+            break;
+    }
+    hci_run();
+}
+#endif
+
 // reserves outgoing packet buffer. @returns 1 if successful
 int hci_reserve_packet_buffer(void){
     if (hci_stack->hci_packet_buffer_reserved) {
@@ -716,6 +805,89 @@ static int hci_send_acl_packet_fragments(hci_connection_t *connection){
     return err;
 }
 
+#if defined(ENABLE_BLE) && defined(ENABLE_LE_CONNECTION_PARAMETER_MANAGER)
+static void hci_le_connection_profile_timeout_handler(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    hci_stack->le_connection_profile_timer_active = 0;
+    uint32_t now = btstack_run_loop_get_time_ms();
+    int num_active = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->connections);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        hci_connection_t * connection = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+        if (connection->le_connection_profile != GAP_LE_CONNECTION_PROFILE_ADAPTIVE) continue;
+        if (connection->le_connection_profile_requested != GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER) continue;
+        if ((now - connection->le_connection_profile_last_activity_ms) < LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS){
+            num_active++;
+            continue;
+        }
+        log_info("LE connection profile: con 0x%04x idle", connection->con_handle);
+        connection->le_connection_profile_requested = GAP_LE_CONNECTION_PROFILE_POWER_SAVE;
+        connection->le_connection_profile_request_pending = 1;
+    }
+    if (num_active){
+        hci_stack->le_connection_profile_timer_active = 1;
+        btstack_run_loop_set_timer(&hci_stack->le_connection_profile_timer, LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS);
+        btstack_run_loop_add_timer(&hci_stack->le_connection_profile_timer);
+    }
+    hci_run();
+}
+
+static void hci_le_connection_profile_start_timer(void){
+    if (hci_stack->le_connection_profile_timer_active) return;
+    hci_stack->le_connection_profile_timer_active = 1;
+    btstack_run_loop_set_timer_handler(&hci_stack->le_connection_profile_timer, hci_le_connection_profile_timeout_handler);
+    btstack_run_loop_set_timer(&hci_stack->le_connection_profile_timer, LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS);
+    btstack_run_loop_add_timer(&hci_stack->le_connection_profile_timer);
+}
+
+static void hci_le_connection_profile_request(hci_connection_t * connection, uint8_t profile){
+    if (profile == connection->le_connection_profile_requested) return;
+    connection->le_connection_profile_requested = profile;
+    connection->le_connection_profile_request_pending = profile != GAP_LE_CONNECTION_PROFILE_MANUAL;
+}
+
+static void hci_le_connection_profile_select(hci_connection_t * connection){
+    if (connection->le_connection_profile == GAP_LE_CONNECTION_PROFILE_ADAPTIVE){
+        // start with bulk transfer, e.g. for service discovery
+        connection->le_connection_profile_last_activity_ms = btstack_run_loop_get_time_ms();
+        hci_le_connection_profile_request(connection, GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER);
+        hci_le_connection_profile_start_timer();
+        return;
+    }
+    hci_le_connection_profile_request(connection, connection->le_connection_profile);
+}
+
+// ACL data, except for LE signaling, marks connection as active
+static void hci_le_connection_profile_activity(hci_connection_t * connection, const uint8_t * packet, uint16_t size){
+    if (connection->le_connection_profile != GAP_LE_CONNECTION_PROFILE_ADAPTIVE) return;
+    int continuation = (READ_ACL_FLAGS(packet) & 0x03) == 0x01;
+    if (!continuation && size >= 8 && little_endian_read_16(packet, 6) == L2CAP_CID_SIGNALING_LE) return;
+    connection->le_connection_profile_last_activity_ms = btstack_run_loop_get_time_ms();
+    if (connection->le_connection_profile_requested == GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER) return;
+    log_info("LE connection profile: con 0x%04x active", connection->con_handle);
+    hci_le_connection_profile_request(connection, GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER);
+    hci_le_connection_profile_start_timer();
+}
+
+static void hci_le_connection_profile_send_request(hci_connection_t * connection){
+    const le_connection_profile_parameters_t * parameters =
+        &hci_stack->le_connection_profile_parameters[connection->le_connection_profile_requested - GAP_LE_CONNECTION_PROFILE_LOW_LATENCY];
+    log_info("LE connection profile: con 0x%04x, profile %u, interval %u-%u", connection->con_handle,
+        connection->le_connection_profile_requested, parameters->conn_interval_min, parameters->conn_interval_max);
+    connection->le_conn_interval_min   = parameters->conn_interval_min;
+    connection->le_conn_interval_max   = parameters->conn_interval_max;
+    connection->le_conn_latency        = parameters->conn_latency;
+    connection->le_supervision_timeout = parameters->supervision_timeout;
+    // Central updates parameters directly, Peripheral asks via L2CAP
+    if (connection->role == HCI_ROLE_MASTER){
+        connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_CHANGE_HCI_CON_PARAMETERS;
+    } else {
+        connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_SEND_REQUEST;
+    }
+}
+#endif
+
 // pre: caller has reserved the packet buffer
 int hci_send_acl_packet_buffer(int size){
 
@@ -749,6 +921,10 @@ int hci_send_acl_packet_buffer(int size){
     hci_connection_timestamp(connection);
 #endif
 
+#if defined(ENABLE_BLE) && defined(ENABLE_LE_CONNECTION_PARAMETER_MANAGER)
+    hci_le_connection_profile_activity(connection, packet, size);
+#endif
+
     // hci_dump_packet( HCI_ACL_DATA_PACKET, 0, packet, size);
 
     // setup data
@@ -838,6 +1014,10 @@ static void acl_handler(uint8_t *packet, int size){
     hci_connection_timestamp(conn);
 #endif
 
+#if defined(ENABLE_BLE) && defined(ENABLE_LE_CONNECTION_PARAMETER_MANAGER)
+    hci_le_connection_profile_activity(conn, packet, size);
+#endif
+
 #ifdef ENABLE_HCI_CONTROLLER_TO_HOST_FLOW_CONTROL
     hci_stack->host_completed_packets = 1;
     conn->num_packets_completed++;
@@ -1058,6 +1238,266 @@ void gap_le_get_own_address(uint8_t * addr_type, bd_addr_t addr){
 }
 
 #ifdef ENABLE_LE_CENTRAL
+#if defined(ENABLE_LE_ADVERTISING_REPORT_FILTER) || defined(ENABLE_LE_SCAN_AGGREGATOR)
+// FNV-1a
+#define HCI_LE_HASH_INIT 2166136261u
+static uint32_t hci_le_hash_update(uint32_t hash, const uint8_t * data, uint16_t len){
+    uint16_t i;
+    for (i=0;i<len;i++){
+        hash = (hash ^ data[i]) * 16777619u;
+    }
+    return hash;
+}
+#endif
+
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+static int hci_le_advertising_report_filter_match_uuid16(uint16_t uuid16){
+    int i;
+    for (i=0;i<hci_stack->le_advertising_report_filter_num_rules;i++){
+        le_advertising_report_filter_rule_t * rule = &hci_stack->le_advertising_report_filter_rules[i];
+        if (rule->type != LE_ADVERTISING_REPORT_FILTER_RULE_UUID16) continue;
+        if (little_endian_read_16(rule->data, 0) == uuid16) return 1;
+    }
+    return 0;
+}
+
+static int hci_le_advertising_report_filter_match_uuid128(const uint8_t * uuid128_le){
+    // UUID16 based on the Bluetooth Base UUID are stored as 16-bit rules, UUID32 as 128-bit rules
+    uint8_t uuid128[16];
+    reverse_128(uuid128_le, uuid128);
+    if (uuid_has_bluetooth_prefix(uuid128) && big_endian_read_16(uuid128, 0) == 0){
+        return hci_le_advertising_report_filter_match_uuid16(big_endian_read_16(uuid128, 2));
+    }
+    int i;
+    for (i=0;i<hci_stack->le_advertising_report_filter_num_rules;i++){
+        le_advertising_report_filter_rule_t * rule = &hci_stack->le_advertising_report_filter_rules[i];
+        if (rule->type != LE_ADVERTISING_REPORT_FILTER_RULE_UUID128) continue;
+        if (memcmp(rule->data, uuid128_le, 16) == 0) return 1;
+    }
+    return 0;
+}
+
+static int hci_le_advertising_report_filter_match_uuid32(uint32_t uuid32){
+    if (uuid32 <= 0xffff) return hci_le_advertising_report_filter_match_uuid16((uint16_t) uuid32);
+    uint8_t uuid128[16];
+    uint8_t uuid128_le[16];
+    uuid_add_bluetooth_prefix(uuid128, uuid32);
+    reverse_128(uuid128, uuid128_le);
+    return hci_le_advertising_report_filter_match_uuid128(uuid128_le);
+}
+
+static int hci_le_advertising_report_filter_match_manufacturer_data(const uint8_t * data, uint8_t data_len){
+    int i;
+    for (i=0;i<hci_stack->le_advertising_report_filter_num_rules;i++){
+        le_advertising_report_filter_rule_t * rule = &hci_stack->le_advertising_report_filter_rules[i];
+        if (rule->type != LE_ADVERTISING_REPORT_FILTER_RULE_MANUFACTURER_PREFIX) continue;
+        if (rule->len > data_len) continue;
+        if (memcmp(rule->data, data, rule->len) == 0) return 1;
+    }
+    return 0;
+}
+
+// address in HCI byte order as found in HCI_SUBEVENT_LE_ADVERTISING_REPORT
+static int hci_le_advertising_report_filter_match(uint8_t address_type, const uint8_t * address, int8_t rssi, uint16_t data_length, const uint8_t * data){
+    if (rssi < hci_stack->le_advertising_report_filter_rssi_min) return 0;
+    if (hci_stack->le_advertising_report_filter_num_rules == 0) return 1;
+
+    // address rules
+    int i;
+    for (i=0;i<hci_stack->le_advertising_report_filter_num_rules;i++){
+        le_advertising_report_filter_rule_t * rule = &hci_stack->le_advertising_report_filter_rules[i];
+        if (rule->type != LE_ADVERTISING_REPORT_FILTER_RULE_ADDRESS) continue;
+        if (rule->len != address_type) continue;
+        if (memcmp(rule->data, address, 6) == 0) return 1;
+    }
+
+    // single pass over advertising data, extended advertising data may exceed 255 bytes
+    uint16_t offset = 0;
+    while (offset + 2 <= data_length){
+        uint8_t         ad_len  = data[offset];
+        if (ad_len == 0 || offset + 1 + ad_len > data_length) break;
+        uint8_t         ad_type = data[offset + 1];
+        const uint8_t * ad_data = &data[offset + 2];
+        offset += 1 + ad_len;
+        ad_len--;
+        int j;
+        switch (ad_type){
+            case BLUETOOTH_DATA_TYPE_INCOMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS:
+            case BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS:
+                for (j=0; j + 2 <= ad_len; j += 2){
+                    if (hci_le_advertising_report_filter_match_uuid16(little_endian_read_16(ad_data, j))) return 1;
+                }
+                break;
+            case BLUETOOTH_DATA_TYPE_INCOMPLETE_LIST_OF_32_BIT_SERVICE_CLASS_UUIDS:
+            case BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_32_BIT_SERVICE_CLASS_UUIDS:
+                for (j=0; j + 4 <= ad_len; j += 4){
+                    if (hci_le_advertising_report_filter_match_uuid32(little_endian_read_32(ad_data, j))) return 1;
+                }
+                break;
+            case BLUETOOTH_DATA_TYPE_INCOMPLETE_LIST_OF_128_BIT_SERVICE_CLASS_UUIDS:
+            case BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_128_BIT_SERVICE_CLASS_UUIDS:
+                for (j=0; j + 16 <= ad_len; j += 16){
+                    if (hci_le_advertising_report_filter_match_uuid128(&ad_data[j])) return 1;
+                }
+                break;
+            case BLUETOOTH_DATA_TYPE_MANUFACTURER_SPECIFIC_DATA:
+                if (hci_le_advertising_report_filter_match_manufacturer_data(ad_data, ad_len)) return 1;
+                break;
+            default:
+                break;
+        }
+    }
+    return 0;
+}
+
+static uint32_t hci_le_advertising_report_hash(uint8_t event_type, uint8_t address_type, const uint8_t * address, uint16_t data_length, const uint8_t * data){
+    uint32_t hash = HCI_LE_HASH_INIT;
+    hash = hci_le_hash_update(hash, &event_type, 1);
+    hash = hci_le_hash_update(hash, &address_type, 1);
+    hash = hci_le_hash_update(hash, address, 6);
+    hash = hci_le_hash_update(hash, data, data_length);
+    // 0 marks unused cache entry
+    if (hash == 0) hash = 1;
+    return hash;
+}
+
+static int hci_le_advertising_report_is_duplicate(uint8_t event_type, uint8_t address_type, const uint8_t * address, uint16_t data_length, const uint8_t * data){
+    if (hci_stack->le_advertising_report_duplicate_window_ms == 0) return 0;
+    uint32_t hash = hci_le_advertising_report_hash(event_type, address_type, address, data_length, data);
+    uint32_t now  = btstack_run_loop_get_time_ms();
+    le_advertising_report_duplicate_t * entry = &hci_stack->le_advertising_report_duplicates[hash % LE_ADVERTISING_REPORT_DUPLICATE_CACHE_SIZE];
+    if (entry->hash == hash && memcmp(entry->address, address, 6) == 0
+    && (now - entry->timestamp_ms) < hci_stack->le_advertising_report_duplicate_window_ms){
+        return 1;
+    }
+    // new or expired, replace entry
+    entry->hash = hash;
+    entry->timestamp_ms = now;
+    memcpy(entry->address, address, 6);
+    return 0;
+}
+#endif
+
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+// address in HCI byte order
+static void hci_le_scan_aggregator_add_report(uint8_t address_type, const uint8_t * address, int8_t rssi, uint16_t data_length, const uint8_t * data){
+    uint32_t now = btstack_run_loop_get_time_ms();
+    uint32_t address_hash = hci_le_hash_update(hci_le_hash_update(HCI_LE_HASH_INIT, &address_type, 1), address, 6);
+    // open addressing with linear probing
+    le_scan_aggregator_device_t * device = NULL;
+    int i;
+    for (i=0;i<LE_SCAN_AGGREGATOR_MAX_DEVICES;i++){
+        le_scan_aggregator_device_t * entry = &hci_stack->le_scan_aggregator_devices[(address_hash + i) % LE_SCAN_AGGREGATOR_MAX_DEVICES];
+        if (!entry->valid){
+            memset(entry, 0, sizeof(le_scan_aggregator_device_t));
+            entry->valid         = 1;
+            entry->address_type  = address_type;
+            memcpy(entry->address, address, 6);
+            entry->first_seen_ms = now;
+            entry->rssi_min      = rssi;
+            entry->rssi_max      = rssi;
+            entry->rssi_avg_q4   = rssi * 16;
+            device = entry;
+            break;
+        }
+        if (entry->address_type == address_type && memcmp(entry->address, address, 6) == 0){
+            device = entry;
+            break;
+        }
+    }
+    if (!device){
+        if (hci_stack->le_scan_aggregator_num_dropped < 0xffff){
+            hci_stack->le_scan_aggregator_num_dropped++;
+        }
+        return;
+    }
+    if (rssi < device->rssi_min) device->rssi_min = rssi;
+    if (rssi > device->rssi_max) device->rssi_max = rssi;
+    // EMA with alpha = 1/8
+    device->rssi_avg_q4 += (rssi * 16 - device->rssi_avg_q4) / 8;
+    device->report_count++;
+    device->last_seen_ms = now;
+    device->data_hash    = hci_le_hash_update(HCI_LE_HASH_INIT, data, data_length);
+}
+
+static void hci_le_scan_aggregator_flush(void){
+    uint8_t num_devices = 0;
+    uint8_t event[28];
+    int i;
+    for (i=0;i<LE_SCAN_AGGREGATOR_MAX_DEVICES;i++){
+        le_scan_aggregator_device_t * device = &hci_stack->le_scan_aggregator_devices[i];
+        if (!device->valid) continue;
+        event[0] = GAP_EVENT_SCAN_AGGREGATE_DEVICE;
+        event[1] = sizeof(event) - 2;
+        event[2] = device->address_type;
+        memcpy(&event[3], device->address, 6);
+        event[9]  = (uint8_t) device->rssi_min;
+        event[10] = (uint8_t) device->rssi_max;
+        event[11] = (uint8_t) (device->rssi_avg_q4 / 16);
+        little_endian_store_32(event, 12, device->report_count);
+        little_endian_store_32(event, 16, device->first_seen_ms);
+        little_endian_store_32(event, 20, device->last_seen_ms);
+        little_endian_store_32(event, 24, device->data_hash);
+        hci_emit_event(event, sizeof(event), 1);
+        device->valid = 0;
+        num_devices++;
+    }
+    if (num_devices == 0 && hci_stack->le_scan_aggregator_num_dropped == 0) return;
+    event[0] = GAP_EVENT_SCAN_AGGREGATE_COMPLETE;
+    event[1] = 3;
+    event[2] = num_devices;
+    little_endian_store_16(event, 3, hci_stack->le_scan_aggregator_num_dropped);
+    hci_emit_event(event, 5, 1);
+    hci_stack->le_scan_aggregator_num_dropped = 0;
+}
+
+static void hci_le_scan_aggregator_timeout_handler(btstack_timer_source_t * ts){
+    hci_le_scan_aggregator_flush();
+    if (hci_stack->le_scan_aggregator_flush_interval_ms == 0) return;
+    btstack_run_loop_set_timer(ts, hci_stack->le_scan_aggregator_flush_interval_ms);
+    btstack_run_loop_add_timer(ts);
+}
+#endif
+
+// address in HCI byte order, returns 1 if report should be passed to the application
+static int hci_le_advertising_report_accept(uint8_t event_type, uint8_t address_type, const uint8_t * address, int8_t rssi, uint16_t data_length, const uint8_t * data){
+    UNUSED(event_type);
+    UNUSED(address_type);
+    UNUSED(address);
+    UNUSED(rssi);
+    UNUSED(data_length);
+    UNUSED(data);
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+    // drop reports before creating GAP event
+    if (!hci_le_advertising_report_filter_match(address_type, address, rssi, data_length, data)) return 0;
+    if (hci_le_advertising_report_is_duplicate(event_type, address_type, address, data_length, data)) return 0;
+#endif
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+    // only summaries are reported while aggregator is active
+    if (hci_stack->le_scan_aggregator_flush_interval_ms){
+        hci_le_scan_aggregator_add_report(address_type, address, rssi, data_length, data);
+        return 0;
+    }
+#endif
+    return 1;
+}
+
+static void hci_emit_le_advertising_report(uint8_t event_type, uint8_t address_type, const uint8_t * address, int8_t rssi, uint8_t data_length, const uint8_t * data){
+    uint8_t event[12 + LE_ADVERTISING_DATA_SIZE]; // use upper bound to avoid var size automatic var
+    int pos = 0;
+    event[pos++] = GAP_EVENT_ADVERTISING_REPORT;
+    event[pos++] = 10 + data_length;
+    event[pos++] = event_type;
+    event[pos++] = address_type;
+    memcpy(&event[pos], address, 6);
+    pos += 6;
+    event[pos++] = (uint8_t) rssi;
+    event[pos++] = data_length;
+    memcpy(&event[pos], data, data_length);
+    pos += data_length;
+    hci_emit_event(event, pos, 1);
+}
+
 void le_handle_advertisement_report(uint8_t *packet, uint16_t size){
 
     int offset = 3;
@@ -1066,34 +1506,293 @@ void le_handle_advertisement_report(uint8_t *packet, uint16_t size){
 
     int i;
     // log_info("HCI: handle adv report with num reports: %d", num_reports);
-    uint8_t event[12 + LE_ADVERTISING_DATA_SIZE]; // use upper bound to avoid var size automatic var
     for (i=0; i<num_reports && offset < size;i++){
         // sanity checks on data_length:
         uint8_t data_length = packet[offset + 8];
         if (data_length > LE_ADVERTISING_DATA_SIZE) return;
         if (offset + 9 + data_length + 1 > size)    return;
-        // setup event
-        uint8_t event_size = 10 + data_length;
-        int pos = 0;
-        event[pos++] = GAP_EVENT_ADVERTISING_REPORT;
-        event[pos++] = event_size;
-        memcpy(&event[pos], &packet[offset], 1+1+6); // event type + address type + address
-        offset += 8;
-        pos += 8;
-        event[pos++] = packet[offset + 1 + data_length]; // rssi
-        event[pos++] = data_length;
-        offset++;
-        memcpy(&event[pos], &packet[offset], data_length);
-        pos +=    data_length;
-        offset += data_length + 1; // rssi
-        hci_emit_event(event, pos, 1);
+        uint8_t         event_type   = packet[offset];
+        uint8_t         address_type = packet[offset + 1];
+        const uint8_t * address      = &packet[offset + 2];
+        const uint8_t * data         = &packet[offset + 9];
+        int8_t          rssi         = (int8_t) packet[offset + 9 + data_length];
+        offset += 10 + data_length;
+        if (!hci_le_advertising_report_accept(event_type, address_type, address, rssi, data_length, data)) continue;
+        hci_emit_le_advertising_report(event_type, address_type, address, rssi, data_length, data);
+    }
+}
+
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+// map event type of extended advertising report with legacy PDU to legacy advertising report event type
+static uint8_t hci_le_extended_advertising_report_legacy_event_type(uint16_t event_type){
+    switch (event_type & 0x1f){
+        case 0x13:
+            return 0;   // ADV_IND
+        case 0x15:
+        case 0x1d:
+            return 1;   // ADV_DIRECT_IND
+        case 0x12:
+            return 2;   // ADV_SCAN_IND
+        case 0x10:
+            return 3;   // ADV_NONCONN_IND
+        default:
+            return 4;   // SCAN_RSP
+    }
+}
+
+// report: HCI extended advertising report starting at event type, header layout matches GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+static void hci_le_extended_advertising_report_add_fragment(const uint8_t * report, uint8_t data_length, const uint8_t * data){
+    uint8_t * event = hci_stack->le_extended_advertising_report;
+    if (hci_stack->le_extended_advertising_report_active){
+        // fragments of different advertisers are not interleaved, drop incomplete report
+        if (event[4] != report[2] || memcmp(&event[5], &report[3], 6) != 0 || event[13] != report[11]){
+            log_info("Extended advertising report from other advertiser, drop incomplete report");
+            hci_stack->le_extended_advertising_report_active = 0;
+        }
+    }
+    if (!hci_stack->le_extended_advertising_report_active){
+        hci_stack->le_extended_advertising_report_active = 1;
+        hci_stack->le_extended_advertising_report_len = 0;
+        event[0] = GAP_EVENT_EXTENDED_ADVERTISING_REPORT;
+        // event type .. direct address
+        memcpy(&event[2], report, 23);
+    }
+    uint16_t event_type  = little_endian_read_16(report, 0);
+    uint8_t  data_status = (event_type >> 5) & 0x03;
+    // store latest rssi
+    event[15] = report[13];
+
+    uint16_t len = hci_stack->le_extended_advertising_report_len;
+    uint16_t bytes_to_copy = btstack_min(data_length, LE_EXTENDED_ADVERTISING_MAX_DATA_LEN - len);
+    memcpy(&event[GAP_EVENT_EXTENDED_ADVERTISING_REPORT_HEADER_LEN + len], data, bytes_to_copy);
+    len += bytes_to_copy;
+    hci_stack->le_extended_advertising_report_len = len;
+    if (bytes_to_copy < data_length){
+        // remember truncation in stored event type
+        event[2] = (event[2] & 0x9f) | (2 << 5);
+    }
+
+    // more fragments to come
+    if (data_status == 1) return;
+    hci_stack->le_extended_advertising_report_active = 0;
+
+    // data status from last fragment unless truncated by host
+    if (((event[2] >> 5) & 0x03) != 2){
+        event[2] = (event[2] & 0x9f) | (data_status << 5);
+    }
+    uint16_t event_size = GAP_EVENT_EXTENDED_ADVERTISING_REPORT_HEADER_LEN + len;
+    event[1] = (uint8_t) btstack_min(event_size - 2, 0xff);
+    little_endian_store_16(event, 25, len);
+    if (!hci_le_advertising_report_accept(event[2], event[4], &event[5], (int8_t) event[15], len, &event[GAP_EVENT_EXTENDED_ADVERTISING_REPORT_HEADER_LEN])) return;
+    hci_emit_event(event, event_size, 1);
+}
+
+static void le_handle_extended_advertisement_report(uint8_t *packet, uint16_t size){
+    int offset = 3;
+    int num_reports = packet[offset];
+    offset += 1;
+
+    int i;
+    for (i=0; i<num_reports && offset < size;i++){
+        // sanity checks on data_length
+        if (offset + 24 > size) return;
+        uint8_t data_length = packet[offset + 23];
+        if (offset + 24 + data_length > size) return;
+        const uint8_t * report     = &packet[offset];
+        const uint8_t * data       = &packet[offset + 24];
+        uint16_t        event_type = little_endian_read_16(report, 0);
+        offset += 24 + data_length;
+        if (event_type & 0x10){
+            // legacy PDU, report as GAP_EVENT_ADVERTISING_REPORT
+            if (data_length > LE_ADVERTISING_DATA_SIZE) continue;
+            uint8_t legacy_event_type = hci_le_extended_advertising_report_legacy_event_type(event_type);
+            if (!hci_le_advertising_report_accept(legacy_event_type, report[2], &report[3], (int8_t) report[13], data_length, data)) continue;
+            hci_emit_le_advertising_report(legacy_event_type, report[2], &report[3], (int8_t) report[13], data_length, data);
+        } else {
+            hci_le_extended_advertising_report_add_fragment(report, data_length, data);
+        }
+    }
+}
+#endif
+
+static void hci_send_le_create_connection(uint8_t initiator_filter_policy, uint8_t peer_address_type, uint8_t * peer_address){
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    // same connection parameters for LE 1M and LE Coded
+    uint8_t  initiating_phys = hci_stack->le_scan_phys;
+    uint16_t scan_interval[2];
+    uint16_t scan_window[2];
+    uint16_t conn_interval_min[2];
+    uint16_t conn_interval_max[2];
+    uint16_t conn_latency[2];
+    uint16_t supervision_timeout[2];
+    uint16_t min_ce_length[2];
+    uint16_t max_ce_length[2];
+    int i;
+    for (i=0;i<2;i++){
+        scan_interval[i]       = hci_stack->le_connection_scan_interval;
+        scan_window[i]         = hci_stack->le_connection_scan_window;
+        conn_interval_min[i]   = hci_stack->le_connection_interval_min;
+        conn_interval_max[i]   = hci_stack->le_connection_interval_max;
+        conn_latency[i]        = hci_stack->le_connection_latency;
+        supervision_timeout[i] = hci_stack->le_supervision_timeout;
+        min_ce_length[i]       = hci_stack->le_minimum_ce_length;
+        max_ce_length[i]       = hci_stack->le_maximum_ce_length;
     }
+    hci_send_cmd(&hci_le_extended_create_connection, initiator_filter_policy, hci_stack->le_own_addr_type,
+        peer_address_type, peer_address, initiating_phys, scan_interval, scan_window, conn_interval_min,
+        conn_interval_max, conn_latency, supervision_timeout, min_ce_length, max_ce_length);
+#else
+    hci_send_cmd(&hci_le_create_connection,
+         hci_stack->le_connection_scan_interval,    // conn scan interval
+         hci_stack->le_connection_scan_window,      // conn scan windows
+         initiator_filter_policy,                   // use whitelist
+         peer_address_type,                         // peer address type
+         peer_address,                              // peer bd addr
+         hci_stack->le_own_addr_type,               // our addr type:
+         hci_stack->le_connection_interval_min,     // conn interval min
+         hci_stack->le_connection_interval_max,     // conn interval max
+         hci_stack->le_connection_latency,          // conn latency
+         hci_stack->le_supervision_timeout,         // conn latency
+         hci_stack->le_minimum_ce_length,           // min ce length
+         hci_stack->le_maximum_ce_length            // max ce length
+         );
+#endif
 }
 #endif
 #endif
 
 #ifdef ENABLE_BLE
 #ifdef ENABLE_LE_PERIPHERAL
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+// map legacy advertising type to advertising event properties with legacy PDUs
+static uint16_t hci_le_legacy_advertising_event_properties(uint8_t advertising_type){
+    switch (advertising_type){
+        case 1:
+            return 0x1d;    // ADV_DIRECT_IND, high duty cycle
+        case 2:
+            return 0x12;    // ADV_SCAN_IND
+        case 3:
+            return 0x10;    // ADV_NONCONN_IND
+        case 4:
+            return 0x15;    // ADV_DIRECT_IND, low duty cycle
+        default:
+            return 0x13;    // ADV_IND
+    }
+}
+
+static le_advertising_set_t * hci_advertising_set_for_handle(uint8_t advertising_handle){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+        if (advertising_set->advertising_handle == advertising_handle) return advertising_set;
+    }
+    return NULL;
+}
+
+// returns operation for next fragment of advertising or scan response data and updates fragment position
+static uint8_t hci_le_advertising_set_next_fragment(le_advertising_set_t * advertising_set, uint16_t data_len, uint8_t * out_fragment_len){
+    uint16_t pos       = advertising_set->fragment_pos;
+    uint16_t remaining = data_len - pos;
+    uint8_t  operation;
+    if (remaining <= LE_EXTENDED_ADVERTISING_MAX_FRAGMENT_LEN){
+        operation = (pos == 0) ? 3 : 2;     // complete data / last fragment
+        *out_fragment_len = (uint8_t) remaining;
+        advertising_set->fragment_pos = 0;
+    } else {
+        operation = (pos == 0) ? 1 : 0;     // first fragment / intermediate fragment
+        *out_fragment_len = LE_EXTENDED_ADVERTISING_MAX_FRAGMENT_LEN;
+        advertising_set->fragment_pos += LE_EXTENDED_ADVERTISING_MAX_FRAGMENT_LEN;
+    }
+    return operation;
+}
+
+static int hci_le_advertising_sets_run(void){
+    uint8_t advertising_handle;
+    // disable and remove sets released by application
+    for (advertising_handle = 1; advertising_handle <= LE_EXTENDED_ADVERTISING_MAX_SETS; advertising_handle++){
+        uint16_t mask = 1 << advertising_handle;
+        if (hci_stack->le_advertising_sets_to_disable & mask){
+            hci_stack->le_advertising_sets_to_disable &= ~mask;
+            hci_send_cmd(&hci_le_set_extended_advertising_enable, 0, 1, advertising_handle, 0, 0);
+            return 1;
+        }
+        if (hci_stack->le_advertising_sets_to_remove & mask){
+            hci_stack->le_advertising_sets_to_remove &= ~mask;
+            hci_send_cmd(&hci_le_remove_advertising_set, advertising_handle);
+            return 1;
+        }
+    }
+
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+        if (advertising_set->tasks == 0) continue;
+        advertising_handle = advertising_set->advertising_handle;
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_DISABLE){
+            advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_DISABLE;
+            advertising_set->state &= ~LE_ADVERTISING_SET_STATE_ACTIVE;
+            hci_send_cmd(&hci_le_set_extended_advertising_enable, 0, 1, advertising_handle, 0, 0);
+            return 1;
+        }
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_SET_PARAMS){
+            advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_SET_PARAMS;
+            le_extended_advertising_parameters_t * params = &advertising_set->params;
+            hci_send_cmd(&hci_le_set_extended_advertising_parameters,
+                advertising_handle,
+                params->advertising_event_properties,
+                params->primary_advertising_interval_min,
+                params->primary_advertising_interval_max,
+                params->primary_advertising_channel_map,
+                params->own_address_type,
+                params->peer_address_type,
+                params->peer_address,
+                params->advertising_filter_policy,
+                params->advertising_tx_power,
+                params->primary_advertising_phy,
+                params->secondary_advertising_max_skip,
+                params->secondary_advertising_phy,
+                params->advertising_sid,
+                params->scan_request_notification_enable);
+            return 1;
+        }
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_SET_ADDRESS){
+            advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_SET_ADDRESS;
+            hci_send_cmd(&hci_le_set_advertising_set_random_address, advertising_handle, hci_stack->le_random_address);
+            return 1;
+        }
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_SET_ADV_DATA){
+            uint16_t pos = advertising_set->fragment_pos;
+            uint8_t  fragment_len;
+            uint8_t  operation = hci_le_advertising_set_next_fragment(advertising_set, advertising_set->adv_data_len, &fragment_len);
+            if (advertising_set->fragment_pos == 0){
+                advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_SET_ADV_DATA;
+            }
+            hci_send_cmd(&hci_le_set_extended_advertising_data, advertising_handle, operation, 1, fragment_len, &advertising_set->adv_data[pos]);
+            return 1;
+        }
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_SET_SCAN_DATA){
+            uint16_t pos = advertising_set->fragment_pos;
+            uint8_t  fragment_len;
+            uint8_t  operation = hci_le_advertising_set_next_fragment(advertising_set, advertising_set->scan_data_len, &fragment_len);
+            if (advertising_set->fragment_pos == 0){
+                advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_SET_SCAN_DATA;
+            }
+            hci_send_cmd(&hci_le_set_extended_scan_response_data, advertising_handle, operation, 1, fragment_len, &advertising_set->scan_data[pos]);
+            return 1;
+        }
+        if (advertising_set->tasks & LE_ADVERTISING_SET_TASKS_ENABLE){
+            advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_ENABLE;
+            advertising_set->state |= LE_ADVERTISING_SET_STATE_ACTIVE;
+            hci_send_cmd(&hci_le_set_extended_advertising_enable, 1, 1, advertising_handle, advertising_set->enable_duration, advertising_set->enable_max_events);
+            return 1;
+        }
+    }
+    return 0;
+}
+#endif
+
 static void hci_reenable_advertisements_if_needed(void){
     if (!hci_stack->le_advertisements_active && hci_stack->le_advertisements_enabled){
         // get number of active le slave connections
@@ -1198,6 +1897,26 @@ static void hci_replace_bd_addr_placeholder(uint8_t * data, uint16_t size){
 }
 #endif
 
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_ADVERTISING_SCHEDULER) && !defined(ENABLE_LE_EXTENDED_ADVERTISING)
+static void hci_le_advertising_scheduler_prepare_command(uint8_t * command, const hci_cmd_t * cmd, uint8_t data_len, const uint8_t * data){
+    // opcode, parameter length, data length, 31 bytes data
+    little_endian_store_16(command, 0, cmd->opcode);
+    command[2] = 32;
+    command[3] = data_len;
+    memset(&command[4], 0, 31);
+    memcpy(&command[4], data, data_len);
+    hci_replace_bd_addr_placeholder(&command[4], data_len);
+}
+
+// HCI commands are prepared once and re-used on every rotation
+static void hci_le_advertising_scheduler_prepare(le_advertising_scheduler_entry_t * entry){
+    if (entry->commands_valid) return;
+    entry->commands_valid = 1;
+    hci_le_advertising_scheduler_prepare_command(entry->adv_data_command, &hci_le_set_advertising_data, entry->adv_data_len, entry->adv_data);
+    hci_le_advertising_scheduler_prepare_command(entry->scan_data_command, &hci_le_set_scan_response_data, entry->scan_data_len, entry->scan_data);
+}
+#endif
+
 // assumption: hci_can_send_command_packet_now() == true
 static void hci_initializing_run(void){
     log_debug("hci_initializing_run: substate %u, can send %u", hci_stack->substate, hci_can_send_command_packet_now());
@@ -1469,10 +2188,18 @@ static void hci_initializing_run(void){
             hci_stack->substate = HCI_INIT_W4_LE_READ_BUFFER_SIZE;
             hci_send_cmd(&hci_le_read_buffer_size);
             break;
-        case HCI_INIT_LE_SET_EVENT_MASK:
+        case HCI_INIT_LE_SET_EVENT_MASK: {
             hci_stack->substate = HCI_INIT_W4_LE_SET_EVENT_MASK;
-            hci_send_cmd(&hci_le_set_event_mask, 0x809FF, 0x0); // bits 0-8, 11, 19 
+            uint32_t le_event_mask = 0x809FF;   // bits 0-8, 11, 19
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+            le_event_mask |= 0x200;             // bit 9: enhanced connection complete
+#endif
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            le_event_mask |= 0x31000;           // bits 12, 16, 17: extended advertising report, scan timeout, advertising set terminated
+#endif
+            hci_send_cmd(&hci_le_set_event_mask, le_event_mask, 0x0);
             break;
+        }
         case HCI_INIT_WRITE_LE_HOST_SUPPORTED:
             // LE Supported Host = 1, Simultaneous Host = 0
             hci_stack->substate = HCI_INIT_W4_WRITE_LE_HOST_SUPPORTED;
@@ -1499,7 +2226,17 @@ static void hci_initializing_run(void){
         case HCI_INIT_LE_SET_SCAN_PARAMETERS:
             // LE Scan Parameters: active scanning, 300 ms interval, 30 ms window, own address type, accept all advs
             hci_stack->substate = HCI_INIT_W4_LE_SET_SCAN_PARAMETERS;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            {
+                // LE 1M only
+                const uint8_t  scan_types[1]     = { 1 };
+                const uint16_t scan_intervals[1] = { 0x1e0 };
+                const uint16_t scan_windows[1]   = { 0x30 };
+                hci_send_cmd(&hci_le_set_extended_scan_parameters, hci_stack->le_own_addr_type, 0, 1, scan_types, scan_intervals, scan_windows);
+            }
+#else
             hci_send_cmd(&hci_le_set_scan_parameters, 1, 0x1e0, 0x30, hci_stack->le_own_addr_type, 0);
+#endif
             break;
 #endif
         default:
@@ -1853,6 +2590,77 @@ static void hci_handle_connection_failed(hci_connection_t * conn, uint8_t status
 #endif
 }
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+static void hci_num_completed_packets_flush(void){
+    int num_handles = hci_stack->num_completed_packets_num_handles;
+    if (num_handles == 0) return;
+    hci_stack->num_completed_packets_num_handles = 0;
+
+    uint8_t event[3 + HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES * 4];
+    uint16_t pos = 3;
+    int i;
+    for (i=0;i<num_handles;i++){
+        little_endian_store_16(event, pos, hci_stack->num_completed_packets_handles[i]);
+        pos += 2;
+        little_endian_store_16(event, pos, hci_stack->num_completed_packets_counts[i]);
+        pos += 2;
+    }
+    event[0] = HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS;
+    event[1] = pos - 2;
+    event[2] = num_handles;
+    hci_emit_event(event, pos, 0);  // don't dump, original events have been dumped
+
+#ifdef ENABLE_CLASSIC
+    // For SCO, we do the can_send_now_check here
+    hci_notify_if_sco_can_send_now();
+#endif
+}
+
+// transport might not report end of batch on error or close, drop coalesced events as connections are gone, too
+static void hci_packet_batch_reset(void){
+    hci_stack->packet_batch_active = 0;
+    hci_stack->num_completed_packets_num_handles = 0;
+}
+
+// counters in hci_connection_t have been updated already, only collect event for upper stack
+static void hci_num_completed_packets_coalesce(const uint8_t * packet){
+    int offset = 3;
+    int i;
+    for (i=0; i<packet[2];i++){
+        hci_con_handle_t handle = little_endian_read_16(packet, offset) & 0x0fff;
+        uint16_t num_packets = little_endian_read_16(packet, offset + 2);
+        offset += 4;
+
+        int pos;
+        for (pos = 0; pos < hci_stack->num_completed_packets_num_handles; pos++){
+            if (hci_stack->num_completed_packets_handles[pos] == handle) break;
+        }
+        if (pos == HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES){
+            hci_num_completed_packets_flush();
+            pos = 0;
+        }
+        if (pos == hci_stack->num_completed_packets_num_handles){
+            hci_stack->num_completed_packets_handles[pos] = handle;
+            hci_stack->num_completed_packets_counts[pos]  = 0;
+            hci_stack->num_completed_packets_num_handles++;
+        }
+        hci_stack->num_completed_packets_counts[pos] += num_packets;
+    }
+}
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+// convert LE Enhanced Connection Complete into LE Connection Complete in place, returns new size
+static int hci_le_convert_enhanced_connection_complete(uint8_t * packet){
+    // drop local and peer resolvable private address, keep identity address and connection parameters
+    packet[2] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    packet[7] &= 0x01;
+    memmove(&packet[14], &packet[26], 7);
+    packet[1] = 19;
+    return 21;
+}
+#endif
+
 static void event_handler(uint8_t *packet, int size){
 
     uint16_t event_length = packet[1];
@@ -1875,6 +2683,15 @@ static void event_handler(uint8_t *packet, int size){
 #endif
 
     // log_info("HCI:EVENT:%02x", hci_event_packet_get_type(packet));
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    // upper layers only handle LE Connection Complete, peer identity address type 0x02/0x03 indicates resolution by Controller
+    int le_peer_address_resolved = 0;
+    if (hci_event_packet_get_type(packet) == HCI_EVENT_LE_META && packet[2] == HCI_SUBEVENT_LE_ENHANCED_CONNECTION_COMPLETE && size >= 33){
+        le_peer_address_resolved = packet[7] >= 0x02;
+        size = hci_le_convert_enhanced_connection_complete(packet);
+    }
+#endif
     
     switch (hci_event_packet_get_type(packet)) {
                         
@@ -1929,6 +2746,48 @@ static void event_handler(uint8_t *packet, int size){
                 hci_stack->le_whitelist_capacity = packet[6];
                 log_info("hci_le_read_white_list_size: size %u", hci_stack->le_whitelist_capacity);
             }   
+#endif
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+            if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_read_resolving_list_size)){
+                if (packet[5] == ERROR_CODE_SUCCESS){
+                    hci_stack->le_resolving_list_size = packet[6];
+                    hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_DISABLE_ADDRESS_RESOLUTION;
+                } else {
+                    hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_UNSUPPORTED;
+                }
+                log_info("hci_le_read_resolving_list_size: status 0x%02x, size %u", packet[5], hci_stack->le_resolving_list_size);
+            }
+            if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_set_address_resolution_enabled)){
+                if (hci_stack->le_resolving_list_state == LE_RESOLVING_LIST_W4_DISABLE_ADDRESS_RESOLUTION){
+                    if (packet[5] == ERROR_CODE_SUCCESS){
+                        hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_CLEAR;
+                    } else {
+                        // list cannot be modified, keep current list and address resolution
+                        log_error("hci_le_set_address_resolution_enabled(0): status 0x%02x", packet[5]);
+                        hci_le_resolving_list_done();
+                    }
+                } else if (packet[5] != ERROR_CODE_SUCCESS){
+                    log_error("hci_le_set_address_resolution_enabled(1): status 0x%02x", packet[5]);
+                }
+            }
+            if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_clear_resolving_list)){
+                if (packet[5] == ERROR_CODE_SUCCESS){
+                    hci_stack->le_resolving_list_num_entries = 0;
+                    hci_stack->le_resolving_list_next_index = 0;
+                    hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_ADD_ENTRIES;
+                } else {
+                    // entries are still on the Controller, enable address resolution again
+                    log_error("hci_le_clear_resolving_list: status 0x%02x", packet[5]);
+                    hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_ENABLE_ADDRESS_RESOLUTION;
+                }
+            }
+            if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_le_add_device_to_resolving_list)){
+                if (packet[5] == ERROR_CODE_SUCCESS){
+                    hci_stack->le_resolving_list_num_entries++;
+                } else {
+                    log_error("hci_le_add_device_to_resolving_list: status 0x%02x", packet[5]);
+                }
+            }
 #endif
             if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_read_bd_addr)) {
                 reverse_bd_addr(&packet[OFFSET_OF_DATA_IN_COMMAND_COMPLETE + 1],
@@ -1948,6 +2807,9 @@ static void event_handler(uint8_t *packet, int size){
             if (HCI_EVENT_IS_COMMAND_COMPLETE(packet, hci_inquiry_cancel)){
                 if (hci_stack->inquiry_state == GAP_INQUIRY_STATE_W4_CANCELLED){
                     hci_stack->inquiry_state = GAP_INQUIRY_STATE_IDLE;
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+                    hci_stack->discovery_state = GAP_DISCOVERY_STATE_IDLE;
+#endif
                     uint8_t event[] = { GAP_EVENT_INQUIRY_COMPLETE, 1, 0};
                     hci_emit_event(event, sizeof(event), 1);
                 }
@@ -2009,6 +2871,11 @@ static void event_handler(uint8_t *packet, int size){
             if (HCI_EVENT_IS_COMMAND_STATUS(packet, hci_le_create_connection)){
                 create_connection_cmd = 1;
             }
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            if (HCI_EVENT_IS_COMMAND_STATUS(packet, hci_le_extended_create_connection)){
+                create_connection_cmd = 1;
+            }
+#endif
 #endif
             if (create_connection_cmd) {
                 uint8_t status = hci_event_command_status_get_status(packet);
@@ -2024,9 +2891,21 @@ static void event_handler(uint8_t *packet, int size){
                     hci_handle_connection_failed(conn, status);
                 }
             }
-            break;
-            
-        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:{
+#ifdef ENABLE_BLE
+            // rejected connection update => no complete event, command status does not contain handle
+            if (HCI_EVENT_IS_COMMAND_STATUS(packet, hci_le_connection_update) && (hci_event_command_status_get_status(packet) != ERROR_CODE_SUCCESS)){
+                btstack_linked_list_iterator_t it;
+                hci_connections_get_iterator(&it);
+                while (btstack_linked_list_iterator_has_next(&it)){
+                    conn = (hci_connection_t *) btstack_linked_list_iterator_next(&it);
+                    if (conn->le_con_parameter_update_state != CON_PARAMETER_UPDATE_W4_CONNECTION_UPDATE_COMPLETE) continue;
+                    conn->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
+                }
+            }
+#endif
+            break;
+            
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:{
             int offset = 3;
             for (i=0; i<packet[2];i++){
                 handle = little_endian_read_16(packet, offset) & 0x0fff;
@@ -2048,18 +2927,47 @@ static void event_handler(uint8_t *packet, int size){
                 }
                 // log_info("hci_number_completed_packet %u processed for handle %u, outstanding %u", num_packets, handle, conn->num_packets_sent);
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+                // emitted at end of batch
+                if (hci_stack->packet_batch_active) continue;
+#endif
+
 #ifdef ENABLE_CLASSIC
                 // For SCO, we do the can_send_now_check here
                 hci_notify_if_sco_can_send_now();
 #endif
             }
+#ifdef ENABLE_HCI_PACKET_BATCHING
+            if (hci_stack->packet_batch_active){
+                hci_num_completed_packets_coalesce(packet);
+                // don't notify upper stack and don't run hci_run
+                return;
+            }
+#endif
             break;
         }
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+        case HCI_EVENT_TRANSPORT_PACKET_BATCH:
+            hci_stack->packet_batch_active = hci_event_transport_packet_batch_get_active(packet);
+            if (hci_stack->packet_batch_active) break;
+            // emit coalesced Number Of Completed Packets before upper stack gets notified about end of batch
+            hci_num_completed_packets_flush();
+            break;
+#endif
+
 #ifdef ENABLE_CLASSIC
         case HCI_EVENT_INQUIRY_COMPLETE:
             if (hci_stack->inquiry_state == GAP_INQUIRY_STATE_ACTIVE){
                 hci_stack->inquiry_state = GAP_INQUIRY_STATE_IDLE;
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+                // inquiry pause, request remote names before next slice
+                if (hci_stack->discovery_state == GAP_DISCOVERY_STATE_INQUIRY){
+                    hci_stack->discovery_state = GAP_DISCOVERY_STATE_NAMES;
+                    hci_stack->discovery_name_requests = 0;
+                    break;
+                }
+#endif
                 uint8_t event[] = { GAP_EVENT_INQUIRY_COMPLETE, 1, 0};
                 hci_emit_event(event, sizeof(event), 1);
             }
@@ -2068,7 +2976,41 @@ static void event_handler(uint8_t *packet, int size){
             if (hci_stack->remote_name_state == GAP_REMOTE_NAME_STATE_W4_COMPLETE){
                 hci_stack->remote_name_state = GAP_REMOTE_NAME_STATE_IDLE;
             }
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+            gap_inquiry_cache_remote_name_complete(packet);
+            if (hci_stack->discovery_state == GAP_DISCOVERY_STATE_W4_NAME){
+                hci_stack->discovery_state = GAP_DISCOVERY_STATE_NAMES;
+            }
+#endif
             break;
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+        case HCI_EVENT_READ_CLOCK_OFFSET_COMPLETE:
+            if (hci_event_read_clock_offset_complete_get_status(packet) != ERROR_CODE_SUCCESS) break;
+            conn = hci_connection_for_handle(hci_event_read_clock_offset_complete_get_handle(packet));
+            if (!conn) break;
+            {
+                int page_scan_repetition_mode = -1;
+                if (conn->page_scan_repetition_mode != 0xff){
+                    page_scan_repetition_mode = conn->page_scan_repetition_mode;
+                }
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+                gap_inquiry_cache_entry_t * entry = gap_inquiry_cache_for_address(conn->address);
+                if (page_scan_repetition_mode < 0 && entry){
+                    page_scan_repetition_mode = entry->page_scan_repetition_mode;
+                }
+#endif
+                hci_page_parameters_store(conn->address, hci_event_read_clock_offset_complete_get_clock_offset(packet) & 0x7fff, page_scan_repetition_mode);
+            }
+            break;
+        case HCI_EVENT_PAGE_SCAN_REPETITION_MODE_CHANGE:
+            hci_event_page_scan_repetition_mode_change_get_bd_addr(packet, addr);
+            conn = hci_connection_for_bd_addr_and_type(addr, BD_ADDR_TYPE_CLASSIC);
+            if (!conn) break;
+            // clock offset is read again to update stored entry
+            conn->read_clock_offset = 1;
+            conn->page_scan_repetition_mode = hci_event_page_scan_repetition_mode_change_get_page_scan_repetition_mode(packet);
+            break;
+#endif
         case HCI_EVENT_CONNECTION_REQUEST:
             reverse_bd_addr(&packet[2], addr);
             // TODO: eval COD 8-10
@@ -2105,6 +3047,9 @@ static void event_handler(uint8_t *packet, int size){
                     conn->state = OPEN;
                     conn->con_handle = little_endian_read_16(packet, 3);
                     conn->bonding_flags |= BONDING_REQUEST_REMOTE_FEATURES;
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+                    conn->read_clock_offset = 1;
+#endif
 
                     // restart timer
                     btstack_run_loop_set_timer(&conn->timeout, HCI_CONNECTION_TIMEOUT_MS);
@@ -2364,6 +3309,57 @@ static void event_handler(uint8_t *packet, int size){
                     if (!hci_stack->le_scanning_enabled) break;
                     le_handle_advertisement_report(packet, size);
                     break;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+                case HCI_SUBEVENT_LE_EXTENDED_ADVERTISING_REPORT:
+                    if (!hci_stack->le_scanning_enabled) break;
+                    le_handle_extended_advertisement_report(packet, size);
+                    break;
+#endif
+#endif
+                case HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE:
+                    conn = hci_connection_for_handle(hci_subevent_le_data_length_change_get_connection_handle(packet));
+                    if (!conn) break;
+                    conn->le_max_tx_octets = hci_subevent_le_data_length_change_get_max_tx_octets(packet);
+                    conn->le_max_rx_octets = hci_subevent_le_data_length_change_get_max_rx_octets(packet);
+                    log_info("LE Data Length Change: con 0x%04x, tx %u, rx %u octets", conn->con_handle, conn->le_max_tx_octets, conn->le_max_rx_octets);
+                    break;
+                case HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE:
+                    if (hci_subevent_le_phy_update_complete_get_status(packet)) break;
+                    conn = hci_connection_for_handle(hci_subevent_le_phy_update_complete_get_connection_handle(packet));
+                    if (!conn) break;
+                    conn->le_tx_phy = hci_subevent_le_phy_update_complete_get_tx_phy(packet);
+                    conn->le_rx_phy = hci_subevent_le_phy_update_complete_get_rx_phy(packet);
+                    log_info("LE PHY Update: con 0x%04x, tx %u, rx %u", conn->con_handle, conn->le_tx_phy, conn->le_rx_phy);
+                    break;
+#ifdef ENABLE_LE_LINK_AUTO_NEGOTIATION
+                case HCI_SUBEVENT_LE_READ_REMOTE_USED_FEATURES_COMPLETE:
+                    // status, connection handle, LE features
+                    if (packet[3]) break;
+                    conn = hci_connection_for_handle(little_endian_read_16(packet, 4));
+                    if (!conn) break;
+                    log_info("LE Remote Features: con 0x%04x, features %02x %02x", conn->con_handle, packet[6], packet[7]);
+                    // LE Data Packet Length Extension
+                    if ((packet[6] & 0x20) && (hci_stack->local_supported_commands[0] & 0x20)){
+                        conn->le_link_negotiation_tasks |= LE_LINK_NEGOTIATION_TASKS_SET_DATA_LENGTH;
+                    }
+                    // LE 2M PHY, unless application already requested PHY update
+                    if ((packet[7] & 0x01) && (hci_stack->local_supported_commands[0] & 0x40) && (conn->le_link_negotiation_tasks & LE_LINK_NEGOTIATION_PHY_REQUESTED) == 0){
+                        conn->le_phy_update_all_phys    = 0;
+                        conn->le_phy_update_tx_phys     = 2;
+                        conn->le_phy_update_rx_phys     = 2;
+                        conn->le_phy_update_phy_options = 0;
+                    }
+                    break;
+#endif
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_EXTENDED_ADVERTISING)
+                case HCI_SUBEVENT_LE_ADVERTISING_SET_TERMINATED: {
+                    // set 0 is handled via connection complete
+                    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(hci_subevent_le_advertising_set_terminated_get_advertising_handle(packet));
+                    if (advertising_set){
+                        advertising_set->state &= ~(LE_ADVERTISING_SET_STATE_ENABLED | LE_ADVERTISING_SET_STATE_ACTIVE);
+                    }
+                    break;
+                }
 #endif
                 case HCI_SUBEVENT_LE_CONNECTION_COMPLETE:
                     // Connection management
@@ -2423,6 +3419,20 @@ static void event_handler(uint8_t *packet, int size){
                     conn->role  = packet[6];
                     conn->con_handle             = hci_subevent_le_connection_complete_get_connection_handle(packet);
                     conn->le_connection_interval = hci_subevent_le_connection_complete_get_conn_interval(packet);
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+                    conn->le_peer_address_resolved = le_peer_address_resolved;
+#endif
+#ifdef ENABLE_LE_LINK_AUTO_NEGOTIATION
+                    // negotiate data length and PHY if supported by local Controller: LE Read Maximum Data Length / LE Set Default PHY
+                    if (hci_stack->local_supported_commands[0] & 0x60){
+                        conn->le_link_negotiation_tasks |= LE_LINK_NEGOTIATION_TASKS_READ_REMOTE_FEATURES;
+                    }
+#endif
+#ifdef ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+                    conn->le_connection_profile = hci_stack->le_connection_profile_default;
+                    conn->le_connection_profile_requested = GAP_LE_CONNECTION_PROFILE_MANUAL;
+                    hci_le_connection_profile_select(conn);
+#endif
 
 #ifdef ENABLE_LE_PERIPHERAL
                     if (packet[6] == HCI_ROLE_SLAVE){
@@ -2446,6 +3456,16 @@ static void event_handler(uint8_t *packet, int size){
                     handle = hci_subevent_le_connection_update_complete_get_connection_handle(packet);
                     conn = hci_connection_for_handle(handle);
                     if (!conn) break;
+                    // procedure done, also if it failed or was started by the remote
+                    switch (conn->le_con_parameter_update_state){
+                        case CON_PARAMETER_UPDATE_W4_RESPONSE:
+                        case CON_PARAMETER_UPDATE_W4_CONNECTION_UPDATE_COMPLETE:
+                            conn->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
+                            break;
+                        default:
+                            break;
+                    }
+                    if (hci_subevent_le_connection_update_complete_get_status(packet) != ERROR_CODE_SUCCESS) break;
                     conn->le_connection_interval = hci_subevent_le_connection_update_complete_get_conn_interval(packet);
                     break;
 
@@ -2637,6 +3657,10 @@ static void hci_state_reset(void){
     // no pending cmds
     hci_stack->decline_reason = 0;
     hci_stack->new_scan_enable_value = 0xff;
+
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+    hci_stack->discovery_state = GAP_DISCOVERY_STATE_IDLE;
+#endif
     
     // LE
 #ifdef ENABLE_BLE
@@ -2649,6 +3673,34 @@ static void hci_state_reset(void){
     hci_stack->le_connecting_state = LE_CONNECTING_IDLE;
     hci_stack->le_whitelist = 0;
     hci_stack->le_whitelist_capacity = 0;
+    hci_stack->le_whitelist_num_on_controller = 0;
+    hci_stack->le_whitelist_sync_pending = 0;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    hci_stack->le_extended_advertising_report_active = 0;
+#endif
+#endif
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_ADVERTISING_SCHEDULER)
+    hci_stack->le_advertising_scheduler_adv_data_on_controller  = NULL;
+    hci_stack->le_advertising_scheduler_scan_data_on_controller = NULL;
+#endif
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_EXTENDED_ADVERTISING)
+    // advertising sets are lost on reset, configure them again
+    hci_stack->le_advertising_sets_to_disable = 0;
+    hci_stack->le_advertising_sets_to_remove  = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+        advertising_set->state &= ~LE_ADVERTISING_SET_STATE_ACTIVE;
+        advertising_set->fragment_pos = 0;
+        advertising_set->tasks = LE_ADVERTISING_SET_TASKS_SET_PARAMS | LE_ADVERTISING_SET_TASKS_SET_ADV_DATA | LE_ADVERTISING_SET_TASKS_SET_SCAN_DATA;
+        if (advertising_set->params.own_address_type != BD_ADDR_TYPE_LE_PUBLIC){
+            advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_SET_ADDRESS;
+        }
+        if (advertising_set->state & LE_ADVERTISING_SET_STATE_ENABLED){
+            advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_ENABLE;
+        }
+    }
 #endif
 }
 
@@ -2726,6 +3778,12 @@ void hci_init(const hci_transport_t *transport, const void *config){
     hci_stack->le_supervision_timeout     = 0x0048;    // 720 ms
     hci_stack->le_minimum_ce_length       = 2;         // 1.25 ms
     hci_stack->le_maximum_ce_length       = 0x0030;    // 30 ms
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    hci_stack->le_scan_phys               = 1;         // LE 1M
+#endif
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+    hci_stack->le_advertising_report_filter_rssi_min = -128;
+#endif
 #endif
 
 #ifdef ENABLE_LE_PERIPHERAL
@@ -2740,6 +3798,15 @@ void hci_init(const hci_transport_t *transport, const void *config){
     hci_stack->le_connection_parameter_range.le_supervision_timeout_min =   10;
     hci_stack->le_connection_parameter_range.le_supervision_timeout_max = 3200;
 
+#if defined(ENABLE_BLE) && defined(ENABLE_LE_CONNECTION_PARAMETER_MANAGER)
+    // low latency: 7.5-15 ms, 2 s timeout
+    gap_le_connection_profile_set_parameters(GAP_LE_CONNECTION_PROFILE_LOW_LATENCY,     6,  12, 0, 200);
+    // bulk transfer: 7.5-30 ms, 4 s timeout
+    gap_le_connection_profile_set_parameters(GAP_LE_CONNECTION_PROFILE_BULK_TRANSFER,   6,  24, 0, 400);
+    // power save: 200-400 ms, slave latency 4, 6 s timeout
+    gap_le_connection_profile_set_parameters(GAP_LE_CONNECTION_PROFILE_POWER_SAVE,    160, 320, 4, 600);
+#endif
+
     hci_state_reset();
 }
 
@@ -2780,6 +3847,11 @@ void hci_close(void){
         hci_shutdown_connection(connection);
     }
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // hci_run is deferred during batch, make sure transport gets closed
+    hci_packet_batch_reset();
+#endif
+
     hci_power_control(HCI_POWER_OFF);
     
 #ifdef HAVE_MALLOC
@@ -2821,6 +3893,23 @@ void hci_set_bd_addr(bd_addr_t addr){
 
 static int hci_power_control_on(void){
     
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // batch might not have been completed by transport before power off
+    hci_packet_batch_reset();
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    // resolving list is cleared by HCI Reset, reload if it has been requested before
+    switch (hci_stack->le_resolving_list_state){
+        case LE_RESOLVING_LIST_IDLE:
+        case LE_RESOLVING_LIST_UNSUPPORTED:
+            break;
+        default:
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_READ_SIZE;
+            break;
+    }
+#endif
+
     // power on
     int err = 0;
     if (hci_stack->control && hci_stack->control->on){
@@ -2862,6 +3951,10 @@ static void hci_power_control_off(void){
     // close low-level device
     hci_stack->hci_transport->close();
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    hci_packet_batch_reset();
+#endif
+
     log_info("hci_power_control_off - hci_transport closed");
     
     // power off
@@ -3153,11 +4246,168 @@ static void hci_halting_timeout_handler(btstack_timer_source_t * ds){
     hci_run();
 }   
 
+#ifdef ENABLE_LE_CENTRAL
+// returns entry to remove from or add to Controller, removals first. Only the first le_whitelist_capacity entries are kept on the Controller
+static whitelist_entry_t * hci_whitelist_next_change(void){
+    whitelist_entry_t * add_entry = NULL;
+    int num_desired = 0;
+    btstack_linked_list_iterator_t lit;
+    btstack_linked_list_iterator_init(&lit, &hci_stack->le_whitelist);
+    while (btstack_linked_list_iterator_has_next(&lit)){
+        whitelist_entry_t * entry = (whitelist_entry_t*) btstack_linked_list_iterator_next(&lit);
+        if (entry->state & LE_WHITELIST_REMOVE_FROM_CONTROLLER){
+            if (entry->state & LE_WHITELIST_ON_CONTROLLER) return entry;
+            // not on controller, free directly
+            btstack_linked_list_iterator_remove(&lit);
+            btstack_memory_whitelist_entry_free(entry);
+            continue;
+        }
+        int desired = num_desired < hci_stack->le_whitelist_capacity;
+        if (desired){
+            num_desired++;
+        }
+        if (!desired && (entry->state & LE_WHITELIST_ON_CONTROLLER)) return entry;
+        if (desired && !(entry->state & LE_WHITELIST_ON_CONTROLLER) && !add_entry){
+            add_entry = entry;
+        }
+    }
+    return add_entry;
+}
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+// address resolution cannot be changed while advertising, scanning or initiating. returns 1 if command was sent
+static int hci_le_resolving_list_pause_activities(void){
+#ifdef ENABLE_LE_CENTRAL
+    // white list connecting gets restarted by hci_run
+    if (hci_stack->le_connecting_state == LE_CONNECTING_WHITELIST){
+        hci_send_cmd(&hci_le_create_connection_cancel);
+        return 1;
+    }
+    // scanning gets enabled again by hci_run as le_scanning_enabled != le_scanning_active
+    if (hci_stack->le_scanning_active){
+        hci_stack->le_scanning_active = 0;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        hci_send_cmd(&hci_le_set_extended_scan_enable, 0, 0, 0, 0);
+#else
+        hci_send_cmd(&hci_le_set_scan_enable, 0, 0);
+#endif
+        return 1;
+    }
+#endif
+#ifdef ENABLE_LE_PERIPHERAL
+    if (hci_stack->le_advertisements_active){
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        hci_send_cmd(&hci_le_set_extended_advertising_enable, 0, 1, 0, 0, 0);
+#else
+        hci_send_cmd(&hci_le_set_advertise_enable, 0);
+#endif
+        return 1;
+    }
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+        if ((advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE) == 0) continue;
+        advertising_set->state &= ~LE_ADVERTISING_SET_STATE_ACTIVE;
+        hci_send_cmd(&hci_le_set_extended_advertising_enable, 0, 1, advertising_set->advertising_handle, 0, 0);
+        return 1;
+    }
+#endif
+#endif
+    return 0;
+}
+
+static void hci_le_resolving_list_done(void){
+    hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_DONE;
+#ifdef ENABLE_LE_PERIPHERAL
+    // resume advertising paused by hci_le_resolving_list_pause_activities
+    hci_reenable_advertisements_if_needed();
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+        if ((advertising_set->state & LE_ADVERTISING_SET_STATE_ENABLED) == 0) continue;
+        if (advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE) continue;
+        advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_ENABLE;
+    }
+#endif
+#endif
+}
+
+// sync resolving list with le_device_db: list can only be modified while address resolution is disabled. returns 1 if command was sent
+static int hci_le_resolving_list_run(void){
+    switch (hci_stack->le_resolving_list_state){
+        case LE_RESOLVING_LIST_SEND_READ_SIZE:
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_W4_READ_SIZE;
+            hci_send_cmd(&hci_le_read_resolving_list_size);
+            return 1;
+        case LE_RESOLVING_LIST_SEND_DISABLE_ADDRESS_RESOLUTION:
+#ifdef ENABLE_LE_CENTRAL
+            // outgoing connection to a specific device cannot be resumed, sync after it completed
+            if (hci_stack->le_connecting_state == LE_CONNECTING_DIRECT) return 0;
+#endif
+            if (hci_le_resolving_list_pause_activities()) return 1;
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_W4_DISABLE_ADDRESS_RESOLUTION;
+            hci_send_cmd(&hci_le_set_address_resolution_enabled, 0);
+            return 1;
+        case LE_RESOLVING_LIST_W4_DISABLE_ADDRESS_RESOLUTION:
+        case LE_RESOLVING_LIST_W4_CLEAR:
+            // no other LE activity until sync is complete
+            return 1;
+        case LE_RESOLVING_LIST_SEND_CLEAR:
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_W4_CLEAR;
+            hci_send_cmd(&hci_le_clear_resolving_list);
+            return 1;
+        case LE_RESOLVING_LIST_ADD_ENTRIES:
+            while (hci_stack->le_resolving_list_next_index < le_device_db_max_count()){
+                int index = hci_stack->le_resolving_list_next_index++;
+                if (hci_stack->le_resolving_list_num_entries >= btstack_min(hci_stack->le_resolving_list_size, LE_RESOLVING_LIST_MAX_ENTRIES)){
+                    log_info("Resolving list full, skipping remaining bonded devices");
+                    break;
+                }
+                int addr_type = BD_ADDR_TYPE_UNKNOWN;
+                bd_addr_t addr;
+                sm_key_t irk;
+                le_device_db_info(index, &addr_type, addr, irk);
+                if (addr_type != BD_ADDR_TYPE_LE_PUBLIC && addr_type != BD_ADDR_TYPE_LE_RANDOM) continue;
+                // devices without IRK use their identity address
+                sm_key_t zero_irk;
+                memset(zero_irk, 0, 16);
+                if (memcmp(irk, zero_irk, 16) == 0) continue;
+                sm_key_t peer_irk_flipped;
+                sm_key_t local_irk_flipped;
+                reverse_128(irk, peer_irk_flipped);
+                reverse_128(hci_stack->le_resolving_list_local_irk, local_irk_flipped);
+                hci_send_cmd(&hci_le_add_device_to_resolving_list, addr_type, addr, peer_irk_flipped, local_irk_flipped);
+                return 1;
+            }
+            hci_stack->le_resolving_list_state = LE_RESOLVING_LIST_SEND_ENABLE_ADDRESS_RESOLUTION;
+            /* fall through */
+        case LE_RESOLVING_LIST_SEND_ENABLE_ADDRESS_RESOLUTION:
+            hci_le_resolving_list_done();
+            if (hci_stack->le_resolving_list_num_entries == 0) return 0;
+            log_info("Resolving list: %u entries, enable address resolution", hci_stack->le_resolving_list_num_entries);
+            hci_send_cmd(&hci_le_set_address_resolution_enabled, 1);
+            return 1;
+        default:
+            return 0;
+    }
+}
+#endif
+
 static void hci_run(void){
     
     // log_info("hci_run: entered");
     btstack_linked_item_t * it;
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // executed at end of batch
+    if (hci_stack->packet_batch_active) return;
+#endif
+
     // send continuation fragments first, as they block the prepared packet buffer
     if (hci_stack->acl_fragmentation_total_size > 0) {
         hci_con_handle_t con_handle = READ_ACL_CONNECTION_HANDLE(hci_stack->hci_packet_buffer);
@@ -3202,6 +4452,10 @@ static void hci_run(void){
         hci_stack->new_scan_enable_value = 0xff;
         return;
     }
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+    // discovery: queue next remote name request or inquiry slice
+    if (gap_discovery_run()) return;
+#endif
     // start/stop inquiry
     if (hci_stack->inquiry_state >= GAP_INQUIRY_DURATION_MIN && hci_stack->inquiry_state <= GAP_INQUIRY_DURATION_MAX){
         uint8_t duration = hci_stack->inquiry_state;
@@ -3221,6 +4475,12 @@ static void hci_run(void){
             hci_stack->remote_name_page_scan_repetition_mode, 0, hci_stack->remote_name_clock_offset);
         return;
     }
+    if (hci_stack->remote_name_state == GAP_REMOTE_NAME_STATE_W2_CANCEL){
+        // Remote Name Request Complete follows
+        hci_stack->remote_name_state = GAP_REMOTE_NAME_STATE_W4_COMPLETE;
+        hci_send_cmd(&hci_remote_name_request_cancel, hci_stack->remote_name_addr);
+        return;
+    }
     // pairing
     if (hci_stack->gap_pairing_state != GAP_PAIRING_STATE_IDLE){
         uint8_t state = hci_stack->gap_pairing_state;
@@ -3251,6 +4511,10 @@ static void hci_run(void){
     }
 #endif
 
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    if (hci_stack->state == HCI_STATE_WORKING && hci_le_resolving_list_run()) return;
+#endif
+
 #ifdef ENABLE_BLE
     // advertisements, active scanning, and creating connections requires randaom address to be set if using private address
     if ((hci_stack->state == HCI_STATE_WORKING)
@@ -3260,14 +4524,26 @@ static void hci_run(void){
         // handle le scan
         if ((hci_stack->le_scanning_enabled != hci_stack->le_scanning_active)){
             hci_stack->le_scanning_active = hci_stack->le_scanning_enabled;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            hci_send_cmd(&hci_le_set_extended_scan_enable, hci_stack->le_scanning_enabled, 0, 0, 0);
+#else
             hci_send_cmd(&hci_le_set_scan_enable, hci_stack->le_scanning_enabled, 0);
+#endif
             return;
         }
         if (hci_stack->le_scan_type != 0xff){
             // defaults: active scanning, accept all advertisement packets
             int scan_type = hci_stack->le_scan_type;
             hci_stack->le_scan_type = 0xff;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            // same parameters for LE 1M and LE Coded
+            uint8_t  scan_types[2]     = { (uint8_t) scan_type, (uint8_t) scan_type };
+            uint16_t scan_intervals[2] = { hci_stack->le_scan_interval, hci_stack->le_scan_interval };
+            uint16_t scan_windows[2]   = { hci_stack->le_scan_window, hci_stack->le_scan_window };
+            hci_send_cmd(&hci_le_set_extended_scan_parameters, hci_stack->le_own_addr_type, 0, hci_stack->le_scan_phys, scan_types, scan_intervals, scan_windows);
+#else
             hci_send_cmd(&hci_le_set_scan_parameters, scan_type, hci_stack->le_scan_interval, hci_stack->le_scan_window, hci_stack->le_own_addr_type, 0);
+#endif
             return;
         }
 #endif
@@ -3278,11 +4554,32 @@ static void hci_run(void){
         }
         if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_DISABLE){
             hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_DISABLE;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            hci_send_cmd(&hci_le_set_extended_advertising_enable, 0, 1, 0, 0, 0);
+#else
             hci_send_cmd(&hci_le_set_advertise_enable, 0);
+#endif
             return;
         }
         if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_PARAMS){
             hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_PARAMS;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            // advertising set 0 with legacy PDUs on LE 1M
+            hci_send_cmd(&hci_le_set_extended_advertising_parameters,
+                 0,
+                 hci_le_legacy_advertising_event_properties(hci_stack->le_advertisements_type),
+                 hci_stack->le_advertisements_interval_min,
+                 hci_stack->le_advertisements_interval_max,
+                 hci_stack->le_advertisements_channel_map,
+                 hci_stack->le_own_addr_type,
+                 hci_stack->le_advertisements_direct_address_type,
+                 hci_stack->le_advertisements_direct_address,
+                 hci_stack->le_advertisements_filter_policy,
+                 127, 1, 0, 1, 0, 0);
+            if (hci_stack->le_own_addr_type != BD_ADDR_TYPE_LE_PUBLIC){
+                hci_stack->le_advertisements_todo |= LE_ADVERTISEMENT_TASKS_SET_ADDRESS;
+            }
+#else
             hci_send_cmd(&hci_le_set_advertising_parameters,
                  hci_stack->le_advertisements_interval_min,
                  hci_stack->le_advertisements_interval_max,
@@ -3292,15 +4589,27 @@ static void hci_run(void){
                  hci_stack->le_advertisements_direct_address,
                  hci_stack->le_advertisements_channel_map,
                  hci_stack->le_advertisements_filter_policy);
+#endif
             return;
         }
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_ADDRESS){
+            hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_ADDRESS;
+            hci_send_cmd(&hci_le_set_advertising_set_random_address, 0, hci_stack->le_random_address);
+            return;
+        }
+#endif
         if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_ADV_DATA){
             hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_SET_ADV_DATA;
             uint8_t adv_data_clean[31];
             memset(adv_data_clean, 0, sizeof(adv_data_clean));
             memcpy(adv_data_clean, hci_stack->le_advertisements_data, hci_stack->le_advertisements_data_len);
             hci_replace_bd_addr_placeholder(adv_data_clean, hci_stack->le_advertisements_data_len);
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            hci_send_cmd(&hci_le_set_extended_advertising_data, 0, 3, 1, hci_stack->le_advertisements_data_len, adv_data_clean);
+#else
             hci_send_cmd(&hci_le_set_advertising_data, hci_stack->le_advertisements_data_len, adv_data_clean);
+#endif
             return;
         }
         if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_SET_SCAN_DATA){
@@ -3309,14 +4618,45 @@ static void hci_run(void){
             memset(scan_data_clean, 0, sizeof(scan_data_clean));
             memcpy(scan_data_clean, hci_stack->le_scan_response_data, hci_stack->le_scan_response_data_len);
             hci_replace_bd_addr_placeholder(scan_data_clean, hci_stack->le_scan_response_data_len);
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            hci_send_cmd(&hci_le_set_extended_scan_response_data, 0, 3, 1, hci_stack->le_scan_response_data_len, scan_data_clean);
+#else
             hci_send_cmd(&hci_le_set_scan_response_data, hci_stack->le_scan_response_data_len, hci_stack->le_scan_response_data);
+#endif
             return;
         }
         if (hci_stack->le_advertisements_todo & LE_ADVERTISEMENT_TASKS_ENABLE){
             hci_stack->le_advertisements_todo &= ~LE_ADVERTISEMENT_TASKS_ENABLE;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+            hci_send_cmd(&hci_le_set_extended_advertising_enable, 1, 1, 0, 0, 0);
+#else
             hci_send_cmd(&hci_le_set_advertise_enable, 1);
+#endif
             return;
         }
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        if (hci_le_advertising_sets_run()) return;
+#endif
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_ADVERTISING_SCHEDULER) && !defined(ENABLE_LE_EXTENDED_ADVERTISING)
+        // advertising and scan response data can be updated while advertising
+        if (hci_stack->le_advertising_scheduler_next){
+            le_advertising_scheduler_entry_t * entry = hci_stack->le_advertising_scheduler_next;
+            hci_le_advertising_scheduler_prepare(entry);
+            if (hci_stack->le_advertising_scheduler_adv_data_on_controller != entry){
+                hci_stack->le_advertising_scheduler_adv_data_on_controller = entry;
+                hci_send_prepared_cmd_packet(entry->adv_data_command, sizeof(entry->adv_data_command));
+                return;
+            }
+            le_advertising_scheduler_entry_t * previous = hci_stack->le_advertising_scheduler_scan_data_on_controller;
+            hci_stack->le_advertising_scheduler_scan_data_on_controller = entry;
+            hci_stack->le_advertising_scheduler_next = NULL;
+            // skip scan response data if unchanged
+            if (previous == NULL || memcmp(previous->scan_data_command, entry->scan_data_command, sizeof(entry->scan_data_command)) != 0){
+                hci_send_prepared_cmd_packet(entry->scan_data_command, sizeof(entry->scan_data_command));
+                return;
+            }
+        }
+#endif
 #endif
 
 #ifdef ENABLE_LE_CENTRAL
@@ -3324,66 +4664,43 @@ static void hci_run(void){
         // LE Whitelist Management
         //
 
-        // check if whitelist needs modification
-        btstack_linked_list_iterator_t lit;
-        int modification_pending = 0;
-        btstack_linked_list_iterator_init(&lit, &hci_stack->le_whitelist);
-        while (btstack_linked_list_iterator_has_next(&lit)){
-            whitelist_entry_t * entry = (whitelist_entry_t*) btstack_linked_list_iterator_next(&lit);
-            if (entry->state & (LE_WHITELIST_REMOVE_FROM_CONTROLLER | LE_WHITELIST_ADD_TO_CONTROLLER)){
-                modification_pending = 1;
-                break;
-            }
-        }
-
-        if (modification_pending){
-            // stop connnecting if modification pending
-            if (hci_stack->le_connecting_state != LE_CONNECTING_IDLE){
-                hci_send_cmd(&hci_le_create_connection_cancel);
-                return;
-            }
-
-            // add/remove entries
-            btstack_linked_list_iterator_init(&lit, &hci_stack->le_whitelist);
-            while (btstack_linked_list_iterator_has_next(&lit)){
-                whitelist_entry_t * entry = (whitelist_entry_t*) btstack_linked_list_iterator_next(&lit);
-                if (entry->state & LE_WHITELIST_ADD_TO_CONTROLLER){
-                    entry->state = LE_WHITELIST_ON_CONTROLLER;
-                    hci_send_cmd(&hci_le_add_device_to_white_list, entry->address_type, entry->address);
+        // apply all pending changes while initiator is paused
+        if (hci_stack->le_whitelist_sync_pending){
+            whitelist_entry_t * entry = hci_whitelist_next_change();
+            if (entry){
+                // stop connnecting if modification pending
+                if (hci_stack->le_connecting_state != LE_CONNECTING_IDLE){
+                    hci_send_cmd(&hci_le_create_connection_cancel);
                     return;
-
                 }
-                if (entry->state & LE_WHITELIST_REMOVE_FROM_CONTROLLER){
-                    bd_addr_t address;
-                    bd_addr_type_t address_type = entry->address_type;                    
-                    memcpy(address, entry->address, 6);
-                    btstack_linked_list_remove(&hci_stack->le_whitelist, (btstack_linked_item_t *) entry);
-                    btstack_memory_whitelist_entry_free(entry);
+                bd_addr_t address;
+                bd_addr_type_t address_type = entry->address_type;
+                memcpy(address, entry->address, 6);
+                if (entry->state & LE_WHITELIST_ON_CONTROLLER){
+                    entry->state &= ~LE_WHITELIST_ON_CONTROLLER;
+                    hci_stack->le_whitelist_num_on_controller--;
+                    if (entry->state & LE_WHITELIST_REMOVE_FROM_CONTROLLER){
+                        btstack_linked_list_remove(&hci_stack->le_whitelist, (btstack_linked_item_t *) entry);
+                        btstack_memory_whitelist_entry_free(entry);
+                    }
                     hci_send_cmd(&hci_le_remove_device_from_white_list, address_type, address);
-                    return;
+                } else {
+                    entry->state |= LE_WHITELIST_ON_CONTROLLER;
+                    hci_stack->le_whitelist_num_on_controller++;
+                    hci_send_cmd(&hci_le_add_device_to_white_list, address_type, address);
                 }
+                return;
             }
+            hci_stack->le_whitelist_sync_pending = 0;
         }
 
         // start connecting
         if ( hci_stack->le_connecting_state == LE_CONNECTING_IDLE && 
-            !btstack_linked_list_empty(&hci_stack->le_whitelist)){
+            hci_stack->le_whitelist_num_on_controller > 0){
             bd_addr_t null_addr;
             memset(null_addr, 0, 6);
-            hci_send_cmd(&hci_le_create_connection,
-                hci_stack->le_connection_scan_interval,    // scan interval: 60 ms
-                hci_stack->le_connection_scan_window,    // scan interval: 30 ms
-                 1,         // use whitelist
-                 0,         // peer address type
-                 null_addr, // peer bd addr
-                 hci_stack->le_own_addr_type, // our addr type:
-                 hci_stack->le_connection_interval_min,    // conn interval min
-                 hci_stack->le_connection_interval_max,    // conn interval max
-                 hci_stack->le_connection_latency,         // conn latency
-                 hci_stack->le_supervision_timeout,        // conn latency
-                 hci_stack->le_minimum_ce_length,          // min ce length
-                 hci_stack->le_maximum_ce_length           // max ce length
-                );
+            // use whitelist
+            hci_send_le_create_connection(1, 0, null_addr);
             return;
         }
 #endif
@@ -3410,20 +4727,8 @@ static void hci_run(void){
                         hci_stack->outgoing_addr_type = connection->address_type;
                         memcpy(hci_stack->outgoing_addr, connection->address, 6);
                         log_info("sending hci_le_create_connection");
-                        hci_send_cmd(&hci_le_create_connection,
-                             hci_stack->le_connection_scan_interval,    // conn scan interval
-                             hci_stack->le_connection_scan_window,      // conn scan windows
-                             0,         // don't use whitelist
-                             connection->address_type, // peer address type
-                             connection->address,      // peer bd addr
-                             hci_stack->le_own_addr_type, // our addr type:
-                             hci_stack->le_connection_interval_min,    // conn interval min
-                             hci_stack->le_connection_interval_max,    // conn interval max
-                             hci_stack->le_connection_latency,         // conn latency
-                             hci_stack->le_supervision_timeout,        // conn latency
-                             hci_stack->le_minimum_ce_length,          // min ce length
-                             hci_stack->le_maximum_ce_length          // max ce length
-                             );
+                        // don't use whitelist
+                        hci_send_le_create_connection(0, connection->address_type, connection->address);
                         connection->state = SENT_CREATE_CONNECTION;
 #endif
 #endif
@@ -3523,6 +4828,14 @@ static void hci_run(void){
             return;
         }
 
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+        if (connection->read_clock_offset){
+            connection->read_clock_offset = 0;
+            hci_send_cmd(&hci_read_clock_offset, connection->con_handle);
+            return;
+        }
+#endif
+
         if (connection->bonding_flags & BONDING_DISCONNECT_DEDICATED_DONE){
             connection->bonding_flags &= ~BONDING_DISCONNECT_DEDICATED_DONE;
             connection->bonding_flags |= BONDING_EMIT_COMPLETE_ON_DISCONNECT;
@@ -3567,10 +4880,17 @@ static void hci_run(void){
 #endif
 
 #ifdef ENABLE_BLE
+#ifdef ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+        // wait for ongoing parameter update procedure
+        if (connection->le_connection_profile_request_pending && connection->le_con_parameter_update_state == CON_PARAMETER_UPDATE_NONE){
+            connection->le_connection_profile_request_pending = 0;
+            hci_le_connection_profile_send_request(connection);
+        }
+#endif
         switch (connection->le_con_parameter_update_state){
             // response to L2CAP CON PARAMETER UPDATE REQUEST
             case CON_PARAMETER_UPDATE_CHANGE_HCI_CON_PARAMETERS:
-                connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE; 
+                connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_W4_CONNECTION_UPDATE_COMPLETE;
                 hci_send_cmd(&hci_le_connection_update, connection->con_handle, connection->le_conn_interval_min,
                     connection->le_conn_interval_max, connection->le_conn_latency, connection->le_supervision_timeout,
                     0x0000, 0xffff);
@@ -3594,6 +4914,18 @@ static void hci_run(void){
             hci_send_cmd(&hci_le_set_phy, connection->con_handle, all_phys, connection->le_phy_update_tx_phys, connection->le_phy_update_rx_phys, connection->le_phy_update_phy_options);
             return;
         }
+#ifdef ENABLE_LE_LINK_AUTO_NEGOTIATION
+        if (connection->le_link_negotiation_tasks & LE_LINK_NEGOTIATION_TASKS_READ_REMOTE_FEATURES){
+            connection->le_link_negotiation_tasks &= ~LE_LINK_NEGOTIATION_TASKS_READ_REMOTE_FEATURES;
+            hci_send_cmd(&hci_le_read_remote_used_features, connection->con_handle);
+            return;
+        }
+        if (connection->le_link_negotiation_tasks & LE_LINK_NEGOTIATION_TASKS_SET_DATA_LENGTH){
+            connection->le_link_negotiation_tasks &= ~LE_LINK_NEGOTIATION_TASKS_SET_DATA_LENGTH;
+            hci_send_cmd(&hci_le_set_data_length, connection->con_handle, LE_LINK_AUTO_NEGOTIATION_TX_OCTETS, LE_LINK_AUTO_NEGOTIATION_TX_TIME);
+            return;
+        }
+#endif
 #endif
     }
     
@@ -3621,6 +4953,12 @@ static void hci_run(void){
                             btstack_linked_list_remove(&hci_stack->le_whitelist, (btstack_linked_item_t *) entry);
                             btstack_memory_whitelist_entry_free(entry);
                         }
+                        hci_stack->le_whitelist_num_on_controller = 0;
+                        hci_stack->le_whitelist_sync_pending = 0;
+#ifdef ENABLE_LE_WHITELIST_ROTATION
+                        btstack_run_loop_remove_timer(&hci_stack->le_whitelist_rotation_timer);
+                        hci_stack->le_whitelist_rotation_active = 0;
+#endif
                     }
 #endif
 #endif
@@ -3787,11 +5125,30 @@ int hci_send_cmd_packet(uint8_t *packet, int size){
         }
         conn->state = SENT_CREATE_CONNECTION;
 
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+        gap_inquiry_cache_set_page_parameters(packet, addr, 11, 13);
+#endif
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+        hci_page_parameters_set_page_parameters(packet, addr, 11, 13);
+#endif
+
         // track outgoing connection
         hci_stack->outgoing_addr_type = BD_ADDR_TYPE_CLASSIC;
         memcpy(hci_stack->outgoing_addr, addr, 6);
     }
 
+#if defined(ENABLE_CLASSIC_INQUIRY_CACHE) || defined(ENABLE_CLASSIC_STORED_PAGE_PARAMETERS)
+    if (IS_COMMAND(packet, hci_remote_name_request)){
+        reverse_bd_addr(&packet[3], addr);
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+        gap_inquiry_cache_set_page_parameters(packet, addr, 9, 11);
+#endif
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+        hci_page_parameters_set_page_parameters(packet, addr, 9, 11);
+#endif
+    }
+#endif
+
     if (IS_COMMAND(packet, hci_link_key_request_reply)){
         hci_add_connection_flags_for_flipped_bd_addr(&packet[3], SENT_LINK_KEY_REPLY);
     }
@@ -3845,15 +5202,48 @@ int hci_send_cmd_packet(uint8_t *packet, int size){
     if (IS_COMMAND(packet, hci_le_set_random_address)){
         hci_stack->le_random_address_set = 1;
         reverse_bd_addr(&packet[3], hci_stack->le_random_address);
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        // advertising sets use their own random address, update while disabled
+        if (hci_stack->le_own_addr_type != BD_ADDR_TYPE_LE_PUBLIC){
+            hci_stack->le_advertisements_todo |= LE_ADVERTISEMENT_TASKS_SET_ADDRESS;
+            if (hci_stack->le_advertisements_active){
+                hci_stack->le_advertisements_todo |= LE_ADVERTISEMENT_TASKS_DISABLE | LE_ADVERTISEMENT_TASKS_ENABLE;
+            }
+        }
+        btstack_linked_list_iterator_t it;
+        btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_sets);
+        while (btstack_linked_list_iterator_has_next(&it)){
+            le_advertising_set_t * advertising_set = (le_advertising_set_t *) btstack_linked_list_iterator_next(&it);
+            if (advertising_set->params.own_address_type == BD_ADDR_TYPE_LE_PUBLIC) continue;
+            advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_SET_ADDRESS;
+            if (advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE){
+                advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_DISABLE | LE_ADVERTISING_SET_TASKS_ENABLE;
+            }
+        }
+#endif
     }
     if (IS_COMMAND(packet, hci_le_set_advertise_enable)){
         hci_stack->le_advertisements_active = packet[3];
     }
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    // track set 0 used by gap_advertisements_* functions
+    if (IS_COMMAND(packet, hci_le_set_extended_advertising_enable) && packet[4] == 1 && packet[5] == 0){
+        hci_stack->le_advertisements_active = packet[3];
+    }
+#endif
 #endif
 #ifdef ENABLE_LE_CENTRAL
-    if (IS_COMMAND(packet, hci_le_create_connection)){
+    if (IS_COMMAND(packet, hci_le_create_connection)
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    ||  IS_COMMAND(packet, hci_le_extended_create_connection)
+#endif
+    ){
         // white list used?
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+        uint8_t initiator_filter_policy = packet[3];
+#else
         uint8_t initiator_filter_policy = packet[7];
+#endif
         switch (initiator_filter_policy){
             case 0:
                 // whitelist not used
@@ -3950,6 +5340,30 @@ int hci_send_cmd(const hci_cmd_t *cmd, ...){
     return res;
 }
 
+#if defined(ENABLE_LE_PERIPHERAL) && defined(ENABLE_LE_ADVERTISING_SCHEDULER) && !defined(ENABLE_LE_EXTENDED_ADVERTISING)
+// send complete HCI command prepared in advance
+static int hci_send_prepared_cmd_packet(const uint8_t * command, uint16_t size){
+    if (!hci_can_send_command_packet_now()){
+        log_error("hci_send_prepared_cmd_packet called but cannot send packet now");
+        return 0;
+    }
+    hci_stack->last_cmd_opcode = little_endian_read_16(command, 0);
+
+    hci_reserve_packet_buffer();
+    uint8_t * packet = hci_stack->hci_packet_buffer;
+    memcpy(packet, command, size);
+    int err = hci_send_cmd_packet(packet, size);
+
+    // release packet buffer for synchronous transport implementations
+    if (hci_transport_synchronous()){
+        hci_release_packet_buffer();
+        hci_emit_transport_packet_sent();
+    }
+
+    return err;
+}
+#endif
+
 // Create various non-HCI events. 
 // TODO: generalize, use table similar to hci_create_command
 
@@ -4054,9 +5468,238 @@ static void gap_inquiry_explode(uint8_t * packet){
                 break;
         }
         event[1] = event_size - 2;
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+        // discovery only reports new devices and newly learned names
+        if (!gap_inquiry_cache_update(event)) continue;
+#endif
         hci_emit_event(event, event_size, 1);
     }
 }
+
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+static gap_inquiry_cache_entry_t * gap_inquiry_cache_for_address(const bd_addr_t address){
+    int i;
+    for (i=0;i<GAP_INQUIRY_CACHE_MAX_DEVICES;i++){
+        gap_inquiry_cache_entry_t * entry = &hci_stack->inquiry_cache[i];
+        if ((entry->flags & GAP_INQUIRY_CACHE_FLAG_VALID) == 0) continue;
+        if (bd_addr_cmp(entry->address, address) == 0) return entry;
+    }
+    return NULL;
+}
+
+// returns 1 if GAP_EVENT_INQUIRY_RESULT should be emitted
+static int gap_inquiry_cache_update(const uint8_t * event){
+    bd_addr_t address;
+    reverse_bd_addr(&event[2], address);
+    gap_inquiry_cache_entry_t * entry = gap_inquiry_cache_for_address(address);
+    if (!entry){
+        // use free entry or replace least recently seen one
+        int i;
+        for (i=0;i<GAP_INQUIRY_CACHE_MAX_DEVICES;i++){
+            gap_inquiry_cache_entry_t * candidate = &hci_stack->inquiry_cache[i];
+            if ((candidate->flags & GAP_INQUIRY_CACHE_FLAG_VALID) == 0){
+                entry = candidate;
+                break;
+            }
+            if (!entry || (int32_t)(candidate->last_seen_ms - entry->last_seen_ms) < 0){
+                entry = candidate;
+            }
+        }
+        memset(entry, 0, sizeof(gap_inquiry_cache_entry_t));
+        memcpy(entry->address, address, 6);
+        entry->flags = GAP_INQUIRY_CACHE_FLAG_VALID;
+    }
+    // plain inquiry reports every response, e.g. for RSSI updates
+    int report = (hci_stack->discovery_state == GAP_DISCOVERY_STATE_IDLE) || ((entry->flags & GAP_INQUIRY_CACHE_FLAG_REPORTED) == 0);
+    entry->flags |= GAP_INQUIRY_CACHE_FLAG_REPORTED;
+    entry->last_seen_ms = btstack_run_loop_get_time_ms();
+    entry->page_scan_repetition_mode = event[8];
+    entry->class_of_device = little_endian_read_24(event, 9);
+    entry->clock_offset = little_endian_read_16(event, 12) & 0x7fff;
+    if (event[14]){
+        entry->flags |= GAP_INQUIRY_CACHE_FLAG_RSSI;
+        entry->rssi = (int8_t) event[15];
+    }
+    if (event[16]){
+        uint8_t name_len = event[17];
+        if ((entry->flags & GAP_INQUIRY_CACHE_FLAG_NAME) == 0 || entry->name_len != name_len || memcmp(entry->name, &event[18], name_len) != 0){
+            report = 1;
+        }
+        entry->flags |= GAP_INQUIRY_CACHE_FLAG_NAME;
+        entry->flags &= ~GAP_INQUIRY_CACHE_FLAG_NAME_FAILED;
+        entry->name_len = name_len;
+        memcpy(entry->name, &event[18], name_len);
+    }
+    return report;
+}
+
+static void gap_inquiry_cache_remote_name_complete(const uint8_t * packet){
+    bd_addr_t address;
+    reverse_bd_addr(&packet[3], address);
+    gap_inquiry_cache_entry_t * entry = gap_inquiry_cache_for_address(address);
+    if (!entry) return;
+    if (packet[2] != ERROR_CODE_SUCCESS){
+        // don't retry during this discovery
+        entry->flags |= GAP_INQUIRY_CACHE_FLAG_NAME_FAILED;
+        return;
+    }
+    // name is null-terminated if shorter than 248 bytes
+    uint8_t name_len = 0;
+    while (name_len < GAP_INQUIRY_MAX_NAME_LEN && name_len < 248 && packet[9 + name_len] != 0){
+        name_len++;
+    }
+    entry->flags |= GAP_INQUIRY_CACHE_FLAG_NAME;
+    entry->flags &= ~GAP_INQUIRY_CACHE_FLAG_NAME_FAILED;
+    entry->name_len = name_len;
+    memcpy(entry->name, &packet[9], name_len);
+}
+
+// use page scan repetition mode and clock offset from inquiry if not provided by caller
+static void gap_inquiry_cache_set_page_parameters(uint8_t * packet, const bd_addr_t addr, int psrm_pos, int clock_offset_pos){
+    if (little_endian_read_16(packet, clock_offset_pos) & 0x8000) return;
+    gap_inquiry_cache_entry_t * entry = gap_inquiry_cache_for_address(addr);
+    if (!entry) return;
+    log_info("Page %s with cached PSRM %u, clock offset 0x%04x", bd_addr_to_str(addr), entry->page_scan_repetition_mode, entry->clock_offset);
+    packet[psrm_pos] = entry->page_scan_repetition_mode;
+    little_endian_store_16(packet, clock_offset_pos, 0x8000 | entry->clock_offset);
+}
+
+static void gap_discovery_start_inquiry_slice(void){
+    uint8_t duration = btstack_min(hci_stack->discovery_remaining, GAP_DISCOVERY_INQUIRY_SLICE);
+    hci_stack->discovery_remaining -= duration;
+    hci_stack->discovery_state = GAP_DISCOVERY_STATE_INQUIRY;
+    hci_stack->inquiry_state = duration;
+}
+
+// returns 1 if discovery is complete and hci_run should stop
+static int gap_discovery_run(void){
+    if (hci_stack->discovery_state != GAP_DISCOVERY_STATE_NAMES) return 0;
+    if (hci_stack->remote_name_state != GAP_REMOTE_NAME_STATE_IDLE) return 0;
+
+    // request names of devices found in this discovery, limited per pause unless inquiry is complete
+    if (hci_stack->discovery_remaining == 0 || hci_stack->discovery_name_requests < GAP_DISCOVERY_NAME_REQUESTS_PER_PAUSE){
+        int i;
+        for (i=0;i<GAP_INQUIRY_CACHE_MAX_DEVICES;i++){
+            gap_inquiry_cache_entry_t * entry = &hci_stack->inquiry_cache[i];
+            if ((entry->flags & GAP_INQUIRY_CACHE_FLAG_VALID) == 0) continue;
+            if ((entry->flags & GAP_INQUIRY_CACHE_FLAG_REPORTED) == 0) continue;
+            if (entry->flags & (GAP_INQUIRY_CACHE_FLAG_NAME | GAP_INQUIRY_CACHE_FLAG_NAME_FAILED)) continue;
+            hci_stack->discovery_name_requests++;
+            memcpy(hci_stack->remote_name_addr, entry->address, 6);
+            hci_stack->remote_name_page_scan_repetition_mode = entry->page_scan_repetition_mode;
+            hci_stack->remote_name_clock_offset = 0x8000 | entry->clock_offset;
+            hci_stack->remote_name_state = GAP_REMOTE_NAME_STATE_W2_SEND;
+            hci_stack->discovery_state = GAP_DISCOVERY_STATE_W4_NAME;
+            return 0;
+        }
+    }
+
+    // continue inquiry
+    if (hci_stack->discovery_remaining){
+        gap_discovery_start_inquiry_slice();
+        return 0;
+    }
+
+    // all names resolved
+    hci_stack->discovery_state = GAP_DISCOVERY_STATE_IDLE;
+    uint8_t event[] = { GAP_EVENT_INQUIRY_COMPLETE, 1, 0};
+    hci_emit_event(event, sizeof(event), 1);
+    return 1;
+}
+#endif
+
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+static uint32_t hci_page_parameters_tag_for_index(uint8_t index){
+    return 'B' << 24 | 'T' << 16 | 'P' << 8 | index;
+}
+
+// @param page_scan_repetition_mode or -1 to keep stored value
+static void hci_page_parameters_store(const bd_addr_t addr, uint16_t clock_offset, int page_scan_repetition_mode){
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (!tlv_impl) return;
+
+    int i;
+    uint32_t highest_seq_nr = 0;
+    uint32_t lowest_seq_nr = 0;
+    uint32_t tag_for_lowest_seq_nr = 0;
+    uint32_t tag_for_addr = 0;
+    uint32_t tag_for_empty = 0;
+    page_parameters_nvm_t entry;
+    page_parameters_nvm_t stored;
+    for (i=0;i<NVM_NUM_PAGE_PARAMETERS;i++){
+        uint32_t tag = hci_page_parameters_tag_for_index(i);
+        int size = tlv_impl->get_tag(tlv_context, tag, (uint8_t*) &entry, sizeof(entry));
+        // empty/invalid tag
+        if (size != sizeof(entry)){
+            tag_for_empty = tag;
+            continue;
+        }
+        if (bd_addr_cmp(addr, entry.bd_addr) == 0){
+            tag_for_addr = tag;
+            stored = entry;
+        }
+        if (entry.seq_nr > highest_seq_nr){
+            highest_seq_nr = entry.seq_nr;
+        }
+        if ((tag_for_lowest_seq_nr == 0) || (entry.seq_nr < lowest_seq_nr)){
+            tag_for_lowest_seq_nr = tag;
+            lowest_seq_nr = entry.seq_nr;
+        }
+    }
+
+    uint32_t tag_to_use;
+    if (tag_for_addr){
+        if (page_scan_repetition_mode < 0){
+            page_scan_repetition_mode = stored.page_scan_repetition_mode;
+        }
+        // avoid NVM writes if nothing changed
+        if (stored.clock_offset == clock_offset && stored.page_scan_repetition_mode == page_scan_repetition_mode) return;
+        tag_to_use = tag_for_addr;
+    } else if (tag_for_empty){
+        tag_to_use = tag_for_empty;
+    } else if (tag_for_lowest_seq_nr){
+        tag_to_use = tag_for_lowest_seq_nr;
+    } else {
+        // should not happen
+        return;
+    }
+    if (page_scan_repetition_mode < 0){
+        page_scan_repetition_mode = PAGE_SCAN_REPETITION_MODE_R1;
+    }
+
+    log_info("Store page parameters for %s with tag %"PRIx32": PSRM %u, clock offset 0x%04x", bd_addr_to_str(addr), tag_to_use, page_scan_repetition_mode, clock_offset);
+    memset(&entry, 0, sizeof(entry));
+    entry.seq_nr = highest_seq_nr + 1;
+    memcpy(entry.bd_addr, addr, 6);
+    entry.clock_offset = clock_offset;
+    entry.page_scan_repetition_mode = (uint8_t) page_scan_repetition_mode;
+    tlv_impl->store_tag(tlv_context, tag_to_use, (const uint8_t*) &entry, sizeof(entry));
+}
+
+// use stored page scan repetition mode and clock offset if not provided by caller
+static void hci_page_parameters_set_page_parameters(uint8_t * packet, const bd_addr_t addr, int psrm_pos, int clock_offset_pos){
+    if (little_endian_read_16(packet, clock_offset_pos) & 0x8000) return;
+
+    const btstack_tlv_t * tlv_impl = NULL;
+    void * tlv_context;
+    btstack_tlv_get_instance(&tlv_impl, &tlv_context);
+    if (!tlv_impl) return;
+
+    int i;
+    for (i=0;i<NVM_NUM_PAGE_PARAMETERS;i++){
+        page_parameters_nvm_t entry;
+        int size = tlv_impl->get_tag(tlv_context, hci_page_parameters_tag_for_index(i), (uint8_t*) &entry, sizeof(entry));
+        if (size != sizeof(entry)) continue;
+        if (bd_addr_cmp(addr, entry.bd_addr) != 0) continue;
+        log_info("Page %s with stored PSRM %u, clock offset 0x%04x", bd_addr_to_str(addr), entry.page_scan_repetition_mode, entry.clock_offset);
+        packet[psrm_pos] = entry.page_scan_repetition_mode;
+        little_endian_store_16(packet, clock_offset_pos, 0x8000 | entry.clock_offset);
+        return;
+    }
+}
+#endif
 #endif
 
 void hci_emit_state(void){
@@ -4359,9 +6002,86 @@ void gap_start_scan(void){
 
 void gap_stop_scan(void){
     hci_stack->le_scanning_enabled = 0;
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+    if (hci_stack->le_scan_aggregator_flush_interval_ms){
+        hci_le_scan_aggregator_flush();
+    }
+#endif
     hci_run();
 }
 
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+static uint8_t gap_advertising_report_filter_add_rule(le_advertising_report_filter_rule_type_t type, uint8_t len, const uint8_t * data, uint8_t data_len){
+    if (hci_stack->le_advertising_report_filter_num_rules >= LE_ADVERTISING_REPORT_FILTER_MAX_RULES) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    le_advertising_report_filter_rule_t * rule = &hci_stack->le_advertising_report_filter_rules[hci_stack->le_advertising_report_filter_num_rules++];
+    memset(rule, 0, sizeof(le_advertising_report_filter_rule_t));
+    rule->type = type;
+    rule->len  = len;
+    memcpy(rule->data, data, data_len);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_advertising_report_filter_add_address(bd_addr_type_t address_type, const bd_addr_t address){
+    bd_addr_t address_hci;
+    reverse_bd_addr(address, address_hci);
+    return gap_advertising_report_filter_add_rule(LE_ADVERTISING_REPORT_FILTER_RULE_ADDRESS, (uint8_t) address_type, address_hci, 6);
+}
+
+uint8_t gap_advertising_report_filter_add_uuid16(uint16_t uuid16){
+    uint8_t uuid16_le[2];
+    little_endian_store_16(uuid16_le, 0, uuid16);
+    return gap_advertising_report_filter_add_rule(LE_ADVERTISING_REPORT_FILTER_RULE_UUID16, 2, uuid16_le, 2);
+}
+
+uint8_t gap_advertising_report_filter_add_uuid128(const uint8_t * uuid128){
+    // UUID32 based on Bluetooth Base UUID are kept as 128-bit rule, 32-bit UUIDs in advertising data get expanded
+    if (uuid_has_bluetooth_prefix(uuid128) && big_endian_read_16(uuid128, 0) == 0){
+        return gap_advertising_report_filter_add_uuid16(big_endian_read_16(uuid128, 2));
+    }
+    uint8_t uuid128_le[16];
+    reverse_128(uuid128, uuid128_le);
+    return gap_advertising_report_filter_add_rule(LE_ADVERTISING_REPORT_FILTER_RULE_UUID128, 16, uuid128_le, 16);
+}
+
+uint8_t gap_advertising_report_filter_add_manufacturer_prefix(uint16_t company_id, const uint8_t * prefix, uint8_t prefix_len){
+    uint8_t data[16];
+    if (prefix_len > sizeof(data) - 2) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    little_endian_store_16(data, 0, company_id);
+    if (prefix_len){
+        memcpy(&data[2], prefix, prefix_len);
+    }
+    return gap_advertising_report_filter_add_rule(LE_ADVERTISING_REPORT_FILTER_RULE_MANUFACTURER_PREFIX, 2 + prefix_len, data, 2 + prefix_len);
+}
+
+void gap_advertising_report_filter_clear(void){
+    hci_stack->le_advertising_report_filter_num_rules = 0;
+}
+
+void gap_advertising_report_filter_set_rssi_threshold(int8_t rssi_min){
+    hci_stack->le_advertising_report_filter_rssi_min = rssi_min;
+}
+
+void gap_advertising_report_set_duplicate_window(uint16_t window_ms){
+    hci_stack->le_advertising_report_duplicate_window_ms = window_ms;
+    memset(hci_stack->le_advertising_report_duplicates, 0, sizeof(hci_stack->le_advertising_report_duplicates));
+}
+#endif
+
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+void gap_scan_aggregator_set_flush_interval(uint32_t flush_interval_ms){
+    btstack_run_loop_remove_timer(&hci_stack->le_scan_aggregator_timer);
+    // report devices collected so far
+    if (hci_stack->le_scan_aggregator_flush_interval_ms){
+        hci_le_scan_aggregator_flush();
+    }
+    hci_stack->le_scan_aggregator_flush_interval_ms = flush_interval_ms;
+    if (flush_interval_ms == 0) return;
+    btstack_run_loop_set_timer_handler(&hci_stack->le_scan_aggregator_timer, hci_le_scan_aggregator_timeout_handler);
+    btstack_run_loop_set_timer(&hci_stack->le_scan_aggregator_timer, flush_interval_ms);
+    btstack_run_loop_add_timer(&hci_stack->le_scan_aggregator_timer);
+}
+#endif
+
 void gap_set_scan_parameters(uint8_t scan_type, uint16_t scan_interval, uint16_t scan_window){
     hci_stack->le_scan_type     = scan_type;
     hci_stack->le_scan_interval = scan_interval;
@@ -4369,6 +6089,18 @@ void gap_set_scan_parameters(uint8_t scan_type, uint16_t scan_interval, uint16_t
     hci_run();
 }
 
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+void gap_set_scan_phys(uint8_t scan_phys){
+    // only LE 1M and LE Coded can be used for scanning and initiating
+    scan_phys &= 0x05;
+    if (scan_phys == 0){
+        log_error("gap_set_scan_phys: no supported PHY in %x", scan_phys);
+        return;
+    }
+    hci_stack->le_scan_phys = scan_phys;
+}
+#endif
+
 uint8_t gap_connect(bd_addr_t addr, bd_addr_type_t addr_type){
     hci_connection_t * conn = hci_connection_for_bd_addr_and_type(addr, addr_type);
     if (!conn){
@@ -4511,6 +6243,33 @@ int gap_request_connection_parameter_update(hci_con_handle_t con_handle, uint16_
     return 0;
 }
 
+#ifdef ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+uint8_t gap_le_connection_set_profile(hci_con_handle_t con_handle, gap_le_connection_profile_t profile){
+    hci_connection_t * connection = hci_connection_for_handle(con_handle);
+    if (!connection) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    if (profile > GAP_LE_CONNECTION_PROFILE_ADAPTIVE) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    connection->le_connection_profile = (uint8_t) profile;
+    hci_le_connection_profile_select(connection);
+    hci_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_le_connection_set_default_profile(gap_le_connection_profile_t profile){
+    hci_stack->le_connection_profile_default = profile;
+}
+
+uint8_t gap_le_connection_profile_set_parameters(gap_le_connection_profile_t profile, uint16_t conn_interval_min,
+    uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout){
+    if (profile < GAP_LE_CONNECTION_PROFILE_LOW_LATENCY || profile > GAP_LE_CONNECTION_PROFILE_POWER_SAVE) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    le_connection_profile_parameters_t * parameters = &hci_stack->le_connection_profile_parameters[profile - GAP_LE_CONNECTION_PROFILE_LOW_LATENCY];
+    parameters->conn_interval_min   = conn_interval_min;
+    parameters->conn_interval_max   = conn_interval_max;
+    parameters->conn_latency        = conn_latency;
+    parameters->supervision_timeout = supervision_timeout;
+    return ERROR_CODE_SUCCESS;
+}
+#endif
+
 #ifdef ENABLE_LE_PERIPHERAL
 
 static void gap_advertisments_changed(void){
@@ -4590,6 +6349,301 @@ void gap_advertisements_enable(int enabled){
     hci_run();
 }
 
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+static void gap_extended_advertising_changed(le_advertising_set_t * advertising_set, uint8_t tasks){
+    advertising_set->tasks |= tasks;
+    // disable advertising set before updating data or parameters
+    if (advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE){
+        advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_DISABLE | LE_ADVERTISING_SET_TASKS_ENABLE;
+    }
+    hci_run();
+}
+
+static uint8_t gap_extended_advertising_params_tasks(const le_extended_advertising_parameters_t * advertising_parameters){
+    if (advertising_parameters->own_address_type == BD_ADDR_TYPE_LE_PUBLIC) return LE_ADVERTISING_SET_TASKS_SET_PARAMS;
+    return LE_ADVERTISING_SET_TASKS_SET_PARAMS | LE_ADVERTISING_SET_TASKS_SET_ADDRESS;
+}
+
+uint8_t gap_extended_advertising_setup(le_advertising_set_t * storage, const le_extended_advertising_parameters_t * advertising_parameters, uint8_t * out_advertising_handle){
+    uint8_t advertising_handle;
+    for (advertising_handle = 1; advertising_handle <= LE_EXTENDED_ADVERTISING_MAX_SETS; advertising_handle++){
+        if (hci_advertising_set_for_handle(advertising_handle) == NULL) break;
+    }
+    if (advertising_handle > LE_EXTENDED_ADVERTISING_MAX_SETS) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    memset(storage, 0, sizeof(le_advertising_set_t));
+    storage->advertising_handle = advertising_handle;
+    storage->params = *advertising_parameters;
+    btstack_linked_list_add_tail(&hci_stack->le_advertising_sets, (btstack_linked_item_t *) storage);
+    *out_advertising_handle = advertising_handle;
+    gap_extended_advertising_changed(storage, gap_extended_advertising_params_tasks(advertising_parameters));
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_set_params(uint8_t advertising_handle, const le_extended_advertising_parameters_t * advertising_parameters){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    advertising_set->params = *advertising_parameters;
+    gap_extended_advertising_changed(advertising_set, gap_extended_advertising_params_tasks(advertising_parameters));
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_set_adv_data(uint8_t advertising_handle, uint16_t advertising_data_length, const uint8_t * advertising_data){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    if (advertising_data_length > LE_EXTENDED_ADVERTISING_MAX_DATA_LEN) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    advertising_set->adv_data = advertising_data;
+    advertising_set->adv_data_len = advertising_data_length;
+    // restart fragmentation
+    advertising_set->fragment_pos = 0;
+    gap_extended_advertising_changed(advertising_set, LE_ADVERTISING_SET_TASKS_SET_ADV_DATA);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_set_scan_response_data(uint8_t advertising_handle, uint16_t scan_response_data_length, const uint8_t * scan_response_data){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    if (scan_response_data_length > LE_EXTENDED_ADVERTISING_MAX_DATA_LEN) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    advertising_set->scan_data = scan_response_data;
+    advertising_set->scan_data_len = scan_response_data_length;
+    // restart fragmentation
+    advertising_set->fragment_pos = 0;
+    gap_extended_advertising_changed(advertising_set, LE_ADVERTISING_SET_TASKS_SET_SCAN_DATA);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_start(uint8_t advertising_handle, uint16_t timeout, uint8_t num_extended_advertising_events){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    advertising_set->enable_duration   = timeout;
+    advertising_set->enable_max_events = num_extended_advertising_events;
+    advertising_set->state |= LE_ADVERTISING_SET_STATE_ENABLED;
+    if ((advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE) == 0){
+        advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_ENABLE;
+    }
+    hci_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_stop(uint8_t advertising_handle){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    advertising_set->state &= ~LE_ADVERTISING_SET_STATE_ENABLED;
+    advertising_set->tasks &= ~LE_ADVERTISING_SET_TASKS_ENABLE;
+    if (advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE){
+        advertising_set->tasks |= LE_ADVERTISING_SET_TASKS_DISABLE;
+    }
+    hci_run();
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_extended_advertising_remove(uint8_t advertising_handle){
+    le_advertising_set_t * advertising_set = hci_advertising_set_for_handle(advertising_handle);
+    if (advertising_set == NULL) return ERROR_CODE_UNKNOWN_ADVERTISING_IDENTIFIER;
+    // storage is released now, disable and remove set on controller later
+    btstack_linked_list_remove(&hci_stack->le_advertising_sets, (btstack_linked_item_t *) advertising_set);
+    uint16_t mask = 1 << advertising_handle;
+    if (advertising_set->state & LE_ADVERTISING_SET_STATE_ACTIVE){
+        hci_stack->le_advertising_sets_to_disable |= mask;
+    }
+    hci_stack->le_advertising_sets_to_remove |= mask;
+    hci_run();
+    return ERROR_CODE_SUCCESS;
+}
+#endif
+
+#ifdef ENABLE_LE_ADVERTISING_SCHEDULER
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+// each payload uses its own advertising set, the Controller multiplexes them
+
+static void gap_advertising_scheduler_set_params(le_advertising_scheduler_entry_t * entry, le_extended_advertising_parameters_t * params){
+    // period as advertising interval, unit: 0.625 ms, min 20 ms
+    uint32_t interval = (((uint32_t) entry->period_ms) * 8) / 5;
+    if (interval < 0x20) interval = 0x20;
+    memset(params, 0, sizeof(le_extended_advertising_parameters_t));
+    params->advertising_event_properties     = hci_le_legacy_advertising_event_properties(hci_stack->le_advertisements_type);
+    params->primary_advertising_interval_min = interval;
+    params->primary_advertising_interval_max = interval;
+    params->primary_advertising_channel_map  = hci_stack->le_advertisements_channel_map ? hci_stack->le_advertisements_channel_map : 0x07;
+    params->own_address_type                 = hci_stack->le_own_addr_type;
+    params->peer_address_type                = hci_stack->le_advertisements_direct_address_type;
+    memcpy(params->peer_address, hci_stack->le_advertisements_direct_address, 6);
+    params->advertising_filter_policy        = hci_stack->le_advertisements_filter_policy;
+    params->advertising_tx_power             = 127;
+    params->primary_advertising_phy          = 1;
+    params->secondary_advertising_phy        = 1;
+}
+
+uint8_t gap_advertising_scheduler_add(le_advertising_scheduler_entry_t * entry, uint16_t period_ms, uint8_t priority,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data){
+    if (adv_data_length > 31 || scan_data_length > 31) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    memset(entry, 0, sizeof(le_advertising_scheduler_entry_t));
+    entry->period_ms = period_ms;
+    entry->priority  = priority;
+    le_extended_advertising_parameters_t params;
+    gap_advertising_scheduler_set_params(entry, &params);
+    uint8_t status = gap_extended_advertising_setup(&entry->advertising_set, &params, &entry->advertising_handle);
+    if (status != ERROR_CODE_SUCCESS) return status;
+    btstack_linked_list_add_tail(&hci_stack->le_advertising_scheduler_entries, (btstack_linked_item_t *) entry);
+    gap_advertising_scheduler_set_data(entry, adv_data_length, adv_data, scan_data_length, scan_data);
+    if (hci_stack->le_advertising_scheduler_active){
+        gap_extended_advertising_start(entry->advertising_handle, 0, 0);
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_advertising_scheduler_set_data(le_advertising_scheduler_entry_t * entry,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data){
+    if (adv_data_length > 31 || scan_data_length > 31) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    entry->adv_data      = adv_data;
+    entry->adv_data_len  = adv_data_length;
+    entry->scan_data     = scan_data;
+    entry->scan_data_len = scan_data_length;
+    gap_extended_advertising_set_adv_data(entry->advertising_handle, adv_data_length, adv_data);
+    gap_extended_advertising_set_scan_response_data(entry->advertising_handle, scan_data_length, scan_data);
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_advertising_scheduler_remove(le_advertising_scheduler_entry_t * entry){
+    if (!btstack_linked_list_remove(&hci_stack->le_advertising_scheduler_entries, (btstack_linked_item_t *) entry)) return;
+    gap_extended_advertising_remove(entry->advertising_handle);
+}
+
+void gap_advertising_scheduler_start(void){
+    hci_stack->le_advertising_scheduler_active = 1;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_scheduler_entries);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_scheduler_entry_t * entry = (le_advertising_scheduler_entry_t *) btstack_linked_list_iterator_next(&it);
+        gap_extended_advertising_start(entry->advertising_handle, 0, 0);
+    }
+}
+
+void gap_advertising_scheduler_stop(void){
+    hci_stack->le_advertising_scheduler_active = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_scheduler_entries);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_scheduler_entry_t * entry = (le_advertising_scheduler_entry_t *) btstack_linked_list_iterator_next(&it);
+        gap_extended_advertising_stop(entry->advertising_handle);
+    }
+}
+
+#else
+// payloads are rotated through the single legacy advertising instance
+
+static void gap_advertising_scheduler_select(void){
+    uint32_t now = btstack_run_loop_get_time_ms();
+    // prefer overdue entry with highest priority, otherwise earliest deadline
+    le_advertising_scheduler_entry_t * selected = NULL;
+    int32_t selected_delta = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_scheduler_entries);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_scheduler_entry_t * entry = (le_advertising_scheduler_entry_t *) btstack_linked_list_iterator_next(&it);
+        int32_t delta = (int32_t) (entry->deadline_ms - now);
+        if (selected == NULL){
+            selected = entry;
+            selected_delta = delta;
+            continue;
+        }
+        int overdue          = delta <= 0;
+        int selected_overdue = selected_delta <= 0;
+        if (overdue && selected_overdue && entry->priority != selected->priority){
+            if (entry->priority < selected->priority) continue;
+        } else if (delta >= selected_delta){
+            continue;
+        }
+        selected = entry;
+        selected_delta = delta;
+    }
+    if (selected == NULL) return;
+    selected->deadline_ms = now + selected->period_ms;
+    if (selected == hci_stack->le_advertising_scheduler_adv_data_on_controller
+    &&  selected == hci_stack->le_advertising_scheduler_scan_data_on_controller) return;
+    hci_stack->le_advertising_scheduler_next = selected;
+    hci_run();
+}
+
+static void gap_advertising_scheduler_timeout_handler(btstack_timer_source_t * ts){
+    gap_advertising_scheduler_select();
+    btstack_run_loop_set_timer(ts, LE_ADVERTISING_SCHEDULER_SLOT_MS);
+    btstack_run_loop_add_timer(ts);
+}
+
+uint8_t gap_advertising_scheduler_add(le_advertising_scheduler_entry_t * entry, uint16_t period_ms, uint8_t priority,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data){
+    if (adv_data_length > 31 || scan_data_length > 31) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    memset(entry, 0, sizeof(le_advertising_scheduler_entry_t));
+    entry->period_ms   = period_ms;
+    entry->priority    = priority;
+    // due immediately
+    entry->deadline_ms = btstack_run_loop_get_time_ms();
+    btstack_linked_list_add_tail(&hci_stack->le_advertising_scheduler_entries, (btstack_linked_item_t *) entry);
+    return gap_advertising_scheduler_set_data(entry, adv_data_length, adv_data, scan_data_length, scan_data);
+}
+
+uint8_t gap_advertising_scheduler_set_data(le_advertising_scheduler_entry_t * entry,
+    uint8_t adv_data_length, const uint8_t * adv_data, uint8_t scan_data_length, const uint8_t * scan_data){
+    if (adv_data_length > 31 || scan_data_length > 31) return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    entry->adv_data       = adv_data;
+    entry->adv_data_len   = adv_data_length;
+    entry->scan_data      = scan_data;
+    entry->scan_data_len  = scan_data_length;
+    entry->commands_valid = 0;
+    // resend if currently on air
+    if (hci_stack->le_advertising_scheduler_adv_data_on_controller == entry){
+        hci_stack->le_advertising_scheduler_adv_data_on_controller  = NULL;
+        hci_stack->le_advertising_scheduler_scan_data_on_controller = NULL;
+        if (hci_stack->le_advertising_scheduler_active){
+            hci_stack->le_advertising_scheduler_next = entry;
+            hci_run();
+        }
+    }
+    return ERROR_CODE_SUCCESS;
+}
+
+void gap_advertising_scheduler_remove(le_advertising_scheduler_entry_t * entry){
+    if (!btstack_linked_list_remove(&hci_stack->le_advertising_scheduler_entries, (btstack_linked_item_t *) entry)) return;
+    if (hci_stack->le_advertising_scheduler_next == entry){
+        hci_stack->le_advertising_scheduler_next = NULL;
+    }
+    if (hci_stack->le_advertising_scheduler_adv_data_on_controller == entry){
+        hci_stack->le_advertising_scheduler_adv_data_on_controller = NULL;
+    }
+    if (hci_stack->le_advertising_scheduler_scan_data_on_controller == entry){
+        hci_stack->le_advertising_scheduler_scan_data_on_controller = NULL;
+    }
+}
+
+void gap_advertising_scheduler_start(void){
+    if (hci_stack->le_advertising_scheduler_active) return;
+    hci_stack->le_advertising_scheduler_active = 1;
+    // all entries are due
+    uint32_t now = btstack_run_loop_get_time_ms();
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_advertising_scheduler_entries);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        le_advertising_scheduler_entry_t * entry = (le_advertising_scheduler_entry_t *) btstack_linked_list_iterator_next(&it);
+        entry->deadline_ms = now;
+    }
+    btstack_run_loop_set_timer_handler(&hci_stack->le_advertising_scheduler_timer, gap_advertising_scheduler_timeout_handler);
+    btstack_run_loop_set_timer(&hci_stack->le_advertising_scheduler_timer, LE_ADVERTISING_SCHEDULER_SLOT_MS);
+    btstack_run_loop_add_timer(&hci_stack->le_advertising_scheduler_timer);
+    // select first payload before advertising is enabled
+    gap_advertising_scheduler_select();
+    gap_advertisements_enable(1);
+}
+
+void gap_advertising_scheduler_stop(void){
+    if (!hci_stack->le_advertising_scheduler_active) return;
+    hci_stack->le_advertising_scheduler_active = 0;
+    hci_stack->le_advertising_scheduler_next = NULL;
+    btstack_run_loop_remove_timer(&hci_stack->le_advertising_scheduler_timer);
+    gap_advertisements_enable(0);
+}
+#endif
+#endif
+
 #endif
 
 void hci_le_set_own_address_type(uint8_t own_address_type){
@@ -4655,6 +6709,10 @@ uint8_t gap_le_set_phy(hci_con_handle_t connection_handle, uint8_t all_phys, uin
     conn->le_phy_update_tx_phys     = tx_phys;
     conn->le_phy_update_rx_phys     = rx_phys;
     conn->le_phy_update_phy_options = phy_options;
+#ifdef ENABLE_LE_LINK_AUTO_NEGOTIATION
+    // request might have been sent before remote features are known
+    conn->le_link_negotiation_tasks |= LE_LINK_NEGOTIATION_PHY_REQUESTED;
+#endif
 
     hci_run();
 
@@ -4662,6 +6720,52 @@ uint8_t gap_le_set_phy(hci_con_handle_t connection_handle, uint8_t all_phys, uin
 }
 
 #ifdef ENABLE_LE_CENTRAL
+#ifdef ENABLE_LE_WHITELIST_ROTATION
+static int hci_whitelist_num_active_entries(void){
+    int num_entries = 0;
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_whitelist);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        whitelist_entry_t * entry = (whitelist_entry_t*) btstack_linked_list_iterator_next(&it);
+        if (entry->state & LE_WHITELIST_REMOVE_FROM_CONTROLLER) continue;
+        num_entries++;
+    }
+    return num_entries;
+}
+
+static void hci_whitelist_rotation_handler(btstack_timer_source_t * ts){
+    int num_entries = hci_whitelist_num_active_entries();
+    if (num_entries <= hci_stack->le_whitelist_capacity){
+        hci_stack->le_whitelist_rotation_active = 0;
+        return;
+    }
+    // move entries currently on Controller to the end, next set will be added in one batch
+    int num_moved = 0;
+    while (num_moved < hci_stack->le_whitelist_capacity){
+        whitelist_entry_t * entry = (whitelist_entry_t *) btstack_linked_list_get_first_item(&hci_stack->le_whitelist);
+        btstack_linked_list_remove(&hci_stack->le_whitelist, (btstack_linked_item_t *) entry);
+        btstack_linked_list_add_tail(&hci_stack->le_whitelist, (btstack_linked_item_t *) entry);
+        if (entry->state & LE_WHITELIST_REMOVE_FROM_CONTROLLER) continue;
+        num_moved++;
+    }
+    log_info("White list rotation: %u entries, capacity %u", num_entries, hci_stack->le_whitelist_capacity);
+    hci_stack->le_whitelist_sync_pending = 1;
+    btstack_run_loop_set_timer(ts, LE_WHITELIST_ROTATION_INTERVAL_MS);
+    btstack_run_loop_add_timer(ts);
+    hci_run();
+}
+
+// start rotation timer if there are more entries than the Controller can hold
+static void hci_whitelist_rotation_start(void){
+    if (hci_stack->le_whitelist_rotation_active) return;
+    if (btstack_linked_list_count(&hci_stack->le_whitelist) <= hci_stack->le_whitelist_capacity) return;
+    hci_stack->le_whitelist_rotation_active = 1;
+    btstack_run_loop_set_timer_handler(&hci_stack->le_whitelist_rotation_timer, hci_whitelist_rotation_handler);
+    btstack_run_loop_set_timer(&hci_stack->le_whitelist_rotation_timer, LE_WHITELIST_ROTATION_INTERVAL_MS);
+    btstack_run_loop_add_timer(&hci_stack->le_whitelist_rotation_timer);
+}
+#endif
+
 /**
  * @brief Auto Connection Establishment - Start Connecting to device
  * @param address_typ
@@ -4669,15 +6773,33 @@ uint8_t gap_le_set_phy(hci_con_handle_t connection_handle, uint8_t all_phys, uin
  * @returns 0 if ok
  */
 int gap_auto_connection_start(bd_addr_type_t address_type, bd_addr_t address){
+    // already in list, cancel pending removal
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &hci_stack->le_whitelist);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        whitelist_entry_t * entry = (whitelist_entry_t*) btstack_linked_list_iterator_next(&it);
+        if (entry->address_type != address_type) continue;
+        if (memcmp(entry->address, address, 6) != 0) continue;
+        entry->state &= ~LE_WHITELIST_REMOVE_FROM_CONTROLLER;
+        hci_stack->le_whitelist_sync_pending = 1;
+        hci_run();
+        return 0;
+    }
+#ifndef ENABLE_LE_WHITELIST_ROTATION
     // check capacity
     int num_entries = btstack_linked_list_count(&hci_stack->le_whitelist);
     if (num_entries >= hci_stack->le_whitelist_capacity) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+#endif
     whitelist_entry_t * entry = btstack_memory_whitelist_entry_get();
     if (!entry) return BTSTACK_MEMORY_ALLOC_FAILED;
     entry->address_type = address_type;
     memcpy(entry->address, address, 6);
-    entry->state = LE_WHITELIST_ADD_TO_CONTROLLER;
-    btstack_linked_list_add(&hci_stack->le_whitelist, (btstack_linked_item_t*) entry);
+    entry->state = 0;
+    btstack_linked_list_add_tail(&hci_stack->le_whitelist, (btstack_linked_item_t*) entry);
+    hci_stack->le_whitelist_sync_pending = 1;
+#ifdef ENABLE_LE_WHITELIST_ROTATION
+    hci_whitelist_rotation_start();
+#endif
     hci_run();
     return 0;
 }
@@ -4692,11 +6814,14 @@ static void hci_remove_from_whitelist(bd_addr_type_t address_type, bd_addr_t add
         if (entry->state & LE_WHITELIST_ON_CONTROLLER){
             // remove from controller if already present
             entry->state |= LE_WHITELIST_REMOVE_FROM_CONTROLLER;
+            hci_stack->le_whitelist_sync_pending = 1;
             continue;
         }
         // direclty remove entry from whitelist
         btstack_linked_list_iterator_remove(&it);
         btstack_memory_whitelist_entry_free(entry);
+        // spilled entry might take its place
+        hci_stack->le_whitelist_sync_pending = 1;
     }
 }
 
@@ -4730,6 +6855,7 @@ void gap_auto_connection_stop_all(void){
         btstack_linked_list_iterator_remove(&it);
         btstack_memory_whitelist_entry_free(entry);
     }
+    hci_stack->le_whitelist_sync_pending = 1;
     hci_run();
 }
 
@@ -4739,6 +6865,22 @@ uint16_t gap_le_connection_interval(hci_con_handle_t connection_handle){
     return conn->le_connection_interval;
 }
 #endif
+
+uint8_t gap_le_connection_data_length(hci_con_handle_t connection_handle, uint16_t * out_max_tx_octets, uint16_t * out_max_rx_octets){
+    hci_connection_t * conn = hci_connection_for_handle(connection_handle);
+    if (!conn) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    *out_max_tx_octets = conn->le_max_tx_octets;
+    *out_max_rx_octets = conn->le_max_rx_octets;
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t gap_le_connection_phy(hci_con_handle_t connection_handle, uint8_t * out_tx_phy, uint8_t * out_rx_phy){
+    hci_connection_t * conn = hci_connection_for_handle(connection_handle);
+    if (!conn) return ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER;
+    *out_tx_phy = conn->le_tx_phy;
+    *out_rx_phy = conn->le_rx_phy;
+    return ERROR_CODE_SUCCESS;
+}
 #endif
 
 #ifdef ENABLE_CLASSIC 
@@ -4763,16 +6905,70 @@ int gap_inquiry_start(uint8_t duration_in_1280ms_units){
     if (duration_in_1280ms_units < GAP_INQUIRY_DURATION_MIN || duration_in_1280ms_units > GAP_INQUIRY_DURATION_MAX){
         return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
     }
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+    if (hci_stack->discovery_state != GAP_DISCOVERY_STATE_IDLE) return ERROR_CODE_COMMAND_DISALLOWED;
+    gap_inquiry_cache_reset_reported();
+#endif
     hci_stack->inquiry_state = duration_in_1280ms_units;
     hci_run();
     return 0;
 }
 
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+static void gap_inquiry_cache_reset_reported(void){
+    int i;
+    for (i=0;i<GAP_INQUIRY_CACHE_MAX_DEVICES;i++){
+        hci_stack->inquiry_cache[i].flags &= ~(GAP_INQUIRY_CACHE_FLAG_REPORTED | GAP_INQUIRY_CACHE_FLAG_NAME_FAILED);
+    }
+}
+
+int gap_discovery_start(uint8_t duration_in_1280ms_units){
+    if (hci_stack->state != HCI_STATE_WORKING) return ERROR_CODE_COMMAND_DISALLOWED;
+    if (hci_stack->inquiry_state != GAP_INQUIRY_STATE_IDLE) return ERROR_CODE_COMMAND_DISALLOWED;
+    if (hci_stack->discovery_state != GAP_DISCOVERY_STATE_IDLE) return ERROR_CODE_COMMAND_DISALLOWED;
+    if (duration_in_1280ms_units < GAP_INQUIRY_DURATION_MIN || duration_in_1280ms_units > GAP_INQUIRY_DURATION_MAX){
+        return ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
+    gap_inquiry_cache_reset_reported();
+    hci_stack->discovery_remaining = duration_in_1280ms_units;
+    gap_discovery_start_inquiry_slice();
+    hci_run();
+    return 0;
+}
+
+void gap_inquiry_cache_clear(void){
+    memset(hci_stack->inquiry_cache, 0, sizeof(hci_stack->inquiry_cache));
+}
+#endif
+
 /**
  * @brief Stop GAP Classic Inquiry
  * @returns 0 if ok
  */
 int gap_inquiry_stop(void){
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+    if (hci_stack->discovery_state != GAP_DISCOVERY_STATE_IDLE && hci_stack->inquiry_state != GAP_INQUIRY_STATE_ACTIVE){
+        // discovery between inquiry slices, cancel our remote name request
+        if (hci_stack->discovery_state == GAP_DISCOVERY_STATE_W4_NAME){
+            switch (hci_stack->remote_name_state){
+                case GAP_REMOTE_NAME_STATE_W2_SEND:
+                    hci_stack->remote_name_state = GAP_REMOTE_NAME_STATE_IDLE;
+                    break;
+                case GAP_REMOTE_NAME_STATE_W4_COMPLETE:
+                    hci_stack->remote_name_state = GAP_REMOTE_NAME_STATE_W2_CANCEL;
+                    break;
+                default:
+                    break;
+            }
+        }
+        hci_stack->discovery_state = GAP_DISCOVERY_STATE_IDLE;
+        hci_stack->inquiry_state = GAP_INQUIRY_STATE_IDLE;
+        uint8_t event[] = { GAP_EVENT_INQUIRY_COMPLETE, 1, 0};
+        hci_emit_event(event, sizeof(event), 1);
+        hci_run();
+        return 0;
+    }
+#endif
     if (hci_stack->inquiry_state >= GAP_INQUIRY_DURATION_MIN && hci_stack->inquiry_state <= GAP_INQUIRY_DURATION_MAX) {
         // emit inquiry complete event, before it even started
         uint8_t event[] = { GAP_EVENT_INQUIRY_COMPLETE, 1, 0};
@@ -141,6 +141,90 @@ extern "C" {
 #endif
 #endif
 
+// max number of connection handles in Number Of Completed Packets event coalesced during a packet batch
+#ifndef HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES
+#define HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES 4
+#endif
+
+// host-side filter for LE Advertising Reports
+#ifndef LE_ADVERTISING_REPORT_FILTER_MAX_RULES
+#define LE_ADVERTISING_REPORT_FILTER_MAX_RULES 8
+#endif
+
+// number of recently seen advertisements used to suppress duplicates
+#ifndef LE_ADVERTISING_REPORT_DUPLICATE_CACHE_SIZE
+#define LE_ADVERTISING_REPORT_DUPLICATE_CACHE_SIZE 32
+#endif
+
+// number of devices tracked by scan aggregator per flush interval
+#ifndef LE_SCAN_AGGREGATOR_MAX_DEVICES
+#define LE_SCAN_AGGREGATOR_MAX_DEVICES 16
+#endif
+
+// max number of bonded devices loaded into controller resolving list
+#ifndef LE_RESOLVING_LIST_MAX_ENTRIES
+#define LE_RESOLVING_LIST_MAX_ENTRIES 8
+#endif
+
+// time each set of white list entries stays on the Controller if there are more entries than it can hold
+#ifndef LE_WHITELIST_ROTATION_INTERVAL_MS
+#define LE_WHITELIST_ROTATION_INTERVAL_MS 5000
+#endif
+
+// max number of LE Extended Advertising sets in addition to the set used by gap_advertisements_* functions
+#ifndef LE_EXTENDED_ADVERTISING_MAX_SETS
+#define LE_EXTENDED_ADVERTISING_MAX_SETS 4
+#endif
+
+// max size of reassembled LE Extended Advertising Report
+#ifndef LE_EXTENDED_ADVERTISING_MAX_DATA_LEN
+#define LE_EXTENDED_ADVERTISING_MAX_DATA_LEN 1650
+#endif
+
+// data of LE Extended Advertising commands and report fragments
+#define LE_EXTENDED_ADVERTISING_MAX_FRAGMENT_LEN 251
+
+// header of GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+#define GAP_EVENT_EXTENDED_ADVERTISING_REPORT_HEADER_LEN 27
+
+// LL payload and time requested by LE link auto negotiation
+#ifndef LE_LINK_AUTO_NEGOTIATION_TX_OCTETS
+#define LE_LINK_AUTO_NEGOTIATION_TX_OCTETS 251
+#endif
+#ifndef LE_LINK_AUTO_NEGOTIATION_TX_TIME
+#define LE_LINK_AUTO_NEGOTIATION_TX_TIME 2120
+#endif
+
+// ADAPTIVE connection profile switches to power save after this time without data
+#ifndef LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS
+#define LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS 2000
+#endif
+
+// time each advertising scheduler payload stays on air before next payload is selected
+#ifndef LE_ADVERTISING_SCHEDULER_SLOT_MS
+#define LE_ADVERTISING_SCHEDULER_SLOT_MS 200
+#endif
+
+// Names are arbitrarily shortened to 32 bytes if not requested otherwise
+#ifndef GAP_INQUIRY_MAX_NAME_LEN
+#define GAP_INQUIRY_MAX_NAME_LEN 32
+#endif
+
+// number of Classic devices tracked by inquiry cache
+#ifndef GAP_INQUIRY_CACHE_MAX_DEVICES
+#define GAP_INQUIRY_CACHE_MAX_DEVICES 16
+#endif
+
+// discovery inquiry is split into slices of this duration in 1.28s units, remote names are requested in between
+#ifndef GAP_DISCOVERY_INQUIRY_SLICE
+#define GAP_DISCOVERY_INQUIRY_SLICE 3
+#endif
+
+// max number of remote name requests between two discovery inquiry slices
+#ifndef GAP_DISCOVERY_NAME_REQUESTS_PER_PAUSE
+#define GAP_DISCOVERY_NAME_REQUESTS_PER_PAUSE 2
+#endif
+
 // 
 #define IS_COMMAND(packet, command) (little_endian_read_16(packet,0) == command.opcode)
 
@@ -172,6 +256,9 @@ typedef enum {
     CON_PARAMETER_UPDATE_SEND_RESPONSE,
     CON_PARAMETER_UPDATE_CHANGE_HCI_CON_PARAMETERS,
     CON_PARAMETER_UPDATE_DENY,
+    CON_PARAMETER_UPDATE_W4_RESPONSE,
+    // HCI - Central updates parameters directly
+    CON_PARAMETER_UPDATE_W4_CONNECTION_UPDATE_COMPLETE,
     // HCI - in respnose to HCI_SUBEVENT_LE_REMOTE_CONNECTION_PARAMETER_REQUEST
     CON_PARAMETER_UPDATE_REPLY,
     CON_PARAMETER_UPDATE_NEGATIVE_REPLY,
@@ -486,6 +573,13 @@ typedef struct {
     // remote supported features
     uint8_t remote_supported_feature_eSCO;
 
+#ifdef ENABLE_CLASSIC_STORED_PAGE_PARAMETERS
+    // read clock offset for page parameter store
+    uint8_t read_clock_offset;
+    // 0xff if not known
+    uint8_t page_scan_repetition_mode;
+#endif
+
 #ifdef ENABLE_CLASSIC
     // connection mode, default ACL_CONNECTION_MODE_ACTIVE
     uint8_t connection_mode;
@@ -532,12 +626,36 @@ typedef struct {
 #ifdef ENABLE_BLE
     uint16_t le_connection_interval;
 
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    // peer address has been resolved by Controller, address is identity address
+    uint8_t le_peer_address_resolved;
+#endif
+
     // LE PHY Update via set phy command
     uint8_t le_phy_update_all_phys;      // 0xff for idle
     uint8_t le_phy_update_tx_phys;
     uint8_t le_phy_update_rx_phys;
     int8_t  le_phy_update_phy_options;
 
+    // current PHYs and max LL payload, updated by PHY Update Complete and Data Length Change events
+    uint8_t  le_tx_phy;
+    uint8_t  le_rx_phy;
+    uint16_t le_max_tx_octets;
+    uint16_t le_max_rx_octets;
+
+#ifdef ENABLE_LE_LINK_AUTO_NEGOTIATION
+    uint8_t le_link_negotiation_tasks;
+#endif
+
+#ifdef ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+    // gap_le_connection_profile_t selected by application
+    uint8_t  le_connection_profile;
+    // profile with parameters to request, GAP_LE_CONNECTION_PROFILE_MANUAL if none
+    uint8_t  le_connection_profile_requested;
+    uint8_t  le_connection_profile_request_pending;
+    uint32_t le_connection_profile_last_activity_ms;
+#endif
+
     // LE Security Manager
     sm_connection_t sm_connection;
 
@@ -674,11 +792,32 @@ enum {
     LE_ADVERTISEMENT_TASKS_SET_SCAN_DATA = 1 << 2,
     LE_ADVERTISEMENT_TASKS_SET_PARAMS    = 1 << 3,
     LE_ADVERTISEMENT_TASKS_ENABLE        = 1 << 4,
+    LE_ADVERTISEMENT_TASKS_SET_ADDRESS   = 1 << 5,
+};
+
+enum {
+    LE_LINK_NEGOTIATION_TASKS_READ_REMOTE_FEATURES = 1 << 0,
+    LE_LINK_NEGOTIATION_TASKS_SET_DATA_LENGTH      = 1 << 1,
+    // PHY requested by application via gap_le_set_phy, don't switch to 2M
+    LE_LINK_NEGOTIATION_PHY_REQUESTED              = 1 << 2,
+};
+
+enum {
+    LE_ADVERTISING_SET_TASKS_DISABLE       = 1 << 0,
+    LE_ADVERTISING_SET_TASKS_SET_PARAMS    = 1 << 1,
+    LE_ADVERTISING_SET_TASKS_SET_ADDRESS   = 1 << 2,
+    LE_ADVERTISING_SET_TASKS_SET_ADV_DATA  = 1 << 3,
+    LE_ADVERTISING_SET_TASKS_SET_SCAN_DATA = 1 << 4,
+    LE_ADVERTISING_SET_TASKS_ENABLE        = 1 << 5,
+};
+
+enum {
+    LE_ADVERTISING_SET_STATE_ENABLED = 1 << 0,
+    LE_ADVERTISING_SET_STATE_ACTIVE  = 1 << 1,
 };
 
 enum {
     LE_WHITELIST_ON_CONTROLLER          = 1 << 0,
-    LE_WHITELIST_ADD_TO_CONTROLLER      = 1 << 1,
     LE_WHITELIST_REMOVE_FROM_CONTROLLER = 1 << 2,
 };
 
@@ -689,6 +828,86 @@ typedef struct {
     uint8_t        state;   
 } whitelist_entry_t;
 
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+typedef enum {
+    LE_ADVERTISING_REPORT_FILTER_RULE_ADDRESS = 1,
+    LE_ADVERTISING_REPORT_FILTER_RULE_UUID16,
+    LE_ADVERTISING_REPORT_FILTER_RULE_UUID128,
+    LE_ADVERTISING_REPORT_FILTER_RULE_MANUFACTURER_PREFIX,
+} le_advertising_report_filter_rule_type_t;
+
+typedef struct {
+    le_advertising_report_filter_rule_type_t type;
+    // address type or length of manufacturer prefix incl. company id
+    uint8_t len;
+    // address, UUID16 and UUID128 in little endian
+    uint8_t data[16];
+} le_advertising_report_filter_rule_t;
+
+typedef struct {
+    // hash over event type, address and advertising data, 0 = unused
+    uint32_t  hash;
+    uint32_t  timestamp_ms;
+    bd_addr_t address;
+} le_advertising_report_duplicate_t;
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+typedef enum {
+    LE_RESOLVING_LIST_IDLE = 0,
+    LE_RESOLVING_LIST_SEND_READ_SIZE,
+    LE_RESOLVING_LIST_W4_READ_SIZE,
+    LE_RESOLVING_LIST_SEND_DISABLE_ADDRESS_RESOLUTION,
+    LE_RESOLVING_LIST_W4_DISABLE_ADDRESS_RESOLUTION,
+    LE_RESOLVING_LIST_SEND_CLEAR,
+    LE_RESOLVING_LIST_W4_CLEAR,
+    LE_RESOLVING_LIST_ADD_ENTRIES,
+    LE_RESOLVING_LIST_SEND_ENABLE_ADDRESS_RESOLUTION,
+    LE_RESOLVING_LIST_DONE,
+    LE_RESOLVING_LIST_UNSUPPORTED,
+} le_resolving_list_state_t;
+#endif
+
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+typedef struct {
+    uint32_t       first_seen_ms;
+    uint32_t       last_seen_ms;
+    uint32_t       report_count;
+    // hash of last advertising data
+    uint32_t       data_hash;
+    // exponential moving average of RSSI in 1/16 dBm
+    int16_t        rssi_avg_q4;
+    int8_t         rssi_min;
+    int8_t         rssi_max;
+    uint8_t        valid;
+    uint8_t        address_type;
+    bd_addr_t      address;
+} le_scan_aggregator_device_t;
+#endif
+
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+typedef struct {
+    uint32_t       last_seen_ms;
+    uint32_t       class_of_device;
+    // clock offset without valid flag
+    uint16_t       clock_offset;
+    uint8_t        page_scan_repetition_mode;
+    int8_t         rssi;
+    // see hci.c for flag defines
+    uint8_t        flags;
+    uint8_t        name_len;
+    uint8_t        name[GAP_INQUIRY_MAX_NAME_LEN];
+    bd_addr_t      address;
+} gap_inquiry_cache_entry_t;
+#endif
+
+typedef struct {
+    uint16_t conn_interval_min;
+    uint16_t conn_interval_max;
+    uint16_t conn_latency;
+    uint16_t supervision_timeout;
+} le_connection_profile_parameters_t;
+
 /**
  * main data structure
  */
@@ -799,6 +1018,14 @@ typedef struct {
     uint8_t   remote_name_page_scan_repetition_mode;
     uint8_t   remote_name_state;    // see hci.c for state defines
 
+#ifdef ENABLE_CLASSIC_INQUIRY_CACHE
+    gap_inquiry_cache_entry_t inquiry_cache[GAP_INQUIRY_CACHE_MAX_DEVICES];
+    uint8_t   discovery_state;      // see hci.c for state defines
+    // inquiry duration left in 1.28s units
+    uint8_t   discovery_remaining;
+    uint8_t   discovery_name_requests;
+#endif
+
     bd_addr_t gap_pairing_addr;
     uint8_t   gap_pairing_state;    // see hci.c for state defines
     union {
@@ -828,6 +1055,13 @@ typedef struct {
 #ifdef ENABLE_LE_CENTRAL
     uint8_t   le_scanning_enabled;
     uint8_t   le_scanning_active;
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    uint8_t   le_scan_phys;
+    // reassembly of fragmented LE Extended Advertising Reports
+    uint8_t   le_extended_advertising_report_active;
+    uint16_t  le_extended_advertising_report_len;
+    uint8_t   le_extended_advertising_report[GAP_EVENT_EXTENDED_ADVERTISING_REPORT_HEADER_LEN + LE_EXTENDED_ADVERTISING_MAX_DATA_LEN];
+#endif
 
     le_connecting_state_t le_connecting_state;
 
@@ -836,9 +1070,44 @@ typedef struct {
     uint16_t le_scan_interval;  
     uint16_t le_scan_window;
 
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+    le_resolving_list_state_t le_resolving_list_state;
+    uint8_t                   le_resolving_list_size;
+    uint8_t                   le_resolving_list_num_entries;
+    // next le_device_db index to add
+    uint16_t                  le_resolving_list_next_index;
+    sm_key_t                  le_resolving_list_local_irk;
+#endif
+
+#ifdef ENABLE_LE_ADVERTISING_REPORT_FILTER
+    // reports are forwarded if they match any rule or if there are no rules
+    uint8_t                             le_advertising_report_filter_num_rules;
+    le_advertising_report_filter_rule_t le_advertising_report_filter_rules[LE_ADVERTISING_REPORT_FILTER_MAX_RULES];
+    int8_t                              le_advertising_report_filter_rssi_min;
+    // time window for duplicate suppression, 0 = off
+    uint16_t                            le_advertising_report_duplicate_window_ms;
+    le_advertising_report_duplicate_t   le_advertising_report_duplicates[LE_ADVERTISING_REPORT_DUPLICATE_CACHE_SIZE];
+#endif
+
+#ifdef ENABLE_LE_SCAN_AGGREGATOR
+    // summary is emitted every flush interval, 0 = off
+    uint32_t                    le_scan_aggregator_flush_interval_ms;
+    btstack_timer_source_t      le_scan_aggregator_timer;
+    uint16_t                    le_scan_aggregator_num_dropped;
+    le_scan_aggregator_device_t le_scan_aggregator_devices[LE_SCAN_AGGREGATOR_MAX_DEVICES];
+#endif
+
     // LE Whitelist Management
     uint8_t               le_whitelist_capacity;
     btstack_linked_list_t le_whitelist;
+    // entries on Controller
+    uint8_t               le_whitelist_num_on_controller;
+    // set when entries have been added/removed, cleared after Controller has been updated
+    uint8_t               le_whitelist_sync_pending;
+#ifdef ENABLE_LE_WHITELIST_ROTATION
+    btstack_timer_source_t le_whitelist_rotation_timer;
+    uint8_t                le_whitelist_rotation_active;
+#endif
 
     // Connection parameters
     uint16_t le_connection_interval_min;
@@ -853,6 +1122,14 @@ typedef struct {
 
     le_connection_parameter_range_t le_connection_parameter_range;
 
+#ifdef ENABLE_LE_CONNECTION_PARAMETER_MANAGER
+    // parameters for low latency, bulk transfer, and power save profiles
+    le_connection_profile_parameters_t le_connection_profile_parameters[3];
+    gap_le_connection_profile_t        le_connection_profile_default;
+    btstack_timer_source_t             le_connection_profile_timer;
+    uint8_t                            le_connection_profile_timer_active;
+#endif
+
 #ifdef ENABLE_LE_PERIPHERAL
     uint8_t  * le_advertisements_data;
     uint8_t    le_advertisements_data_len;
@@ -873,6 +1150,23 @@ typedef struct {
     bd_addr_t le_advertisements_direct_address;
 
     uint8_t le_max_number_peripheral_connections;
+
+#ifdef ENABLE_LE_EXTENDED_ADVERTISING
+    btstack_linked_list_t le_advertising_sets;
+    // bitmap of advertising handles to disable/remove after set has been removed by application
+    uint16_t              le_advertising_sets_to_disable;
+    uint16_t              le_advertising_sets_to_remove;
+#endif
+
+#ifdef ENABLE_LE_ADVERTISING_SCHEDULER
+    btstack_linked_list_t  le_advertising_scheduler_entries;
+    btstack_timer_source_t le_advertising_scheduler_timer;
+    uint8_t                le_advertising_scheduler_active;
+    // entry to send next and entries whose data is on the controller
+    le_advertising_scheduler_entry_t * le_advertising_scheduler_next;
+    le_advertising_scheduler_entry_t * le_advertising_scheduler_adv_data_on_controller;
+    le_advertising_scheduler_entry_t * le_advertising_scheduler_scan_data_on_controller;
+#endif
 #endif
 
 #ifdef ENABLE_LE_DATA_LENGTH_EXTENSION
@@ -893,6 +1187,15 @@ typedef struct {
     bd_addr_t      outgoing_addr;
     bd_addr_type_t outgoing_addr_type;
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // transport delivers a batch of packets, hci_run is deferred until end of batch
+    uint8_t          packet_batch_active;
+    // Number Of Completed Packets coalesced during batch
+    uint8_t          num_completed_packets_num_handles;
+    hci_con_handle_t num_completed_packets_handles[HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES];
+    uint16_t         num_completed_packets_counts[HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES];
+#endif
+
 } hci_stack_t;
 
 
@@ -1077,6 +1380,22 @@ hci_connection_t * hci_connection_for_bd_addr_and_type(bd_addr_t addr, bd_addr_t
  */
 int hci_is_packet_buffer_reserved(void);
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+/**
+ * Check if HCI Transport is delivering a batch of packets. Used in l2cap.c to defer l2cap_run until end of batch
+ */
+int hci_packet_batch_active(void);
+#endif
+
+#ifdef ENABLE_LE_PRIVACY_ADDRESS_RESOLUTION
+/**
+ * Reload Controller resolving list with all bonded devices from le_device_db that have an IRK. Called by sm.c
+ * Advertising, scanning and connecting via white list are paused while the list is modified
+ * @param local_irk
+ */
+void hci_le_resolving_list_load(const sm_key_t local_irk);
+#endif
+
 /**
  * Check hci packet buffer is free and a classic acl packet can be sent to controller
  */
@@ -55,6 +55,9 @@
 // calculate combined ogf/ocf value
 #define OPCODE(ogf, ocf) (ocf | ogf << 10)
 
+// max number of array fields in '[' ... ']', e.g. 8 in LE Extended Create Connection
+#define HCI_CMD_MAX_ARRAY_FIELDS 8
+
 /**
  * construct HCI Command based on template
  *
@@ -69,6 +72,10 @@
  *   A: 31 bytes advertising data
  *   S: Service Record (Data Element Sequence)
  *   Q: 32 byte data block, e.g. for X and Y coordinates of P-256 public key
+ *   J: 8 bit length of following variable length data block
+ *   V: variable length data block, length given by preceding J
+ *   [: arrays of 8 or 16 bit values until ], one element per bit set in preceding 8 bit value, each passed as pointer.
+ *      Serialized element by element, e.g. all values for first PHY, then all values for second PHY
  */
 uint16_t hci_cmd_create_from_template(uint8_t *hci_cmd_buffer, const hci_cmd_t *cmd, va_list argptr){
     
@@ -80,6 +87,8 @@ uint16_t hci_cmd_create_from_template(uint8_t *hci_cmd_buffer, const hci_cmd_t *
     uint16_t word;
     uint32_t longword;
     uint8_t * ptr;
+    uint8_t last_byte = 0;
+    uint8_t var_len = 0;
     while (*format) {
         switch(*format) {
             case '1': //  8 bit value
@@ -87,6 +96,7 @@ uint16_t hci_cmd_create_from_template(uint8_t *hci_cmd_buffer, const hci_cmd_t *
             case 'H': // hci_handle
                 word = va_arg(argptr, int);  // minimal va_arg is int: 2 bytes on 8+16 bit CPUs
                 hci_cmd_buffer[pos++] = word & 0xff;
+                last_byte = word & 0xff;
                 if (*format == '2') {
                     hci_cmd_buffer[pos++] = word >> 8;
                 } else if (*format == 'H') {
@@ -167,6 +177,45 @@ uint16_t hci_cmd_create_from_template(uint8_t *hci_cmd_buffer, const hci_cmd_t *
                 pos += 32;
                 break;
 #endif
+            case 'J': // 8 bit length of following variable length data block
+                word = va_arg(argptr, int);
+                var_len = word & 0xff;
+                hci_cmd_buffer[pos++] = var_len;
+                break;
+            case 'V': // variable length data block
+                ptr = va_arg(argptr, uint8_t *);
+                memcpy(&hci_cmd_buffer[pos], ptr, var_len);
+                pos += var_len;
+                break;
+            case '[': { // arrays of values, e.g. one entry per PHY
+                int num_elements = 0;
+                int i;
+                for (i=0;i<8;i++){
+                    if (last_byte & (1 << i)) num_elements++;
+                }
+                // collect arrays for all fields
+                const char * array_format = &format[1];
+                const void * arrays[HCI_CMD_MAX_ARRAY_FIELDS];
+                int num_fields = 0;
+                while (format[1] && format[1] != ']' && num_fields < HCI_CMD_MAX_ARRAY_FIELDS){
+                    format++;
+                    arrays[num_fields++] = va_arg(argptr, const void *);
+                }
+                if (format[1]) format++;
+                // store one element of each field after the other
+                for (i=0;i<num_elements;i++){
+                    int field;
+                    for (field=0;field<num_fields;field++){
+                        if (array_format[field] == '1'){
+                            hci_cmd_buffer[pos++] = ((const uint8_t *) arrays[field])[i];
+                        } else if (array_format[field] == '2'){
+                            little_endian_store_16(hci_cmd_buffer, pos, ((const uint16_t *) arrays[field])[i]);
+                            pos += 2;
+                        }
+                    }
+                }
+                break;
+            }
             default:
                 break;
         }
@@ -324,6 +373,13 @@ const hci_cmd_t hci_read_remote_supported_features_command = {
 OPCODE(OGF_LINK_CONTROL, 0x1B), "H"
 };
 
+/**
+ * @param handle
+ */
+const hci_cmd_t hci_read_clock_offset = {
+OPCODE(OGF_LINK_CONTROL, 0x1F), "H"
+};
+
 /** 
  * @param handle
  * @param transmit_bandwidth 8000(64kbps)
@@ -1191,6 +1247,48 @@ OPCODE(OGF_LE_CONTROLLER, 0x26), "QQ"
 // LE Generate DHKey Complete is generated on completion
 };
 
+/**
+ * @param peer_identity_address_type (public (0), random (1))
+ * @param peer_identity_address
+ * @param peer_irk (128) in little endian
+ * @param local_irk (128) in little endian
+ */
+const hci_cmd_t hci_le_add_device_to_resolving_list = {
+OPCODE(OGF_LE_CONTROLLER, 0x27), "1BPP"
+// return: status
+};
+
+/**
+ * @param peer_identity_address_type (public (0), random (1))
+ * @param peer_identity_address
+ */
+const hci_cmd_t hci_le_remove_device_from_resolving_list = {
+OPCODE(OGF_LE_CONTROLLER, 0x28), "1B"
+// return: status
+};
+
+/**
+ */
+const hci_cmd_t hci_le_clear_resolving_list = {
+OPCODE(OGF_LE_CONTROLLER, 0x29), ""
+// return: status
+};
+
+/**
+ */
+const hci_cmd_t hci_le_read_resolving_list_size = {
+OPCODE(OGF_LE_CONTROLLER, 0x2A), ""
+// return: status, resolving list size
+};
+
+/**
+ * @param address_resolution_enable (disabled (0), enabled (1))
+ */
+const hci_cmd_t hci_le_set_address_resolution_enabled = {
+OPCODE(OGF_LE_CONTROLLER, 0x2D), "1"
+// return: status
+};
+
 /**
  */
 const hci_cmd_t hci_le_read_maximum_data_length = {
@@ -1228,6 +1326,139 @@ OPCODE(OGF_LE_CONTROLLER, 0x32), "H1111"
 // LE PHY Update Complete is generated on completion
 };
 
+/**
+ * @param advertising_handle
+ * @param random_address
+ */
+const hci_cmd_t hci_le_set_advertising_set_random_address = {
+OPCODE(OGF_LE_CONTROLLER, 0x35), "1B"
+// return: status
+};
+
+/**
+ * @param advertising_handle
+ * @param advertising_event_properties
+ * @param primary_advertising_interval_min (unit: 0.625 msec)
+ * @param primary_advertising_interval_max (unit: 0.625 msec)
+ * @param primary_advertising_channel_map
+ * @param own_address_type
+ * @param peer_address_type
+ * @param peer_address
+ * @param advertising_filter_policy
+ * @param advertising_tx_power (127 = no preference)
+ * @param primary_advertising_phy (LE 1M (1), LE Coded (3))
+ * @param secondary_advertising_max_skip
+ * @param secondary_advertising_phy (LE 1M (1), LE 2M (2), LE Coded (3))
+ * @param advertising_sid
+ * @param scan_request_notification_enable
+ */
+const hci_cmd_t hci_le_set_extended_advertising_parameters = {
+OPCODE(OGF_LE_CONTROLLER, 0x36), "1233111B1111111"
+// return: status, selected tx power
+};
+
+/**
+ * @param advertising_handle
+ * @param operation (intermediate fragment (0), first fragment (1), last fragment (2), complete data (3), unchanged data (4))
+ * @param fragment_preference
+ * @param advertising_data_length (max 251)
+ * @param advertising_data
+ */
+const hci_cmd_t hci_le_set_extended_advertising_data = {
+OPCODE(OGF_LE_CONTROLLER, 0x37), "111JV"
+// return: status
+};
+
+/**
+ * @param advertising_handle
+ * @param operation (intermediate fragment (0), first fragment (1), last fragment (2), complete data (3))
+ * @param fragment_preference
+ * @param scan_response_data_length (max 251)
+ * @param scan_response_data
+ */
+const hci_cmd_t hci_le_set_extended_scan_response_data = {
+OPCODE(OGF_LE_CONTROLLER, 0x38), "111JV"
+// return: status
+};
+
+/**
+ * @param enable
+ * @param number_of_sets (only 1 supported)
+ * @param advertising_handle
+ * @param duration (unit: 10 msec, 0 = until disabled)
+ * @param max_extended_advertising_events (0 = no maximum)
+ */
+const hci_cmd_t hci_le_set_extended_advertising_enable = {
+OPCODE(OGF_LE_CONTROLLER, 0x39), "11121"
+// return: status
+};
+
+/**
+ */
+const hci_cmd_t hci_le_read_maximum_advertising_data_length = {
+OPCODE(OGF_LE_CONTROLLER, 0x3A), ""
+// return: status, max advertising data length
+};
+
+/**
+ */
+const hci_cmd_t hci_le_read_number_of_supported_advertising_sets = {
+OPCODE(OGF_LE_CONTROLLER, 0x3B), ""
+// return: status, number of supported advertising sets
+};
+
+/**
+ * @param advertising_handle
+ */
+const hci_cmd_t hci_le_remove_advertising_set = {
+OPCODE(OGF_LE_CONTROLLER, 0x3C), "1"
+// return: status
+};
+
+/**
+ * @param own_address_type
+ * @param scanning_filter_policy
+ * @param scanning_phys (LE 1M (1), LE Coded (4))
+ * @param scan_type array, one entry per PHY
+ * @param scan_interval array, one entry per PHY (unit: 0.625 msec)
+ * @param scan_window array, one entry per PHY (unit: 0.625 msec)
+ */
+const hci_cmd_t hci_le_set_extended_scan_parameters = {
+OPCODE(OGF_LE_CONTROLLER, 0x41), "111[122]"
+// return: status
+};
+
+/**
+ * @param enable
+ * @param filter_duplicates
+ * @param duration (unit: 10 msec, 0 = until disabled)
+ * @param period (unit: 1.28 sec, 0 = continuous)
+ */
+const hci_cmd_t hci_le_set_extended_scan_enable = {
+OPCODE(OGF_LE_CONTROLLER, 0x42), "1122"
+// return: status
+};
+
+/**
+ * @param initiator_filter_policy
+ * @param own_address_type
+ * @param peer_address_type
+ * @param peer_address
+ * @param initiating_phys (LE 1M (1), LE 2M (2), LE Coded (4))
+ * @param scan_interval array, one entry per PHY (unit: 0.625 msec)
+ * @param scan_window array, one entry per PHY (unit: 0.625 msec)
+ * @param conn_interval_min array, one entry per PHY (unit: 1.25 msec)
+ * @param conn_interval_max array, one entry per PHY (unit: 1.25 msec)
+ * @param conn_latency array, one entry per PHY
+ * @param supervision_timeout array, one entry per PHY (unit: 10 msec)
+ * @param minimum_CE_length array, one entry per PHY (unit: 0.625 msec)
+ * @param maximum_CE_length array, one entry per PHY (unit: 0.625 msec)
+ */
+const hci_cmd_t hci_le_extended_create_connection = {
+OPCODE(OGF_LE_CONTROLLER, 0x43), "111B1[22222222]"
+// return: none -> le enhanced connection complete or le connection complete event
+};
+
 
 #endif
 
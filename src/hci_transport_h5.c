@@ -49,6 +49,7 @@
 
 #include "hci.h"
 #include "btstack_slip.h"
+#include "btstack_crc.h"
 #include "btstack_debug.h"
 #include "hci_transport.h"
 #include "btstack_uart_block.h"
@@ -157,41 +158,11 @@ static void hci_transport_link_run(void);
 static void hci_transport_slip_init(void);
 
 // -----------------------------
-// CRC16-CCITT Calculation - compromise: use 32 byte table - 512 byte table would be faster, but that's too large
-
-static const uint16_t crc16_ccitt_table[] ={
-    0x0000, 0x1081, 0x2102, 0x3183,
-    0x4204, 0x5285, 0x6306, 0x7387,
-    0x8408, 0x9489, 0xa50a, 0xb58b,
-    0xc60c, 0xd68d, 0xe70e, 0xf78f
-};
-
-static uint16_t crc16_ccitt_update (uint16_t crc, uint8_t ch){
-    crc = (crc >> 4) ^ crc16_ccitt_table[(crc ^ ch) & 0x000f];
-    crc = (crc >> 4) ^ crc16_ccitt_table[(crc ^ (ch >> 4)) & 0x000f];
-    return crc;
-}
-
-static uint16_t btstack_reverse_bits_16(uint16_t value){
-    int reverse = 0;
-    int i;
-    for (i = 0; i < 16; i++) { 
-        reverse = reverse << 1;
-        reverse |= value & 1;
-        value = value >> 1;
-    }
-    return reverse;
-}
+// CRC16-CCITT Calculation
 
 static uint16_t crc16_calc_for_slip_frame(const uint8_t * header, const uint8_t * payload, uint16_t len){
-    int i;
-    uint16_t crc = 0xffff;
-    for (i=0 ; i < 4 ; i++){
-        crc = crc16_ccitt_update(crc, header[i]);
-    }
-    for (i=0 ; i < len ; i++){
-        crc = crc16_ccitt_update(crc, payload[i]);
-    }
+    uint16_t crc = btstack_crc16_ccitt_update(0xffff, header, 4);
+    crc = btstack_crc16_ccitt_update(crc, payload, len);
     return btstack_reverse_bits_16(crc);
 }
 
@@ -49,6 +49,7 @@
 #include "hci.h"
 #include "hci_dump.h"
 #include "bluetooth_sdp.h"
+#include "btstack_crc.h"
 #include "btstack_debug.h"
 #include "btstack_event.h"
 #include "btstack_memory.h"
@@ -64,9 +65,18 @@
 // used to cache l2cap rejects, echo, and informational requests
 #define NR_PENDING_SIGNALING_RESPONSES 3
 
-// nr of credits provided to remote if credits fall below watermark
-#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_WATERMARK 5
-#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INCREMENT 5
+// ERTM: lower bound for retransmission timeout derived from measured round-trip time
+#ifndef L2CAP_ERTM_RETRANSMISSION_TIMEOUT_MIN_MS
+#define L2CAP_ERTM_RETRANSMISSION_TIMEOUT_MIN_MS 200
+#endif
+
+// automatic credits: initial credit window, doubled each time the remote runs out of credits up to the max window
+#ifndef L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL
+#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL 10
+#endif
+#ifndef L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX
+#define L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX 80
+#endif
 
 // offsets for L2CAP SIGNALING COMMANDS
 #define L2CAP_SIGNALING_COMMAND_CODE_OFFSET   0
@@ -100,6 +110,8 @@ static void l2cap_emit_le_channel_opened(l2cap_channel_t *channel, uint8_t statu
 static void l2cap_emit_le_channel_closed(l2cap_channel_t * channel);
 static void l2cap_emit_le_incoming_connection(l2cap_channel_t *channel);
 static void l2cap_le_notify_channel_can_send(l2cap_channel_t *channel);
+static void l2cap_le_send_pdu(l2cap_channel_t *channel);
+static void l2cap_le_update_automatic_credits(l2cap_channel_t *channel);
 static void l2cap_le_finialize_channel_close(l2cap_channel_t *channel);
 static inline l2cap_service_t * l2cap_le_get_service(uint16_t psm);
 #endif
@@ -153,36 +165,6 @@ static uint16_t l2cap_le_custom_max_mtu;
 // enable for testing
 // #define L2CAP_ERTM_SIMULATE_FCS_ERROR_INTERVAL 16
 
-/*
- * CRC lookup table for generator polynom D^16 + D^15 + D^2 + 1
- */
-static const uint16_t crc16_table[256] = {
-    0x0000, 0xc0c1, 0xc181, 0x0140, 0xc301, 0x03c0, 0x0280, 0xc241, 0xc601, 0x06c0, 0x0780, 0xc741, 0x0500, 0xc5c1, 0xc481, 0x0440,
-    0xcc01, 0x0cc0, 0x0d80, 0xcd41, 0x0f00, 0xcfc1, 0xce81, 0x0e40, 0x0a00, 0xcac1, 0xcb81, 0x0b40, 0xc901, 0x09c0, 0x0880, 0xc841,
-    0xd801, 0x18c0, 0x1980, 0xd941, 0x1b00, 0xdbc1, 0xda81, 0x1a40, 0x1e00, 0xdec1, 0xdf81, 0x1f40, 0xdd01, 0x1dc0, 0x1c80, 0xdc41,
-    0x1400, 0xd4c1, 0xd581, 0x1540, 0xd701, 0x17c0, 0x1680, 0xd641, 0xd201, 0x12c0, 0x1380, 0xd341, 0x1100, 0xd1c1, 0xd081, 0x1040,
-    0xf001, 0x30c0, 0x3180, 0xf141, 0x3300, 0xf3c1, 0xf281, 0x3240, 0x3600, 0xf6c1, 0xf781, 0x3740, 0xf501, 0x35c0, 0x3480, 0xf441,
-    0x3c00, 0xfcc1, 0xfd81, 0x3d40, 0xff01, 0x3fc0, 0x3e80, 0xfe41, 0xfa01, 0x3ac0, 0x3b80, 0xfb41, 0x3900, 0xf9c1, 0xf881, 0x3840,
-    0x2800, 0xe8c1, 0xe981, 0x2940, 0xeb01, 0x2bc0, 0x2a80, 0xea41, 0xee01, 0x2ec0, 0x2f80, 0xef41, 0x2d00, 0xedc1, 0xec81, 0x2c40,
-    0xe401, 0x24c0, 0x2580, 0xe541, 0x2700, 0xe7c1, 0xe681, 0x2640, 0x2200, 0xe2c1, 0xe381, 0x2340, 0xe101, 0x21c0, 0x2080, 0xe041,
-    0xa001, 0x60c0, 0x6180, 0xa141, 0x6300, 0xa3c1, 0xa281, 0x6240, 0x6600, 0xa6c1, 0xa781, 0x6740, 0xa501, 0x65c0, 0x6480, 0xa441,
-    0x6c00, 0xacc1, 0xad81, 0x6d40, 0xaf01, 0x6fc0, 0x6e80, 0xae41, 0xaa01, 0x6ac0, 0x6b80, 0xab41, 0x6900, 0xa9c1, 0xa881, 0x6840,
-    0x7800, 0xb8c1, 0xb981, 0x7940, 0xbb01, 0x7bc0, 0x7a80, 0xba41, 0xbe01, 0x7ec0, 0x7f80, 0xbf41, 0x7d00, 0xbdc1, 0xbc81, 0x7c40,
-    0xb401, 0x74c0, 0x7580, 0xb541, 0x7700, 0xb7c1, 0xb681, 0x7640, 0x7200, 0xb2c1, 0xb381, 0x7340, 0xb101, 0x71c0, 0x7080, 0xb041,
-    0x5000, 0x90c1, 0x9181, 0x5140, 0x9301, 0x53c0, 0x5280, 0x9241, 0x9601, 0x56c0, 0x5780, 0x9741, 0x5500, 0x95c1, 0x9481, 0x5440,
-    0x9c01, 0x5cc0, 0x5d80, 0x9d41, 0x5f00, 0x9fc1, 0x9e81, 0x5e40, 0x5a00, 0x9ac1, 0x9b81, 0x5b40, 0x9901, 0x59c0, 0x5880, 0x9841,
-    0x8801, 0x48c0, 0x4980, 0x8941, 0x4b00, 0x8bc1, 0x8a81, 0x4a40, 0x4e00, 0x8ec1, 0x8f81, 0x4f40, 0x8d01, 0x4dc0, 0x4c80, 0x8c41,
-    0x4400, 0x84c1, 0x8581, 0x4540, 0x8701, 0x47c0, 0x4680, 0x8641, 0x8201, 0x42c0, 0x4380, 0x8341, 0x4100, 0x81c1, 0x8081, 0x4040, 
-};
-
-static uint16_t crc16_calc(uint8_t * data, uint16_t len){
-    uint16_t crc = 0;   // initial value = 0 
-    while (len--){
-        crc = (crc >> 8) ^ crc16_table[ (crc ^ ((uint16_t) *data++)) & 0x00FF ];
-    }
-    return crc;
-}
-
 static inline uint16_t l2cap_encanced_control_field_for_information_frame(uint8_t tx_seq, int final, uint8_t req_seq, l2cap_segmentation_and_reassembly_t sar){
     return (((uint16_t) sar) << 14) | (req_seq << 8) | (final << 7) | (tx_seq << 1) | 0; 
 }
@@ -191,8 +173,42 @@ static inline uint16_t l2cap_encanced_control_field_for_supevisor_frame(l2cap_su
     return (req_seq << 8) | (final << 7) | (poll << 4) | (((int) supervisory_function) << 2) | 1; 
 }
 
-static int l2cap_next_ertm_seq_nr(int seq_nr){
-    return (seq_nr + 1) & 0x3f;
+static inline uint32_t l2cap_extended_control_field_for_information_frame(uint16_t tx_seq, int final, uint16_t req_seq, l2cap_segmentation_and_reassembly_t sar){
+    return (((uint32_t) tx_seq) << 18) | (((uint32_t) sar) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 0;
+}
+
+static inline uint32_t l2cap_extended_control_field_for_supevisor_frame(l2cap_supervisory_function_t supervisory_function, int poll, int final, uint16_t req_seq){
+    return (((uint32_t) poll) << 18) | (((uint32_t) supervisory_function) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 1;
+}
+
+static uint16_t l2cap_ertm_control_field_size(l2cap_channel_t * channel){
+    return channel->extended_control ? 4 : 2;
+}
+
+static uint16_t l2cap_ertm_seq_nr_mask(l2cap_channel_t * channel){
+    return channel->extended_control ? 0x3fff : 0x3f;
+}
+
+static uint16_t l2cap_next_ertm_seq_nr(l2cap_channel_t * channel, uint16_t seq_nr){
+    return (seq_nr + 1) & l2cap_ertm_seq_nr_mask(channel);
+}
+
+// Extended Window Size option is used if our window doesn't fit into 6 bit and remote supports it
+static int l2cap_ertm_use_extended_window_size(l2cap_channel_t * channel){
+    if (channel->num_rx_buffers <= 0x3f) return 0;
+    hci_connection_t * connection = hci_connection_for_handle(channel->con_handle);
+    if (!connection) return 0;
+    return (connection->l2cap_state.extended_feature_mask & 0x0100) != 0;
+}
+
+// store control field at start of l2cap payload in outgoing buffer and return its size
+static uint16_t l2cap_ertm_store_control_field(l2cap_channel_t * channel, uint8_t * acl_buffer, uint32_t control){
+    if (channel->extended_control){
+        little_endian_store_32(acl_buffer, 8, control);
+        return 4;
+    }
+    little_endian_store_16(acl_buffer, 8, (uint16_t) control);
+    return 2;
 }
 
 static int l2cap_ertm_can_store_packet_now(l2cap_channel_t * channel){
@@ -242,7 +258,7 @@ static void l2cap_ertm_start_retransmission_timer(l2cap_channel_t * channel){
     btstack_run_loop_remove_timer(&channel->retransmission_timer);
     btstack_run_loop_set_timer_handler(&channel->retransmission_timer, &l2cap_ertm_retransmission_timeout_callback);
     btstack_run_loop_set_timer_context(&channel->retransmission_timer, channel);
-    btstack_run_loop_set_timer(&channel->retransmission_timer, channel->local_retransmission_timeout_ms);
+    btstack_run_loop_set_timer(&channel->retransmission_timer, channel->retransmission_timeout_ms);
     btstack_run_loop_add_timer(&channel->retransmission_timer);
 }
 
@@ -251,6 +267,26 @@ static void l2cap_ertm_stop_retransmission_timer(l2cap_channel_t * l2cap_channel
     btstack_run_loop_remove_timer(&l2cap_channel->retransmission_timer);
 }    
 
+// update retransmission timeout from round-trip time sample, see RFC 6298
+static void l2cap_ertm_update_retransmission_timeout(l2cap_channel_t * channel, uint32_t rtt_ms){
+    if (rtt_ms == 0){
+        rtt_ms = 1;
+    }
+    if (channel->srtt_ms == 0){
+        channel->srtt_ms   = rtt_ms;
+        channel->rttvar_ms = rtt_ms / 2;
+    } else {
+        uint32_t deviation = (channel->srtt_ms > rtt_ms) ? (channel->srtt_ms - rtt_ms) : (rtt_ms - channel->srtt_ms);
+        channel->rttvar_ms = (3 * channel->rttvar_ms + deviation) / 4;
+        channel->srtt_ms   = (7 * channel->srtt_ms + rtt_ms) / 8;
+    }
+    uint32_t timeout_ms = channel->srtt_ms + 4 * channel->rttvar_ms;
+    timeout_ms = btstack_max(timeout_ms, L2CAP_ERTM_RETRANSMISSION_TIMEOUT_MIN_MS);
+    timeout_ms = btstack_min(timeout_ms, channel->local_retransmission_timeout_ms);
+    channel->retransmission_timeout_ms = (uint16_t) timeout_ms;
+    log_debug("RTT %u ms, SRTT %u ms, RTTVAR %u ms -> retransmission timeout %u ms", rtt_ms, channel->srtt_ms, channel->rttvar_ms, timeout_ms);
+}
+
 static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts){
     log_info("Monitor timeout");
     l2cap_channel_t * l2cap_channel = (l2cap_channel_t *) btstack_run_loop_get_timer_context(ts);
@@ -264,9 +300,6 @@ static void l2cap_ertm_monitor_timeout_callback(btstack_timer_source_t * ts){
         // increment retry count
         tx_state->retry_count++;
 
-        // start retransmit
-        l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
-
         // start monitor timer
         l2cap_ertm_start_monitor_timer(l2cap_channel);
 
@@ -290,8 +323,10 @@ static void l2cap_ertm_retransmission_timeout_callback(btstack_timer_source_t *
     // set retry count = 1
     tx_state->retry_count = 1;
 
-    // start retransmit
-    l2cap_ertm_retransmit_unacknowleded_frames(l2cap_channel);
+    // back off until next round-trip time sample
+    l2cap_channel->retransmission_timeout_ms = btstack_min(l2cap_channel->retransmission_timeout_ms * 2, l2cap_channel->local_retransmission_timeout_ms);
+
+    // poll remote instead of resending all unacknowledged frames, response (RR/REJ/SREJ with F=1) triggers retransmission
 
     // start monitor timer
     l2cap_ertm_start_monitor_timer(l2cap_channel);
@@ -305,14 +340,25 @@ static int l2cap_ertm_send_information_frame(l2cap_channel_t * channel, int inde
     l2cap_ertm_tx_packet_state_t * tx_state = &channel->tx_packets_state[index];
     hci_reserve_packet_buffer();
     uint8_t *acl_buffer = hci_get_outgoing_packet_buffer();
-    uint16_t control = l2cap_encanced_control_field_for_information_frame(tx_state->tx_seq, final, channel->req_seq, tx_state->sar);
-    log_info("I-Frame: control 0x%04x", control);
-    little_endian_store_16(acl_buffer, 8, control);
-    memcpy(&acl_buffer[8+2], &channel->tx_packets_data[index * channel->local_mps], tx_state->len);
+    uint32_t control;
+    if (channel->extended_control){
+        control = l2cap_extended_control_field_for_information_frame(tx_state->tx_seq, final, channel->req_seq, tx_state->sar);
+    } else {
+        control = l2cap_encanced_control_field_for_information_frame(tx_state->tx_seq, final, channel->req_seq, tx_state->sar);
+    }
+    log_info("I-Frame: control 0x%04x", (unsigned int) control);
+    uint16_t control_size = l2cap_ertm_store_control_field(channel, acl_buffer, control);
+    memcpy(&acl_buffer[8+control_size], &channel->tx_packets_data[index * channel->local_mps], tx_state->len);
+    // track transmissions for round-trip time measurement
+    if (tx_state->num_transmissions < 255){
+        tx_state->num_transmissions++;
+    }
+    tx_state->sent_ms = btstack_run_loop_get_time_ms();
+    tx_state->sent_ms_valid = (tx_state->num_transmissions == 1) && (tx_state->sent_ms != 0);
     // (re-)start retransmission timer on 
     l2cap_ertm_start_retransmission_timer(channel);
     // send
-    return l2cap_send_prepared(channel->local_cid, 2 + tx_state->len);
+    return l2cap_send_prepared(channel->local_cid, control_size + tx_state->len);
 }
 
 static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentation_and_reassembly_t sar, uint16_t sdu_length, uint8_t * data, uint16_t len){
@@ -324,6 +370,9 @@ static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentat
     tx_state->len = len;
     tx_state->sar = sar;
     tx_state->retry_count = 0;
+    tx_state->retransmission_requested = 0;
+    tx_state->num_transmissions = 0;
+    tx_state->sent_ms_valid = 0;
 
     uint8_t * tx_packet = &channel->tx_packets_data[index * channel->local_mps];
     log_debug("index %u, mtu %u, packet tx %p", index, channel->local_mtu, tx_packet);
@@ -336,7 +385,7 @@ static void l2cap_ertm_store_fragment(l2cap_channel_t * channel, l2cap_segmentat
 
     // update
     channel->num_stored_tx_frames++;
-    channel->next_tx_seq = l2cap_next_ertm_seq_nr(channel->next_tx_seq);
+    channel->next_tx_seq = l2cap_next_ertm_seq_nr(channel, channel->next_tx_seq);
     l2cap_ertm_next_tx_write_index(channel);
 
     log_info("l2cap_ertm_store_fragment: tx_read_index %u, tx_write_index %u, num stored %u", channel->tx_read_index, channel->tx_write_index, channel->num_stored_tx_frames);
@@ -395,7 +444,7 @@ static uint16_t l2cap_setup_options_ertm_request(l2cap_channel_t * channel, uint
     config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_RETRANSMISSION_AND_FLOW_CONTROL;
     config_options[pos++] = 9;      // length
     config_options[pos++] = (uint8_t) channel->mode;
-    config_options[pos++] = channel->num_rx_buffers;    // == TxWindows size
+    config_options[pos++] = (uint8_t) btstack_min(channel->num_rx_buffers, 0x3f);    // == TxWindows size
     config_options[pos++] = channel->local_max_transmit;
     little_endian_store_16( config_options, pos, channel->local_retransmission_timeout_ms);
     pos += 2;
@@ -414,7 +463,16 @@ static uint16_t l2cap_setup_options_ertm_request(l2cap_channel_t * channel, uint
     config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_FRAME_CHECK_SEQUENCE;
     config_options[pos++] = 1;     // length
     config_options[pos++] = channel->fcs_option;
-    return pos; // 11+4+3=18
+
+    // Extended Window Size for windows larger than 63 frames, also selects Extended Control Field
+    if (l2cap_ertm_use_extended_window_size(channel)){
+        config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE;
+        config_options[pos++] = 2;     // length
+        little_endian_store_16(config_options, pos, channel->num_rx_buffers);
+        pos += 2;
+        channel->extended_control = 1;
+    }
+    return pos; // 11+4+3+4=22
 }
 
 static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uint8_t * config_options){
@@ -422,8 +480,8 @@ static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uin
     config_options[pos++] = L2CAP_CONFIG_OPTION_TYPE_RETRANSMISSION_AND_FLOW_CONTROL;
     config_options[pos++] = 9;      // length
     config_options[pos++] = (uint8_t) channel->mode;
-    // less or equal to remote tx window size
-    config_options[pos++] = btstack_min(channel->num_tx_buffers, channel->remote_tx_window_size);
+    // less or equal to remote tx window size, windows > 63 are sent via Extended Window Size option
+    config_options[pos++] = (uint8_t) btstack_min(btstack_min(channel->num_tx_buffers, channel->remote_tx_window_size), 0x3f);
     // max transmit in response shall be ignored -> use sender values
     config_options[pos++] = channel->remote_max_transmit;
     // A value for the Retransmission time-out shall be sent in a positive Configuration Response
@@ -451,12 +509,18 @@ static uint16_t l2cap_setup_options_ertm_response(l2cap_channel_t * channel, uin
     return pos; // 11+4=15
 }
 
-static int l2cap_ertm_send_supervisor_frame(l2cap_channel_t * channel, uint16_t control){
+static int l2cap_ertm_send_supervisor_frame(l2cap_channel_t * channel, l2cap_supervisory_function_t supervisory_function, int poll, int final, uint16_t req_seq){
+    uint32_t control;
+    if (channel->extended_control){
+        control = l2cap_extended_control_field_for_supevisor_frame(supervisory_function, poll, final, req_seq);
+    } else {
+        control = l2cap_encanced_control_field_for_supevisor_frame(supervisory_function, poll, final, (uint8_t) req_seq);
+    }
     hci_reserve_packet_buffer();
     uint8_t *acl_buffer = hci_get_outgoing_packet_buffer();
-    log_info("S-Frame: control 0x%04x", control);
-    little_endian_store_16(acl_buffer, 8, control);
-    return l2cap_send_prepared(channel->local_cid, 2);
+    log_info("S-Frame: control 0x%04x", (unsigned int) control);
+    uint16_t control_size = l2cap_ertm_store_control_field(channel, acl_buffer, control);
+    return l2cap_send_prepared(channel->local_cid, control_size);
 }
 
 static uint8_t l2cap_ertm_validate_local_config(l2cap_ertm_config_t * ertm_config){
@@ -482,6 +546,10 @@ static uint8_t l2cap_ertm_validate_local_config(l2cap_ertm_config_t * ertm_confi
         log_error("num_rx_buffers must be >= 1");
         result = ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
     }
+    if (ertm_config->num_rx_buffers > 0x3fff){
+        log_error("num_rx_buffers must be <= 0x3fff");
+        result = ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
+    }
     if (ertm_config->num_tx_buffers < 1){
         log_error("num_rx_buffers must be >= 1");
         result = ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS;
@@ -496,6 +564,10 @@ static void l2cap_ertm_configure_channel(l2cap_channel_t * channel, l2cap_ertm_c
     channel->local_max_transmit = ertm_config->max_transmit;
     channel->local_retransmission_timeout_ms = ertm_config->retransmission_timeout_ms;
     channel->local_monitor_timeout_ms = ertm_config->monitor_timeout_ms;
+    channel->retransmission_timeout_ms = ertm_config->retransmission_timeout_ms;
+    channel->srtt_ms = 0;
+    channel->rttvar_ms = 0;
+    channel->extended_control = 0;
     channel->local_mtu = ertm_config->local_mtu;
     channel->num_rx_buffers = ertm_config->num_rx_buffers;
     channel->num_tx_buffers = ertm_config->num_tx_buffers;
@@ -628,8 +700,9 @@ uint8_t l2cap_ertm_set_ready(uint16_t local_cid){
 }
 
 // Process-ReqSeq
-static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t req_seq){
+static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint16_t req_seq){
     int num_buffers_acked = 0;
+    uint32_t now_ms = btstack_run_loop_get_time_ms();
     l2cap_ertm_tx_packet_state_t * tx_state;
     log_info("l2cap_ertm_process_req_seq: tx_read_index %u, tx_write_index %u, req_seq %u", l2cap_channel->tx_read_index, l2cap_channel->tx_write_index, req_seq);
     while (1){
@@ -643,17 +716,22 @@ static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t
 
         tx_state = &l2cap_channel->tx_packets_state[l2cap_channel->tx_read_index];
         // calc delta
-        int delta = (req_seq - tx_state->tx_seq) & 0x03f;
+        int delta = (req_seq - tx_state->tx_seq) & l2cap_ertm_seq_nr_mask(l2cap_channel);
         if (delta == 0) break;  // all packets acknowledged
         if (delta > l2cap_channel->remote_tx_window_size) break;   
 
+        // measure round-trip time only for frames that have not been retransmitted (Karn's algorithm)
+        if (tx_state->sent_ms_valid){
+            l2cap_ertm_update_retransmission_timeout(l2cap_channel, now_ms - tx_state->sent_ms);
+        }
+
         num_buffers_acked++;
         l2cap_channel->num_stored_tx_frames--;
         l2cap_channel->unacked_frames--;
         log_info("RR seq %u => packet with tx_seq %u done", req_seq, tx_state->tx_seq);
 
         l2cap_channel->tx_read_index++;
-        if (l2cap_channel->tx_read_index >= l2cap_channel->num_rx_buffers){
+        if (l2cap_channel->tx_read_index >= l2cap_channel->num_tx_buffers){
             l2cap_channel->tx_read_index = 0;
         }
     }
@@ -663,24 +741,45 @@ static void l2cap_ertm_process_req_seq(l2cap_channel_t * l2cap_channel, uint8_t
 }     
 }     
 
-static l2cap_ertm_tx_packet_state_t * l2cap_ertm_get_tx_state(l2cap_channel_t * l2cap_channel, uint8_t tx_seq){
+// only stored frames are considered, acknowledged buffers may contain stale tx_seq
+static l2cap_ertm_tx_packet_state_t * l2cap_ertm_get_tx_state(l2cap_channel_t * l2cap_channel, uint16_t tx_seq){
     int i;
-    for (i=0;i<l2cap_channel->num_tx_buffers;i++){
-        l2cap_ertm_tx_packet_state_t * tx_state = &l2cap_channel->tx_packets_state[i];
+    int index = l2cap_channel->tx_read_index;
+    for (i=0;i<l2cap_channel->num_stored_tx_frames;i++){
+        l2cap_ertm_tx_packet_state_t * tx_state = &l2cap_channel->tx_packets_state[index];
         if (tx_state->tx_seq == tx_seq) return tx_state;
+        index++;
+        if (index >= l2cap_channel->num_tx_buffers){
+            index = 0;
+        }
     }
     return NULL;
 }
 
+// rx_store_index is the buffer for ExpectedTxSeq, later frames follow in ring buffer order
+// @param delta number of frames in the future, 1..num_rx_buffers-1
+static int l2cap_ertm_rx_index_for_delta(l2cap_channel_t * l2cap_channel, int delta){
+    int index = l2cap_channel->rx_store_index + delta;
+    if (index >= l2cap_channel->num_rx_buffers){
+        index -= l2cap_channel->num_rx_buffers;
+    }
+    return index;
+}
+
+// check if out-of-sequence frame with given tx_seq has been stored
+static int l2cap_ertm_rx_frame_stored(l2cap_channel_t * l2cap_channel, uint16_t tx_seq){
+    int delta = (tx_seq - l2cap_channel->expected_tx_seq) & l2cap_ertm_seq_nr_mask(l2cap_channel);
+    if (delta == 0) return 0;
+    if (delta >= l2cap_channel->num_rx_buffers) return 0;
+    return l2cap_channel->rx_packets_state[l2cap_ertm_rx_index_for_delta(l2cap_channel, delta)].valid;
+}
+
 // @param delta number of frames in the future, >= 1
 // @assumption size <= l2cap_channel->local_mps (checked in l2cap_acl_classic_handler)
 static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channel, l2cap_segmentation_and_reassembly_t sar, int delta, const uint8_t * payload, uint16_t size){
     log_info("Store SDU with delta %u", delta);
     // get rx state for packet to store
-    int index = l2cap_channel->rx_store_index + delta - 1;
-    if (index > l2cap_channel->num_rx_buffers){
-        index -= l2cap_channel->num_rx_buffers;
-    }
+    int index = l2cap_ertm_rx_index_for_delta(l2cap_channel, delta);
     log_info("Index of packet to store %u", index);
     l2cap_ertm_rx_packet_state_t * rx_state = &l2cap_channel->rx_packets_state[index];
     // check if buffer is free
@@ -688,10 +787,15 @@ static void l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel_t * l2cap_channe
         log_error("Packet buffer already used");
         return;
     }
+    // check if payload fits into buffer
+    if (size > l2cap_channel->local_mps){
+        log_error("Out-of-sequence frame larger than MPS");
+        return;
+    }
     rx_state->valid = 1;
     rx_state->sar = sar;
     rx_state->len = size;
-    uint8_t * rx_buffer = &l2cap_channel->rx_packets_data[index];
+    uint8_t * rx_buffer = &l2cap_channel->rx_packets_data[index * l2cap_channel->local_mps];
     memcpy(rx_buffer, payload, size);
 }
 
@@ -1183,7 +1287,7 @@ int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     if (fcs_size){
         // calculate FCS over l2cap data
-        uint16_t fcs = crc16_calc(acl_buffer + 4, 4 + len);
+        uint16_t fcs = btstack_crc16_l2cap_calc(acl_buffer + 4, 4 + len);
         log_info("I-Frame: fcs 0x%04x", fcs);
         little_endian_store_16(acl_buffer, 8 + len, fcs);
     }
@@ -1318,7 +1422,8 @@ static uint32_t l2cap_extended_features_mask(void){
     // extended features request supported, features: fixed channels, unicast connectionless data reception
     uint32_t features = 0x280;
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
-    features |= 0x0028;
+    // ERTM, FCS, Extended Window Size
+    features |= 0x0128;
 #endif
     return features;
 }
@@ -1327,6 +1432,11 @@ static uint32_t l2cap_extended_features_mask(void){
 // MARK: L2CAP_RUN
 // process outstanding signaling tasks
 static void l2cap_run(void){
+
+#ifdef ENABLE_HCI_PACKET_BATCHING
+    // executed at end of batch
+    if (hci_packet_batch_active()) return;
+#endif
     
     // log_info("l2cap_run: entered");
 
@@ -1429,7 +1539,7 @@ static void l2cap_run(void){
 
 #ifdef ENABLE_CLASSIC
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
-    uint8_t  config_options[18];
+    uint8_t  config_options[22];
 #else
     uint8_t  config_options[10];
 #endif
@@ -1587,41 +1697,53 @@ static void l2cap_run(void){
             if (channel->send_supervisor_frame_receiver_ready){
                 channel->send_supervisor_frame_receiver_ready = 0;
                 log_info("Send S-Frame: RR %u, final %u", channel->req_seq, channel->set_final_bit_after_packet_with_poll_bit_set);
-                uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 0,  channel->set_final_bit_after_packet_with_poll_bit_set, channel->req_seq);
+                int final = channel->set_final_bit_after_packet_with_poll_bit_set;
                 channel->set_final_bit_after_packet_with_poll_bit_set = 0;
-                l2cap_ertm_send_supervisor_frame(channel, control);
+                l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 0, final, channel->req_seq);
                 continue;
             }
             if (channel->send_supervisor_frame_receiver_ready_poll){
                 channel->send_supervisor_frame_receiver_ready_poll = 0;
                 log_info("Send S-Frame: RR %u with poll=1 ", channel->req_seq);
-                uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 1, 0, channel->req_seq);
-                l2cap_ertm_send_supervisor_frame(channel, control);
+                l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY, 1, 0, channel->req_seq);
                 continue;
             }
             if (channel->send_supervisor_frame_receiver_not_ready){
                 channel->send_supervisor_frame_receiver_not_ready = 0;
                 log_info("Send S-Frame: RNR %u", channel->req_seq);
-                uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY, 0, 0, channel->req_seq);
-                l2cap_ertm_send_supervisor_frame(channel, control);
+                l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_RNR_RECEIVER_NOT_READY, 0, 0, channel->req_seq);
                 continue;
             }
             if (channel->send_supervisor_frame_reject){
                 channel->send_supervisor_frame_reject = 0;
                 log_info("Send S-Frame: REJ %u", channel->req_seq);
-                uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT, 0, 0, channel->req_seq);
-                l2cap_ertm_send_supervisor_frame(channel, control);
+                l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT, 0, 0, channel->req_seq);
                 continue;
             }
             if (channel->send_supervisor_frame_selective_reject){
                 channel->send_supervisor_frame_selective_reject = 0;
                 log_info("Send S-Frame: SREJ %u", channel->expected_tx_seq);
-                uint16_t control = l2cap_encanced_control_field_for_supevisor_frame( L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT, 0, channel->set_final_bit_after_packet_with_poll_bit_set, channel->expected_tx_seq);
+                int final = channel->set_final_bit_after_packet_with_poll_bit_set;
                 channel->set_final_bit_after_packet_with_poll_bit_set = 0;
-                l2cap_ertm_send_supervisor_frame(channel, control);
+                l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT, 0, final, channel->expected_tx_seq);
                 continue;
             }
 
+            // request missing frames one by one, skip frames that have been stored meanwhile
+            if (channel->srej_recovery){
+                int srej_sent = 0;
+                while (channel->srej_next_tx_seq != channel->srej_end_tx_seq){
+                    uint16_t tx_seq = channel->srej_next_tx_seq;
+                    channel->srej_next_tx_seq = l2cap_next_ertm_seq_nr(channel, tx_seq);
+                    if (l2cap_ertm_rx_frame_stored(channel, tx_seq)) continue;
+                    log_info("Send S-Frame: SREJ %u", tx_seq);
+                    l2cap_ertm_send_supervisor_frame(channel, L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT, 0, 0, tx_seq);
+                    srej_sent = 1;
+                    break;
+                }
+                if (srej_sent) continue;
+            }
+
             if (channel->srej_active){
                 int i;
                 for (i=0;i<channel->num_tx_buffers;i++){
@@ -1651,10 +1773,6 @@ static void l2cap_run(void){
 #ifdef ENABLE_LE_DATA_CHANNELS
     btstack_linked_list_iterator_init(&it, &l2cap_channels);
     while (btstack_linked_list_iterator_has_next(&it)){
-        uint8_t  * acl_buffer;
-        uint8_t  * l2cap_payload;
-        uint16_t pos;
-        uint16_t payload_size;
         uint16_t mps;
         l2cap_channel_t * channel = (l2cap_channel_t *) btstack_linked_list_iterator_next(&it);
 
@@ -1706,39 +1824,11 @@ static void l2cap_run(void){
                     break;
                 }
 
-                // send data
-                if (!channel->send_sdu_buffer) break;
-                if (!channel->credits_outgoing) break;
-
-                // send part of SDU
-                hci_reserve_packet_buffer();
-                acl_buffer = hci_get_outgoing_packet_buffer();
-                l2cap_payload = acl_buffer + 8;
-                pos = 0;
-                if (!channel->send_sdu_pos){
-                    // store SDU len
-                    channel->send_sdu_pos += 2;
-                    little_endian_store_16(l2cap_payload, pos, channel->send_sdu_len);
-                    pos += 2;
+                // send data: pipeline PDUs of queued SDUs as long as credits and ACL buffers are available
+                while (channel->send_sdu_buffer && channel->credits_outgoing && hci_can_send_acl_packet_now(channel->con_handle)){
+                    l2cap_le_send_pdu(channel);
+                    if (channel->state != L2CAP_STATE_OPEN) break;
                 }
-                payload_size = btstack_min(channel->send_sdu_len + 2 - channel->send_sdu_pos, channel->remote_mps - pos);
-                log_info("len %u, pos %u => payload %u, credits %u", channel->send_sdu_len, channel->send_sdu_pos, payload_size, channel->credits_outgoing);
-                memcpy(&l2cap_payload[pos], &channel->send_sdu_buffer[channel->send_sdu_pos-2], payload_size); // -2 for virtual SDU len
-                pos += payload_size;
-                channel->send_sdu_pos += payload_size;
-                l2cap_setup_header(acl_buffer, channel->con_handle, 0, channel->remote_cid, pos);
-                // done
-
-                channel->credits_outgoing--;
-
-                if (channel->send_sdu_pos >= channel->send_sdu_len + 2){
-                    channel->send_sdu_buffer = NULL;
-                    // send done event
-                    l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_LE_PACKET_SENT);
-                    // inform about can send now
-                    l2cap_le_notify_channel_can_send(channel);
-                }
-                hci_send_acl_packet_buffer(8 + pos);
                 break;
             case L2CAP_STATE_WILL_SEND_DISCONNECT_REQUEST:
                 if (!hci_can_send_acl_packet_now(channel->con_handle)) break;
@@ -1767,7 +1857,7 @@ static void l2cap_run(void){
         if (!hci_can_send_acl_packet_now(connection->con_handle)) continue;
         switch (connection->le_con_parameter_update_state){
             case CON_PARAMETER_UPDATE_SEND_REQUEST:
-                connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
+                connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_W4_RESPONSE;
                 l2cap_send_le_signaling_packet(connection->con_handle, CONNECTION_PARAMETER_UPDATE_REQUEST, l2cap_next_sig_id(),
                                                connection->le_conn_interval_min, connection->le_conn_interval_max, connection->le_conn_latency, connection->le_supervision_timeout);
                 break;
@@ -2114,6 +2204,14 @@ static void l2cap_hci_event_handler(uint8_t packet_type, uint16_t cid, uint8_t *
             l2cap_notify_channel_can_send();
             break;
 
+#ifdef ENABLE_HCI_PACKET_BATCHING
+        case HCI_EVENT_TRANSPORT_PACKET_BATCH:
+            if (hci_event_transport_packet_batch_get_active(packet)) break;
+            l2cap_run();    // try sending signaling packets first
+            l2cap_notify_channel_can_send();
+            break;
+#endif
+
         case HCI_EVENT_COMMAND_STATUS:
 #ifdef ENABLE_CLASSIC
             // check command status for create connection for errors
@@ -2377,6 +2475,7 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
 
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
     uint8_t use_fcs = 1;
+    uint16_t extended_window_size = 0;
 #endif
 
     channel->remote_sig_id = command[L2CAP_SIGNALING_COMMAND_SIGID_OFFSET];
@@ -2458,7 +2557,11 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
         }
         if (option_type == L2CAP_CONFIG_OPTION_TYPE_FRAME_CHECK_SEQUENCE && length == 1){
             use_fcs = command[pos];
-        }        
+        }
+        // Extended Window Size { type(8): 7, len(8): 2, Max Window Size(16) }
+        if (option_type == L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE && length == 2){
+            extended_window_size = little_endian_read_16(command, pos) & 0x3fff;
+        }
 #endif        
         // check for unknown options
         if (option_hint == 0 && (option_type < L2CAP_CONFIG_OPTION_TYPE_MAX_TRANSMISSION_UNIT || option_type > L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE)){
@@ -2473,6 +2576,13 @@ static void l2cap_signaling_handle_configure_request(l2cap_channel_t *channel, u
         uint8_t update = channel->fcs_option || use_fcs;
         log_info("local fcs: %u, remote fcs: %u -> %u", channel->fcs_option, use_fcs, update);
         channel->fcs_option = update;
+
+        // Extended Window Size replaces TxWindow of Retransmission and Flow Control option and requires Extended Control Field
+        if (extended_window_size && channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
+            log_info("Extended Window Size %u", extended_window_size);
+            channel->remote_tx_window_size = extended_window_size;
+            channel->extended_control = 1;
+        }
 #endif
 }
 
@@ -2899,6 +3009,10 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
             // check size
             if (len < 2) return 0;
             result = little_endian_read_16(command, 4);
+            connection = hci_connection_for_handle(handle);
+            if (connection && (connection->le_con_parameter_update_state == CON_PARAMETER_UPDATE_W4_RESPONSE)){
+                connection->le_con_parameter_update_state = CON_PARAMETER_UPDATE_NONE;
+            }
             l2cap_emit_connection_parameter_update_response(handle, result);
             break;
 
@@ -3014,7 +3128,7 @@ static int l2cap_le_signaling_handler_dispatch(hci_con_handle_t handle, uint8_t
 
                 // set initial state
                 channel->state      = L2CAP_STATE_WAIT_CLIENT_ACCEPT_OR_REJECT;
-                channel->state_var |= L2CAP_CHANNEL_STATE_VAR_INCOMING;
+                channel->state_var  = (L2CAP_CHANNEL_STATE_VAR) (channel->state_var | L2CAP_CHANNEL_STATE_VAR_INCOMING);
 
                 // add to connections list
                 btstack_linked_list_add(&l2cap_channels, (btstack_linked_item_t *) channel);
@@ -3159,13 +3273,14 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
                 if (l2cap_channel->mode == L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION){
 
                     int fcs_size = l2cap_channel->fcs_option ? 2 : 0;
+                    int control_size = l2cap_ertm_control_field_size(l2cap_channel);
 
                     // assert control + FCS fields are inside
-                    if (size < COMPLETE_L2CAP_HEADER+2+fcs_size) break;
+                    if (size < COMPLETE_L2CAP_HEADER+control_size+fcs_size) break;
 
                     if (l2cap_channel->fcs_option){
                         // verify FCS (required if one side requested it)
-                        uint16_t fcs_calculated = crc16_calc(&packet[4], size - (4+2));
+                        uint16_t fcs_calculated = btstack_crc16_l2cap_calc(&packet[4], size - (4+2));
                         uint16_t fcs_packet     = little_endian_read_16(packet, size-2);
 
 #ifdef L2CAP_ERTM_SIMULATE_FCS_ERROR_INTERVAL
@@ -3187,15 +3302,34 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
                         }
                     }
 
+                    // parse Enhanced or Extended Control Field
+                    uint32_t control;
+                    uint16_t req_seq;
+                    uint16_t tx_seq;
+                    int final;
+                    int poll;
+                    int sar_or_s;
+                    if (l2cap_channel->extended_control){
+                        control  = little_endian_read_32(packet, COMPLETE_L2CAP_HEADER);
+                        req_seq  = (control >> 2) & 0x3fff;
+                        final    = (control >> 1) & 0x01;
+                        sar_or_s = (control >> 16) & 0x03;
+                        poll     = (control >> 18) & 0x01;
+                        tx_seq   = (control >> 18) & 0x3fff;
+                    } else {
+                        control  = little_endian_read_16(packet, COMPLETE_L2CAP_HEADER);
+                        req_seq  = (control >> 8) & 0x3f;
+                        final    = (control >> 7) & 0x01;
+                        sar_or_s = (control & 1) ? ((control >> 2) & 0x03) : (control >> 14);
+                        poll     = (control >> 4) & 0x01;
+                        tx_seq   = (control >> 1) & 0x3f;
+                    }
+
                     // switch on packet type
-                    uint16_t control = little_endian_read_16(packet, COMPLETE_L2CAP_HEADER);
-                    uint8_t  req_seq = (control >> 8) & 0x3f;
-                    int final = (control >> 7) & 0x01;
                     if (control & 1){
                         // S-Frame
-                        int poll  = (control >> 4) & 0x01;
-                        l2cap_supervisory_function_t s = (l2cap_supervisory_function_t) ((control >> 2) & 0x03);
-                        log_info("Control: 0x%04x => Supervisory function %u, ReqSeq %02u", control, (int) s, req_seq);
+                        l2cap_supervisory_function_t s = (l2cap_supervisory_function_t) sar_or_s;
+                        log_info("Control: 0x%04x => Supervisory function %u, ReqSeq %02u", (unsigned int) control, (int) s, req_seq);
                         l2cap_ertm_tx_packet_state_t * tx_state;
                         switch (s){
                             case L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY:
@@ -3267,9 +3401,8 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
                     } else {
                         // I-Frame
                         // get control
-                        l2cap_segmentation_and_reassembly_t sar = (l2cap_segmentation_and_reassembly_t) (control >> 14);
-                        uint8_t tx_seq = (control >> 1) & 0x3f;
-                        log_info("Control: 0x%04x => SAR %u, ReqSeq %02u, R?, TxSeq %02u", control, (int) sar, req_seq, tx_seq);
+                        l2cap_segmentation_and_reassembly_t sar = (l2cap_segmentation_and_reassembly_t) sar_or_s;
+                        log_info("Control: 0x%04x => SAR %u, ReqSeq %02u, R?, TxSeq %02u", (unsigned int) control, (int) sar, req_seq, tx_seq);
                         log_info("SAR: pos %u", l2cap_channel->reassembly_pos);
                         log_info("State: expected_tx_seq %02u, req_seq %02u", l2cap_channel->expected_tx_seq, l2cap_channel->req_seq);
                         l2cap_ertm_process_req_seq(l2cap_channel, req_seq);
@@ -3279,8 +3412,8 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
                         }
 
                         // get SDU
-                        const uint8_t * payload_data = &packet[COMPLETE_L2CAP_HEADER+2];
-                        uint16_t        payload_len  = size-(COMPLETE_L2CAP_HEADER+2+fcs_size);
+                        const uint8_t * payload_data = &packet[COMPLETE_L2CAP_HEADER+control_size];
+                        uint16_t        payload_len  = size-(COMPLETE_L2CAP_HEADER+control_size+fcs_size);
 
                         // assert SDU size is smaller or equal to our buffers
                         uint16_t max_payload_size = 0;
@@ -3303,7 +3436,7 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
                         // check ordering
                         if (l2cap_channel->expected_tx_seq == tx_seq){
                             log_info("Received expected frame with TxSeq == ExpectedTxSeq == %02u", tx_seq);
-                            l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel->expected_tx_seq);
+                            l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, l2cap_channel->expected_tx_seq);
                             l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
  
                             // process SDU
@@ -3311,36 +3444,59 @@ static void l2cap_acl_classic_handler(hci_con_handle_t handle, uint8_t *packet,
 
                             // process stored segments
                             while (1){
-                                int index = l2cap_channel->rx_store_index;
+                                // advance rx store index to buffer for new ExpectedTxSeq
+                                int index = l2cap_channel->rx_store_index + 1;
+                                if (index >= l2cap_channel->num_rx_buffers){
+                                    index = 0;
+                                }
+                                l2cap_channel->rx_store_index = index;
+
                                 l2cap_ertm_rx_packet_state_t * rx_state = &l2cap_channel->rx_packets_state[index];
                                 if (!rx_state->valid) break;
 
                                 log_info("Processing stored frame with TxSeq == ExpectedTxSeq == %02u", l2cap_channel->expected_tx_seq);
-                                l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel->expected_tx_seq);
+                                l2cap_channel->expected_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, l2cap_channel->expected_tx_seq);
                                 l2cap_channel->req_seq         = l2cap_channel->expected_tx_seq;
 
                                 rx_state->valid = 0;
-                                l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, &l2cap_channel->rx_packets_data[index], rx_state->len);
+                                l2cap_ertm_handle_in_sequence_sdu(l2cap_channel, rx_state->sar, &l2cap_channel->rx_packets_data[index * l2cap_channel->local_mps], rx_state->len);
+                            }
 
-                                // update rx store index
-                                index++;
-                                if (index >= l2cap_channel->num_rx_buffers){
-                                    index = 0;
+                            // selective reject recovery
+                            if (l2cap_channel->srej_recovery){
+                                uint16_t mask = l2cap_ertm_seq_nr_mask(l2cap_channel);
+                                uint16_t end_delta = (l2cap_channel->srej_end_tx_seq - l2cap_channel->expected_tx_seq) & mask;
+                                if (end_delta == 0){
+                                    // all frames up to highest received one delivered
+                                    l2cap_channel->srej_recovery = 0;
+                                } else if (((l2cap_channel->srej_next_tx_seq - l2cap_channel->expected_tx_seq) & mask) > end_delta){
+                                    // frames arrived before they were requested
+                                    l2cap_channel->srej_next_tx_seq = l2cap_channel->expected_tx_seq;
                                 }
-                                l2cap_channel->rx_store_index = index;
                             }
 
                             //
                             l2cap_channel->send_supervisor_frame_receiver_ready = 1;
 
                         } else {
-                            int delta = (tx_seq - l2cap_channel->expected_tx_seq) & 0x3f;
-                            if (delta < 2){
+                            uint16_t mask = l2cap_ertm_seq_nr_mask(l2cap_channel);
+                            int delta = (tx_seq - l2cap_channel->expected_tx_seq) & mask;
+                            if (delta < l2cap_channel->num_rx_buffers){
                                 // store segment
                                 l2cap_ertm_handle_out_of_sequence_sdu(l2cap_channel, sar, delta, payload_data, payload_len);
 
+                                // request all missing frames up to this one via SREJ
+                                uint16_t next_tx_seq = l2cap_next_ertm_seq_nr(l2cap_channel, tx_seq);
+                                if (!l2cap_channel->srej_recovery){
+                                    l2cap_channel->srej_recovery    = 1;
+                                    l2cap_channel->srej_next_tx_seq = l2cap_channel->expected_tx_seq;
+                                    l2cap_channel->srej_end_tx_seq  = next_tx_seq;
+                                } else if (delta >= ((l2cap_channel->srej_end_tx_seq - l2cap_channel->expected_tx_seq) & mask)){
+                                    l2cap_channel->srej_end_tx_seq  = next_tx_seq;
+                                }
                                 log_info("Received unexpected frame TxSeq %u but expected %u -> send S-SREJ", tx_seq, l2cap_channel->expected_tx_seq);
-                                l2cap_channel->send_supervisor_frame_selective_reject = 1;
+                            } else if (((l2cap_channel->expected_tx_seq - tx_seq) & mask) <= l2cap_channel->num_rx_buffers){
+                                log_info("Received duplicate frame TxSeq %u, expected %u -> ignore", tx_seq, l2cap_channel->expected_tx_seq);
                             } else {
                                 log_info("Received unexpected frame TxSeq %u but expected %u -> send S-REJ", tx_seq, l2cap_channel->expected_tx_seq);
                                 l2cap_channel->send_supervisor_frame_reject = 1;
@@ -3411,9 +3567,7 @@ static void l2cap_acl_le_handler(hci_con_handle_t handle, uint8_t *packet, uint1
                 l2cap_channel->credits_incoming--;
 
                 // automatic credits
-                if (l2cap_channel->credits_incoming < L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_WATERMARK && l2cap_channel->automatic_credits){
-                    l2cap_channel->new_credits_incoming = L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INCREMENT;
-                }
+                l2cap_le_update_automatic_credits(l2cap_channel);
 
                 // first fragment
                 uint16_t pos = 0;
@@ -3560,9 +3714,97 @@ uint8_t l2cap_unregister_service(uint16_t psm){
 
 #ifdef ENABLE_LE_DATA_CHANNELS
 
+static int l2cap_le_send_queue_free(l2cap_channel_t *channel){
+    if (!channel->send_sdu_buffer) return L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 1;
+    return L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE - channel->send_sdu_queue_count;
+}
+
+static void l2cap_le_send_queue_add(l2cap_channel_t *channel, uint8_t * data, uint16_t len){
+    if (!channel->send_sdu_buffer){
+        channel->send_sdu_buffer = data;
+        channel->send_sdu_len    = len;
+        channel->send_sdu_pos    = 0;
+        return;
+    }
+    int index = (channel->send_sdu_queue_head + channel->send_sdu_queue_count) % L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE;
+    channel->send_sdu_queue[index].data = data;
+    channel->send_sdu_queue[index].len  = len;
+    channel->send_sdu_queue_count++;
+}
+
+static void l2cap_le_send_queue_next(l2cap_channel_t *channel){
+    if (!channel->send_sdu_queue_count){
+        channel->send_sdu_buffer = NULL;
+        return;
+    }
+    l2cap_le_sdu_t * sdu = &channel->send_sdu_queue[channel->send_sdu_queue_head];
+    channel->send_sdu_buffer = sdu->data;
+    channel->send_sdu_len    = sdu->len;
+    channel->send_sdu_pos    = 0;
+    channel->send_sdu_queue_head = (channel->send_sdu_queue_head + 1) % L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE;
+    channel->send_sdu_queue_count--;
+}
+
+// send next PDU of current SDU, requires send_sdu_buffer, outgoing credits and hci_can_send_acl_packet_now
+static void l2cap_le_send_pdu(l2cap_channel_t *channel){
+    hci_reserve_packet_buffer();
+    uint8_t * acl_buffer = hci_get_outgoing_packet_buffer();
+    uint8_t * l2cap_payload = acl_buffer + 8;
+    uint16_t pos = 0;
+    if (!channel->send_sdu_pos){
+        // store SDU len
+        channel->send_sdu_pos += 2;
+        little_endian_store_16(l2cap_payload, pos, channel->send_sdu_len);
+        pos += 2;
+    }
+    uint16_t payload_size = btstack_min(channel->send_sdu_len + 2 - channel->send_sdu_pos, channel->remote_mps - pos);
+    log_info("len %u, pos %u => payload %u, credits %u", channel->send_sdu_len, channel->send_sdu_pos, payload_size, channel->credits_outgoing);
+    memcpy(&l2cap_payload[pos], &channel->send_sdu_buffer[channel->send_sdu_pos-2], payload_size); // -2 for virtual SDU len
+    pos += payload_size;
+    channel->send_sdu_pos += payload_size;
+    l2cap_setup_header(acl_buffer, channel->con_handle, 0, channel->remote_cid, pos);
+
+    channel->credits_outgoing--;
+
+    if (channel->send_sdu_pos >= channel->send_sdu_len + 2){
+        // start next queued SDU
+        l2cap_le_send_queue_next(channel);
+        // send done event
+        l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_LE_PACKET_SENT);
+        // inform about can send now
+        l2cap_le_notify_channel_can_send(channel);
+    }
+    hci_send_acl_packet_buffer(8 + pos);
+}
+
+static void l2cap_le_setup_initial_credits(l2cap_channel_t *channel, uint16_t initial_credits){
+    if (initial_credits == L2CAP_LE_AUTOMATIC_CREDITS){
+        channel->automatic_credits        = L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX;
+        channel->automatic_credits_window = btstack_min(L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL, L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX);
+        channel->new_credits_incoming     = channel->automatic_credits_window;
+    } else {
+        channel->automatic_credits        = 0;
+        channel->new_credits_incoming     = initial_credits;
+    }
+}
+
+// called after credit for incoming PDU was consumed
+static void l2cap_le_update_automatic_credits(l2cap_channel_t *channel){
+    if (!channel->automatic_credits) return;
+    uint16_t outstanding = channel->credits_incoming + channel->new_credits_incoming;
+    // remote used all credits before our pending batch was sent: it's faster than our batches, grow window
+    if (channel->credits_incoming == 0 && channel->automatic_credits_window < channel->automatic_credits){
+        channel->automatic_credits_window = btstack_min(channel->automatic_credits_window * 2, channel->automatic_credits);
+        log_info("l2cap: cid 0x%02x remote out of credits, window %u", channel->local_cid, channel->automatic_credits_window);
+    }
+    // return credits in a single batch once half of the window is used
+    if (outstanding > channel->automatic_credits_window / 2) return;
+    channel->new_credits_incoming += channel->automatic_credits_window - outstanding;
+}
+
 static void l2cap_le_notify_channel_can_send(l2cap_channel_t *channel){
     if (!channel->waiting_for_can_send_now) return;
-    if (channel->send_sdu_buffer) return;
+    if (l2cap_le_send_queue_free(channel) == 0) return;
     channel->waiting_for_can_send_now = 0;
     log_debug("L2CAP_EVENT_CHANNEL_LE_CAN_SEND_NOW local_cid 0x%x", channel->local_cid);
     l2cap_emit_simple_event_with_cid(channel, L2CAP_EVENT_LE_CAN_SEND_NOW);
@@ -3684,8 +3926,7 @@ uint8_t l2cap_le_accept_connection(uint16_t local_cid, uint8_t * receive_sdu_buf
     channel->state = L2CAP_STATE_WILL_SEND_LE_CONNECTION_RESPONSE_ACCEPT;
     channel->receive_sdu_buffer = receive_sdu_buffer;
     channel->local_mtu = mtu;
-    channel->new_credits_incoming = initial_credits;
-    channel->automatic_credits  = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
+    l2cap_le_setup_initial_credits(channel, initial_credits);
 
     // test
     // channel->new_credits_incoming = 1;
@@ -3745,8 +3986,7 @@ uint8_t l2cap_le_create_channel(btstack_packet_handler_t packet_handler, hci_con
     channel->con_handle = con_handle;
     channel->receive_sdu_buffer = receive_sdu_buffer;
     channel->state = L2CAP_STATE_WILL_SEND_LE_CONNECTION_REQUEST;
-    channel->new_credits_incoming = initial_credits;
-    channel->automatic_credits    = initial_credits == L2CAP_LE_AUTOMATIC_CREDITS;
+    l2cap_le_setup_initial_credits(channel, initial_credits);
 
     // add to connections list
     btstack_linked_list_add(&l2cap_channels, (btstack_linked_item_t *) channel);
@@ -3791,6 +4031,44 @@ uint8_t l2cap_le_provide_credits(uint16_t local_cid, uint16_t credits){
     return 0;
 }
 
+/**
+ * @brief Enable or disable automatic credits for LE Data Channel
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param max_credits           Max number of outstanding credits, 0 to disable automatic credits
+ */
+uint8_t l2cap_le_set_automatic_credits(uint16_t local_cid, uint16_t max_credits){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_le_set_automatic_credits no channel for cid 0x%02x", local_cid);
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+    if (max_credits == L2CAP_LE_AUTOMATIC_CREDITS){
+        max_credits = L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX;
+    }
+    channel->automatic_credits = max_credits;
+    if (!max_credits) return 0;
+
+    // start with current number of outstanding credits
+    uint16_t outstanding = channel->credits_incoming + channel->new_credits_incoming;
+    channel->automatic_credits_window = btstack_max(btstack_min(outstanding, max_credits), btstack_min(L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL, max_credits));
+    l2cap_le_update_automatic_credits(channel);
+    l2cap_run();
+    return 0;
+}
+
+/**
+ * @brief Get number of credits remote can use to send data, including credits not sent yet
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ */
+uint16_t l2cap_le_get_incoming_credits(uint16_t local_cid){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_le_get_incoming_credits no channel for cid 0x%02x", local_cid);
+        return 0;
+    }
+    return channel->credits_incoming + channel->new_credits_incoming;
+}
+
 /**
  * @brief Check if outgoing buffer is available and that there's space on the Bluetooth module
  * @param local_cid             L2CAP LE Data Channel Identifier
@@ -3806,12 +4084,26 @@ int l2cap_le_can_send_now(uint16_t local_cid){
     if (channel->state != L2CAP_STATE_OPEN) return 0;
 
     // check queue
-    if (channel->send_sdu_buffer) return 0;    
+    if (l2cap_le_send_queue_free(channel) == 0) return 0;
 
     // fine, go ahead
     return 1;
 }
 
+/**
+ * @brief Get number of SDUs that can be passed to l2cap_le_send_data / l2cap_le_send_data_multiple
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ */
+uint16_t l2cap_le_send_queue_num_free(uint16_t local_cid){
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_le_send_queue_num_free no channel for cid 0x%02x", local_cid);
+        return 0;
+    }
+    if (channel->state != L2CAP_STATE_OPEN) return 0;
+    return l2cap_le_send_queue_free(channel);
+}
+
 /**
  * @brief Request emission of L2CAP_EVENT_CAN_SEND_NOW as soon as possible
  * @note L2CAP_EVENT_CAN_SEND_NOW might be emitted during call to this function
@@ -3831,7 +4123,7 @@ uint8_t l2cap_le_request_can_send_now_event(uint16_t local_cid){
 
 /**
  * @brief Send data via LE Data Channel
- * @note Since data larger then the maximum PDU needs to be segmented into multiple PDUs, data needs to stay valid until ... event
+ * @note Since data larger then the maximum PDU needs to be segmented into multiple PDUs, data needs to stay valid until L2CAP_EVENT_LE_PACKET_SENT
  * @param local_cid             L2CAP LE Data Channel Identifier
  * @param data                  data to send
  * @param size                  data size
@@ -3849,14 +4141,47 @@ uint8_t l2cap_le_send_data(uint16_t local_cid, uint8_t * data, uint16_t len){
         return L2CAP_DATA_LEN_EXCEEDS_REMOTE_MTU;
     }
 
-    if (channel->send_sdu_buffer){
+    if (l2cap_le_send_queue_free(channel) == 0){
         log_info("l2cap_send cid 0x%02x, cannot send", local_cid);
         return BTSTACK_ACL_BUFFERS_FULL;
     }
 
-    channel->send_sdu_buffer = data;
-    channel->send_sdu_len    = len;
-    channel->send_sdu_pos    = 0;
+    l2cap_le_send_queue_add(channel, data, len);
+
+    l2cap_run();
+    return 0;
+}
+
+/**
+ * @brief Send several SDUs via LE Data Channel
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param sdus                  array of SDUs
+ * @param num_sdus              number of SDUs
+ */
+uint8_t l2cap_le_send_data_multiple(uint16_t local_cid, const l2cap_le_sdu_t * sdus, uint16_t num_sdus){
+
+    l2cap_channel_t * channel = l2cap_get_channel_for_local_cid(local_cid);
+    if (!channel) {
+        log_error("l2cap_send no channel for cid 0x%02x", local_cid);
+        return L2CAP_LOCAL_CID_DOES_NOT_EXIST;
+    }
+
+    uint16_t i;
+    for (i=0;i<num_sdus;i++){
+        if (sdus[i].len > channel->remote_mtu){
+            log_error("l2cap_send cid 0x%02x, data length exceeds remote MTU.", local_cid);
+            return L2CAP_DATA_LEN_EXCEEDS_REMOTE_MTU;
+        }
+    }
+
+    if (l2cap_le_send_queue_free(channel) < num_sdus){
+        log_info("l2cap_send cid 0x%02x, cannot queue %u SDUs", local_cid, num_sdus);
+        return BTSTACK_ACL_BUFFERS_FULL;
+    }
+
+    for (i=0;i<num_sdus;i++){
+        l2cap_le_send_queue_add(channel, sdus[i].data, sdus[i].len);
+    }
 
     l2cap_run();
     return 0;
@@ -69,6 +69,11 @@ extern "C" {
 
 #define L2CAP_LE_AUTOMATIC_CREDITS 0xffff
 
+// nr of outgoing SDUs that can be queued per LE Data Channel in addition to the one being sent
+#ifndef L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE
+#define L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE 4
+#endif
+
 // private structs
 typedef enum {
     L2CAP_STATE_CLOSED = 1,           // no baseband
@@ -123,6 +128,12 @@ typedef enum {
     L2CAP_CHANNEL_TYPE_LE_FIXED,        // LE ATT + SM
 } l2cap_channel_type_t;
 
+// outgoing SDU on LE Data Channel
+typedef struct {
+    uint8_t * data;
+    uint16_t  len;
+} l2cap_le_sdu_t;
+
 typedef struct {
     l2cap_segmentation_and_reassembly_t sar;
     uint16_t len;
@@ -132,9 +143,15 @@ typedef struct {
 typedef struct {
     l2cap_segmentation_and_reassembly_t sar;
     uint16_t len;
-    uint8_t tx_seq;
+    uint16_t tx_seq;
     uint8_t retry_count;
     uint8_t retransmission_requested;
+    // nr of transmissions, RTT is only measured for frames sent once
+    uint8_t num_transmissions;
+    // time of last transmission
+    uint32_t sent_ms;
+    // sent_ms is a usable RTT sample: frame sent once and run loop provides time
+    uint8_t sent_ms_valid;
 } l2cap_ertm_tx_packet_state_t;
 
 typedef struct {
@@ -154,10 +171,11 @@ typedef struct {
     uint16_t local_mtu;
 
     // Number of buffers for outgoing data
-    uint8_t num_tx_buffers;
+    uint16_t num_tx_buffers;
 
     // Number of packets that can be received out of order (-> our tx_window size)
-    uint8_t num_rx_buffers;
+    // Values > 63 use the Extended Window Size option if supported by remote (max 0x3fff)
+    uint16_t num_rx_buffers;
 
     // Frame Check Sequence (FCS) Option
     uint8_t fcs_option;
@@ -245,6 +263,13 @@ typedef struct {
     uint16_t   send_sdu_len;
     uint16_t   send_sdu_pos;
 
+#ifdef ENABLE_LE_DATA_CHANNELS
+    // outgoing SDUs queued after send_sdu_buffer
+    l2cap_le_sdu_t send_sdu_queue[L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE];
+    uint8_t        send_sdu_queue_head;
+    uint8_t        send_sdu_queue_count;
+#endif
+
     // max PDU size
     uint16_t  remote_mps;
 
@@ -257,9 +282,12 @@ typedef struct {
     // credits for incoming traffic
     uint16_t credits_incoming;
 
-    // automatic credits incoming
+    // automatic credits incoming: max nr of outstanding credits, 0 = credits are provided by application
     uint16_t automatic_credits;
 
+    // automatic credits incoming: current nr of outstanding credits, grows while remote runs out of credits
+    uint16_t automatic_credits_window;
+
 #ifdef ENABLE_L2CAP_ENHANCED_RETRANSMISSION_MODE
 
     // l2cap channel mode: basic or enhanced retransmission mode
@@ -281,7 +309,15 @@ typedef struct {
     uint16_t remote_retransmission_timeout_ms;
     uint16_t remote_monitor_timeout_ms;
 
-    uint8_t remote_tx_window_size;
+    uint16_t remote_tx_window_size;
+
+    // 32-bit Extended Control Field with 14-bit sequence numbers is used as Extended Window Size option was sent or received
+    uint8_t extended_control;
+
+    // retransmission timeout based on measured round-trip time, bounded by local_retransmission_timeout_ms
+    uint16_t retransmission_timeout_ms;
+    uint32_t srtt_ms;
+    uint32_t rttvar_ms;
 
     uint8_t local_max_transmit;
     uint8_t remote_max_transmit;
@@ -293,41 +329,50 @@ typedef struct {
     uint8_t fcs_option;
 
     // sender: max num of stored outgoing frames
-    uint8_t num_tx_buffers;
+    uint16_t num_tx_buffers;
 
     // sender: num stored outgoing frames
-    uint8_t num_stored_tx_frames;
+    uint16_t num_stored_tx_frames;
 
     // sender: number of unacknowledeged I-Frames - frames have been sent, but not acknowledged yet
-    uint8_t unacked_frames;
+    uint16_t unacked_frames;
 
     // sender: buffer index of oldest packet
-    uint8_t tx_read_index;
+    uint16_t tx_read_index;
 
     // sender: buffer index to store next tx packet
-    uint8_t tx_write_index;
+    uint16_t tx_write_index;
 
     // sender: buffer index of packet to send next
-    uint8_t tx_send_index;
+    uint16_t tx_send_index;
 
     // sender: next seq nr used for sending
-    uint8_t next_tx_seq;
+    uint16_t next_tx_seq;
 
     // sender: selective retransmission requested
     uint8_t srej_active;
 
 
     // receiver: max num out-of-order packets // tx_window
-    uint8_t num_rx_buffers;
+    uint16_t num_rx_buffers;
 
     // receiver: buffer index of to store packet with delta = 1
-    uint8_t rx_store_index;
+    uint16_t rx_store_index;
 
     // receiver: value of tx_seq in next expected i-frame
-    uint8_t expected_tx_seq;
+    uint16_t expected_tx_seq;
 
     // receiver: request transmission with tx_seq = req_seq and ack up to and including req_seq
-    uint8_t req_seq;
+    uint16_t req_seq;
+
+    // receiver: selective reject recovery active - missing frames are requested via SREJ
+    uint8_t srej_recovery;
+
+    // receiver: next tx_seq to check for SREJ
+    uint16_t srej_next_tx_seq;
+
+    // receiver: tx_seq following highest received tx_seq
+    uint16_t srej_end_tx_seq;
 
     // receiver: local busy condition
     uint8_t local_busy;
@@ -612,12 +657,37 @@ uint8_t l2cap_le_create_channel(btstack_packet_handler_t packet_handler, hci_con
  */
 uint8_t l2cap_le_provide_credits(uint16_t cid, uint16_t credits);
 
+/**
+ * @brief Enable or disable automatic credits for LE Data Channel
+ * @note With automatic credits, credits are returned in batches once half of the credit window has been used.
+ *       The window starts at L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_INITIAL and doubles each time the remote runs out of credits.
+ *       With automatic credits disabled, the application provides credits via l2cap_le_provide_credits
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param max_credits           Max number of outstanding credits, 0 to disable automatic credits
+ */
+uint8_t l2cap_le_set_automatic_credits(uint16_t cid, uint16_t max_credits);
+
+/**
+ * @brief Get number of credits remote can use to send data, including credits not sent yet
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @return credits
+ */
+uint16_t l2cap_le_get_incoming_credits(uint16_t cid);
+
 /**
  * @brief Check if packet can be scheduled for transmission
+ * @note SDUs are queued, up to L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE SDUs can wait behind the one being sent
  * @param local_cid             L2CAP LE Data Channel Identifier
  */
 int l2cap_le_can_send_now(uint16_t cid);
 
+/**
+ * @brief Get number of SDUs that can be passed to l2cap_le_send_data / l2cap_le_send_data_multiple
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @return num SDUs, 0 if channel not open or queue full
+ */
+uint16_t l2cap_le_send_queue_num_free(uint16_t cid);
+
 /**
  * @brief Request emission of L2CAP_EVENT_LE_CAN_SEND_NOW as soon as possible
  * @note L2CAP_EVENT_CAN_SEND_NOW might be emitted during call to this function
@@ -628,13 +698,24 @@ uint8_t l2cap_le_request_can_send_now_event(uint16_t cid);
 
 /**
  * @brief Send data via LE Data Channel
- * @note Since data larger then the maximum PDU needs to be segmented into multiple PDUs, data needs to stay valid until ... event
+ * @note Since data larger then the maximum PDU needs to be segmented into multiple PDUs, data needs to stay valid until L2CAP_EVENT_LE_PACKET_SENT
+ *       SDUs are queued and sent back-to-back as long as the remote provides credits
  * @param local_cid             L2CAP LE Data Channel Identifier
  * @param data                  data to send
  * @param size                  data size
  */
 uint8_t l2cap_le_send_data(uint16_t cid, uint8_t * data, uint16_t size);
 
+/**
+ * @brief Send several SDUs via LE Data Channel
+ * @note Either all or none of the SDUs are queued. L2CAP_EVENT_LE_PACKET_SENT is emitted for each SDU
+ * @param local_cid             L2CAP LE Data Channel Identifier
+ * @param sdus                  array of SDUs, data needs to stay valid until L2CAP_EVENT_LE_PACKET_SENT
+ * @param num_sdus              number of SDUs
+ * @return 0 if ok, BTSTACK_ACL_BUFFERS_FULL if not enough space in queue
+ */
+uint8_t l2cap_le_send_data_multiple(uint16_t cid, const l2cap_le_sdu_t * sdus, uint16_t num_sdus);
+
 /**
  * @brief Disconnect from LE Data Channel
  * @param local_cid             L2CAP LE Data Channel Identifier
@@ -0,0 +1,374 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack.h"
+#include "classic/avdtp.h"
+#include "classic/avdtp_source.h"
+#include "classic/a2dp_source.h"
+
+#define MAX_SENT_PACKETS 10
+#define TEST_MTU 200
+
+typedef struct {
+    uint16_t cid;
+    uint8_t  packet[TEST_MTU];
+    uint16_t size;
+} sent_packet_t;
+
+static avdtp_context_t * avdtp_context;
+static btstack_packet_handler_t a2dp_source_avdtp_handler;
+static uint8_t outgoing_buffer[TEST_MTU];
+static sent_packet_t sent_packets[MAX_SENT_PACKETS];
+static int num_sent_packets;
+static uint16_t can_send_now_requests[MAX_SENT_PACKETS];
+static int num_can_send_now_requests;
+static int num_a2dp_can_send_now_events;
+static uint16_t a2dp_can_send_now_cid;
+static uint8_t  a2dp_can_send_now_seid;
+
+// mock AVDTP Source and L2CAP
+
+void avdtp_source_init(avdtp_context_t * context){
+    avdtp_context = context;
+}
+
+void avdtp_source_register_packet_handler(btstack_packet_handler_t callback){
+    a2dp_source_avdtp_handler = callback;
+}
+
+avdtp_stream_endpoint_t * avdtp_source_create_stream_endpoint(avdtp_sep_type_t sep_type, avdtp_media_type_t media_type){
+    avdtp_stream_endpoint_t * stream_endpoint = (avdtp_stream_endpoint_t *) calloc(1, sizeof(avdtp_stream_endpoint_t));
+    stream_endpoint->sep.seid = ++avdtp_context->stream_endpoints_id_counter;
+    stream_endpoint->sep.type = sep_type;
+    stream_endpoint->sep.media_type = media_type;
+    btstack_linked_list_add(&avdtp_context->stream_endpoints, (btstack_linked_item_t *) stream_endpoint);
+    return stream_endpoint;
+}
+
+uint8_t avdtp_stream_endpoint_seid(avdtp_stream_endpoint_t * stream_endpoint){
+    return stream_endpoint->sep.seid;
+}
+
+void avdtp_source_register_media_transport_category(uint8_t seid){
+    UNUSED(seid);
+}
+
+void avdtp_source_register_media_codec_category(uint8_t seid, avdtp_media_type_t media_type, avdtp_media_codec_type_t media_codec_type, uint8_t * media_codec_info, uint16_t media_codec_info_len){
+    UNUSED(seid);
+    UNUSED(media_type);
+    UNUSED(media_codec_type);
+    UNUSED(media_codec_info);
+    UNUSED(media_codec_info_len);
+}
+
+uint8_t avdtp_source_connect(bd_addr_t bd_addr, uint16_t * avdtp_cid){
+    (void) bd_addr;
+    UNUSED(avdtp_cid);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_source_discover_stream_endpoints(uint16_t avdtp_cid){
+    UNUSED(avdtp_cid);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_source_get_capabilities(uint16_t avdtp_cid, uint8_t acp_seid){
+    UNUSED(avdtp_cid);
+    UNUSED(acp_seid);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_source_set_configuration(uint16_t avdtp_cid, uint8_t int_seid, uint8_t acp_seid, uint16_t configured_services_bitmap, avdtp_capabilities_t configuration){
+    UNUSED(avdtp_cid);
+    UNUSED(int_seid);
+    UNUSED(acp_seid);
+    UNUSED(configured_services_bitmap);
+    UNUSED(configuration);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_source_reconfigure(uint16_t avdtp_cid, uint8_t int_seid, uint8_t acp_seid, uint16_t configured_services_bitmap, avdtp_capabilities_t configuration){
+    UNUSED(avdtp_cid);
+    UNUSED(int_seid);
+    UNUSED(acp_seid);
+    UNUSED(configured_services_bitmap);
+    UNUSED(configuration);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_source_open_stream(uint16_t avdtp_cid, uint8_t int_seid, uint8_t acp_seid){
+    UNUSED(avdtp_cid);
+    UNUSED(int_seid);
+    UNUSED(acp_seid);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_start_stream(uint16_t avdtp_cid, uint8_t local_seid, avdtp_context_t * context){
+    UNUSED(avdtp_cid);
+    UNUSED(local_seid);
+    UNUSED(context);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_suspend_stream(uint16_t avdtp_cid, uint8_t local_seid, avdtp_context_t * context){
+    UNUSED(avdtp_cid);
+    UNUSED(local_seid);
+    UNUSED(context);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_disconnect(uint16_t avdtp_cid, avdtp_context_t * context){
+    UNUSED(avdtp_cid);
+    UNUSED(context);
+    return ERROR_CODE_SUCCESS;
+}
+
+uint8_t avdtp_choose_sbc_channel_mode(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_channel_mode_bitmap){
+    UNUSED(stream_endpoint);
+    return remote_channel_mode_bitmap;
+}
+
+uint8_t avdtp_choose_sbc_allocation_method(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_allocation_method_bitmap){
+    UNUSED(stream_endpoint);
+    return remote_allocation_method_bitmap;
+}
+
+uint8_t avdtp_choose_sbc_sampling_frequency(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_sampling_frequency_bitmap){
+    UNUSED(stream_endpoint);
+    return remote_sampling_frequency_bitmap;
+}
+
+uint8_t avdtp_choose_sbc_subbands(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_subbands_bitmap){
+    UNUSED(stream_endpoint);
+    return remote_subbands_bitmap;
+}
+
+uint8_t avdtp_choose_sbc_block_length(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_block_length_bitmap){
+    UNUSED(stream_endpoint);
+    return remote_block_length_bitmap;
+}
+
+uint8_t avdtp_choose_sbc_max_bitpool_value(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_max_bitpool_value){
+    UNUSED(stream_endpoint);
+    return remote_max_bitpool_value;
+}
+
+uint8_t avdtp_choose_sbc_min_bitpool_value(avdtp_stream_endpoint_t * stream_endpoint, uint8_t remote_min_bitpool_value){
+    UNUSED(stream_endpoint);
+    return remote_min_bitpool_value;
+}
+
+void avdtp_sink_register_media_handler(void (*callback)(avdtp_stream_endpoint_t * stream_endpoint, uint8_t *packet, uint16_t size)){
+    UNUSED(callback);
+}
+
+uint32_t btstack_run_loop_get_time_ms(void){
+    return 0;
+}
+
+uint16_t l2cap_get_remote_mtu_for_local_cid(uint16_t local_cid){
+    UNUSED(local_cid);
+    return TEST_MTU;
+}
+
+void l2cap_request_can_send_now_event(uint16_t local_cid){
+    can_send_now_requests[num_can_send_now_requests++] = local_cid;
+}
+
+int l2cap_reserve_packet_buffer(void){
+    return 1;
+}
+
+uint8_t * l2cap_get_outgoing_buffer(void){
+    return outgoing_buffer;
+}
+
+int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    sent_packet_t * sent_packet = &sent_packets[num_sent_packets++];
+    sent_packet->cid  = local_cid;
+    sent_packet->size = len;
+    memcpy(sent_packet->packet, outgoing_buffer, len);
+    return ERROR_CODE_SUCCESS;
+}
+
+// test setup
+
+static void a2dp_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != HCI_EVENT_A2DP_META) return;
+    if (hci_event_a2dp_meta_get_subevent_code(packet) != A2DP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW) return;
+    num_a2dp_can_send_now_events++;
+    a2dp_can_send_now_cid  = a2dp_subevent_streaming_can_send_media_packet_now_get_a2dp_cid(packet);
+    a2dp_can_send_now_seid = a2dp_subevent_streaming_can_send_media_packet_now_get_local_seid(packet);
+}
+
+static void avdtp_emit_can_send_media_packet_now(avdtp_stream_endpoint_t * stream_endpoint){
+    uint8_t event[8];
+    int pos = 0;
+    event[pos++] = HCI_EVENT_AVDTP_META;
+    event[pos++] = sizeof(event) - 2;
+    event[pos++] = AVDTP_SUBEVENT_STREAMING_CAN_SEND_MEDIA_PACKET_NOW;
+    little_endian_store_16(event, pos, stream_endpoint->connection->avdtp_cid);
+    pos += 2;
+    event[pos++] = avdtp_stream_endpoint_seid(stream_endpoint);
+    little_endian_store_16(event, pos, stream_endpoint->sequence_number);
+    (*a2dp_source_avdtp_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+}
+
+static uint8_t media_sbc_codec_capabilities[] = {
+    0xFF, 0xFF, 2, 53
+};
+
+static const uint8_t payload[] = { 0x9c, 0x11, 0x22, 0x33, 0x44, 0x55, 0x66, 0x77 };
+
+#define NUM_SINKS 3
+
+static avdtp_connection_t connections[NUM_SINKS];
+static avdtp_stream_endpoint_t * stream_endpoints[NUM_SINKS];
+static uint8_t media_codec_configurations[NUM_SINKS][4];
+
+static const sent_packet_t * sent_packet_for_cid(uint16_t cid){
+    int i;
+    for (i=0;i<num_sent_packets;i++){
+        if (sent_packets[i].cid == cid) return &sent_packets[i];
+    }
+    return NULL;
+}
+
+static int can_send_now_requested(uint16_t cid){
+    int i;
+    for (i=0;i<num_can_send_now_requests;i++){
+        if (can_send_now_requests[i] == cid) return 1;
+    }
+    return 0;
+}
+
+TEST_GROUP(A2DP_SOURCE_BROADCAST){
+    void setup(void){
+        num_sent_packets = 0;
+        num_can_send_now_requests = 0;
+        num_a2dp_can_send_now_events = 0;
+        memset(connections, 0, sizeof(connections));
+
+        a2dp_source_init();
+        a2dp_source_register_packet_handler(&a2dp_packet_handler);
+        avdtp_context->stream_endpoints = NULL;
+        avdtp_context->stream_endpoints_id_counter = 0;
+
+        // sinks 0 and 1 use the same SBC configuration in separate buffers, sink 2 a different bitpool
+        int i;
+        for (i=0;i<NUM_SINKS;i++){
+            const uint8_t configuration[] = { 0x21, 0x15, 2, (uint8_t) (i == 2 ? 35 : 53) };
+            memcpy(media_codec_configurations[i], configuration, sizeof(configuration));
+            avdtp_stream_endpoint_t * stream_endpoint = a2dp_source_create_stream_endpoint(AVDTP_AUDIO, AVDTP_CODEC_SBC,
+                media_sbc_codec_capabilities, sizeof(media_sbc_codec_capabilities), media_codec_configurations[i], 4);
+            connections[i].avdtp_cid = 1 + i;
+            stream_endpoint->connection = &connections[i];
+            stream_endpoint->state = AVDTP_STREAM_ENDPOINT_STREAMING;
+            stream_endpoint->l2cap_media_cid = 0x40 + i;
+            stream_endpoint->sequence_number = 100 * i;
+            adtvp_media_codec_capabilities_t * media_codec = &stream_endpoint->remote_sep.configuration.media_codec;
+            media_codec->media_type = AVDTP_AUDIO;
+            media_codec->media_codec_type = AVDTP_CODEC_SBC;
+            media_codec->media_codec_information = media_codec_configurations[i];
+            media_codec->media_codec_information_len = 4;
+            stream_endpoints[i] = stream_endpoint;
+        }
+    }
+
+    void teardown(void){
+        int i;
+        for (i=0;i<NUM_SINKS;i++){
+            free(stream_endpoints[i]);
+        }
+    }
+};
+
+TEST(A2DP_SOURCE_BROADCAST, SendToAllSinksWithSameConfiguration){
+    uint8_t seid = avdtp_stream_endpoint_seid(stream_endpoints[0]);
+    CHECK_EQUAL(2, a2dp_source_broadcast_send_media_payload(1, seid, payload, sizeof(payload), 5, 0));
+    CHECK_EQUAL(2, num_can_send_now_requests);
+    CHECK(can_send_now_requested(0x40));
+    CHECK(can_send_now_requested(0x41));
+    CHECK(!can_send_now_requested(0x42));
+
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[1]);
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[0]);
+    CHECK_EQUAL(2, num_sent_packets);
+    CHECK_EQUAL(0, num_a2dp_can_send_now_events);
+
+    // same payload, independent sequence numbers
+    const sent_packet_t * packet_0 = sent_packet_for_cid(0x40);
+    const sent_packet_t * packet_1 = sent_packet_for_cid(0x41);
+    CHECK(packet_0 != NULL);
+    CHECK(packet_1 != NULL);
+    CHECK(sent_packet_for_cid(0x42) == NULL);
+    CHECK_EQUAL(12 + 1 + sizeof(payload), packet_0->size);
+    CHECK_EQUAL(packet_0->size, packet_1->size);
+    CHECK_EQUAL(0,   big_endian_read_16(packet_0->packet, 2));
+    CHECK_EQUAL(100, big_endian_read_16(packet_1->packet, 2));
+    CHECK_EQUAL(5, packet_0->packet[12]);
+    MEMCMP_EQUAL(payload, &packet_0->packet[13], sizeof(payload));
+    MEMCMP_EQUAL(payload, &packet_1->packet[13], sizeof(payload));
+    CHECK_EQUAL(1,   stream_endpoints[0]->sequence_number);
+    CHECK_EQUAL(101, stream_endpoints[1]->sequence_number);
+    CHECK_EQUAL(200, stream_endpoints[2]->sequence_number);
+}
+
+TEST(A2DP_SOURCE_BROADCAST, CanSendNowAfterAllSinksSent){
+    uint8_t seid = avdtp_stream_endpoint_seid(stream_endpoints[0]);
+    CHECK_EQUAL(2, a2dp_source_broadcast_send_media_payload(1, seid, payload, sizeof(payload), 5, 0));
+
+    // payload still pending, no additional L2CAP request
+    a2dp_source_broadcast_request_can_send_now(1, seid);
+    CHECK_EQUAL(2, num_can_send_now_requests);
+
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[0]);
+    CHECK_EQUAL(0, num_a2dp_can_send_now_events);
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[1]);
+    CHECK_EQUAL(1, num_a2dp_can_send_now_events);
+    CHECK_EQUAL(1, a2dp_can_send_now_cid);
+    CHECK_EQUAL(seid, a2dp_can_send_now_seid);
+
+    // nothing pending, request goes to the reference sink
+    a2dp_source_broadcast_request_can_send_now(1, seid);
+    CHECK_EQUAL(3, num_can_send_now_requests);
+    CHECK_EQUAL(0x40, can_send_now_requests[2]);
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[0]);
+    CHECK_EQUAL(2, num_a2dp_can_send_now_events);
+    CHECK_EQUAL(2, num_sent_packets);
+}
+
+TEST(A2DP_SOURCE_BROADCAST, SinkNotStreaming){
+    stream_endpoints[1]->state = AVDTP_STREAM_ENDPOINT_OPENED;
+    uint8_t seid = avdtp_stream_endpoint_seid(stream_endpoints[0]);
+    CHECK_EQUAL(1, a2dp_source_broadcast_send_media_payload(1, seid, payload, sizeof(payload), 5, 0));
+    avdtp_emit_can_send_media_packet_now(stream_endpoints[0]);
+    CHECK_EQUAL(1, num_sent_packets);
+    CHECK_EQUAL(0x40, sent_packets[0].cid);
+}
+
+TEST(A2DP_SOURCE_BROADCAST, WrongA2dpCid){
+    // a2dp_cid has to match the connection of the stream endpoint
+    uint8_t seid = avdtp_stream_endpoint_seid(stream_endpoints[0]);
+    CHECK_EQUAL(0, a2dp_source_broadcast_send_media_payload(2, seid, payload, sizeof(payload), 5, 0));
+    CHECK_EQUAL(0, a2dp_source_stream_send_media_payload(2, seid, (uint8_t *) payload, sizeof(payload), 5, 0));
+    CHECK_EQUAL(0, a2dp_max_media_payload_size(2, seid));
+    a2dp_source_stream_endpoint_request_can_send_now(2, seid);
+    CHECK_EQUAL(0, num_can_send_now_requests);
+    CHECK_EQUAL(0, num_sent_packets);
+
+    CHECK(a2dp_source_stream_send_media_payload(1, seid, (uint8_t *) payload, sizeof(payload), 5, 0) > 0);
+    CHECK_EQUAL(1, num_sent_packets);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,443 @@
+// *****************************************************************************
+//
+// test Classic discovery with inquiry cache and remote name requests
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_data_types.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static int      num_inquiries;
+static uint8_t  last_inquiry_duration;
+static int      num_inquiry_cancels;
+static int      num_name_requests;
+static int      num_name_request_cancels;
+static bd_addr_t last_name_request_addr;
+static uint8_t  last_name_request_psrm;
+static uint16_t last_name_request_clock_offset;
+
+// events received by application
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static int      num_inquiry_results;
+static int      num_inquiry_complete;
+static bd_addr_t last_result_addr;
+static int8_t   last_result_rssi;
+static int      last_result_name_len;
+
+static bd_addr_t device_a = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x01 };
+static bd_addr_t device_b = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x02 };
+static bd_addr_t device_c = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x03 };
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// inquiry and remote name request are completed by test
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        if (opcode == hci_inquiry.opcode){
+            num_inquiries++;
+            last_inquiry_duration = command[6];
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_remote_name_request.opcode){
+            num_name_requests++;
+            reverse_bd_addr(&command[3], last_name_request_addr);
+            last_name_request_psrm = command[9];
+            last_name_request_clock_offset = little_endian_read_16(command, 11);
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_inquiry_cancel.opcode){
+            num_inquiry_cancels++;
+        }
+        if (opcode == hci_remote_name_request_cancel.opcode){
+            num_name_request_cancels++;
+        }
+        controller_send_command_complete(opcode);
+    }
+}
+
+static void controller_send_inquiry_result_with_rssi(const bd_addr_t addr, uint16_t clock_offset, int8_t rssi){
+    uint8_t event[17];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_INQUIRY_RESULT_WITH_RSSI;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    reverse_bd_addr(addr, &event[3]);
+    event[9] = 1;
+    little_endian_store_24(event, 11, 0x240404);
+    little_endian_store_16(event, 14, clock_offset);
+    event[16] = (uint8_t) rssi;
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void controller_send_extended_inquiry_response(const bd_addr_t addr, const char * name){
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_EXTENDED_INQUIRY_RESPONSE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    reverse_bd_addr(addr, &event[3]);
+    event[9] = 1;
+    little_endian_store_24(event, 11, 0x240404);
+    event[16] = (uint8_t) -60;
+    uint8_t name_len = (uint8_t) strlen(name);
+    event[17] = 1 + name_len;
+    event[18] = BLUETOOTH_DATA_TYPE_COMPLETE_LOCAL_NAME;
+    memcpy(&event[19], name, name_len);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void controller_send_inquiry_complete(void){
+    uint8_t event[] = { HCI_EVENT_INQUIRY_COMPLETE, 1, 0};
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void controller_send_remote_name_request_complete(uint8_t status, const char * name){
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = status;
+    reverse_bd_addr(last_name_request_addr, &event[3]);
+    if (status == ERROR_CODE_SUCCESS){
+        memcpy(&event[9], name, strlen(name));
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case GAP_EVENT_INQUIRY_RESULT:
+            num_inquiry_results++;
+            gap_event_inquiry_result_get_bd_addr(packet, last_result_addr);
+            last_result_rssi = (int8_t) gap_event_inquiry_result_get_rssi(packet);
+            last_result_name_len = gap_event_inquiry_result_get_name_available(packet) ? gap_event_inquiry_result_get_name_len(packet) : 0;
+            break;
+        case GAP_EVENT_INQUIRY_COMPLETE:
+            num_inquiry_complete++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void check_name_request(const bd_addr_t addr){
+    CHECK_EQUAL(0, bd_addr_cmp(addr, last_name_request_addr));
+}
+
+TEST_GROUP(Discovery){
+    void setup(void){
+        num_pending_commands = 0;
+        num_inquiries = 0;
+        last_inquiry_duration = 0;
+        num_inquiry_cancels = 0;
+        num_name_requests = 0;
+        num_name_request_cancels = 0;
+        memset(last_name_request_addr, 0, 6);
+        num_inquiry_results = 0;
+        num_inquiry_complete = 0;
+        last_result_rssi = 0;
+        last_result_name_len = 0;
+        hci_init(&test_transport, NULL);
+        hci_event_callback_registration.callback = &app_packet_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+        gap_inquiry_cache_clear();
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(Discovery, InquiryReportsEveryResponse){
+    CHECK_EQUAL(0, gap_inquiry_start(5));
+    controller_process_commands();
+    CHECK_EQUAL(1, num_inquiries);
+    CHECK_EQUAL(5, last_inquiry_duration);
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -40);
+    CHECK_EQUAL(2, num_inquiry_results);
+    CHECK_EQUAL(-40, last_result_rssi);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(1, num_inquiry_complete);
+    // plain inquiry does not request names
+    CHECK_EQUAL(0, num_name_requests);
+}
+
+TEST(Discovery, ReportsDeviceOnce){
+    CHECK_EQUAL(0, gap_discovery_start(6));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -40);
+    CHECK_EQUAL(1, num_inquiry_results);
+    // name learned via EIR is reported again
+    controller_send_extended_inquiry_response(device_a, "Speaker");
+    CHECK_EQUAL(2, num_inquiry_results);
+    CHECK_EQUAL(7, last_result_name_len);
+    controller_send_extended_inquiry_response(device_a, "Speaker");
+    CHECK_EQUAL(2, num_inquiry_results);
+}
+
+TEST(Discovery, Slices){
+    CHECK_EQUAL(0, gap_discovery_start(7));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, gap_discovery_start(7));
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, gap_inquiry_start(7));
+    controller_process_commands();
+    CHECK_EQUAL(1, num_inquiries);
+    CHECK_EQUAL(GAP_DISCOVERY_INQUIRY_SLICE, last_inquiry_duration);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(2, num_inquiries);
+    CHECK_EQUAL(GAP_DISCOVERY_INQUIRY_SLICE, last_inquiry_duration);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(3, num_inquiries);
+    CHECK_EQUAL(1, last_inquiry_duration);
+    CHECK_EQUAL(0, num_inquiry_complete);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(3, num_inquiries);
+    CHECK_EQUAL(1, num_inquiry_complete);
+}
+
+TEST(Discovery, NamesBetweenSlices){
+    CHECK_EQUAL(0, gap_discovery_start(6));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_result_with_rssi(device_b, 0x2345, -50);
+    controller_send_inquiry_result_with_rssi(device_c, 0x3456, -50);
+    controller_send_inquiry_complete();
+    // names are requested with page parameters from inquiry
+    CHECK_EQUAL(1, num_name_requests);
+    check_name_request(device_a);
+    CHECK_EQUAL(1, last_name_request_psrm);
+    CHECK_EQUAL(0x9234, last_name_request_clock_offset);
+    controller_send_remote_name_request_complete(ERROR_CODE_SUCCESS, "A");
+    CHECK_EQUAL(2, num_name_requests);
+    check_name_request(device_b);
+    controller_send_remote_name_request_complete(ERROR_CODE_SUCCESS, "B");
+    // limited per pause, next slice
+    CHECK_EQUAL(2, num_name_requests);
+    CHECK_EQUAL(2, num_inquiries);
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_complete();
+    // remaining names after last slice
+    CHECK_EQUAL(3, num_name_requests);
+    check_name_request(device_c);
+    CHECK_EQUAL(0, num_inquiry_complete);
+    controller_send_remote_name_request_complete(ERROR_CODE_SUCCESS, "C");
+    CHECK_EQUAL(3, num_name_requests);
+    CHECK_EQUAL(2, num_inquiries);
+    CHECK_EQUAL(1, num_inquiry_complete);
+}
+
+TEST(Discovery, EirNameAndFailedName){
+    CHECK_EQUAL(0, gap_discovery_start(6));
+    controller_process_commands();
+    controller_send_extended_inquiry_response(device_a, "Speaker");
+    controller_send_inquiry_result_with_rssi(device_b, 0x2345, -50);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(1, num_name_requests);
+    check_name_request(device_b);
+    controller_send_remote_name_request_complete(ERROR_CODE_PAGE_TIMEOUT, NULL);
+    // failed name is not retried in this discovery
+    CHECK_EQUAL(2, num_inquiries);
+    controller_send_inquiry_result_with_rssi(device_b, 0x2345, -50);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(1, num_name_requests);
+    CHECK_EQUAL(1, num_inquiry_complete);
+    // but in the next one
+    CHECK_EQUAL(0, gap_discovery_start(1));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_b, 0x2345, -50);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(2, num_name_requests);
+    check_name_request(device_b);
+}
+
+TEST(Discovery, StopDuringInquiry){
+    CHECK_EQUAL(0, gap_discovery_start(6));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    CHECK_EQUAL(0, gap_inquiry_stop());
+    controller_process_commands();
+    CHECK_EQUAL(1, num_inquiry_cancels);
+    CHECK_EQUAL(1, num_inquiry_complete);
+    CHECK_EQUAL(0, num_name_requests);
+    CHECK_EQUAL(0, gap_discovery_start(1));
+}
+
+TEST(Discovery, StopCancelsNameRequest){
+    CHECK_EQUAL(0, gap_discovery_start(6));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_result_with_rssi(device_b, 0x2345, -50);
+    controller_send_inquiry_complete();
+    CHECK_EQUAL(1, num_name_requests);
+    CHECK_EQUAL(0, gap_inquiry_stop());
+    controller_process_commands();
+    CHECK_EQUAL(1, num_inquiry_complete);
+    CHECK_EQUAL(1, num_name_request_cancels);
+    CHECK_EQUAL(ERROR_CODE_COMMAND_DISALLOWED, gap_remote_name_request(device_b, 0, 0));
+    controller_send_remote_name_request_complete(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, NULL);
+    // discovery stays stopped
+    CHECK_EQUAL(1, num_name_requests);
+    CHECK_EQUAL(1, num_inquiries);
+    CHECK_EQUAL(1, num_inquiry_complete);
+    // application can request names again
+    CHECK_EQUAL(0, gap_remote_name_request(device_b, 0, 0));
+    controller_process_commands();
+    CHECK_EQUAL(2, num_name_requests);
+}
+
+TEST(Discovery, CachedPageParameters){
+    CHECK_EQUAL(0, gap_inquiry_start(1));
+    controller_process_commands();
+    controller_send_inquiry_result_with_rssi(device_a, 0x1234, -50);
+    controller_send_inquiry_complete();
+    // clock offset without valid flag is replaced by cached one
+    CHECK_EQUAL(0, gap_remote_name_request(device_a, 0, 0));
+    controller_process_commands();
+    CHECK_EQUAL(1, last_name_request_psrm);
+    CHECK_EQUAL(0x9234, last_name_request_clock_offset);
+    controller_send_remote_name_request_complete(ERROR_CODE_SUCCESS, "A");
+    // valid clock offset from caller is kept
+    CHECK_EQUAL(0, gap_remote_name_request(device_a, 2, 0x8111));
+    controller_process_commands();
+    CHECK_EQUAL(2, last_name_request_psrm);
+    CHECK_EQUAL(0x8111, last_name_request_clock_offset);
+    controller_send_remote_name_request_complete(ERROR_CODE_SUCCESS, "A");
+    // cache cleared
+    gap_inquiry_cache_clear();
+    CHECK_EQUAL(0, gap_remote_name_request(device_a, 0, 0));
+    controller_process_commands();
+    CHECK_EQUAL(0, last_name_request_psrm);
+    CHECK_EQUAL(0, last_name_request_clock_offset);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
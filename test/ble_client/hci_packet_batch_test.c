@@ -0,0 +1,294 @@
+// *****************************************************************************
+//
+// test HCI packet batches and coalescing of Number Of Completed Packets events
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+#define MAX_RECEIVED_EVENTS  10
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+static int      num_transport_close;
+
+// events received by upper stack
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static uint8_t  received_events[MAX_RECEIVED_EVENTS][2 + 255];
+static int      num_received_events;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    num_transport_close++;
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint16_t opcode = little_endian_read_16(pending_commands[0], 0);
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        controller_send_command_complete(opcode);
+    }
+}
+
+static void transport_send_packet_batch(uint8_t active){
+    uint8_t event[] = { HCI_EVENT_TRANSPORT_PACKET_BATCH, 1, active };
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_num_completed_packets(hci_con_handle_t con_handle, uint16_t num_packets){
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 0, 0 };
+    little_endian_store_16(event, 3, con_handle);
+    little_endian_store_16(event, 5, num_packets);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_hardware_error(void){
+    uint8_t event[] = { HCI_EVENT_HARDWARE_ERROR, 1, 0x01 };
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS:
+        case HCI_EVENT_TRANSPORT_PACKET_BATCH:
+            CHECK(num_received_events < MAX_RECEIVED_EVENTS);
+            memcpy(received_events[num_received_events++], packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+static int num_completed_packets_num_handles(int index){
+    CHECK(index < num_received_events);
+    CHECK_EQUAL(HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, hci_event_packet_get_type(received_events[index]));
+    return received_events[index][2];
+}
+
+static uint16_t num_completed_packets_for_handle(int index, hci_con_handle_t con_handle){
+    int num_handles = num_completed_packets_num_handles(index);
+    int i;
+    for (i=0;i<num_handles;i++){
+        const uint8_t * entry = &received_events[index][3 + i * 4];
+        if (little_endian_read_16(entry, 0) == con_handle){
+            return little_endian_read_16(entry, 2);
+        }
+    }
+    return 0;
+}
+
+TEST_GROUP(PacketBatch){
+    void setup(void){
+        num_pending_commands = 0;
+        num_transport_close = 0;
+        hci_init(&test_transport, NULL);
+        hci_event_callback_registration.callback = &hci_event_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+        num_received_events = 0;
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(PacketBatch, NoBatch){
+    controller_send_num_completed_packets(0x0001, 1);
+    CHECK_EQUAL(1, num_received_events);
+    CHECK_EQUAL(1, num_completed_packets_for_handle(0, 0x0001));
+}
+
+TEST(PacketBatch, CoalesceAcrossHandles){
+    transport_send_packet_batch(1);
+    CHECK(hci_packet_batch_active());
+    controller_send_num_completed_packets(0x0001, 1);
+    controller_send_num_completed_packets(0x0002, 2);
+    controller_send_num_completed_packets(0x0001, 3);
+    controller_send_num_completed_packets(0x0003, 1);
+    controller_send_num_completed_packets(0x0002, 1);
+    // nothing reported during batch besides start of batch
+    CHECK_EQUAL(1, num_received_events);
+    transport_send_packet_batch(0);
+    CHECK_FALSE(hci_packet_batch_active());
+    CHECK_EQUAL(3, num_received_events);
+    CHECK_EQUAL(3, num_completed_packets_num_handles(1));
+    CHECK_EQUAL(4, num_completed_packets_for_handle(1, 0x0001));
+    CHECK_EQUAL(3, num_completed_packets_for_handle(1, 0x0002));
+    CHECK_EQUAL(1, num_completed_packets_for_handle(1, 0x0003));
+}
+
+TEST(PacketBatch, FlushBeforeEndOfBatch){
+    transport_send_packet_batch(1);
+    controller_send_num_completed_packets(0x0001, 2);
+    transport_send_packet_batch(0);
+    CHECK_EQUAL(3, num_received_events);
+    CHECK_EQUAL(HCI_EVENT_TRANSPORT_PACKET_BATCH, hci_event_packet_get_type(received_events[0]));
+    CHECK_EQUAL(2, num_completed_packets_for_handle(1, 0x0001));
+    // upper stack gets notified about end of batch after coalesced event
+    CHECK_EQUAL(HCI_EVENT_TRANSPORT_PACKET_BATCH, hci_event_packet_get_type(received_events[2]));
+    CHECK_EQUAL(0, hci_event_transport_packet_batch_get_active(received_events[2]));
+}
+
+TEST(PacketBatch, EmptyBatch){
+    transport_send_packet_batch(1);
+    transport_send_packet_batch(0);
+    // no Number Of Completed Packets without completed packets
+    CHECK_EQUAL(2, num_received_events);
+}
+
+TEST(PacketBatch, HandleOverflow){
+    transport_send_packet_batch(1);
+    hci_con_handle_t con_handle;
+    for (con_handle = 1; con_handle <= HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES + 1; con_handle++){
+        controller_send_num_completed_packets(con_handle, con_handle);
+    }
+    // full event emitted when table overflows
+    CHECK_EQUAL(2, num_received_events);
+    CHECK_EQUAL(HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES, num_completed_packets_num_handles(1));
+    for (con_handle = 1; con_handle <= HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES; con_handle++){
+        CHECK_EQUAL(con_handle, num_completed_packets_for_handle(1, con_handle));
+    }
+    // remaining handle at end of batch
+    transport_send_packet_batch(0);
+    CHECK_EQUAL(4, num_received_events);
+    CHECK_EQUAL(1, num_completed_packets_num_handles(2));
+    CHECK_EQUAL(HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES + 1, num_completed_packets_for_handle(2, HCI_NUM_COMPLETED_PACKETS_MAX_HANDLES + 1));
+}
+
+TEST(PacketBatch, HardwareErrorDuringBatch){
+    transport_send_packet_batch(1);
+    controller_send_num_completed_packets(0x0001, 1);
+    // stack gets restarted by hardware error, transport does not report end of batch
+    controller_send_hardware_error();
+    CHECK_EQUAL(1, num_transport_close);
+    CHECK_FALSE(hci_packet_batch_active());
+    hci_power_control(HCI_POWER_ON);
+    controller_process_commands();
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    // coalesced event from before restart is dropped
+    num_received_events = 0;
+    controller_send_num_completed_packets(0x0002, 1);
+    CHECK_EQUAL(1, num_received_events);
+    CHECK_EQUAL(1, num_completed_packets_num_handles(0));
+    CHECK_EQUAL(1, num_completed_packets_for_handle(0, 0x0002));
+}
+
+TEST(PacketBatch, CloseDuringBatch){
+    transport_send_packet_batch(1);
+    controller_send_num_completed_packets(0x0001, 1);
+    // transport does not report end of batch after close
+    hci_close();
+    CHECK_EQUAL(1, num_transport_close);
+    // restart for teardown
+    hci_init(&test_transport, NULL);
+    hci_power_control(HCI_POWER_ON);
+    controller_process_commands();
+    CHECK_FALSE(hci_packet_batch_active());
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,148 @@
+// *****************************************************************************
+//
+// test LE Advertising Report filter for Service UUIDs
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_data_types.h"
+#include "btstack_event.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+
+void le_handle_advertisement_report(uint8_t *packet, uint16_t size);
+
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static int num_advertising_reports;
+
+static int dummy_callback(void){
+    return 0;
+}
+
+static hci_transport_t dummy_transport = {
+  /*  .transport.name                          = */  "DUMMY",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  NULL,
+  /*  .transport.close                         = */  NULL,
+  /*  .transport.register_packet_handler       = */  (void (*)(void (*)(uint8_t, uint8_t *, uint16_t))) dummy_callback,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  NULL,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    (void) channel;
+    (void) size;
+    if (packet_type != HCI_EVENT_PACKET) return;
+    if (hci_event_packet_get_type(packet) != GAP_EVENT_ADVERTISING_REPORT) return;
+    num_advertising_reports++;
+}
+
+// returns 1 if single report with given advertising data was passed on as GAP event
+static int report_accepted(const uint8_t * data, uint8_t data_len){
+    uint8_t packet[50];
+    int pos = 0;
+    packet[pos++] = HCI_EVENT_LE_META;
+    packet[pos++] = 0;
+    packet[pos++] = HCI_SUBEVENT_LE_ADVERTISING_REPORT;
+    packet[pos++] = 1;      // num reports
+    packet[pos++] = 0;      // ADV_IND
+    packet[pos++] = 0;      // public address
+    static const uint8_t address[] = { 0x34, 0xB1, 0xF7, 0xD1, 0x77, 0x9B };
+    memcpy(&packet[pos], address, 6);
+    pos += 6;
+    packet[pos++] = data_len;
+    memcpy(&packet[pos], data, data_len);
+    pos += data_len;
+    packet[pos++] = 0xc0;   // rssi
+    packet[1] = pos - 2;
+    num_advertising_reports = 0;
+    le_handle_advertisement_report(packet, pos);
+    return num_advertising_reports;
+}
+
+static int uuid16_list_accepted(uint16_t uuid16){
+    uint8_t data[4] = { 3, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_16_BIT_SERVICE_CLASS_UUIDS };
+    little_endian_store_16(data, 2, uuid16);
+    return report_accepted(data, sizeof(data));
+}
+
+static int uuid32_list_accepted(uint32_t uuid32){
+    uint8_t data[6] = { 5, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_32_BIT_SERVICE_CLASS_UUIDS };
+    little_endian_store_32(data, 2, uuid32);
+    return report_accepted(data, sizeof(data));
+}
+
+// uuid128 in big endian
+static int uuid128_list_accepted(const uint8_t * uuid128){
+    uint8_t data[18] = { 17, BLUETOOTH_DATA_TYPE_COMPLETE_LIST_OF_128_BIT_SERVICE_CLASS_UUIDS };
+    reverse_128(uuid128, &data[2]);
+    return report_accepted(data, sizeof(data));
+}
+
+static const uint8_t custom_uuid128[] = {
+    0x00, 0x00, 0xFF, 0x10, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5F, 0x9B, 0x34, 0xFC
+};
+
+TEST_GROUP(AdvertisingReportFilter){
+    void setup(void){
+        hci_init(&dummy_transport, NULL);
+        hci_event_callback_registration.callback = &packet_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+    }
+    void teardown(void){
+        gap_advertising_report_filter_clear();
+    }
+};
+
+TEST(AdvertisingReportFilter, NoRules){
+    CHECK_EQUAL(1, uuid16_list_accepted(0x180d));
+}
+
+TEST(AdvertisingReportFilter, UUID16){
+    CHECK_EQUAL(0, gap_advertising_report_filter_add_uuid16(0x180d));
+    CHECK_EQUAL(1, uuid16_list_accepted(0x180d));
+    CHECK_EQUAL(0, uuid16_list_accepted(0x180f));
+    CHECK_EQUAL(1, uuid32_list_accepted(0x180d));
+    uint8_t uuid128[16];
+    uuid_add_bluetooth_prefix(uuid128, 0x180d);
+    CHECK_EQUAL(1, uuid128_list_accepted(uuid128));
+}
+
+TEST(AdvertisingReportFilter, UUID128BasedOnBaseUUIDWithUUID16){
+    uint8_t uuid128[16];
+    uuid_add_bluetooth_prefix(uuid128, 0x180d);
+    CHECK_EQUAL(0, gap_advertising_report_filter_add_uuid128(uuid128));
+    CHECK_EQUAL(1, uuid16_list_accepted(0x180d));
+    CHECK_EQUAL(1, uuid32_list_accepted(0x180d));
+    CHECK_EQUAL(1, uuid128_list_accepted(uuid128));
+}
+
+TEST(AdvertisingReportFilter, UUID128BasedOnBaseUUIDWithUUID32){
+    uint8_t uuid128[16];
+    uuid_add_bluetooth_prefix(uuid128, 0x12345678);
+    CHECK_EQUAL(0, gap_advertising_report_filter_add_uuid128(uuid128));
+    CHECK_EQUAL(1, uuid32_list_accepted(0x12345678));
+    CHECK_EQUAL(0, uuid32_list_accepted(0x12345679));
+    CHECK_EQUAL(1, uuid128_list_accepted(uuid128));
+    CHECK_EQUAL(0, uuid16_list_accepted(0x5678));
+}
+
+TEST(AdvertisingReportFilter, CustomUUID128){
+    CHECK_EQUAL(0, gap_advertising_report_filter_add_uuid128(custom_uuid128));
+    CHECK_EQUAL(1, uuid128_list_accepted(custom_uuid128));
+    CHECK_EQUAL(0, uuid32_list_accepted(0x0000ff10));
+    CHECK_EQUAL(0, uuid16_list_accepted(0xff10));
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
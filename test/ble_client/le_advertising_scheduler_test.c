@@ -0,0 +1,367 @@
+// *****************************************************************************
+//
+// test LE advertising scheduler with legacy advertising
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static uint8_t  controller_adv_data[31];
+static uint8_t  controller_adv_data_len;
+static uint8_t  controller_scan_data[31];
+static uint8_t  controller_scan_data_len;
+static int      controller_advertising;
+static int      num_set_adv_data;
+static int      num_set_scan_data;
+static int      num_set_advertise_enable;
+
+// last timer registered with run loop
+static btstack_timer_source_t * active_timer;
+static uint32_t current_time_ms;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = current_time_ms + timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    active_timer = ts;
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    if (active_timer == ts){
+        active_timer = NULL;
+    }
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return current_time_ms;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        if (opcode == hci_reset.opcode){
+            controller_adv_data_len = 0;
+            controller_scan_data_len = 0;
+            controller_advertising = 0;
+        } else if (opcode == hci_le_set_advertising_data.opcode){
+            num_set_adv_data++;
+            controller_adv_data_len = command[3];
+            memcpy(controller_adv_data, &command[4], 31);
+        } else if (opcode == hci_le_set_scan_response_data.opcode){
+            num_set_scan_data++;
+            controller_scan_data_len = command[3];
+            memcpy(controller_scan_data, &command[4], 31);
+        } else if (opcode == hci_le_set_advertise_enable.opcode){
+            num_set_advertise_enable++;
+            controller_advertising = command[3];
+        }
+        controller_send_command_complete(opcode);
+    }
+}
+
+static void reset_command_counters(void){
+    num_set_adv_data = 0;
+    num_set_scan_data = 0;
+    num_set_advertise_enable = 0;
+}
+
+// advance time to next scheduler slot
+static void fire_scheduler_timer(void){
+    btstack_timer_source_t * ts = active_timer;
+    CHECK(ts != NULL);
+    active_timer = NULL;
+    current_time_ms = ts->timeout;
+    ts->process(ts);
+    controller_process_commands();
+}
+
+// payloads are identified by single byte of manufacturer specific data
+static int controller_advertises(const uint8_t * adv_data){
+    if (!controller_advertising) return 0;
+    if (controller_adv_data_len != adv_data[0] + 1) return 0;
+    return memcmp(controller_adv_data, adv_data, controller_adv_data_len) == 0;
+}
+
+static const uint8_t adv_data_a[] = { 2, 0xff, 'A' };
+static const uint8_t adv_data_b[] = { 2, 0xff, 'B' };
+static const uint8_t adv_data_c[] = { 2, 0xff, 'C' };
+static const uint8_t scan_data_1[] = { 2, 0x09, '1' };
+static const uint8_t scan_data_2[] = { 2, 0x09, '2' };
+
+static le_advertising_scheduler_entry_t entry_a;
+static le_advertising_scheduler_entry_t entry_b;
+static le_advertising_scheduler_entry_t entry_c;
+
+TEST_GROUP(AdvertisingScheduler){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_adv_data_len = 0;
+        controller_scan_data_len = 0;
+        controller_advertising = 0;
+        active_timer = NULL;
+        current_time_ms = 0;
+        hci_init(&test_transport, NULL);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+        reset_command_counters();
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(AdvertisingScheduler, Start){
+    CHECK_EQUAL(0, gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, sizeof(scan_data_1), scan_data_1));
+    CHECK_EQUAL(0, gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, sizeof(scan_data_1), scan_data_1));
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_a));
+    CHECK_EQUAL(sizeof(scan_data_1), controller_scan_data_len);
+    MEMCMP_EQUAL(scan_data_1, controller_scan_data, sizeof(scan_data_1));
+    CHECK(active_timer != NULL);
+}
+
+TEST(AdvertisingScheduler, InvalidLength){
+    uint8_t data[32];
+    memset(data, 0, sizeof(data));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(data), data, 0, NULL));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, gap_advertising_scheduler_add(&entry_a, 400, 0, 0, NULL, sizeof(data), data));
+}
+
+TEST(AdvertisingScheduler, RotateWithoutRestartingAdvertising){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, sizeof(scan_data_1), scan_data_1);
+    gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, sizeof(scan_data_1), scan_data_1);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+
+    // same scan response: single command per rotation
+    reset_command_counters();
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_b));
+    CHECK_EQUAL(1, num_set_adv_data);
+    CHECK_EQUAL(0, num_set_scan_data);
+    CHECK_EQUAL(0, num_set_advertise_enable);
+
+    reset_command_counters();
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+    CHECK_EQUAL(1, num_set_adv_data);
+    CHECK_EQUAL(0, num_set_advertise_enable);
+}
+
+TEST(AdvertisingScheduler, RotateScanResponse){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, sizeof(scan_data_1), scan_data_1);
+    gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, sizeof(scan_data_2), scan_data_2);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+
+    reset_command_counters();
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_b));
+    MEMCMP_EQUAL(scan_data_2, controller_scan_data, sizeof(scan_data_2));
+    CHECK_EQUAL(1, num_set_adv_data);
+    CHECK_EQUAL(1, num_set_scan_data);
+    CHECK_EQUAL(0, num_set_advertise_enable);
+}
+
+TEST(AdvertisingScheduler, EarliestDeadline){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, 0, NULL);
+    gap_advertising_scheduler_add(&entry_b, 1000, 0, sizeof(adv_data_b), adv_data_b, 0, NULL);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_a));
+
+    // t = 200: b is overdue
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_b));
+    // t = 400: a is due again
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+    // t = 600 .. 1000: nothing overdue, a has earliest deadline and stays on air without commands
+    reset_command_counters();
+    fire_scheduler_timer();
+    fire_scheduler_timer();
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+    CHECK_EQUAL(0, num_set_adv_data);
+    // t = 1200: b is due once per period
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_b));
+    CHECK_EQUAL(1, num_set_adv_data);
+}
+
+TEST(AdvertisingScheduler, Priority){
+    gap_advertising_scheduler_add(&entry_a, 200, 0, sizeof(adv_data_a), adv_data_a, 0, NULL);
+    gap_advertising_scheduler_add(&entry_b, 1000, 5, sizeof(adv_data_b), adv_data_b, 0, NULL);
+    gap_advertising_scheduler_add(&entry_c, 200, 0, sizeof(adv_data_c), adv_data_c, 0, NULL);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    // all overdue, highest priority first
+    CHECK(controller_advertises(adv_data_b));
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_c));
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+}
+
+TEST(AdvertisingScheduler, SetDataOnAir){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, 0, NULL);
+    gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, 0, NULL);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_a));
+
+    // updated immediately
+    CHECK_EQUAL(0, gap_advertising_scheduler_set_data(&entry_a, sizeof(adv_data_c), adv_data_c, 0, NULL));
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_c));
+
+    // not on air: sent on next rotation
+    reset_command_counters();
+    CHECK_EQUAL(0, gap_advertising_scheduler_set_data(&entry_b, sizeof(adv_data_a), adv_data_a, 0, NULL));
+    controller_process_commands();
+    CHECK_EQUAL(0, num_set_adv_data);
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_a));
+}
+
+TEST(AdvertisingScheduler, Remove){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, 0, NULL);
+    gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, 0, NULL);
+    gap_advertising_scheduler_add(&entry_c, 400, 0, sizeof(adv_data_c), adv_data_c, 0, NULL);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_a));
+
+    gap_advertising_scheduler_remove(&entry_a);
+    gap_advertising_scheduler_remove(&entry_b);
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_c));
+    // single entry stays on air
+    reset_command_counters();
+    fire_scheduler_timer();
+    fire_scheduler_timer();
+    CHECK(controller_advertises(adv_data_c));
+    CHECK_EQUAL(0, num_set_adv_data);
+}
+
+TEST(AdvertisingScheduler, Stop){
+    gap_advertising_scheduler_add(&entry_a, 400, 0, sizeof(adv_data_a), adv_data_a, 0, NULL);
+    gap_advertising_scheduler_add(&entry_b, 400, 0, sizeof(adv_data_b), adv_data_b, 0, NULL);
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    gap_advertising_scheduler_stop();
+    controller_process_commands();
+    CHECK_EQUAL(0, controller_advertising);
+    CHECK(active_timer == NULL);
+
+    // restart with all entries due
+    current_time_ms = 5000;
+    gap_advertising_scheduler_start();
+    controller_process_commands();
+    CHECK(controller_advertises(adv_data_a));
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,379 @@
+// *****************************************************************************
+//
+// test LE connection parameter manager
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+#define TEST_CON_HANDLE      0x0040
+#define TEST_ATT_CID         0x0004
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static uint8_t  controller_connection_update_status;
+static int      num_connection_updates;
+static uint16_t last_conn_interval_min;
+static uint16_t last_conn_interval_max;
+static uint16_t last_conn_latency;
+static uint16_t last_supervision_timeout;
+
+// last timer registered with run loop
+static btstack_timer_source_t * active_timer;
+static uint32_t current_time_ms;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = current_time_ms + timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    active_timer = ts;
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    if (active_timer == ts){
+        active_timer = NULL;
+    }
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return current_time_ms;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_status(uint16_t opcode, uint8_t status){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    event[2] = status;
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    } else if (opcode == hci_le_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        event[8] = 4;
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_le_event(uint8_t subevent, const uint8_t * params, uint8_t params_len){
+    uint8_t event[2 + 255];
+    event[0] = HCI_EVENT_LE_META;
+    event[1] = 1 + params_len;
+    event[2] = subevent;
+    memcpy(&event[3], params, params_len);
+    hci_packet_handler(HCI_EVENT_PACKET, event, 3 + params_len);
+}
+
+// connection update procedure takes several connection events, Connection Update Complete is sent by test
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        if (opcode == hci_le_connection_update.opcode){
+            num_connection_updates++;
+            last_conn_interval_min   = little_endian_read_16(command, 5);
+            last_conn_interval_max   = little_endian_read_16(command, 7);
+            last_conn_latency        = little_endian_read_16(command, 9);
+            last_supervision_timeout = little_endian_read_16(command, 11);
+            controller_send_command_status(opcode, controller_connection_update_status);
+            continue;
+        }
+        controller_send_command_complete(opcode);
+    }
+}
+
+static void controller_send_connection_update_complete(hci_con_handle_t con_handle, uint8_t status){
+    uint8_t params[9];
+    params[0] = status;
+    little_endian_store_16(params, 1, con_handle);
+    little_endian_store_16(params, 3, last_conn_interval_max);
+    little_endian_store_16(params, 5, last_conn_latency);
+    little_endian_store_16(params, 7, last_supervision_timeout);
+    controller_send_le_event(HCI_SUBEVENT_LE_CONNECTION_UPDATE_COMPLETE, params, sizeof(params));
+    controller_process_commands();
+}
+
+static void controller_send_connection_complete(hci_con_handle_t con_handle, uint8_t role){
+    uint8_t params[18];
+    memset(params, 0, sizeof(params));
+    params[0] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(params, 1, con_handle);
+    params[3] = role;
+    params[4] = BD_ADDR_TYPE_LE_PUBLIC;
+    params[5] = (uint8_t) con_handle;
+    params[10] = 0xC0;
+    little_endian_store_16(params, 11, 0x0018);
+    little_endian_store_16(params, 15, 0x0048);
+    controller_send_le_event(HCI_SUBEVENT_LE_CONNECTION_COMPLETE, params, sizeof(params));
+    controller_process_commands();
+}
+
+static void controller_send_number_of_completed_packets(hci_con_handle_t con_handle){
+    uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, 0, 0, 1, 0 };
+    little_endian_store_16(event, 3, con_handle);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+// application sends ATT PDU, Controller reports it as sent
+static void send_acl_packet(hci_con_handle_t con_handle){
+    CHECK(hci_reserve_packet_buffer());
+    uint8_t * acl_buffer = hci_get_outgoing_packet_buffer();
+    little_endian_store_16(acl_buffer, 0, con_handle | (0x02 << 12));
+    little_endian_store_16(acl_buffer, 2, 5);
+    little_endian_store_16(acl_buffer, 4, 1);
+    little_endian_store_16(acl_buffer, 6, TEST_ATT_CID);
+    acl_buffer[8] = 0x52;
+    hci_send_acl_packet_buffer(9);
+    controller_send_number_of_completed_packets(con_handle);
+}
+
+static void check_update(int expected_num_updates, uint16_t conn_interval_min, uint16_t conn_interval_max, uint16_t conn_latency, uint16_t supervision_timeout){
+    CHECK_EQUAL(expected_num_updates, num_connection_updates);
+    CHECK_EQUAL(conn_interval_min, last_conn_interval_min);
+    CHECK_EQUAL(conn_interval_max, last_conn_interval_max);
+    CHECK_EQUAL(conn_latency, last_conn_latency);
+    CHECK_EQUAL(supervision_timeout, last_supervision_timeout);
+}
+
+// advance time to idle timeout
+static void fire_idle_timer(void){
+    btstack_timer_source_t * ts = active_timer;
+    CHECK(ts != NULL);
+    active_timer = NULL;
+    current_time_ms = ts->timeout;
+    ts->process(ts);
+    controller_process_commands();
+}
+
+TEST_GROUP(ConnectionProfile){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_connection_update_status = ERROR_CODE_SUCCESS;
+        num_connection_updates = 0;
+        last_conn_interval_min = 0;
+        last_conn_interval_max = 0;
+        last_conn_latency = 0;
+        last_supervision_timeout = 0;
+        active_timer = NULL;
+        current_time_ms = 0;
+        hci_init(&test_transport, NULL);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(ConnectionProfile, ManualByDefault){
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    send_acl_packet(TEST_CON_HANDLE);
+    CHECK_EQUAL(0, num_connection_updates);
+    CHECK(active_timer == NULL);
+}
+
+TEST(ConnectionProfile, InvalidArguments){
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, gap_le_connection_profile_set_parameters(GAP_LE_CONNECTION_PROFILE_ADAPTIVE, 6, 12, 0, 200));
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    CHECK_EQUAL(ERROR_CODE_INVALID_HCI_COMMAND_PARAMETERS, gap_le_connection_set_profile(TEST_CON_HANDLE, (gap_le_connection_profile_t) 0x10));
+}
+
+TEST(ConnectionProfile, FixedProfile){
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    controller_process_commands();
+    check_update(1, 6, 12, 0, 200);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    // fixed profile does not track activity
+    send_acl_packet(TEST_CON_HANDLE);
+    CHECK(active_timer == NULL);
+    CHECK_EQUAL(1, num_connection_updates);
+    // same profile again is ignored
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    controller_process_commands();
+    CHECK_EQUAL(1, num_connection_updates);
+}
+
+TEST(ConnectionProfile, DefaultProfileWithCustomParameters){
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_profile_set_parameters(GAP_LE_CONNECTION_PROFILE_POWER_SAVE, 80, 100, 2, 500));
+    gap_le_connection_set_default_profile(GAP_LE_CONNECTION_PROFILE_POWER_SAVE);
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    check_update(1, 80, 100, 2, 500);
+}
+
+TEST(ConnectionProfile, ActiveIdleActive){
+    gap_le_connection_set_default_profile(GAP_LE_CONNECTION_PROFILE_ADAPTIVE);
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    // active: bulk transfer for service discovery
+    check_update(1, 6, 24, 0, 400);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    // traffic within idle timeout keeps bulk transfer
+    current_time_ms = 1500;
+    send_acl_packet(TEST_CON_HANDLE);
+    fire_idle_timer();
+    CHECK_EQUAL(LE_CONNECTION_PROFILE_IDLE_TIMEOUT_MS, current_time_ms);
+    CHECK_EQUAL(1, num_connection_updates);
+    // idle: power save, timer stops
+    fire_idle_timer();
+    check_update(2, 160, 320, 4, 600);
+    CHECK(active_timer == NULL);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    // active again
+    current_time_ms += 10000;
+    send_acl_packet(TEST_CON_HANDLE);
+    check_update(3, 6, 24, 0, 400);
+    CHECK(active_timer != NULL);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    // and idle again
+    fire_idle_timer();
+    check_update(4, 160, 320, 4, 600);
+}
+
+TEST(ConnectionProfile, SingleUpdateInFlight){
+    gap_le_connection_set_default_profile(GAP_LE_CONNECTION_PROFILE_ADAPTIVE);
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    check_update(1, 6, 24, 0, 400);
+    // idle before bulk transfer update completed
+    fire_idle_timer();
+    CHECK_EQUAL(1, num_connection_updates);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    check_update(2, 160, 320, 4, 600);
+    // application overrides while power save update is ongoing
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    controller_process_commands();
+    CHECK_EQUAL(2, num_connection_updates);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    check_update(3, 6, 12, 0, 200);
+}
+
+TEST(ConnectionProfile, RejectedUpdate){
+    controller_connection_update_status = ERROR_CODE_COMMAND_DISALLOWED;
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    controller_process_commands();
+    check_update(1, 6, 12, 0, 200);
+    // no Connection Update Complete follows, next profile is not blocked
+    controller_connection_update_status = ERROR_CODE_SUCCESS;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_POWER_SAVE));
+    controller_process_commands();
+    check_update(2, 160, 320, 4, 600);
+}
+
+TEST(ConnectionProfile, FailedUpdate){
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_LOW_LATENCY));
+    controller_process_commands();
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_set_profile(TEST_CON_HANDLE, GAP_LE_CONNECTION_PROFILE_POWER_SAVE));
+    controller_process_commands();
+    CHECK_EQUAL(1, num_connection_updates);
+    // remote did not accept parameters
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_UNSUPPORTED_LMP_PARAMETER_VALUE_UNSUPPORTED_LL_PARAMETER_VALUE);
+    check_update(2, 160, 320, 4, 600);
+}
+
+TEST(ConnectionProfile, PerConnection){
+    gap_le_connection_set_default_profile(GAP_LE_CONNECTION_PROFILE_ADAPTIVE);
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_MASTER);
+    controller_send_connection_update_complete(TEST_CON_HANDLE, ERROR_CODE_SUCCESS);
+    gap_le_connection_set_default_profile(GAP_LE_CONNECTION_PROFILE_MANUAL);
+    controller_send_connection_complete(TEST_CON_HANDLE + 1, HCI_ROLE_MASTER);
+    CHECK_EQUAL(1, num_connection_updates);
+    // only adaptive connection becomes idle
+    current_time_ms = 1000;
+    send_acl_packet(TEST_CON_HANDLE + 1);
+    fire_idle_timer();
+    check_update(2, 160, 320, 4, 600);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,374 @@
+// *****************************************************************************
+//
+// test LE Extended Scanning, Connection Creation and Advertising Report reassembly
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+
+// max data length in single HCI LE Extended Advertising Report
+#define MAX_FRAGMENT_LEN 229
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// last command with requested opcode
+static uint16_t captured_opcode;
+static uint8_t  captured_command[HCI_CMD_HEADER_SIZE + 255];
+static int      captured_command_len;
+
+// last GAP_EVENT_EXTENDED_ADVERTISING_REPORT
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static int      num_extended_reports;
+static int      num_legacy_reports;
+static bd_addr_t report_address;
+static uint8_t  report_data_status;
+static uint16_t report_data_len;
+static uint8_t  report_data[LE_EXTENDED_ADVERTISING_MAX_DATA_LEN];
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    (void) ts;
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    (void) ts;
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    if (little_endian_read_16(packet, 0) == captured_opcode){
+        memcpy(captured_command, packet, size);
+        captured_command_len = size;
+    }
+    return 0;
+}
+
+// synchronous transport: no can_send_packet_now
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint16_t opcode = little_endian_read_16(pending_commands[0], 0);
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        if (opcode == hci_le_extended_create_connection.opcode){
+            controller_send_command_status(opcode);
+        } else {
+            controller_send_command_complete(opcode);
+        }
+    }
+}
+
+static void capture_command(const hci_cmd_t * cmd){
+    captured_opcode = cmd->opcode;
+    captured_command_len = 0;
+}
+
+static void check_per_phy_parameters(const uint8_t * expected, int expected_len, int offset, int num_phys){
+    CHECK_EQUAL(offset + num_phys * expected_len, captured_command_len);
+    CHECK_EQUAL(captured_command_len - HCI_CMD_HEADER_SIZE, captured_command[2]);
+    int i;
+    for (i=0;i<num_phys;i++){
+        MEMCMP_EQUAL(expected, &captured_command[offset + i * expected_len], expected_len);
+    }
+}
+
+static bd_addr_t peer_address = { 0xC0, 0x01, 0x02, 0x03, 0x04, 0x05 };
+static bd_addr_t advertiser_a = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A };
+static bd_addr_t advertiser_b = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0B };
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    (void) channel;
+    (void) size;
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case GAP_EVENT_ADVERTISING_REPORT:
+            num_legacy_reports++;
+            break;
+        case GAP_EVENT_EXTENDED_ADVERTISING_REPORT:
+            num_extended_reports++;
+            gap_event_extended_advertising_report_get_address(packet, report_address);
+            report_data_status = (gap_event_extended_advertising_report_get_advertising_event_type(packet) >> 5) & 0x03;
+            report_data_len = gap_event_extended_advertising_report_get_data_length(packet);
+            memcpy(report_data, gap_event_extended_advertising_report_get_data(packet), report_data_len);
+            break;
+        default:
+            break;
+    }
+}
+
+// send HCI LE Extended Advertising Report with single report, data status: 0 = complete, 1 = more to come
+static void controller_send_extended_advertising_report(const bd_addr_t address, uint16_t event_type, uint8_t data_status, const uint8_t * data, uint8_t data_len){
+    uint8_t event[4 + 24 + MAX_FRAGMENT_LEN];
+    int pos = 0;
+    event[pos++] = HCI_EVENT_LE_META;
+    event[pos++] = 0;
+    event[pos++] = HCI_SUBEVENT_LE_EXTENDED_ADVERTISING_REPORT;
+    event[pos++] = 1;       // num reports
+    little_endian_store_16(event, pos, event_type | (data_status << 5));
+    pos += 2;
+    event[pos++] = 0;       // public address
+    reverse_bd_addr(address, &event[pos]);
+    pos += 6;
+    event[pos++] = 1;       // primary phy: LE 1M
+    event[pos++] = 2;       // secondary phy: LE 2M
+    event[pos++] = 0;       // advertising sid
+    event[pos++] = 0x7f;    // tx power: not available
+    event[pos++] = 0xc0;    // rssi
+    little_endian_store_16(event, pos, 0);  // periodic advertising interval
+    pos += 2;
+    event[pos++] = 0;       // direct address type
+    memset(&event[pos], 0, 6);
+    pos += 6;
+    event[pos++] = data_len;
+    memcpy(&event[pos], data, data_len);
+    pos += data_len;
+    event[1] = pos - 2;
+    hci_packet_handler(HCI_EVENT_PACKET, event, pos);
+}
+
+// send advertising data in fragments of given size
+static void controller_send_fragmented_advertising_data(const bd_addr_t address, const uint8_t * data, uint16_t data_len, uint8_t fragment_len){
+    uint16_t pos = 0;
+    while (pos < data_len){
+        uint8_t bytes_to_send = (uint8_t) btstack_min(fragment_len, data_len - pos);
+        uint8_t data_status = (pos + bytes_to_send < data_len) ? 1 : 0;
+        controller_send_extended_advertising_report(address, 0, data_status, &data[pos], bytes_to_send);
+        pos += bytes_to_send;
+    }
+}
+
+TEST_GROUP(ExtendedScanning){
+    void setup(void){
+        num_pending_commands = 0;
+        captured_opcode = 0;
+        captured_command_len = 0;
+        hci_init(&test_transport, NULL);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(ExtendedScanning, ScanParametersOnePhy){
+    capture_command(&hci_le_set_extended_scan_parameters);
+    gap_set_scan_phys(0x01);
+    gap_set_scan_parameters(1, 0x0030, 0x0020);
+    gap_start_scan();
+    controller_process_commands();
+    // own address type, filter policy, scanning phys
+    CHECK_EQUAL(0x01, captured_command[5]);
+    // scan type, scan interval, scan window
+    const uint8_t expected[] = { 0x01, 0x30, 0x00, 0x20, 0x00 };
+    check_per_phy_parameters(expected, sizeof(expected), 6, 1);
+}
+
+TEST(ExtendedScanning, ScanParametersTwoPhys){
+    capture_command(&hci_le_set_extended_scan_parameters);
+    gap_set_scan_phys(0x05);
+    gap_set_scan_parameters(1, 0x0030, 0x0020);
+    gap_start_scan();
+    controller_process_commands();
+    CHECK_EQUAL(0x05, captured_command[5]);
+    // LE 1M parameters followed by LE Coded parameters
+    const uint8_t expected[] = { 0x01, 0x30, 0x00, 0x20, 0x00 };
+    check_per_phy_parameters(expected, sizeof(expected), 6, 2);
+}
+
+TEST(ExtendedScanning, CreateConnectionTwoPhys){
+    capture_command(&hci_le_extended_create_connection);
+    gap_set_scan_phys(0x05);
+    gap_set_connection_parameters(0x0060, 0x0030, 0x0008, 0x0018, 4, 0x0048, 2, 0x0030);
+    CHECK_EQUAL(0, gap_connect(peer_address, BD_ADDR_TYPE_LE_PUBLIC));
+    controller_process_commands();
+    // initiator filter policy, own address type, peer address type, peer address, initiating phys
+    CHECK_EQUAL(0x05, captured_command[12]);
+    // scan interval, scan window, connection interval min/max, latency, supervision timeout, min/max CE length
+    const uint8_t expected[] = { 0x60, 0x00, 0x30, 0x00, 0x08, 0x00, 0x18, 0x00, 0x04, 0x00, 0x48, 0x00, 0x02, 0x00, 0x30, 0x00 };
+    check_per_phy_parameters(expected, sizeof(expected), 13, 2);
+}
+
+TEST_GROUP(ExtendedAdvertisingReport){
+    uint8_t data[LE_EXTENDED_ADVERTISING_MAX_DATA_LEN + 2 * MAX_FRAGMENT_LEN];
+
+    void setup(void){
+        num_pending_commands = 0;
+        captured_opcode = 0;
+        num_extended_reports = 0;
+        num_legacy_reports = 0;
+        hci_init(&test_transport, NULL);
+        hci_event_callback_registration.callback = &packet_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+        hci_power_control(HCI_POWER_ON);
+        gap_start_scan();
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+        unsigned int i;
+        for (i=0;i<sizeof(data);i++){
+            data[i] = (uint8_t) (i * 7);
+        }
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(ExtendedAdvertisingReport, Complete){
+    controller_send_extended_advertising_report(advertiser_a, 0, 0, data, 20);
+    CHECK_EQUAL(1, num_extended_reports);
+    CHECK_EQUAL(0, report_data_status);
+    CHECK_EQUAL(20, report_data_len);
+    MEMCMP_EQUAL(data, report_data, 20);
+}
+
+TEST(ExtendedAdvertisingReport, Fragmented){
+    controller_send_fragmented_advertising_data(advertiser_a, data, 500, 200);
+    CHECK_EQUAL(1, num_extended_reports);
+    MEMCMP_EQUAL(advertiser_a, report_address, 6);
+    CHECK_EQUAL(0, report_data_status);
+    CHECK_EQUAL(500, report_data_len);
+    MEMCMP_EQUAL(data, report_data, 500);
+}
+
+TEST(ExtendedAdvertisingReport, InterleavedAdvertisers){
+    // first fragment of advertiser A, complete report from advertiser B
+    controller_send_extended_advertising_report(advertiser_a, 0, 1, data, 100);
+    CHECK_EQUAL(0, num_extended_reports);
+    controller_send_extended_advertising_report(advertiser_b, 0, 0, &data[100], 50);
+    CHECK_EQUAL(1, num_extended_reports);
+    MEMCMP_EQUAL(advertiser_b, report_address, 6);
+    CHECK_EQUAL(0, report_data_status);
+    CHECK_EQUAL(50, report_data_len);
+    MEMCMP_EQUAL(&data[100], report_data, 50);
+
+    // incomplete report of advertiser A has been dropped, next report starts from scratch
+    controller_send_fragmented_advertising_data(advertiser_a, &data[200], 300, 200);
+    CHECK_EQUAL(2, num_extended_reports);
+    MEMCMP_EQUAL(advertiser_a, report_address, 6);
+    CHECK_EQUAL(300, report_data_len);
+    MEMCMP_EQUAL(&data[200], report_data, 300);
+}
+
+TEST(ExtendedAdvertisingReport, Truncated){
+    controller_send_fragmented_advertising_data(advertiser_a, data, sizeof(data), MAX_FRAGMENT_LEN);
+    CHECK_EQUAL(1, num_extended_reports);
+    // data status: incomplete, truncated
+    CHECK_EQUAL(2, report_data_status);
+    CHECK_EQUAL(LE_EXTENDED_ADVERTISING_MAX_DATA_LEN, report_data_len);
+    MEMCMP_EQUAL(data, report_data, LE_EXTENDED_ADVERTISING_MAX_DATA_LEN);
+
+    // next report is not affected
+    controller_send_fragmented_advertising_data(advertiser_b, data, 300, 200);
+    CHECK_EQUAL(2, num_extended_reports);
+    CHECK_EQUAL(0, report_data_status);
+    CHECK_EQUAL(300, report_data_len);
+}
+
+TEST(ExtendedAdvertisingReport, LegacyPdu){
+    // ADV_IND with legacy PDU
+    controller_send_extended_advertising_report(advertiser_a, 0x13, 0, data, 20);
+    CHECK_EQUAL(0, num_extended_reports);
+    CHECK_EQUAL(1, num_legacy_reports);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,364 @@
+// *****************************************************************************
+//
+// test LE Data Length and PHY auto negotiation
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+#define TEST_CON_HANDLE      0x0040
+
+// LE features
+#define FEATURE_DATA_LENGTH_EXTENSION 0x0020
+#define FEATURE_2M_PHY                0x0100
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static int      controller_supports_dle_and_phy;
+static uint16_t controller_remote_features;
+static uint16_t controller_max_octets;
+static int      num_read_remote_features;
+static int      num_set_data_length;
+static int      num_set_phy;
+static uint8_t  last_set_phy_tx_phys;
+static uint8_t  last_set_phy_rx_phys;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    } else if (opcode == hci_read_local_supported_commands.opcode && controller_supports_dle_and_phy){
+        // LE Write Suggested Default Data Length, LE Read Maximum Data Length, LE Set Default PHY
+        event[6 + 34] = 0x01;
+        event[6 + 35] = 0x08 | 0x20;
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_le_event(uint8_t subevent, const uint8_t * params, uint8_t params_len){
+    uint8_t event[2 + 255];
+    event[0] = HCI_EVENT_LE_META;
+    event[1] = 1 + params_len;
+    event[2] = subevent;
+    memcpy(&event[3], params, params_len);
+    hci_packet_handler(HCI_EVENT_PACKET, event, 3 + params_len);
+}
+
+static void controller_send_remote_features_complete(hci_con_handle_t con_handle){
+    uint8_t params[11];
+    memset(params, 0, sizeof(params));
+    little_endian_store_16(params, 1, con_handle);
+    little_endian_store_16(params, 3, controller_remote_features);
+    controller_send_le_event(HCI_SUBEVENT_LE_READ_REMOTE_USED_FEATURES_COMPLETE, params, sizeof(params));
+}
+
+static void controller_send_data_length_change(hci_con_handle_t con_handle, uint16_t octets){
+    uint8_t params[10];
+    little_endian_store_16(params, 0, con_handle);
+    little_endian_store_16(params, 2, octets);
+    little_endian_store_16(params, 4, 2120);
+    little_endian_store_16(params, 6, octets);
+    little_endian_store_16(params, 8, 2120);
+    controller_send_le_event(HCI_SUBEVENT_LE_DATA_LENGTH_CHANGE, params, sizeof(params));
+}
+
+static void controller_send_phy_update_complete(hci_con_handle_t con_handle, uint8_t tx_phy, uint8_t rx_phy){
+    uint8_t params[5];
+    params[0] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(params, 1, con_handle);
+    params[3] = tx_phy;
+    params[4] = rx_phy;
+    controller_send_le_event(HCI_SUBEVENT_LE_PHY_UPDATE_COMPLETE, params, sizeof(params));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        hci_con_handle_t con_handle = little_endian_read_16(command, 3);
+        if (opcode == hci_le_read_remote_used_features.opcode){
+            num_read_remote_features++;
+            controller_send_command_status(opcode);
+            controller_send_remote_features_complete(con_handle);
+            continue;
+        }
+        if (opcode == hci_le_set_phy.opcode){
+            num_set_phy++;
+            last_set_phy_tx_phys = command[6];
+            last_set_phy_rx_phys = command[7];
+            controller_send_command_status(opcode);
+            // select fastest requested PHY supported by remote
+            uint8_t phy = ((command[6] & 2) && (controller_remote_features & FEATURE_2M_PHY)) ? 2 : 1;
+            controller_send_phy_update_complete(con_handle, phy, phy);
+            continue;
+        }
+        controller_send_command_complete(opcode);
+        if (opcode == hci_le_set_data_length.opcode){
+            num_set_data_length++;
+            uint16_t tx_octets = little_endian_read_16(command, 5);
+            controller_send_data_length_change(con_handle, btstack_min(tx_octets, controller_max_octets));
+        }
+    }
+}
+
+static void controller_send_connection_complete(hci_con_handle_t con_handle, uint8_t role){
+    uint8_t params[18];
+    memset(params, 0, sizeof(params));
+    params[0] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(params, 1, con_handle);
+    params[3] = role;
+    params[4] = BD_ADDR_TYPE_LE_PUBLIC;
+    params[5] = (uint8_t) con_handle;
+    params[10] = 0xC0;
+    little_endian_store_16(params, 11, 0x0018);
+    little_endian_store_16(params, 15, 0x0048);
+    controller_send_le_event(HCI_SUBEVENT_LE_CONNECTION_COMPLETE, params, sizeof(params));
+}
+
+static void connect(void){
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_SLAVE);
+    controller_process_commands();
+}
+
+static void check_phy(uint8_t expected_tx_phy, uint8_t expected_rx_phy){
+    uint8_t tx_phy;
+    uint8_t rx_phy;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_phy(TEST_CON_HANDLE, &tx_phy, &rx_phy));
+    CHECK_EQUAL(expected_tx_phy, tx_phy);
+    CHECK_EQUAL(expected_rx_phy, rx_phy);
+}
+
+static void check_data_length(uint16_t expected_octets){
+    uint16_t max_tx_octets;
+    uint16_t max_rx_octets;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_data_length(TEST_CON_HANDLE, &max_tx_octets, &max_rx_octets));
+    CHECK_EQUAL(expected_octets, max_tx_octets);
+    CHECK_EQUAL(expected_octets, max_rx_octets);
+}
+
+static void power_on(void){
+    hci_init(&test_transport, NULL);
+    hci_power_control(HCI_POWER_ON);
+    controller_process_commands();
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+}
+
+TEST_GROUP(LinkNegotiation){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_supports_dle_and_phy = 1;
+        controller_remote_features = FEATURE_DATA_LENGTH_EXTENSION | FEATURE_2M_PHY;
+        controller_max_octets = 251;
+        num_read_remote_features = 0;
+        num_set_data_length = 0;
+        num_set_phy = 0;
+        last_set_phy_tx_phys = 0;
+        last_set_phy_rx_phys = 0;
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(LinkNegotiation, Defaults){
+    controller_remote_features = 0;
+    power_on();
+    connect();
+    check_data_length(27);
+    check_phy(1, 1);
+}
+
+TEST(LinkNegotiation, UnknownConnection){
+    power_on();
+    uint16_t octets;
+    uint8_t phy;
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, gap_le_connection_data_length(TEST_CON_HANDLE, &octets, &octets));
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, gap_le_connection_phy(TEST_CON_HANDLE, &phy, &phy));
+}
+
+TEST(LinkNegotiation, DataLengthAnd2MPhy){
+    power_on();
+    connect();
+    CHECK_EQUAL(1, num_read_remote_features);
+    CHECK_EQUAL(1, num_set_data_length);
+    CHECK_EQUAL(1, num_set_phy);
+    CHECK_EQUAL(2, last_set_phy_tx_phys);
+    CHECK_EQUAL(2, last_set_phy_rx_phys);
+    check_data_length(251);
+    check_phy(2, 2);
+}
+
+TEST(LinkNegotiation, DataLengthLimitedByRemote){
+    controller_max_octets = 100;
+    controller_remote_features = FEATURE_DATA_LENGTH_EXTENSION;
+    power_on();
+    connect();
+    CHECK_EQUAL(1, num_set_data_length);
+    CHECK_EQUAL(0, num_set_phy);
+    check_data_length(100);
+    check_phy(1, 1);
+}
+
+TEST(LinkNegotiation, RemoteWithout2MPhy){
+    controller_remote_features = FEATURE_DATA_LENGTH_EXTENSION;
+    power_on();
+    connect();
+    CHECK_EQUAL(0, num_set_phy);
+    check_phy(1, 1);
+}
+
+TEST(LinkNegotiation, RemoteWithoutFeatures){
+    controller_remote_features = 0;
+    power_on();
+    connect();
+    CHECK_EQUAL(1, num_read_remote_features);
+    CHECK_EQUAL(0, num_set_data_length);
+    CHECK_EQUAL(0, num_set_phy);
+}
+
+TEST(LinkNegotiation, LocalControllerWithoutSupport){
+    controller_supports_dle_and_phy = 0;
+    power_on();
+    connect();
+    CHECK_EQUAL(0, num_read_remote_features);
+    CHECK_EQUAL(0, num_set_data_length);
+    CHECK_EQUAL(0, num_set_phy);
+}
+
+TEST(LinkNegotiation, ApplicationPhyRequestWins){
+    power_on();
+    controller_send_connection_complete(TEST_CON_HANDLE, HCI_ROLE_SLAVE);
+    // application requests 1M PHY before remote features are known
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_set_phy(TEST_CON_HANDLE, 0, 1, 1, 0));
+    controller_process_commands();
+    CHECK_EQUAL(1, num_set_phy);
+    CHECK_EQUAL(1, last_set_phy_tx_phys);
+    CHECK_EQUAL(1, last_set_phy_rx_phys);
+    check_phy(1, 1);
+    // data length is negotiated anyway
+    check_data_length(251);
+}
+
+TEST(LinkNegotiation, PerConnection){
+    power_on();
+    connect();
+    controller_remote_features = 0;
+    controller_send_connection_complete(TEST_CON_HANDLE + 1, HCI_ROLE_SLAVE);
+    controller_process_commands();
+    check_phy(2, 2);
+    uint8_t tx_phy;
+    uint8_t rx_phy;
+    CHECK_EQUAL(ERROR_CODE_SUCCESS, gap_le_connection_phy(TEST_CON_HANDLE + 1, &tx_phy, &rx_phy));
+    CHECK_EQUAL(1, tx_phy);
+    CHECK_EQUAL(1, rx_phy);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
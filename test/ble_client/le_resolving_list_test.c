@@ -0,0 +1,423 @@
+// *****************************************************************************
+//
+// test LE resolving list synchronization with le_device_db
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "ble/le_device_db.h"
+#include "ble/le_device_db_tlv.h"
+#include "btstack_tlv.h"
+#include "btstack_tlv_flash_bank.h"
+#include "hal_flash_bank.h"
+#include "hal_flash_bank_memory.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define RESOLVING_LIST_CAPACITY 4
+#define MAX_PENDING_COMMANDS 10
+#define HAL_FLASH_BANK_MEMORY_STORAGE_SIZE 512
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static bd_addr_t controller_resolving_list[RESOLVING_LIST_CAPACITY];
+static int       controller_resolving_list_count;
+static int       controller_resolving_list_capacity;
+static int       controller_address_resolution_enabled;
+static int       controller_scanning;
+static int       controller_advertising;
+static int       controller_initiating;
+static int       controller_disable_status;
+static int       num_address_resolution_commands;
+
+// le_device_db
+static uint8_t                  hal_flash_bank_memory_storage[HAL_FLASH_BANK_MEMORY_STORAGE_SIZE];
+static hal_flash_bank_memory_t  hal_flash_bank_context;
+static btstack_tlv_flash_bank_t btstack_tlv_context;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static int controller_le_activity_active(void){
+    return controller_scanning || controller_advertising || controller_initiating;
+}
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode, uint8_t status){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    event[5] = status;
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    } else if (opcode == hci_le_read_resolving_list_size.opcode){
+        event[6] = controller_resolving_list_capacity;
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// returns status
+static uint8_t controller_set_address_resolution_enable(uint8_t enable){
+    num_address_resolution_commands++;
+    if (controller_le_activity_active()) return ERROR_CODE_COMMAND_DISALLOWED;
+    if (enable == 0 && controller_disable_status) return controller_disable_status;
+    controller_address_resolution_enabled = enable;
+    return ERROR_CODE_SUCCESS;
+}
+
+// resolving list cannot be modified while address resolution is used
+static uint8_t controller_resolving_list_modify_status(void){
+    if (controller_address_resolution_enabled && controller_le_activity_active()) return ERROR_CODE_COMMAND_DISALLOWED;
+    return ERROR_CODE_SUCCESS;
+}
+
+static uint8_t controller_resolving_list_add(const uint8_t * command){
+    uint8_t status = controller_resolving_list_modify_status();
+    if (status) return status;
+    if (controller_resolving_list_count >= controller_resolving_list_capacity) return ERROR_CODE_MEMORY_CAPACITY_EXCEEDED;
+    reverse_bd_addr(&command[4], controller_resolving_list[controller_resolving_list_count++]);
+    return ERROR_CODE_SUCCESS;
+}
+
+static uint8_t controller_resolving_list_clear(void){
+    uint8_t status = controller_resolving_list_modify_status();
+    if (status) return status;
+    controller_resolving_list_count = 0;
+    return ERROR_CODE_SUCCESS;
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        uint8_t status = ERROR_CODE_SUCCESS;
+        if (opcode == hci_le_create_connection.opcode){
+            controller_initiating = 1;
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_reset.opcode){
+            controller_resolving_list_count = 0;
+            controller_address_resolution_enabled = 0;
+            controller_scanning = 0;
+            controller_advertising = 0;
+            controller_initiating = 0;
+        } else if (opcode == hci_le_set_scan_enable.opcode){
+            controller_scanning = command[3];
+        } else if (opcode == hci_le_set_advertise_enable.opcode){
+            controller_advertising = command[3];
+        } else if (opcode == hci_le_set_address_resolution_enabled.opcode){
+            status = controller_set_address_resolution_enable(command[3]);
+        } else if (opcode == hci_le_clear_resolving_list.opcode){
+            status = controller_resolving_list_clear();
+        } else if (opcode == hci_le_add_device_to_resolving_list.opcode){
+            status = controller_resolving_list_add(command);
+        }
+        controller_send_command_complete(opcode, status);
+    }
+}
+
+// connection established as Central, address in little endian
+static void controller_send_connection_complete(const bd_addr_t address){
+    controller_initiating = 0;
+    uint8_t event[21];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_LE_META;
+    event[1] = sizeof(event) - 2;
+    event[2] = HCI_SUBEVENT_LE_CONNECTION_COMPLETE;
+    event[3] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 4, 0x0040);
+    event[6] = HCI_ROLE_MASTER;
+    event[7] = BD_ADDR_TYPE_LE_PUBLIC;
+    reverse_bd_addr(address, &event[8]);
+    little_endian_store_16(event, 14, 0x0018);
+    little_endian_store_16(event, 18, 0x0048);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static int controller_resolving_list_contains(const bd_addr_t address){
+    int i;
+    for (i=0;i<controller_resolving_list_count;i++){
+        if (bd_addr_cmp(controller_resolving_list[i], address) == 0) return 1;
+    }
+    return 0;
+}
+
+static bd_addr_t address_a = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A };
+static bd_addr_t address_b = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0B };
+static bd_addr_t address_c = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0C };
+
+static sm_key_t local_irk = { 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07, 0x08, 0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f, 0x10 };
+
+static void add_bonded_device(bd_addr_t address, uint8_t irk_byte){
+    sm_key_t irk;
+    memset(irk, irk_byte, 16);
+    CHECK(le_device_db_add(BD_ADDR_TYPE_LE_PUBLIC, address, irk) >= 0);
+}
+
+TEST_GROUP(ResolvingList){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_resolving_list_count = 0;
+        controller_resolving_list_capacity = RESOLVING_LIST_CAPACITY;
+        controller_address_resolution_enabled = 0;
+        controller_scanning = 0;
+        controller_advertising = 0;
+        controller_initiating = 0;
+        controller_disable_status = ERROR_CODE_SUCCESS;
+        num_address_resolution_commands = 0;
+        const hal_flash_bank_t * hal_flash_bank_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_memory_storage, HAL_FLASH_BANK_MEMORY_STORAGE_SIZE);
+        hal_flash_bank_impl->erase(&hal_flash_bank_context, 0);
+        hal_flash_bank_impl->erase(&hal_flash_bank_context, 1);
+        const btstack_tlv_t * btstack_tlv_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+        le_device_db_tlv_configure(btstack_tlv_impl, &btstack_tlv_context);
+        le_device_db_init();
+        hci_init(&test_transport, NULL);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(ResolvingList, Load){
+    add_bonded_device(address_a, 0x11);
+    add_bonded_device(address_b, 0x22);
+    // device without IRK uses identity address
+    add_bonded_device(address_c, 0x00);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+    CHECK(controller_resolving_list_contains(address_a));
+    CHECK(controller_resolving_list_contains(address_b));
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+}
+
+TEST(ResolvingList, NoEntries){
+    add_bonded_device(address_c, 0x00);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(0, controller_resolving_list_count);
+    CHECK_EQUAL(0, controller_address_resolution_enabled);
+}
+
+TEST(ResolvingList, Capacity){
+    controller_resolving_list_capacity = 1;
+    add_bonded_device(address_a, 0x11);
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+}
+
+TEST(ResolvingList, Reload){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_resolving_list_count);
+
+    // new bond
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+}
+
+TEST(ResolvingList, PauseAndResumeScanning){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    gap_start_scan();
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_scanning);
+
+    // list modification would be rejected by Controller while scanning
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+    CHECK_EQUAL(1, controller_scanning);
+}
+
+TEST(ResolvingList, PauseAndResumeAdvertising){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    gap_advertisements_enable(1);
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_advertising);
+
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+    CHECK_EQUAL(1, controller_advertising);
+}
+
+TEST(ResolvingList, DeferredDuringDirectConnect){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(0, gap_connect(address_c, BD_ADDR_TYPE_LE_PUBLIC));
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_initiating);
+
+    // direct connection cannot be paused
+    num_address_resolution_commands = 0;
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(0, num_address_resolution_commands);
+    CHECK_EQUAL(1, controller_resolving_list_count);
+
+    // sync continues after connection has been established
+    controller_send_connection_complete(address_c);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+}
+
+TEST(ResolvingList, DisableFails){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    gap_start_scan();
+    controller_process_commands();
+
+    // current list is kept and scanning resumed
+    controller_disable_status = ERROR_CODE_UNSPECIFIED_ERROR;
+    add_bonded_device(address_b, 0x22);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+    CHECK_EQUAL(1, controller_scanning);
+
+    // next load succeeds
+    controller_disable_status = ERROR_CODE_SUCCESS;
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_resolving_list_count);
+}
+
+TEST(ResolvingList, ReloadAfterPowerCycle){
+    add_bonded_device(address_a, 0x11);
+    hci_le_resolving_list_load(local_irk);
+    controller_process_commands();
+    CHECK_EQUAL(1, controller_resolving_list_count);
+
+    // HCI Reset clears resolving list
+    hci_power_control(HCI_POWER_OFF);
+    controller_process_commands();
+    hci_power_control(HCI_POWER_ON);
+    controller_process_commands();
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    CHECK_EQUAL(1, controller_resolving_list_count);
+    CHECK_EQUAL(1, controller_address_resolution_enabled);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
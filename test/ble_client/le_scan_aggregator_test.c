@@ -0,0 +1,360 @@
+// *****************************************************************************
+//
+// test LE scan aggregator
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+#define MAX_RECEIVED_EVENTS  (LE_SCAN_AGGREGATOR_MAX_DEVICES + 5)
+#define FLUSH_INTERVAL_MS    1000
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// events received by application
+static btstack_packet_callback_registration_t hci_event_callback_registration;
+static uint8_t  received_events[MAX_RECEIVED_EVENTS][30];
+static int      num_received_events;
+static int      num_advertising_reports;
+
+// last timer registered with run loop
+static btstack_timer_source_t * active_timer;
+static uint32_t current_time_ms;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    active_timer = ts;
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    if (active_timer == ts){
+        active_timer = NULL;
+    }
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return current_time_ms;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint16_t opcode = little_endian_read_16(pending_commands[0], 0);
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        controller_send_command_complete(opcode);
+    }
+}
+
+// single advertising report with one byte of advertising data
+static void controller_send_advertising_report(const bd_addr_t address, int8_t rssi, uint8_t data){
+    uint8_t event[15];
+    int pos = 0;
+    event[pos++] = HCI_EVENT_LE_META;
+    event[pos++] = sizeof(event) - 2;
+    event[pos++] = HCI_SUBEVENT_LE_ADVERTISING_REPORT;
+    event[pos++] = 1;      // num reports
+    event[pos++] = 0;      // ADV_IND
+    event[pos++] = 0;      // public address
+    reverse_bd_addr(address, &event[pos]);
+    pos += 6;
+    event[pos++] = 1;
+    event[pos++] = data;
+    event[pos++] = (uint8_t) rssi;
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void hci_event_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    if (packet_type != HCI_EVENT_PACKET) return;
+    switch (hci_event_packet_get_type(packet)){
+        case GAP_EVENT_ADVERTISING_REPORT:
+            num_advertising_reports++;
+            break;
+        case GAP_EVENT_SCAN_AGGREGATE_DEVICE:
+        case GAP_EVENT_SCAN_AGGREGATE_COMPLETE:
+            CHECK(num_received_events < MAX_RECEIVED_EVENTS);
+            CHECK(size <= sizeof(received_events[0]));
+            memcpy(received_events[num_received_events++], packet, size);
+            break;
+        default:
+            break;
+    }
+}
+
+static void fire_flush_timer(void){
+    btstack_timer_source_t * ts = active_timer;
+    CHECK(ts != NULL);
+    active_timer = NULL;
+    ts->process(ts);
+}
+
+static const uint8_t * aggregate_for_address(const bd_addr_t address){
+    int i;
+    for (i=0;i<num_received_events;i++){
+        if (hci_event_packet_get_type(received_events[i]) != GAP_EVENT_SCAN_AGGREGATE_DEVICE) continue;
+        bd_addr_t device_address;
+        gap_event_scan_aggregate_device_get_address(received_events[i], device_address);
+        if (bd_addr_cmp(device_address, address) == 0) return received_events[i];
+    }
+    return NULL;
+}
+
+static const uint8_t * aggregate_complete(void){
+    CHECK(num_received_events > 0);
+    const uint8_t * event = received_events[num_received_events - 1];
+    CHECK_EQUAL(GAP_EVENT_SCAN_AGGREGATE_COMPLETE, hci_event_packet_get_type(event));
+    return event;
+}
+
+static bd_addr_t address_a = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A };
+static bd_addr_t address_b = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0B };
+
+TEST_GROUP(ScanAggregator){
+    void setup(void){
+        num_pending_commands = 0;
+        num_received_events = 0;
+        num_advertising_reports = 0;
+        active_timer = NULL;
+        current_time_ms = 0;
+        hci_init(&test_transport, NULL);
+        hci_event_callback_registration.callback = &hci_event_handler;
+        hci_add_event_handler(&hci_event_callback_registration);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+        gap_scan_aggregator_set_flush_interval(FLUSH_INTERVAL_MS);
+        gap_start_scan();
+        controller_process_commands();
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(ScanAggregator, Disabled){
+    gap_scan_aggregator_set_flush_interval(0);
+    CHECK(active_timer == NULL);
+    controller_send_advertising_report(address_a, -60, 0x01);
+    CHECK_EQUAL(1, num_advertising_reports);
+    CHECK_EQUAL(0, num_received_events);
+}
+
+TEST(ScanAggregator, AggregateReports){
+    current_time_ms = 100;
+    controller_send_advertising_report(address_a, -60, 0x01);
+    current_time_ms = 200;
+    controller_send_advertising_report(address_b, -40, 0x01);
+    current_time_ms = 300;
+    controller_send_advertising_report(address_a, -70, 0x01);
+    current_time_ms = 400;
+    controller_send_advertising_report(address_a, -50, 0x01);
+    // no reports while aggregating
+    CHECK_EQUAL(0, num_advertising_reports);
+    CHECK_EQUAL(0, num_received_events);
+
+    fire_flush_timer();
+    CHECK_EQUAL(3, num_received_events);
+    CHECK_EQUAL(2, gap_event_scan_aggregate_complete_get_num_devices(aggregate_complete()));
+    CHECK_EQUAL(0, gap_event_scan_aggregate_complete_get_num_reports_dropped(aggregate_complete()));
+
+    const uint8_t * device_a = aggregate_for_address(address_a);
+    CHECK(device_a != NULL);
+    CHECK_EQUAL(BD_ADDR_TYPE_LE_PUBLIC, gap_event_scan_aggregate_device_get_address_type(device_a));
+    CHECK_EQUAL(3,   gap_event_scan_aggregate_device_get_report_count(device_a));
+    CHECK_EQUAL(-70, (int8_t) gap_event_scan_aggregate_device_get_rssi_min(device_a));
+    CHECK_EQUAL(-50, (int8_t) gap_event_scan_aggregate_device_get_rssi_max(device_a));
+    int8_t rssi_avg = (int8_t) gap_event_scan_aggregate_device_get_rssi_avg(device_a);
+    CHECK(rssi_avg >= -70);
+    CHECK(rssi_avg <= -50);
+    CHECK_EQUAL(100, gap_event_scan_aggregate_device_get_first_seen_ms(device_a));
+    CHECK_EQUAL(400, gap_event_scan_aggregate_device_get_last_seen_ms(device_a));
+
+    const uint8_t * device_b = aggregate_for_address(address_b);
+    CHECK(device_b != NULL);
+    CHECK_EQUAL(1,   gap_event_scan_aggregate_device_get_report_count(device_b));
+    CHECK_EQUAL(-40, (int8_t) gap_event_scan_aggregate_device_get_rssi_min(device_b));
+    CHECK_EQUAL(-40, (int8_t) gap_event_scan_aggregate_device_get_rssi_max(device_b));
+    CHECK_EQUAL(-40, (int8_t) gap_event_scan_aggregate_device_get_rssi_avg(device_b));
+    CHECK_EQUAL(200, gap_event_scan_aggregate_device_get_first_seen_ms(device_b));
+    CHECK_EQUAL(200, gap_event_scan_aggregate_device_get_last_seen_ms(device_b));
+
+    // timer re-armed
+    CHECK(active_timer != NULL);
+}
+
+TEST(ScanAggregator, TableClearedAfterFlush){
+    controller_send_advertising_report(address_a, -60, 0x01);
+    fire_flush_timer();
+    CHECK_EQUAL(2, num_received_events);
+
+    // nothing to report
+    num_received_events = 0;
+    fire_flush_timer();
+    CHECK_EQUAL(0, num_received_events);
+
+    // new interval starts from scratch
+    current_time_ms = 2000;
+    controller_send_advertising_report(address_a, -80, 0x01);
+    fire_flush_timer();
+    CHECK_EQUAL(2, num_received_events);
+    const uint8_t * device_a = aggregate_for_address(address_a);
+    CHECK(device_a != NULL);
+    CHECK_EQUAL(1,    gap_event_scan_aggregate_device_get_report_count(device_a));
+    CHECK_EQUAL(-80,  (int8_t) gap_event_scan_aggregate_device_get_rssi_max(device_a));
+    CHECK_EQUAL(2000, gap_event_scan_aggregate_device_get_first_seen_ms(device_a));
+}
+
+TEST(ScanAggregator, DataHash){
+    controller_send_advertising_report(address_a, -60, 0x01);
+    controller_send_advertising_report(address_b, -60, 0x01);
+    fire_flush_timer();
+    uint32_t hash_a = gap_event_scan_aggregate_device_get_data_hash(aggregate_for_address(address_a));
+    uint32_t hash_b = gap_event_scan_aggregate_device_get_data_hash(aggregate_for_address(address_b));
+    CHECK_EQUAL(hash_a, hash_b);
+
+    // hash of last advertising data
+    num_received_events = 0;
+    controller_send_advertising_report(address_a, -60, 0x01);
+    controller_send_advertising_report(address_a, -60, 0x02);
+    fire_flush_timer();
+    CHECK(hash_a != gap_event_scan_aggregate_device_get_data_hash(aggregate_for_address(address_a)));
+}
+
+TEST(ScanAggregator, TableFull){
+    int num_devices = LE_SCAN_AGGREGATOR_MAX_DEVICES + 3;
+    int i;
+    for (i=0;i<num_devices;i++){
+        bd_addr_t address = { 0xC0, 0x00, 0x00, 0x00, 0x01, 0x00 };
+        address[5] = (uint8_t) i;
+        controller_send_advertising_report(address, -60, 0x01);
+    }
+    // known device still gets updated
+    bd_addr_t first_address = { 0xC0, 0x00, 0x00, 0x00, 0x01, 0x00 };
+    controller_send_advertising_report(first_address, -60, 0x01);
+
+    fire_flush_timer();
+    CHECK_EQUAL(LE_SCAN_AGGREGATOR_MAX_DEVICES + 1, num_received_events);
+    CHECK_EQUAL(LE_SCAN_AGGREGATOR_MAX_DEVICES, gap_event_scan_aggregate_complete_get_num_devices(aggregate_complete()));
+    CHECK_EQUAL(3, gap_event_scan_aggregate_complete_get_num_reports_dropped(aggregate_complete()));
+    CHECK_EQUAL(2, gap_event_scan_aggregate_device_get_report_count(aggregate_for_address(first_address)));
+
+    // dropped counter is reset with flush
+    num_received_events = 0;
+    controller_send_advertising_report(address_a, -60, 0x01);
+    fire_flush_timer();
+    CHECK_EQUAL(0, gap_event_scan_aggregate_complete_get_num_reports_dropped(aggregate_complete()));
+}
+
+TEST(ScanAggregator, FlushOnStopScan){
+    controller_send_advertising_report(address_a, -60, 0x01);
+    gap_stop_scan();
+    CHECK_EQUAL(2, num_received_events);
+    CHECK(aggregate_for_address(address_a) != NULL);
+    CHECK_EQUAL(1, gap_event_scan_aggregate_complete_get_num_devices(aggregate_complete()));
+}
+
+TEST(ScanAggregator, FlushOnDisable){
+    controller_send_advertising_report(address_a, -60, 0x01);
+    gap_scan_aggregator_set_flush_interval(0);
+    CHECK_EQUAL(2, num_received_events);
+    CHECK(aggregate_for_address(address_a) != NULL);
+    CHECK(active_timer == NULL);
+    // reports are passed on again
+    controller_send_advertising_report(address_a, -60, 0x01);
+    CHECK_EQUAL(1, num_advertising_reports);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,293 @@
+// *****************************************************************************
+//
+// test LE White List synchronization and rotation
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define WHITE_LIST_CAPACITY 2
+#define MAX_PENDING_COMMANDS 10
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// white list on simulated Controller
+static bd_addr_t controller_white_list[WHITE_LIST_CAPACITY];
+static int       controller_white_list_count;
+static int       num_create_connection;
+
+// last timer registered with run loop
+static btstack_timer_source_t * active_timer;
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    active_timer = ts;
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    if (active_timer == ts){
+        active_timer = NULL;
+    }
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static int controller_white_list_index(const uint8_t * address){
+    int i;
+    for (i=0;i<controller_white_list_count;i++){
+        if (memcmp(controller_white_list[i], address, 6) == 0) return i;
+    }
+    return -1;
+}
+
+static void controller_white_list_add(const uint8_t * command){
+    bd_addr_t address;
+    reverse_bd_addr(&command[4], address);
+    CHECK_EQUAL(-1, controller_white_list_index(address));
+    // Controller white list must not overflow
+    CHECK(controller_white_list_count < WHITE_LIST_CAPACITY);
+    memcpy(controller_white_list[controller_white_list_count++], address, 6);
+}
+
+static void controller_white_list_remove(const uint8_t * command){
+    bd_addr_t address;
+    reverse_bd_addr(&command[4], address);
+    int index = controller_white_list_index(address);
+    CHECK(index >= 0);
+    controller_white_list_count--;
+    memmove(controller_white_list[index], controller_white_list[index+1], (controller_white_list_count - index) * 6);
+}
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    } else if (opcode == hci_le_read_white_list_size.opcode){
+        event[6] = WHITE_LIST_CAPACITY;
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        if (opcode == hci_le_create_connection.opcode){
+            num_create_connection++;
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_le_add_device_to_white_list.opcode){
+            controller_white_list_add(command);
+        } else if (opcode == hci_le_remove_device_from_white_list.opcode){
+            controller_white_list_remove(command);
+        }
+        controller_send_command_complete(opcode);
+    }
+}
+
+static int controller_white_list_contains(const bd_addr_t address){
+    return controller_white_list_index(address) >= 0;
+}
+
+static void fire_rotation_timer(void){
+    btstack_timer_source_t * ts = active_timer;
+    CHECK(ts != NULL);
+    active_timer = NULL;
+    ts->process(ts);
+}
+
+static bd_addr_t address_a = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0A };
+static bd_addr_t address_b = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0B };
+static bd_addr_t address_c = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0C };
+static bd_addr_t address_d = { 0xC0, 0x00, 0x00, 0x00, 0x00, 0x0D };
+
+TEST_GROUP(WhiteListRotation){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_white_list_count = 0;
+        num_create_connection = 0;
+        active_timer = NULL;
+        hci_init(&test_transport, NULL);
+        hci_power_control(HCI_POWER_ON);
+        controller_process_commands();
+        CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(WhiteListRotation, WithinCapacity){
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_b));
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(num_create_connection > 0);
+    // no rotation needed
+    CHECK(active_timer == NULL);
+}
+
+TEST(WhiteListRotation, Rotate){
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_b));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_c));
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_a));
+    CHECK(controller_white_list_contains(address_b));
+
+    // entry that did not fit gets its turn
+    num_create_connection = 0;
+    fire_rotation_timer();
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_c));
+    CHECK(num_create_connection > 0);
+    CHECK(active_timer != NULL);
+
+    // all entries are on Controller at least once
+    fire_rotation_timer();
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_b));
+}
+
+TEST(WhiteListRotation, StopsWhenEntriesFit){
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_b));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_c));
+    controller_process_commands();
+
+    // removal pending when rotation timer fires
+    CHECK_EQUAL(0, gap_auto_connection_stop(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    fire_rotation_timer();
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_b));
+    CHECK(controller_white_list_contains(address_c));
+    CHECK(active_timer == NULL);
+}
+
+TEST(WhiteListRotation, RotateWithPendingRemoval){
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_b));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_c));
+    CHECK_EQUAL(0, gap_auto_connection_start(BD_ADDR_TYPE_LE_PUBLIC, address_d));
+    controller_process_commands();
+    CHECK(controller_white_list_contains(address_a));
+    CHECK(controller_white_list_contains(address_b));
+
+    // removal pending when rotation timer fires, entry pending removal does not count towards capacity
+    CHECK_EQUAL(0, gap_auto_connection_stop(BD_ADDR_TYPE_LE_PUBLIC, address_a));
+    fire_rotation_timer();
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_b));
+    CHECK(controller_white_list_contains(address_d));
+    CHECK(active_timer != NULL);
+
+    // removed entry does not come back
+    fire_rotation_timer();
+    controller_process_commands();
+    CHECK_EQUAL(2, controller_white_list_count);
+    CHECK(controller_white_list_contains(address_c));
+    CHECK_FALSE(controller_white_list_contains(address_a));
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,431 @@
+// *****************************************************************************
+//
+// test Classic page parameter store in TLV
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_tlv.h"
+#include "btstack_tlv_flash_bank.h"
+#include "hal_flash_bank.h"
+#include "hal_flash_bank_memory.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_cmd.h"
+
+#define MAX_PENDING_COMMANDS 10
+#define HAL_FLASH_BANK_MEMORY_STORAGE_SIZE 4096
+// default NVM_NUM_PAGE_PARAMETERS
+#define NUM_PAGE_PARAMETERS  8
+#define TEST_CON_HANDLE      0x0001
+
+static void (*hci_packet_handler)(uint8_t packet_type, uint8_t *packet, uint16_t size);
+
+// commands sent by HCI, not answered yet
+static uint8_t  pending_commands[MAX_PENDING_COMMANDS][HCI_CMD_HEADER_SIZE + 255];
+static int      num_pending_commands;
+
+// state of simulated Controller
+static uint16_t controller_clock_offset;
+static int      num_read_clock_offset;
+static uint8_t  last_page_scan_repetition_mode;
+static uint16_t last_clock_offset;
+
+// TLV with store counter
+static uint8_t                  hal_flash_bank_memory_storage[HAL_FLASH_BANK_MEMORY_STORAGE_SIZE];
+static hal_flash_bank_memory_t  hal_flash_bank_context;
+static btstack_tlv_flash_bank_t btstack_tlv_context;
+static const btstack_tlv_t *    btstack_tlv_flash_bank_impl;
+static int                      num_tlv_stores;
+
+static int test_tlv_get_tag(void * context, uint32_t tag, uint8_t * buffer, uint32_t buffer_size){
+    return btstack_tlv_flash_bank_impl->get_tag(context, tag, buffer, buffer_size);
+}
+
+static int test_tlv_store_tag(void * context, uint32_t tag, const uint8_t * data, uint32_t data_size){
+    num_tlv_stores++;
+    return btstack_tlv_flash_bank_impl->store_tag(context, tag, data, data_size);
+}
+
+static void test_tlv_delete_tag(void * context, uint32_t tag){
+    btstack_tlv_flash_bank_impl->delete_tag(context, tag);
+}
+
+static const btstack_tlv_t test_tlv = {
+    &test_tlv_get_tag,
+    &test_tlv_store_tag,
+    &test_tlv_delete_tag,
+};
+
+static void test_run_loop_init(void){
+}
+
+static void test_run_loop_set_timer(btstack_timer_source_t * ts, uint32_t timeout_in_ms){
+    ts->timeout = timeout_in_ms;
+}
+
+static void test_run_loop_add_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+}
+
+static int test_run_loop_remove_timer(btstack_timer_source_t * ts){
+    UNUSED(ts);
+    return 1;
+}
+
+static uint32_t test_run_loop_get_time_ms(void){
+    return 0;
+}
+
+static const btstack_run_loop_t test_run_loop = {
+    /* .init = */                   &test_run_loop_init,
+    /* .add_data_source = */        NULL,
+    /* .remove_data_source = */     NULL,
+    /* .enable_data_source_callbacks = */  NULL,
+    /* .disable_data_source_callbacks = */ NULL,
+    /* .set_timer = */              &test_run_loop_set_timer,
+    /* .add_timer = */              &test_run_loop_add_timer,
+    /* .remove_timer = */           &test_run_loop_remove_timer,
+    /* .execute = */                NULL,
+    /* .dump_timer = */             NULL,
+    /* .get_time_ms = */            &test_run_loop_get_time_ms,
+};
+
+static int test_transport_open(void){
+    return 0;
+}
+
+static int test_transport_close(void){
+    return 0;
+}
+
+static void test_transport_register_packet_handler(void (*handler)(uint8_t packet_type, uint8_t *packet, uint16_t size)){
+    hci_packet_handler = handler;
+}
+
+static int test_transport_send_packet(uint8_t packet_type, uint8_t * packet, int size){
+    if (packet_type != HCI_COMMAND_DATA_PACKET) return 0;
+    CHECK(num_pending_commands < MAX_PENDING_COMMANDS);
+    memcpy(pending_commands[num_pending_commands++], packet, size);
+    return 0;
+}
+
+static const hci_transport_t test_transport = {
+  /*  .transport.name                          = */  "TEST",
+  /*  .transport.init                          = */  NULL,
+  /*  .transport.open                          = */  &test_transport_open,
+  /*  .transport.close                         = */  &test_transport_close,
+  /*  .transport.register_packet_handler       = */  &test_transport_register_packet_handler,
+  /*  .transport.can_send_packet_now           = */  NULL,
+  /*  .transport.send_packet                   = */  &test_transport_send_packet,
+  /*  .transport.set_baudrate                  = */  NULL,
+};
+
+static void controller_send_command_status(uint16_t opcode){
+    uint8_t event[6] = { HCI_EVENT_COMMAND_STATUS, 4, 0, 1 };
+    little_endian_store_16(event, 4, opcode);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_command_complete(uint16_t opcode){
+    // max size, e.g. for local name
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_COMMAND_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = 1;
+    little_endian_store_16(event, 3, opcode);
+    // return parameters, status = 0
+    if (opcode == hci_read_local_supported_features.opcode){
+        memset(&event[6], 0xff, 8);
+    } else if (opcode == hci_read_buffer_size.opcode){
+        little_endian_store_16(event, 6, 251);
+        little_endian_store_16(event, 9, 4);
+    }
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+static void controller_send_read_clock_offset_complete(hci_con_handle_t con_handle){
+    uint8_t event[7];
+    event[0] = HCI_EVENT_READ_CLOCK_OFFSET_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, con_handle);
+    little_endian_store_16(event, 5, controller_clock_offset);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+}
+
+// answer all commands sent by HCI like a Controller would, connections and names are completed by test
+static void controller_process_commands(void){
+    while (num_pending_commands > 0){
+        uint8_t command[HCI_CMD_HEADER_SIZE + 255];
+        memcpy(command, pending_commands[0], sizeof(command));
+        num_pending_commands--;
+        memmove(pending_commands[0], pending_commands[1], num_pending_commands * sizeof(pending_commands[0]));
+        uint16_t opcode = little_endian_read_16(command, 0);
+        if (opcode == hci_create_connection.opcode){
+            last_page_scan_repetition_mode = command[11];
+            last_clock_offset = little_endian_read_16(command, 13);
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_remote_name_request.opcode){
+            last_page_scan_repetition_mode = command[9];
+            last_clock_offset = little_endian_read_16(command, 11);
+            controller_send_command_status(opcode);
+            continue;
+        }
+        if (opcode == hci_read_clock_offset.opcode){
+            num_read_clock_offset++;
+            controller_send_command_status(opcode);
+            controller_send_read_clock_offset_complete(little_endian_read_16(command, 3));
+            continue;
+        }
+        if (opcode == hci_read_remote_supported_features_command.opcode){
+            controller_send_command_status(opcode);
+            continue;
+        }
+        controller_send_command_complete(opcode);
+    }
+}
+
+static void controller_send_connection_complete(const bd_addr_t addr, hci_con_handle_t con_handle){
+    uint8_t event[13];
+    event[0] = HCI_EVENT_CONNECTION_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, con_handle);
+    reverse_bd_addr(addr, &event[5]);
+    event[11] = 1;
+    event[12] = 0;
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void controller_send_disconnection_complete(hci_con_handle_t con_handle){
+    uint8_t event[6];
+    event[0] = HCI_EVENT_DISCONNECTION_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_SUCCESS;
+    little_endian_store_16(event, 3, con_handle);
+    event[5] = ERROR_CODE_REMOTE_USER_TERMINATED_CONNECTION;
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void controller_send_page_scan_repetition_mode_change(const bd_addr_t addr, uint8_t page_scan_repetition_mode){
+    uint8_t event[9];
+    event[0] = HCI_EVENT_PAGE_SCAN_REPETITION_MODE_CHANGE;
+    event[1] = sizeof(event) - 2;
+    reverse_bd_addr(addr, &event[2]);
+    event[8] = page_scan_repetition_mode;
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void device_address(uint8_t index, bd_addr_t addr){
+    bd_addr_t base = { 0x11, 0x22, 0x33, 0x44, 0x55, 0x00 };
+    memcpy(addr, base, 6);
+    addr[5] = index;
+}
+
+static uint16_t device_clock_offset(uint8_t index){
+    return 0x1000 + index;
+}
+
+// outgoing connection, Controller reports clock offset of device afterwards
+static void connect(const bd_addr_t addr, uint16_t clock_offset){
+    hci_send_cmd(&hci_create_connection, addr, 0xcc18, 0, 0, 0, 1);
+    controller_process_commands();
+    controller_clock_offset = clock_offset;
+    controller_send_connection_complete(addr, TEST_CON_HANDLE);
+}
+
+static void connect_and_disconnect(const bd_addr_t addr, uint16_t clock_offset){
+    connect(addr, clock_offset);
+    controller_send_disconnection_complete(TEST_CON_HANDLE);
+}
+
+static void remote_name_request(const bd_addr_t addr, uint8_t page_scan_repetition_mode, uint16_t clock_offset){
+    bd_addr_t address;
+    memcpy(address, addr, 6);
+    CHECK_EQUAL(0, gap_remote_name_request(address, page_scan_repetition_mode, clock_offset));
+    controller_process_commands();
+    // complete request
+    uint8_t event[2 + 255];
+    memset(event, 0, sizeof(event));
+    event[0] = HCI_EVENT_REMOTE_NAME_REQUEST_COMPLETE;
+    event[1] = sizeof(event) - 2;
+    event[2] = ERROR_CODE_PAGE_TIMEOUT;
+    reverse_bd_addr(addr, &event[3]);
+    hci_packet_handler(HCI_EVENT_PACKET, event, sizeof(event));
+    controller_process_commands();
+}
+
+static void check_stored(const bd_addr_t addr, uint8_t page_scan_repetition_mode, uint16_t clock_offset){
+    remote_name_request(addr, 0, 0);
+    CHECK_EQUAL(page_scan_repetition_mode, last_page_scan_repetition_mode);
+    CHECK_EQUAL(0x8000 | clock_offset, last_clock_offset);
+}
+
+static void check_not_stored(const bd_addr_t addr){
+    remote_name_request(addr, 0, 0);
+    CHECK_EQUAL(0, last_page_scan_repetition_mode);
+    CHECK_EQUAL(0, last_clock_offset);
+}
+
+static void power_on(void){
+    hci_init(&test_transport, NULL);
+    hci_power_control(HCI_POWER_ON);
+    controller_process_commands();
+    CHECK_EQUAL(HCI_STATE_WORKING, hci_get_state());
+}
+
+TEST_GROUP(PageParameters){
+    void setup(void){
+        num_pending_commands = 0;
+        controller_clock_offset = 0;
+        num_read_clock_offset = 0;
+        last_page_scan_repetition_mode = 0;
+        last_clock_offset = 0;
+        num_tlv_stores = 0;
+        const hal_flash_bank_t * hal_flash_bank_impl = hal_flash_bank_memory_init_instance(&hal_flash_bank_context, hal_flash_bank_memory_storage, HAL_FLASH_BANK_MEMORY_STORAGE_SIZE);
+        hal_flash_bank_impl->erase(&hal_flash_bank_context, 0);
+        hal_flash_bank_impl->erase(&hal_flash_bank_context, 1);
+        btstack_tlv_flash_bank_impl = btstack_tlv_flash_bank_init_instance(&btstack_tlv_context, hal_flash_bank_impl, &hal_flash_bank_context);
+        btstack_tlv_set_instance(&test_tlv, &btstack_tlv_context);
+        power_on();
+    }
+    void teardown(void){
+        hci_close();
+    }
+};
+
+TEST(PageParameters, NothingStored){
+    bd_addr_t addr;
+    device_address(0, addr);
+    check_not_stored(addr);
+    hci_send_cmd(&hci_create_connection, addr, 0xcc18, 2, 0, 0x0123, 1);
+    controller_process_commands();
+    CHECK_EQUAL(2, last_page_scan_repetition_mode);
+    CHECK_EQUAL(0x0123, last_clock_offset);
+}
+
+TEST(PageParameters, StoreOnConnection){
+    bd_addr_t addr;
+    device_address(0, addr);
+    connect(addr, 0x1234);
+    CHECK_EQUAL(1, num_read_clock_offset);
+    CHECK_EQUAL(1, num_tlv_stores);
+    controller_send_disconnection_complete(TEST_CON_HANDLE);
+    // unknown page scan repetition mode is stored as R1, valid flag from Controller is dropped
+    check_stored(addr, 1, 0x1234);
+    // used by Create Connection, too
+    connect(addr, 0x1234);
+    CHECK_EQUAL(1, last_page_scan_repetition_mode);
+    CHECK_EQUAL(0x9234, last_clock_offset);
+}
+
+TEST(PageParameters, CallerValuesKept){
+    bd_addr_t addr;
+    device_address(0, addr);
+    connect_and_disconnect(addr, 0x1234);
+    remote_name_request(addr, 2, 0x8111);
+    CHECK_EQUAL(2, last_page_scan_repetition_mode);
+    CHECK_EQUAL(0x8111, last_clock_offset);
+}
+
+TEST(PageParameters, UnchangedNotRewritten){
+    bd_addr_t addr;
+    device_address(0, addr);
+    connect_and_disconnect(addr, 0x1234);
+    connect_and_disconnect(addr, 0x1234);
+    CHECK_EQUAL(2, num_read_clock_offset);
+    CHECK_EQUAL(1, num_tlv_stores);
+    connect_and_disconnect(addr, 0x1300);
+    CHECK_EQUAL(2, num_tlv_stores);
+    check_stored(addr, 1, 0x1300);
+}
+
+TEST(PageParameters, PageScanRepetitionModeChange){
+    bd_addr_t addr;
+    device_address(0, addr);
+    connect(addr, 0x1234);
+    // clock offset is read again and stored with new mode
+    controller_clock_offset = 0x1240;
+    controller_send_page_scan_repetition_mode_change(addr, 2);
+    CHECK_EQUAL(2, num_read_clock_offset);
+    controller_send_disconnection_complete(TEST_CON_HANDLE);
+    check_stored(addr, 2, 0x1240);
+    // mode is kept if only clock offset changes
+    connect_and_disconnect(addr, 0x1250);
+    check_stored(addr, 2, 0x1250);
+}
+
+TEST(PageParameters, PersistentAcrossPowerCycle){
+    bd_addr_t addr;
+    device_address(0, addr);
+    connect_and_disconnect(addr, 0x1234);
+    hci_close();
+    power_on();
+    check_stored(addr, 1, 0x1234);
+}
+
+TEST(PageParameters, EvictLeastRecentlyStored){
+    bd_addr_t addr;
+    uint8_t i;
+    for (i=0;i<NUM_PAGE_PARAMETERS;i++){
+        device_address(i, addr);
+        connect_and_disconnect(addr, device_clock_offset(i));
+    }
+    for (i=0;i<NUM_PAGE_PARAMETERS;i++){
+        device_address(i, addr);
+        check_stored(addr, 1, device_clock_offset(i));
+    }
+    // oldest entry replaced
+    device_address(NUM_PAGE_PARAMETERS, addr);
+    connect_and_disconnect(addr, device_clock_offset(NUM_PAGE_PARAMETERS));
+    check_stored(addr, 1, device_clock_offset(NUM_PAGE_PARAMETERS));
+    device_address(0, addr);
+    check_not_stored(addr);
+    for (i=1;i<NUM_PAGE_PARAMETERS;i++){
+        device_address(i, addr);
+        check_stored(addr, 1, device_clock_offset(i));
+    }
+}
+
+TEST(PageParameters, UpdateRefreshesEntry){
+    bd_addr_t addr;
+    uint8_t i;
+    for (i=0;i<NUM_PAGE_PARAMETERS;i++){
+        device_address(i, addr);
+        connect_and_disconnect(addr, device_clock_offset(i));
+    }
+    // first device stored again with new clock offset
+    device_address(0, addr);
+    connect_and_disconnect(addr, 0x2000);
+    // second device is least recently stored now
+    device_address(NUM_PAGE_PARAMETERS, addr);
+    connect_and_disconnect(addr, device_clock_offset(NUM_PAGE_PARAMETERS));
+    device_address(0, addr);
+    check_stored(addr, 1, 0x2000);
+    device_address(1, addr);
+    check_not_stored(addr);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    btstack_run_loop_init(&test_run_loop);
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,78 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "btstack_crc.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static const uint8_t check_input[] = "123456789";
+
+static uint16_t crc16_reference(uint16_t crc, const uint8_t * data, uint32_t len, uint16_t polynomial){
+    while (len--){
+        int i;
+        crc ^= *data++;
+        for (i=0;i<8;i++){
+            crc = (crc & 1) ? ((crc >> 1) ^ polynomial) : (crc >> 1);
+        }
+    }
+    return crc;
+}
+
+TEST_GROUP(CRC){
+    uint8_t buffer[1100];
+
+    void setup(void){
+        unsigned int i;
+        srand(0);
+        for (i=0;i<sizeof(buffer);i++){
+            buffer[i] = (uint8_t) rand();
+        }
+    }
+};
+
+TEST(CRC, L2capCheckValue){
+    CHECK_EQUAL(0xbb3d, btstack_crc16_l2cap_calc(check_input, 9));
+}
+
+TEST(CRC, CcittCheckValue){
+    CHECK_EQUAL(0x6f91, btstack_crc16_ccitt_update(0xffff, check_input, 9));
+}
+
+TEST(CRC, ReverseBits){
+    CHECK_EQUAL(0x8000, btstack_reverse_bits_16(0x0001));
+    CHECK_EQUAL(0x1e6a, btstack_reverse_bits_16(0x5678));
+    CHECK_EQUAL(0xffff, btstack_reverse_bits_16(0xffff));
+}
+
+TEST(CRC, L2capMatchesReference){
+    int offset;
+    uint32_t len;
+    for (offset=0;offset<8;offset++){
+        for (len=0;len<1024;len += 1 + (len >> 3)){
+            CHECK_EQUAL(crc16_reference(0, &buffer[offset], len, 0xa001), btstack_crc16_l2cap_calc(&buffer[offset], len));
+        }
+    }
+}
+
+TEST(CRC, CcittMatchesReference){
+    int offset;
+    uint32_t len;
+    for (offset=0;offset<8;offset++){
+        for (len=0;len<1024;len += 1 + (len >> 3)){
+            CHECK_EQUAL(crc16_reference(0xffff, &buffer[offset], len, 0x8408), btstack_crc16_ccitt_update(0xffff, &buffer[offset], len));
+        }
+    }
+}
+
+TEST(CRC, IncrementalUpdate){
+    uint32_t split;
+    uint16_t expected = btstack_crc16_l2cap_calc(buffer, 100);
+    for (split=0;split<=100;split++){
+        uint16_t crc = btstack_crc16_l2cap_update(0, buffer, split);
+        CHECK_EQUAL(expected, btstack_crc16_l2cap_update(crc, &buffer[split], 100 - split));
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,47 @@
+/*
+ *  crc_benchmark.c
+ *
+ *  Reports throughput of the CRC-16 implementation selected at compile time
+ */
+
+#include <stdio.h>
+#include <stdint.h>
+#include <time.h>
+
+#include "btstack_crc.h"
+
+#define BENCHMARK_FRAME_SIZE 1024
+#define BENCHMARK_ROUNDS     100000
+
+static double now_seconds(void){
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+int main(void){
+    static uint8_t frame[BENCHMARK_FRAME_SIZE];
+    int i;
+    for (i=0;i<BENCHMARK_FRAME_SIZE;i++){
+        frame[i] = (uint8_t) (i * 7);
+    }
+
+    uint16_t crc = 0;
+    double start = now_seconds();
+    for (i=0;i<BENCHMARK_ROUNDS;i++){
+        crc += btstack_crc16_l2cap_calc(frame, BENCHMARK_FRAME_SIZE);
+    }
+    double l2cap_seconds = now_seconds() - start;
+
+    start = now_seconds();
+    for (i=0;i<BENCHMARK_ROUNDS;i++){
+        crc += btstack_crc16_ccitt_update(0xffff, frame, BENCHMARK_FRAME_SIZE);
+    }
+    double ccitt_seconds = now_seconds() - start;
+
+    double megabytes = (double) BENCHMARK_FRAME_SIZE * BENCHMARK_ROUNDS / 1e6;
+    printf("L2CAP FCS: %8.1f MB/s\n", megabytes / l2cap_seconds);
+    printf("H5 CCITT:  %8.1f MB/s\n", megabytes / ccitt_seconds);
+    printf("(checksum %04x)\n", crc);
+    return 0;
+}
@@ -4,6 +4,7 @@
 #include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
+#include <math.h>
 
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
@@ -357,6 +358,55 @@ TEST(CVSD_PLC, CountEqBytes){
 //     process_wav_file_with_plc("results/fanfare_mono_with_bad_frames.wav", "results/fanfare_mono_with_bad_frames_after_plc.wav");
 // }
 
+static double cross_correlation(int16_t * x, int16_t * y){
+    double num = 0;
+    double x2 = 0;
+    double y2 = 0;
+    int m;
+    for (m=0;m<CVSD_M;m++){
+        num += ((double)x[m])*y[m];
+        x2  += ((double)x[m])*x[m];
+        y2  += ((double)y[m])*y[m];
+    }
+    if (x2 == 0 || y2 == 0) return 0;
+    return num / sqrt(x2*y2);
+}
+
+static void check_pattern_match_against_reference(int16_t * hist){
+    int lag_float = btstack_cvsd_plc_pattern_match_float(hist);
+    int lag_fixed = btstack_cvsd_plc_pattern_match_fixed_point(hist);
+    // float reference accumulates rounding errors, different lag is ok if correlation is the same
+    double c_float = cross_correlation(&hist[CVSD_LHIST-CVSD_M], &hist[lag_float]);
+    double c_fixed = cross_correlation(&hist[CVSD_LHIST-CVSD_M], &hist[lag_fixed]);
+    DOUBLES_EQUAL(c_float, c_fixed, 0.001);
+}
+
+TEST(CVSD_PLC, PatternMatchFixedPoint){
+    int16_t hist[CVSD_LHIST];
+    int i;
+
+    // sine wave
+    phase = 0;
+    create_sine_wave_int16_data(CVSD_LHIST, hist);
+    check_pattern_match_against_reference(hist);
+
+    // pseudo-random noise with full scale samples
+    uint32_t lfsr = 0x12345678;
+    int run;
+    for (run=0;run<100;run++){
+        for (i=0;i<CVSD_LHIST;i++){
+            lfsr = lfsr * 1664525 + 1013904223;
+            hist[i] = (int16_t) (lfsr >> 16);
+        }
+        hist[CVSD_LHIST-1] = -32768;
+        check_pattern_match_against_reference(hist);
+    }
+
+    // silence
+    memset(hist, 0, sizeof(hist));
+    CHECK_EQUAL(btstack_cvsd_plc_pattern_match_float(hist), btstack_cvsd_plc_pattern_match_fixed_point(hist));
+}
+
 TEST(CVSD_PLC, TestSineWave){
     int corruption_step = 600;
     create_sine_wav("results/sine_test.wav");
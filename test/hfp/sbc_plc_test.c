@@ -0,0 +1,111 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_sbc_plc.h"
+
+// input signal: pre-computed sine wave, 160 Hz at 16000 kHz
+static const int16_t sine_int16[] = {
+     0,    2057,    4107,    6140,    8149,   10126,   12062,   13952,   15786,   17557,
+ 19260,   20886,   22431,   23886,   25247,   26509,   27666,   28714,   29648,   30466,
+ 31163,   31738,   32187,   32509,   32702,   32767,   32702,   32509,   32187,   31738,
+ 31163,   30466,   29648,   28714,   27666,   26509,   25247,   23886,   22431,   20886,
+ 19260,   17557,   15786,   13952,   12062,   10126,    8149,    6140,    4107,    2057,
+     0,   -2057,   -4107,   -6140,   -8149,  -10126,  -12062,  -13952,  -15786,  -17557,
+-19260,  -20886,  -22431,  -23886,  -25247,  -26509,  -27666,  -28714,  -29648,  -30466,
+-31163,  -31738,  -32187,  -32509,  -32702,  -32767,  -32702,  -32509,  -32187,  -31738,
+-31163,  -30466,  -29648,  -28714,  -27666,  -26509,  -25247,  -23886,  -22431,  -20886,
+-19260,  -17557,  -15786,  -13952,  -12062,  -10126,   -8149,   -6140,   -4107,   -2057,
+};
+
+static int16_t hist[SBC_LHIST];
+
+static double cross_correlation(int16_t * x, int16_t * y){
+    double num = 0;
+    double x2 = 0;
+    double y2 = 0;
+    int m;
+    for (m=0;m<SBC_M;m++){
+        num += ((double)x[m])*y[m];
+        x2  += ((double)x[m])*x[m];
+        y2  += ((double)y[m])*y[m];
+    }
+    if (x2 == 0 || y2 == 0) return 0;
+    return num / sqrt(x2*y2);
+}
+
+// float implementation is the golden reference
+static void check_pattern_match_against_reference(void){
+    int lag_float = btstack_sbc_plc_pattern_match_float(hist);
+    int lag_fixed = btstack_sbc_plc_pattern_match_fixed_point(hist);
+    // float reference accumulates rounding errors, different lag is ok if correlation is the same
+    double c_float = cross_correlation(&hist[SBC_LHIST-SBC_M], &hist[lag_float]);
+    double c_fixed = cross_correlation(&hist[SBC_LHIST-SBC_M], &hist[lag_fixed]);
+    DOUBLES_EQUAL(c_float, c_fixed, 0.001);
+}
+
+TEST_GROUP(SBC_PLC){
+    uint32_t lfsr;
+
+    void setup(void){
+        lfsr = 0x12345678;
+    }
+
+    int16_t next_random(void){
+        lfsr = lfsr * 1664525 + 1013904223;
+        return (int16_t) (lfsr >> 16);
+    }
+};
+
+TEST(SBC_PLC, PatternMatchSine){
+    int i;
+    int amplitude;
+    for (amplitude=1;amplitude<=100;amplitude*=10){
+        for (i=0;i<SBC_LHIST;i++){
+            hist[i] = sine_int16[i % (sizeof(sine_int16) / sizeof(int16_t))] * amplitude / 100;
+        }
+        check_pattern_match_against_reference();
+    }
+}
+
+TEST(SBC_PLC, PatternMatchNoise){
+    int i;
+    int run;
+    for (run=0;run<100;run++){
+        for (i=0;i<SBC_LHIST;i++){
+            hist[i] = next_random();
+        }
+        // full scale negative sample in template
+        hist[SBC_LHIST-1] = -32768;
+        check_pattern_match_against_reference();
+    }
+}
+
+TEST(SBC_PLC, PatternMatchSineWithNoise){
+    int i;
+    for (i=0;i<SBC_LHIST;i++){
+        hist[i] = sine_int16[(i * 3) % (sizeof(sine_int16) / sizeof(int16_t))] / 2 + next_random() / 8;
+    }
+    check_pattern_match_against_reference();
+}
+
+TEST(SBC_PLC, PatternMatchSilence){
+    memset(hist, 0, sizeof(hist));
+    CHECK_EQUAL(btstack_sbc_plc_pattern_match_float(hist), btstack_sbc_plc_pattern_match_fixed_point(hist));
+
+    // silent window before a signal
+    int i;
+    for (i=SBC_LHIST/2;i<SBC_LHIST;i++){
+        hist[i] = next_random();
+    }
+    check_pattern_match_against_reference();
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,479 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "l2cap.h"
+#include "l2cap_signaling.h"
+
+#include "mock.h"
+
+#define TEST_CON_HANDLE  0x0040
+#define TEST_PSM         0x1001
+#define TEST_REMOTE_CID  0x0070
+#define TEST_REMOTE_MPS  100
+
+#define S_FRAME_RR   L2CAP_SUPERVISORY_FUNCTION_RR_RECEIVER_READY
+#define S_FRAME_REJ  L2CAP_SUPERVISORY_FUNCTION_REJ_REJECT
+#define S_FRAME_SREJ L2CAP_SUPERVISORY_FUNCTION_SREJ_SELECTIVE_REJECT
+
+static bd_addr_t remote_addr = { 0x00, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+static uint8_t ertm_buffer[20000];
+static uint16_t local_cid;
+static int channel_opened;
+
+#define MAX_RECEIVED_SDUS 80
+
+static uint8_t received_sdus[MAX_RECEIVED_SDUS][50];
+static uint16_t received_sdu_lens[MAX_RECEIVED_SDUS];
+static int num_received_sdus;
+
+static int num_processed_packets;
+
+typedef struct {
+    int      s_frame;
+    int      function;
+    int      poll;
+    int      final;
+    uint16_t req_seq;
+    uint16_t tx_seq;
+    const uint8_t * payload;
+    uint16_t payload_len;
+} frame_t;
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    switch (packet_type){
+        case L2CAP_DATA_PACKET:
+            if (num_received_sdus >= MAX_RECEIVED_SDUS) break;
+            memcpy(received_sdus[num_received_sdus], packet, size);
+            received_sdu_lens[num_received_sdus] = size;
+            num_received_sdus++;
+            break;
+        case HCI_EVENT_PACKET:
+            if (hci_event_packet_get_type(packet) != L2CAP_EVENT_CHANNEL_OPENED) break;
+            if (l2cap_event_channel_opened_get_status(packet) != 0) break;
+            channel_opened = 1;
+            break;
+        default:
+            break;
+    }
+}
+
+// trigger l2cap_run until all pending packets are sent
+static void complete_packets(void){
+    int i;
+    for (i=0;i<20;i++){
+        uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, TEST_CON_HANDLE, 0x00, 0x01, 0x00 };
+        int num_sent = mock_num_sent_packets();
+        mock_simulate_hci_event(event, sizeof(event));
+        if (num_sent == mock_num_sent_packets()) break;
+    }
+}
+
+static void send_l2cap_packet(uint16_t cid, const uint8_t * data, uint16_t len){
+    uint8_t packet[300];
+    little_endian_store_16(packet, 0, TEST_CON_HANDLE | 0x2000);
+    little_endian_store_16(packet, 2, len + 4);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], data, len);
+    mock_simulate_acl_packet(packet, len + 8);
+    complete_packets();
+}
+
+static void send_signaling_packet(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    uint8_t command[100];
+    command[0] = code;
+    command[1] = sig_id;
+    little_endian_store_16(command, 2, len);
+    memcpy(&command[4], data, len);
+    send_l2cap_packet(L2CAP_CID_SIGNALING, command, len + 4);
+}
+
+// returns signaling command of last sent packet with given code, or NULL
+static uint8_t * last_signaling_command(uint8_t code){
+    int i;
+    for (i=mock_num_sent_packets()-1;i>=0;i--){
+        uint16_t size;
+        uint8_t * packet = mock_sent_packet(i, &size);
+        if (little_endian_read_16(packet, 6) != L2CAP_CID_SIGNALING) continue;
+        if (packet[8] == code) return &packet[8];
+    }
+    return NULL;
+}
+
+static void open_channel(uint16_t num_rx_buffers, uint16_t num_tx_buffers, uint16_t remote_tx_window, uint32_t extended_features){
+    l2cap_ertm_config_t ertm_config;
+    memset(&ertm_config, 0, sizeof(ertm_config));
+    ertm_config.ertm_mandatory = 1;
+    ertm_config.max_transmit = 4;
+    ertm_config.retransmission_timeout_ms = 2000;
+    ertm_config.monitor_timeout_ms = 12000;
+    ertm_config.local_mtu = 200;
+    ertm_config.num_rx_buffers = num_rx_buffers;
+    ertm_config.num_tx_buffers = num_tx_buffers;
+    ertm_config.fcs_option = 0;
+    CHECK_EQUAL(0, l2cap_create_ertm_channel(&packet_handler, remote_addr, TEST_PSM, &ertm_config, ertm_buffer, sizeof(ertm_buffer), &local_cid));
+    complete_packets();
+
+    // extended features
+    uint8_t * command = last_signaling_command(INFORMATION_REQUEST);
+    CHECK(command != NULL);
+    uint8_t info_response[8];
+    little_endian_store_16(info_response, 0, L2CAP_INFO_TYPE_EXTENDED_FEATURES_SUPPORTED);
+    little_endian_store_16(info_response, 2, 0);
+    little_endian_store_32(info_response, 4, extended_features);
+    send_signaling_packet(INFORMATION_RESPONSE, command[1], info_response, sizeof(info_response));
+
+    // connect
+    command = last_signaling_command(CONNECTION_REQUEST);
+    CHECK(command != NULL);
+    uint8_t connection_response[8];
+    little_endian_store_16(connection_response, 0, TEST_REMOTE_CID);
+    little_endian_store_16(connection_response, 2, local_cid);
+    little_endian_store_16(connection_response, 4, 0);
+    little_endian_store_16(connection_response, 6, 0);
+    send_signaling_packet(CONNECTION_RESPONSE, command[1], connection_response, sizeof(connection_response));
+
+    // remote config request: MTU, ERTM without FCS, extended window size if window doesn't fit into 6 bit
+    uint8_t config_request[30];
+    int pos = 0;
+    little_endian_store_16(config_request, pos, local_cid);
+    pos += 2;
+    little_endian_store_16(config_request, pos, 0);
+    pos += 2;
+    config_request[pos++] = L2CAP_CONFIG_OPTION_TYPE_MAX_TRANSMISSION_UNIT;
+    config_request[pos++] = 2;
+    little_endian_store_16(config_request, pos, TEST_REMOTE_MPS);
+    pos += 2;
+    config_request[pos++] = L2CAP_CONFIG_OPTION_TYPE_RETRANSMISSION_AND_FLOW_CONTROL;
+    config_request[pos++] = 9;
+    config_request[pos++] = L2CAP_CHANNEL_MODE_ENHANCED_RETRANSMISSION;
+    config_request[pos++] = (uint8_t) btstack_min(remote_tx_window, 0x3f);
+    config_request[pos++] = 4;
+    little_endian_store_16(config_request, pos, 0);
+    pos += 2;
+    little_endian_store_16(config_request, pos, 0);
+    pos += 2;
+    little_endian_store_16(config_request, pos, TEST_REMOTE_MPS);
+    pos += 2;
+    config_request[pos++] = L2CAP_CONFIG_OPTION_TYPE_FRAME_CHECK_SEQUENCE;
+    config_request[pos++] = 1;
+    config_request[pos++] = 0;
+    if (remote_tx_window > 0x3f){
+        config_request[pos++] = L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE;
+        config_request[pos++] = 2;
+        little_endian_store_16(config_request, pos, remote_tx_window);
+        pos += 2;
+    }
+    send_signaling_packet(CONFIGURE_REQUEST, 0x20, config_request, pos);
+
+    // accept our config request
+    command = last_signaling_command(CONFIGURE_REQUEST);
+    CHECK(command != NULL);
+    uint8_t config_response[6];
+    little_endian_store_16(config_response, 0, local_cid);
+    little_endian_store_16(config_response, 2, 0);
+    little_endian_store_16(config_response, 4, 0);
+    send_signaling_packet(CONFIGURE_RESPONSE, command[1], config_response, sizeof(config_response));
+
+    CHECK(channel_opened);
+    num_processed_packets = mock_num_sent_packets();
+}
+
+static void send_i_frame(uint16_t tx_seq, uint16_t req_seq, const uint8_t * payload, uint16_t len){
+    uint8_t frame[100];
+    int control_size;
+    if (mock_l2cap_channel()->extended_control){
+        little_endian_store_32(frame, 0, (((uint32_t) tx_seq) << 18) | (((uint32_t) req_seq) << 2));
+        control_size = 4;
+    } else {
+        little_endian_store_16(frame, 0, (uint16_t) ((req_seq << 8) | (tx_seq << 1)));
+        control_size = 2;
+    }
+    memcpy(&frame[control_size], payload, len);
+    send_l2cap_packet(local_cid, frame, control_size + len);
+}
+
+static void send_s_frame(int function, int poll, int final, uint16_t req_seq){
+    uint8_t frame[4];
+    if (mock_l2cap_channel()->extended_control){
+        little_endian_store_32(frame, 0, (((uint32_t) poll) << 18) | (((uint32_t) function) << 16) | (((uint32_t) req_seq) << 2) | (final << 1) | 1);
+        send_l2cap_packet(local_cid, frame, 4);
+    } else {
+        little_endian_store_16(frame, 0, (uint16_t) ((req_seq << 8) | (final << 7) | (poll << 4) | (function << 2) | 1));
+        send_l2cap_packet(local_cid, frame, 2);
+    }
+}
+
+// parse next frame sent on our channel, returns 0 if none left
+static int next_sent_frame(frame_t * frame){
+    while (num_processed_packets < mock_num_sent_packets()){
+        uint16_t size;
+        uint8_t * packet = mock_sent_packet(num_processed_packets++, &size);
+        if (little_endian_read_16(packet, 6) != TEST_REMOTE_CID) continue;
+        memset(frame, 0, sizeof(frame_t));
+        int control_size;
+        if (mock_l2cap_channel()->extended_control){
+            uint32_t control = little_endian_read_32(packet, 8);
+            frame->s_frame  = control & 1;
+            frame->final    = (control >> 1) & 1;
+            frame->req_seq  = (control >> 2) & 0x3fff;
+            frame->function = (control >> 16) & 3;
+            frame->poll     = (control >> 18) & 1;
+            frame->tx_seq   = (control >> 18) & 0x3fff;
+            control_size = 4;
+        } else {
+            uint16_t control = little_endian_read_16(packet, 8);
+            frame->s_frame  = control & 1;
+            frame->final    = (control >> 7) & 1;
+            frame->req_seq  = (control >> 8) & 0x3f;
+            frame->function = (control >> 2) & 3;
+            frame->poll     = (control >> 4) & 1;
+            frame->tx_seq   = (control >> 1) & 0x3f;
+            control_size = 2;
+        }
+        frame->payload     = &packet[8 + control_size];
+        frame->payload_len = size - 8 - control_size;
+        return 1;
+    }
+    return 0;
+}
+
+static void check_s_frame(int function, uint16_t req_seq){
+    frame_t frame;
+    CHECK(next_sent_frame(&frame));
+    CHECK_EQUAL(1, frame.s_frame);
+    CHECK_EQUAL(function, frame.function);
+    CHECK_EQUAL(req_seq, frame.req_seq);
+}
+
+static void check_i_frame(uint16_t tx_seq){
+    frame_t frame;
+    CHECK(next_sent_frame(&frame));
+    CHECK_EQUAL(0, frame.s_frame);
+    CHECK_EQUAL(tx_seq, frame.tx_seq);
+}
+
+static void check_no_more_frames(void){
+    frame_t frame;
+    CHECK_EQUAL(0, next_sent_frame(&frame));
+}
+
+static const uint8_t sdu_data[][4] = {
+    { 'S', 'D', 'U', '0' },
+    { 'S', 'D', 'U', '1' },
+    { 'S', 'D', 'U', '2' },
+    { 'S', 'D', 'U', '3' },
+    { 'S', 'D', 'U', '4' },
+};
+
+TEST_GROUP(L2CAP_ERTM){
+    void setup(void){
+        memset(ertm_buffer, 0, sizeof(ertm_buffer));
+        mock_init(remote_addr, TEST_CON_HANDLE);
+        l2cap_init();
+        channel_opened = 0;
+        num_received_sdus = 0;
+        num_processed_packets = 0;
+        mock_set_time_ms(1000);
+    }
+
+    void check_received_sdus(int count){
+        CHECK_EQUAL(count, num_received_sdus);
+        int i;
+        for (i=0;i<count;i++){
+            CHECK_EQUAL(4, received_sdu_lens[i]);
+            MEMCMP_EQUAL(sdu_data[i], received_sdus[i], 4);
+        }
+    }
+};
+
+TEST(L2CAP_ERTM, InSequence){
+    open_channel(4, 4, 4, 0x28);
+    CHECK_EQUAL(0, mock_l2cap_channel()->extended_control);
+    send_i_frame(0, 0, sdu_data[0], 4);
+    check_s_frame(S_FRAME_RR, 1);
+    send_i_frame(1, 0, sdu_data[1], 4);
+    check_s_frame(S_FRAME_RR, 2);
+    check_no_more_frames();
+    check_received_sdus(2);
+}
+
+TEST(L2CAP_ERTM, SelectiveRejectRequestsEachMissingFrame){
+    open_channel(4, 4, 4, 0x28);
+    send_i_frame(0, 0, sdu_data[0], 4);
+    check_s_frame(S_FRAME_RR, 1);
+
+    // frames 1 and 2 lost
+    send_i_frame(3, 0, sdu_data[3], 4);
+    check_s_frame(S_FRAME_SREJ, 1);
+    check_s_frame(S_FRAME_SREJ, 2);
+    check_no_more_frames();
+    check_received_sdus(1);
+
+    // retransmissions complete the window, stored frame is delivered in order
+    send_i_frame(1, 0, sdu_data[1], 4);
+    send_i_frame(2, 0, sdu_data[2], 4);
+    check_received_sdus(4);
+    CHECK_EQUAL(0, mock_l2cap_channel()->srej_recovery);
+    CHECK_EQUAL(4, mock_l2cap_channel()->req_seq);
+
+    // duplicate is ignored
+    send_i_frame(3, 0, sdu_data[3], 4);
+    check_received_sdus(4);
+}
+
+TEST(L2CAP_ERTM, SelectiveRejectStoredFramesUseOwnBuffers){
+    open_channel(4, 4, 4, 0x28);
+    // frames 0 and 1 lost, 2 and 3 stored in separate rx buffers
+    send_i_frame(2, 0, sdu_data[2], 4);
+    send_i_frame(3, 0, sdu_data[3], 4);
+    check_s_frame(S_FRAME_SREJ, 0);
+    check_s_frame(S_FRAME_SREJ, 1);
+    check_no_more_frames();
+    send_i_frame(0, 0, sdu_data[0], 4);
+    send_i_frame(1, 0, sdu_data[1], 4);
+    check_received_sdus(4);
+}
+
+TEST(L2CAP_ERTM, SelectiveRejectRetransmitsRequestedFrame){
+    open_channel(4, 4, 4, 0x28);
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    check_i_frame(0);
+    check_i_frame(1);
+
+    // remote requests tx_seq 0 only
+    send_s_frame(S_FRAME_SREJ, 0, 0, 0);
+    check_i_frame(0);
+    check_no_more_frames();
+
+    // ack all
+    send_s_frame(S_FRAME_RR, 0, 0, 2);
+    CHECK_EQUAL(0, mock_l2cap_channel()->unacked_frames);
+    CHECK_EQUAL(0, mock_l2cap_channel()->num_stored_tx_frames);
+}
+
+TEST(L2CAP_ERTM, ExtendedWindowSize){
+    open_channel(70, 4, 100, 0x0128);
+
+    // our config request announced 70 frames via Extended Window Size option
+    uint8_t * command = last_signaling_command(CONFIGURE_REQUEST);
+    CHECK(command != NULL);
+    uint16_t options_len = little_endian_read_16(command, 2) - 4;
+    uint8_t * options = &command[8];
+    int pos = 0;
+    int extended_window_size = 0;
+    while (pos < options_len){
+        if (options[pos] == L2CAP_CONFIG_OPTION_TYPE_EXTENDED_WINDOW_SIZE){
+            extended_window_size = little_endian_read_16(options, pos + 2);
+        }
+        pos += 2 + options[pos + 1];
+    }
+    CHECK_EQUAL(70, extended_window_size);
+    CHECK_EQUAL(1, mock_l2cap_channel()->extended_control);
+    CHECK_EQUAL(100, mock_l2cap_channel()->remote_tx_window_size);
+
+    // 14-bit sequence numbers: 65 frames in sequence wrap past 6 bit
+    int i;
+    for (i=0;i<65;i++){
+        send_i_frame(i, 0, sdu_data[i % 5], 4);
+        check_s_frame(S_FRAME_RR, i + 1);
+    }
+    CHECK_EQUAL(65, num_received_sdus);
+    CHECK_EQUAL(65, mock_l2cap_channel()->expected_tx_seq);
+
+    // out-of-sequence frame beyond 63 is stored and missing one requested
+    send_i_frame(66, 0, sdu_data[1], 4);
+    check_s_frame(S_FRAME_SREJ, 65);
+    check_no_more_frames();
+    send_i_frame(65, 0, sdu_data[0], 4);
+    check_s_frame(S_FRAME_RR, 67);
+    CHECK_EQUAL(67, num_received_sdus);
+    MEMCMP_EQUAL(sdu_data[1], received_sdus[66], 4);
+
+    // outgoing I-Frame uses Extended Control Field
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    frame_t frame;
+    CHECK(next_sent_frame(&frame));
+    CHECK_EQUAL(0, frame.s_frame);
+    CHECK_EQUAL(0, frame.tx_seq);
+    CHECK_EQUAL(67, frame.req_seq);
+    CHECK_EQUAL(4, frame.payload_len);
+    MEMCMP_EQUAL(data, frame.payload, 4);
+}
+
+TEST(L2CAP_ERTM, RoundTripTime){
+    open_channel(4, 4, 4, 0x28);
+    l2cap_channel_t * channel = mock_l2cap_channel();
+    CHECK_EQUAL(2000, channel->retransmission_timeout_ms);
+
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    check_i_frame(0);
+    CHECK(mock_timer_active(&channel->retransmission_timer));
+    CHECK_EQUAL(2000, channel->retransmission_timer.timeout);
+
+    // ack after 100 ms: SRTT 100, RTTVAR 50 -> 300 ms
+    mock_set_time_ms(1100);
+    send_s_frame(S_FRAME_RR, 0, 0, 1);
+    CHECK_EQUAL(300, channel->retransmission_timeout_ms);
+    CHECK(!mock_timer_active(&channel->retransmission_timer));
+
+    // next frame uses measured timeout
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    check_i_frame(1);
+    CHECK_EQUAL(300, channel->retransmission_timer.timeout);
+
+    // timeout backs off and polls remote
+    mock_fire_timer(&channel->retransmission_timer);
+    complete_packets();
+    CHECK_EQUAL(600, channel->retransmission_timeout_ms);
+    frame_t frame;
+    CHECK(next_sent_frame(&frame));
+    CHECK_EQUAL(1, frame.s_frame);
+    CHECK_EQUAL(S_FRAME_RR, frame.function);
+    CHECK_EQUAL(1, frame.poll);
+
+    // remote asks for retransmission, frame sent twice is not used for RTT (Karn's algorithm)
+    send_s_frame(S_FRAME_REJ, 0, 0, 1);
+    check_i_frame(1);
+    mock_set_time_ms(5000);
+    send_s_frame(S_FRAME_RR, 0, 1, 2);
+    CHECK_EQUAL(600, channel->retransmission_timeout_ms);
+    CHECK_EQUAL(100, channel->srtt_ms);
+}
+
+TEST(L2CAP_ERTM, RoundTripTimeWithoutTime){
+    // run loop without time source
+    mock_set_time_ms(0);
+    open_channel(4, 4, 4, 0x28);
+    l2cap_channel_t * channel = mock_l2cap_channel();
+
+    uint8_t data[4] = { 1, 2, 3, 4 };
+    CHECK_EQUAL(0, l2cap_send(local_cid, data, sizeof(data)));
+    complete_packets();
+    check_i_frame(0);
+    send_s_frame(S_FRAME_RR, 0, 0, 1);
+    CHECK_EQUAL(0, channel->srtt_ms);
+    CHECK_EQUAL(2000, channel->retransmission_timeout_ms);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -0,0 +1,289 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "btstack_memory.h"
+#include "btstack_run_loop.h"
+#include "btstack_linked_list.h"
+#include "gap.h"
+#include "hci.h"
+#include "hci_dump.h"
+#include "l2cap.h"
+
+#include "mock.h"
+
+static hci_connection_t      the_connection;
+static btstack_linked_list_t connections;
+static btstack_linked_list_t event_packet_handlers;
+static btstack_packet_handler_t acl_packet_handler;
+
+static uint8_t  outgoing_buffer[HCI_ACL_PAYLOAD_SIZE + 4];
+static int      outgoing_buffer_reserved;
+
+static uint8_t  sent_packets[MOCK_MAX_SENT_PACKETS][HCI_ACL_PAYLOAD_SIZE + 4];
+static uint16_t sent_packet_sizes[MOCK_MAX_SENT_PACKETS];
+static int      num_sent_packets;
+
+static l2cap_channel_t l2cap_channel;
+static int l2cap_channel_used;
+static l2cap_service_t l2cap_service;
+
+static btstack_linked_list_t timers;
+static uint32_t time_ms;
+
+void mock_init(bd_addr_t address, hci_con_handle_t con_handle){
+    memset(&the_connection, 0, sizeof(the_connection));
+    bd_addr_copy(the_connection.address, address);
+    the_connection.address_type = BD_ADDR_TYPE_CLASSIC;
+    the_connection.con_handle = con_handle;
+    the_connection.state = OPEN;
+    the_connection.bonding_flags = BONDING_RECEIVED_REMOTE_FEATURES;
+    connections = (btstack_linked_item_t *) &the_connection;
+    event_packet_handlers = NULL;
+    acl_packet_handler = NULL;
+    outgoing_buffer_reserved = 0;
+    num_sent_packets = 0;
+    timers = NULL;
+    time_ms = 0;
+    l2cap_channel_used = 0;
+}
+
+l2cap_channel_t * mock_l2cap_channel(void){
+    return &l2cap_channel;
+}
+
+int mock_num_sent_packets(void){
+    return num_sent_packets;
+}
+
+uint8_t * mock_sent_packet(int index, uint16_t * size){
+    *size = sent_packet_sizes[index];
+    return sent_packets[index];
+}
+
+void mock_simulate_acl_packet(uint8_t * packet, uint16_t size){
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 1, packet, size);
+    (*acl_packet_handler)(HCI_ACL_DATA_PACKET, 0, packet, size);
+}
+
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size){
+    hci_dump_packet(HCI_EVENT_PACKET, 1, packet, size);
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &event_packet_handlers);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        btstack_packet_callback_registration_t * item = (btstack_packet_callback_registration_t *) btstack_linked_list_iterator_next(&it);
+        item->callback(HCI_EVENT_PACKET, 0, packet, size);
+    }
+}
+
+void mock_set_time_ms(uint32_t now_ms){
+    time_ms = now_ms;
+}
+
+int mock_timer_active(btstack_timer_source_t * timer){
+    btstack_linked_list_iterator_t it;
+    btstack_linked_list_iterator_init(&it, &timers);
+    while (btstack_linked_list_iterator_has_next(&it)){
+        if (btstack_linked_list_iterator_next(&it) == (btstack_linked_item_t *) timer) return 1;
+    }
+    return 0;
+}
+
+void mock_fire_timer(btstack_timer_source_t * timer){
+    btstack_linked_list_remove(&timers, (btstack_linked_item_t *) timer);
+    (*timer->process)(timer);
+}
+
+// HCI
+
+void hci_add_event_handler(btstack_packet_callback_registration_t * callback_handler){
+    btstack_linked_list_add(&event_packet_handlers, (btstack_linked_item_t *) callback_handler);
+}
+
+void hci_register_acl_packet_handler(btstack_packet_handler_t handler){
+    acl_packet_handler = handler;
+}
+
+hci_connection_t * hci_connection_for_handle(hci_con_handle_t con_handle){
+    if (con_handle != the_connection.con_handle) return NULL;
+    return &the_connection;
+}
+
+hci_connection_t * hci_connection_for_bd_addr_and_type(bd_addr_t addr, bd_addr_type_t addr_type){
+    if (addr_type != the_connection.address_type) return NULL;
+    if (bd_addr_cmp(addr, the_connection.address)) return NULL;
+    return &the_connection;
+}
+
+void hci_connections_get_iterator(btstack_linked_list_iterator_t *it){
+    btstack_linked_list_iterator_init(it, &connections);
+}
+
+int hci_can_send_command_packet_now(void){
+    return 1;
+}
+
+int hci_send_cmd(const hci_cmd_t *cmd, ...){
+    UNUSED(cmd);
+    return 0;
+}
+
+int hci_can_send_acl_classic_packet_now(void){
+    return !outgoing_buffer_reserved;
+}
+
+int hci_can_send_acl_le_packet_now(void){
+    return !outgoing_buffer_reserved;
+}
+
+int hci_can_send_acl_packet_now(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return !outgoing_buffer_reserved;
+}
+
+int hci_can_send_prepared_acl_packet_now(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+    return 1;
+}
+
+int hci_reserve_packet_buffer(void){
+    outgoing_buffer_reserved = 1;
+    return 1;
+}
+
+void hci_release_packet_buffer(void){
+    outgoing_buffer_reserved = 0;
+}
+
+int hci_is_packet_buffer_reserved(void){
+    return outgoing_buffer_reserved;
+}
+
+uint8_t * hci_get_outgoing_packet_buffer(void){
+    return outgoing_buffer;
+}
+
+int hci_send_acl_packet_buffer(int size){
+    hci_dump_packet(HCI_ACL_DATA_PACKET, 0, outgoing_buffer, size);
+    if (num_sent_packets < MOCK_MAX_SENT_PACKETS){
+        memcpy(sent_packets[num_sent_packets], outgoing_buffer, size);
+        sent_packet_sizes[num_sent_packets] = size;
+        num_sent_packets++;
+    }
+    outgoing_buffer_reserved = 0;
+    return 0;
+}
+
+int hci_authentication_active_for_handle(hci_con_handle_t handle){
+    UNUSED(handle);
+    return 0;
+}
+
+uint16_t hci_max_acl_data_packet_length(void){
+    return HCI_ACL_PAYLOAD_SIZE;
+}
+
+uint16_t hci_usable_acl_packet_types(void){
+    return 0;
+}
+
+int hci_non_flushable_packet_boundary_flag_supported(void){
+    return 0;
+}
+
+void hci_disconnect_security_block(hci_con_handle_t con_handle){
+    UNUSED(con_handle);
+}
+
+// GAP
+
+int gap_ssp_supported_on_both_sides(hci_con_handle_t handle){
+    UNUSED(handle);
+    return 0;
+}
+
+gap_connection_type_t gap_get_connection_type(hci_con_handle_t connection_handle){
+    UNUSED(connection_handle);
+    return GAP_CONNECTION_ACL;
+}
+
+void gap_request_security_level(hci_con_handle_t con_handle, gap_security_level_t level){
+    UNUSED(con_handle);
+    UNUSED(level);
+}
+
+void gap_get_connection_parameter_range(le_connection_parameter_range_t * range){
+    UNUSED(range);
+}
+
+int gap_connection_parameter_range_included(le_connection_parameter_range_t * existing_range, uint16_t le_conn_interval_min, uint16_t le_conn_interval_max, uint16_t le_conn_latency, uint16_t le_supervision_timeout){
+    UNUSED(existing_range);
+    UNUSED(le_conn_interval_min);
+    UNUSED(le_conn_interval_max);
+    UNUSED(le_conn_latency);
+    UNUSED(le_supervision_timeout);
+    return 1;
+}
+
+void gap_connectable_control(uint8_t enable){
+    UNUSED(enable);
+}
+
+void gap_drop_link_key_for_bd_addr(bd_addr_t addr){
+    (void) addr;
+}
+
+// Memory, single channel for inspection by test
+
+l2cap_channel_t * btstack_memory_l2cap_channel_get(void){
+    if (l2cap_channel_used) return NULL;
+    l2cap_channel_used = 1;
+    memset(&l2cap_channel, 0, sizeof(l2cap_channel));
+    return &l2cap_channel;
+}
+
+void btstack_memory_l2cap_channel_free(l2cap_channel_t * l2cap_channel){
+    UNUSED(l2cap_channel);
+    l2cap_channel_used = 0;
+}
+
+l2cap_service_t * btstack_memory_l2cap_service_get(void){
+    memset(&l2cap_service, 0, sizeof(l2cap_service));
+    return &l2cap_service;
+}
+
+void btstack_memory_l2cap_service_free(l2cap_service_t * l2cap_service){
+    UNUSED(l2cap_service);
+}
+
+// Run Loop
+
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t * timer, void (*process)(btstack_timer_source_t * _timer)){
+    timer->process = process;
+}
+
+void btstack_run_loop_set_timer_context(btstack_timer_source_t * timer, void * context){
+    timer->context = context;
+}
+
+void * btstack_run_loop_get_timer_context(btstack_timer_source_t * timer){
+    return timer->context;
+}
+
+void btstack_run_loop_set_timer(btstack_timer_source_t * timer, uint32_t timeout_in_ms){
+    timer->timeout = timeout_in_ms;
+}
+
+void btstack_run_loop_add_timer(btstack_timer_source_t * timer){
+    btstack_linked_list_remove(&timers, (btstack_linked_item_t *) timer);
+    btstack_linked_list_add(&timers, (btstack_linked_item_t *) timer);
+}
+
+int btstack_run_loop_remove_timer(btstack_timer_source_t * timer){
+    return btstack_linked_list_remove(&timers, (btstack_linked_item_t *) timer);
+}
+
+uint32_t btstack_run_loop_get_time_ms(void){
+    return time_ms;
+}
@@ -0,0 +1,33 @@
+#ifndef __MOCK_H
+#define __MOCK_H
+
+#include <stdint.h>
+
+#include "btstack_run_loop.h"
+#include "hci.h"
+#include "l2cap.h"
+
+#define MOCK_MAX_SENT_PACKETS 300
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+void mock_init(bd_addr_t address, hci_con_handle_t con_handle);
+l2cap_channel_t * mock_l2cap_channel(void);
+
+int       mock_num_sent_packets(void);
+uint8_t * mock_sent_packet(int index, uint16_t * size);
+
+void mock_simulate_acl_packet(uint8_t * packet, uint16_t size);
+void mock_simulate_hci_event(uint8_t * packet, uint16_t size);
+
+void mock_set_time_ms(uint32_t now_ms);
+int  mock_timer_active(btstack_timer_source_t * timer);
+void mock_fire_timer(btstack_timer_source_t * timer);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,367 @@
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "btstack_event.h"
+#include "btstack_util.h"
+#include "hci.h"
+#include "l2cap.h"
+#include "l2cap_signaling.h"
+
+#include "mock.h"
+
+#define TEST_CON_HANDLE  0x0040
+#define TEST_PSM         0x0080
+#define TEST_REMOTE_CID  0x0070
+#define TEST_REMOTE_MTU  500
+#define TEST_REMOTE_MPS  50
+#define TEST_LOCAL_MTU   200
+
+static bd_addr_t remote_addr = { 0xC0, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+static uint8_t   receive_buffer[TEST_LOCAL_MTU];
+static uint8_t   sdu_data[TEST_REMOTE_MTU];
+static uint16_t  local_cid;
+static int       channel_opened;
+static int       num_packets_sent_events;
+static int       num_can_send_now_events;
+static int       num_received_sdus;
+
+// credits granted by the stack, as seen by the remote
+static uint16_t  remote_credits;
+static int       num_processed_packets;
+
+static void packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    switch (packet_type){
+        case L2CAP_DATA_PACKET:
+            num_received_sdus++;
+            break;
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case L2CAP_EVENT_LE_CHANNEL_OPENED:
+                    if (l2cap_event_le_channel_opened_get_status(packet) != 0) break;
+                    channel_opened = 1;
+                    break;
+                case L2CAP_EVENT_LE_PACKET_SENT:
+                    num_packets_sent_events++;
+                    break;
+                case L2CAP_EVENT_LE_CAN_SEND_NOW:
+                    num_can_send_now_events++;
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// trigger l2cap_run until all pending packets are sent
+static void complete_packets(void){
+    int i;
+    for (i=0;i<20;i++){
+        uint8_t event[] = { HCI_EVENT_NUMBER_OF_COMPLETED_PACKETS, 5, 1, TEST_CON_HANDLE, 0x00, 0x01, 0x00 };
+        int num_sent = mock_num_sent_packets();
+        mock_simulate_hci_event(event, sizeof(event));
+        if (num_sent == mock_num_sent_packets()) break;
+    }
+}
+
+static void send_l2cap_packet(uint16_t cid, const uint8_t * data, uint16_t len){
+    uint8_t packet[300];
+    little_endian_store_16(packet, 0, TEST_CON_HANDLE | 0x2000);
+    little_endian_store_16(packet, 2, len + 4);
+    little_endian_store_16(packet, 4, len);
+    little_endian_store_16(packet, 6, cid);
+    memcpy(&packet[8], data, len);
+    mock_simulate_acl_packet(packet, len + 8);
+}
+
+static void send_signaling_packet(uint8_t code, uint8_t sig_id, const uint8_t * data, uint16_t len){
+    uint8_t command[100];
+    command[0] = code;
+    command[1] = sig_id;
+    little_endian_store_16(command, 2, len);
+    memcpy(&command[4], data, len);
+    send_l2cap_packet(L2CAP_CID_SIGNALING_LE, command, len + 4);
+    complete_packets();
+}
+
+// process packets sent by stack since last call: count PDUs and track credits provided to remote
+static int process_sent_packets(void){
+    int num_pdus = 0;
+    while (num_processed_packets < mock_num_sent_packets()){
+        uint16_t size;
+        uint8_t * packet = mock_sent_packet(num_processed_packets++, &size);
+        uint16_t cid = little_endian_read_16(packet, 6);
+        if (cid == TEST_REMOTE_CID){
+            num_pdus++;
+            continue;
+        }
+        if (cid != L2CAP_CID_SIGNALING_LE) continue;
+        switch (packet[8]){
+            case LE_CREDIT_BASED_CONNECTION_REQUEST:
+                remote_credits = little_endian_read_16(packet, 8 + 4 + 8);
+                break;
+            case LE_FLOW_CONTROL_CREDIT:
+                remote_credits += little_endian_read_16(packet, 8 + 4 + 2);
+                break;
+            default:
+                break;
+        }
+    }
+    return num_pdus;
+}
+
+// returns signaling command of last sent packet with given code, or NULL
+static uint8_t * last_signaling_command(uint8_t code){
+    int i;
+    for (i=mock_num_sent_packets()-1;i>=0;i--){
+        uint16_t size;
+        uint8_t * packet = mock_sent_packet(i, &size);
+        if (little_endian_read_16(packet, 6) != L2CAP_CID_SIGNALING_LE) continue;
+        if (packet[8] == code) return &packet[8];
+    }
+    return NULL;
+}
+
+static void open_channel(uint16_t initial_credits, uint16_t remote_initial_credits){
+    CHECK_EQUAL(0, l2cap_le_create_channel(&packet_handler, TEST_CON_HANDLE, TEST_PSM, receive_buffer, TEST_LOCAL_MTU,
+        initial_credits, LEVEL_0, &local_cid));
+    complete_packets();
+    uint8_t * command = last_signaling_command(LE_CREDIT_BASED_CONNECTION_REQUEST);
+    CHECK(command != NULL);
+    uint8_t connection_response[10];
+    little_endian_store_16(connection_response, 0, TEST_REMOTE_CID);
+    little_endian_store_16(connection_response, 2, TEST_REMOTE_MTU);
+    little_endian_store_16(connection_response, 4, TEST_REMOTE_MPS);
+    little_endian_store_16(connection_response, 6, remote_initial_credits);
+    little_endian_store_16(connection_response, 8, 0);
+    send_signaling_packet(LE_CREDIT_BASED_CONNECTION_RESPONSE, command[1], connection_response, sizeof(connection_response));
+    CHECK(channel_opened);
+    process_sent_packets();
+}
+
+// remote provides credits for our PDUs
+static void send_flow_control_credit(uint16_t credits){
+    uint8_t credit[4];
+    little_endian_store_16(credit, 0, local_cid);
+    little_endian_store_16(credit, 2, credits);
+    send_signaling_packet(LE_FLOW_CONTROL_CREDIT, 0x30, credit, sizeof(credit));
+}
+
+// remote sends single PDU SDU
+static void send_sdu(uint16_t len){
+    uint8_t pdu[TEST_LOCAL_MTU + 2];
+    little_endian_store_16(pdu, 0, len);
+    memcpy(&pdu[2], sdu_data, len);
+    CHECK(remote_credits > 0);
+    remote_credits--;
+    send_l2cap_packet(local_cid, pdu, len + 2);
+}
+
+TEST_GROUP(L2CAP_LE_DATA_CHANNEL){
+    void setup(void){
+        mock_init(remote_addr, BD_ADDR_TYPE_LE_PUBLIC, TEST_CON_HANDLE);
+        l2cap_init();
+        local_cid = 0;
+        channel_opened = 0;
+        num_packets_sent_events = 0;
+        num_can_send_now_events = 0;
+        num_received_sdus = 0;
+        remote_credits = 0;
+        num_processed_packets = 0;
+        int i;
+        for (i=0;i<TEST_REMOTE_MTU;i++){
+            sdu_data[i] = (uint8_t) i;
+        }
+    }
+};
+
+TEST(L2CAP_LE_DATA_CHANNEL, QueueSDUs){
+    open_channel(10, 100);
+    mock_set_acl_buffers_full(1);
+    // one SDU in transmission plus queue
+    int i;
+    for (i=0;i<L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE+1;i++){
+        CHECK_EQUAL(0, l2cap_le_send_data(local_cid, sdu_data, 10));
+    }
+    CHECK_EQUAL(0, l2cap_le_send_queue_num_free(local_cid));
+    CHECK_EQUAL(0, l2cap_le_can_send_now(local_cid));
+    CHECK_EQUAL(BTSTACK_ACL_BUFFERS_FULL, l2cap_le_send_data(local_cid, sdu_data, 10));
+    CHECK_EQUAL(0, process_sent_packets());
+
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    CHECK_EQUAL(L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE+1, process_sent_packets());
+    CHECK_EQUAL(L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE+1, num_packets_sent_events);
+    CHECK_EQUAL(L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE+1, l2cap_le_send_queue_num_free(local_cid));
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, QueuedSDUsInOrder){
+    open_channel(10, 100);
+    mock_set_acl_buffers_full(1);
+    uint8_t sdus[3][4];
+    int i;
+    for (i=0;i<3;i++){
+        memset(sdus[i], i + 1, sizeof(sdus[i]));
+        CHECK_EQUAL(0, l2cap_le_send_data(local_cid, sdus[i], sizeof(sdus[i])));
+    }
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    for (i=0;i<3;i++){
+        uint16_t size;
+        uint8_t * packet = mock_sent_packet(num_processed_packets + i, &size);
+        // header, sdu len, payload
+        CHECK_EQUAL(8 + 2 + 4, size);
+        CHECK_EQUAL(4, little_endian_read_16(packet, 8));
+        MEMCMP_EQUAL(sdus[i], &packet[10], 4);
+    }
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, PipelinePDUs){
+    open_channel(10, 100);
+    // SDU len + 200 bytes payload in PDUs of 50 bytes
+    CHECK_EQUAL(0, l2cap_le_send_data(local_cid, sdu_data, 200));
+    // all PDUs sent without waiting for Number Of Completed Packets
+    CHECK_EQUAL(5, process_sent_packets());
+    CHECK_EQUAL(1, num_packets_sent_events);
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, WaitForCredits){
+    open_channel(10, 2);
+    CHECK_EQUAL(0, l2cap_le_send_data(local_cid, sdu_data, 200));
+    CHECK_EQUAL(2, process_sent_packets());
+    CHECK_EQUAL(0, num_packets_sent_events);
+    send_flow_control_credit(10);
+    CHECK_EQUAL(3, process_sent_packets());
+    CHECK_EQUAL(1, num_packets_sent_events);
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, SendMultiple){
+    open_channel(10, 100);
+    mock_set_acl_buffers_full(1);
+    l2cap_le_sdu_t sdus[L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 2];
+    int i;
+    for (i=0;i<L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 2;i++){
+        sdus[i].data = sdu_data;
+        sdus[i].len  = 10;
+    }
+    // all or nothing
+    CHECK_EQUAL(BTSTACK_ACL_BUFFERS_FULL, l2cap_le_send_data_multiple(local_cid, sdus, L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 2));
+    CHECK_EQUAL(L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 1, l2cap_le_send_queue_num_free(local_cid));
+    CHECK_EQUAL(0, l2cap_le_send_data_multiple(local_cid, sdus, L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 1));
+    CHECK_EQUAL(0, l2cap_le_send_queue_num_free(local_cid));
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    CHECK_EQUAL(L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE + 1, process_sent_packets());
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, SendMultipleExceedsMtu){
+    open_channel(10, 100);
+    l2cap_le_sdu_t sdus[2];
+    sdus[0].data = sdu_data;
+    sdus[0].len  = 10;
+    sdus[1].data = sdu_data;
+    sdus[1].len  = TEST_REMOTE_MTU + 1;
+    CHECK_EQUAL(L2CAP_DATA_LEN_EXCEEDS_REMOTE_MTU, l2cap_le_send_data_multiple(local_cid, sdus, 2));
+    CHECK_EQUAL(0, process_sent_packets());
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, CanSendNowWhenQueueHasSpace){
+    open_channel(10, 100);
+    mock_set_acl_buffers_full(1);
+    int i;
+    for (i=0;i<L2CAP_LE_DATA_CHANNELS_SEND_QUEUE_SIZE+1;i++){
+        CHECK_EQUAL(0, l2cap_le_send_data(local_cid, sdu_data, 10));
+    }
+    l2cap_le_request_can_send_now_event(local_cid);
+    CHECK_EQUAL(0, num_can_send_now_events);
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    CHECK_EQUAL(1, num_can_send_now_events);
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, ReceiveSDUs){
+    open_channel(10, 100);
+    CHECK_EQUAL(10, remote_credits);
+    int i;
+    for (i=0;i<5;i++){
+        send_sdu(20);
+    }
+    CHECK_EQUAL(5, num_received_sdus);
+}
+
+// remote sends SDUs as long as it has credits, returns number of SDUs sent
+static int stream_sdus(void){
+    int num_sdus = 0;
+    while (remote_credits > 0){
+        send_sdu(20);
+        num_sdus++;
+        complete_packets();
+        process_sent_packets();
+        if (num_sdus == 200) break;
+    }
+    return num_sdus;
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, AutomaticCreditsKeepWindow){
+    open_channel(L2CAP_LE_AUTOMATIC_CREDITS, 100);
+    CHECK_EQUAL(10, remote_credits);
+    // credits are returned in time, remote never runs dry
+    int i;
+    for (i=0;i<100;i++){
+        send_sdu(20);
+        complete_packets();
+        process_sent_packets();
+        CHECK(remote_credits > 0);
+        CHECK(remote_credits <= 10);
+    }
+    CHECK_EQUAL(100, num_received_sdus);
+}
+
+TEST(L2CAP_LE_DATA_CHANNEL, AutomaticCreditsGrowWindow){
+    open_channel(L2CAP_LE_AUTOMATIC_CREDITS, 100);
+    CHECK_EQUAL(10, remote_credits);
+
+    // credits cannot be returned while Controller buffers are full, remote runs dry
+    mock_set_acl_buffers_full(1);
+    CHECK_EQUAL(10, stream_sdus());
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    process_sent_packets();
+    CHECK_EQUAL(20, remote_credits);
+
+    mock_set_acl_buffers_full(1);
+    CHECK_EQUAL(20, stream_sdus());
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    process_sent_packets();
+    CHECK_EQUAL(40, remote_credits);
+
+    mock_set_acl_buffers_full(1);
+    CHECK_EQUAL(40, stream_sdus());
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    process_sent_packets();
+    CHECK_EQUAL(80, remote_credits);
+
+    // limited by L2CAP_LE_DATA_CHANNELS_AUTOMATIC_CREDITS_MAX
+    mock_set_acl_buffers_full(1);
+    CHECK_EQUAL(80, stream_sdus());
+    mock_set_acl_buffers_full(0);
+    complete_packets();
+    process_sent_packets();
+    CHECK_EQUAL(80, remote_credits);
+    CHECK_EQUAL(150, num_received_sdus);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
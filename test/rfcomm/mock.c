@@ -0,0 +1,182 @@
+#include <stdint.h>
+#include <string.h>
+
+#include "btstack_debug.h"
+#include "btstack_run_loop.h"
+#include "btstack_util.h"
+#include "bluetooth.h"
+#include "l2cap.h"
+
+#include "mock.h"
+
+static btstack_packet_handler_t l2cap_packet_handler;
+static uint8_t  outgoing_buffer[HCI_ACL_PAYLOAD_SIZE];
+static int      outgoing_buffer_reserved;
+static int      can_send_now_requested;
+static uint16_t can_send_now_cid;
+
+static uint8_t  sent_packets[MOCK_MAX_SENT_PACKETS][HCI_ACL_PAYLOAD_SIZE];
+static uint16_t sent_packet_sizes[MOCK_MAX_SENT_PACKETS];
+static uint16_t sent_packet_cids[MOCK_MAX_SENT_PACKETS];
+static int      num_sent_packets;
+
+void mock_init(void){
+    l2cap_packet_handler = NULL;
+    outgoing_buffer_reserved = 0;
+    can_send_now_requested = 0;
+    num_sent_packets = 0;
+}
+
+int mock_num_sent_packets(void){
+    return num_sent_packets;
+}
+
+uint8_t * mock_sent_packet(int index, uint16_t * size){
+    *size = sent_packet_sizes[index];
+    return sent_packets[index];
+}
+
+uint16_t mock_sent_packet_cid(int index){
+    return sent_packet_cids[index];
+}
+
+int mock_can_send_now_event(void){
+    if (!can_send_now_requested) return 0;
+    can_send_now_requested = 0;
+    uint8_t event[] = { L2CAP_EVENT_CAN_SEND_NOW, 2, 0, 0};
+    little_endian_store_16(event, 2, can_send_now_cid);
+    (*l2cap_packet_handler)(HCI_EVENT_PACKET, 0, event, sizeof(event));
+    return 1;
+}
+
+void mock_process_can_send_now(void){
+    int i;
+    for (i=0;i<MOCK_MAX_SENT_PACKETS;i++){
+        if (!mock_can_send_now_event()) break;
+    }
+}
+
+void mock_simulate_l2cap_event(uint8_t * packet, uint16_t size){
+    (*l2cap_packet_handler)(HCI_EVENT_PACKET, 0, packet, size);
+}
+
+void mock_simulate_l2cap_data(uint16_t local_cid, uint8_t * packet, uint16_t size){
+    (*l2cap_packet_handler)(L2CAP_DATA_PACKET, local_cid, packet, size);
+}
+
+static int mock_store_packet(uint16_t local_cid, const uint8_t * data, uint16_t len){
+    if (num_sent_packets >= MOCK_MAX_SENT_PACKETS) return BTSTACK_ACL_BUFFERS_FULL;
+    memcpy(sent_packets[num_sent_packets], data, len);
+    sent_packet_sizes[num_sent_packets] = len;
+    sent_packet_cids[num_sent_packets] = local_cid;
+    num_sent_packets++;
+    return 0;
+}
+
+// L2CAP
+
+uint8_t l2cap_register_service(btstack_packet_handler_t packet_handler, uint16_t psm, uint16_t mtu, gap_security_level_t security_level){
+    UNUSED(psm);
+    UNUSED(mtu);
+    UNUSED(security_level);
+    l2cap_packet_handler = packet_handler;
+    return 0;
+}
+
+uint8_t l2cap_unregister_service(uint16_t psm){
+    UNUSED(psm);
+    return 0;
+}
+
+uint8_t l2cap_create_channel(btstack_packet_handler_t packet_handler, bd_addr_t address, uint16_t psm, uint16_t mtu, uint16_t * out_local_cid){
+    UNUSED(address);
+    UNUSED(psm);
+    UNUSED(mtu);
+    l2cap_packet_handler = packet_handler;
+    if (out_local_cid){
+        *out_local_cid = 0x40;
+    }
+    return 0;
+}
+
+void l2cap_accept_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+void l2cap_decline_connection(uint16_t local_cid){
+    UNUSED(local_cid);
+}
+
+void l2cap_disconnect(uint16_t local_cid, uint8_t reason){
+    UNUSED(local_cid);
+    UNUSED(reason);
+}
+
+uint16_t l2cap_max_mtu(void){
+    return HCI_ACL_PAYLOAD_SIZE - L2CAP_HEADER_SIZE;
+}
+
+int l2cap_can_send_packet_now(uint16_t local_cid){
+    UNUSED(local_cid);
+    return !outgoing_buffer_reserved;
+}
+
+int l2cap_can_send_prepared_packet_now(uint16_t local_cid){
+    UNUSED(local_cid);
+    return 1;
+}
+
+void l2cap_request_can_send_now_event(uint16_t local_cid){
+    can_send_now_requested = 1;
+    can_send_now_cid = local_cid;
+}
+
+int l2cap_reserve_packet_buffer(void){
+    outgoing_buffer_reserved = 1;
+    return 1;
+}
+
+void l2cap_release_packet_buffer(void){
+    outgoing_buffer_reserved = 0;
+}
+
+uint8_t * l2cap_get_outgoing_buffer(void){
+    return outgoing_buffer;
+}
+
+int l2cap_send_prepared(uint16_t local_cid, uint16_t len){
+    outgoing_buffer_reserved = 0;
+    return mock_store_packet(local_cid, outgoing_buffer, len);
+}
+
+int l2cap_send(uint16_t local_cid, uint8_t *data, uint16_t len){
+    return mock_store_packet(local_cid, data, len);
+}
+
+// Run Loop
+
+void btstack_run_loop_set_timer(btstack_timer_source_t * timer, uint32_t timeout_in_ms){
+    UNUSED(timer);
+    UNUSED(timeout_in_ms);
+}
+
+void btstack_run_loop_set_timer_handler(btstack_timer_source_t * timer, void (*process)(btstack_timer_source_t * _timer)){
+    timer->process = process;
+}
+
+void btstack_run_loop_set_timer_context(btstack_timer_source_t * timer, void * context){
+    timer->context = context;
+}
+
+void * btstack_run_loop_get_timer_context(btstack_timer_source_t * timer){
+    return timer->context;
+}
+
+void btstack_run_loop_add_timer(btstack_timer_source_t * timer){
+    UNUSED(timer);
+}
+
+int btstack_run_loop_remove_timer(btstack_timer_source_t * timer){
+    UNUSED(timer);
+    return 1;
+}
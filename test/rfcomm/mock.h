@@ -0,0 +1,35 @@
+#ifndef __MOCK_H
+#define __MOCK_H
+
+#include <stdint.h>
+
+#include "btstack_defines.h"
+#include "bluetooth.h"
+
+#define MOCK_MAX_SENT_PACKETS 400
+
+#if defined __cplusplus
+extern "C" {
+#endif
+
+void mock_init(void);
+
+// packets sent via L2CAP
+int       mock_num_sent_packets(void);
+uint8_t * mock_sent_packet(int index, uint16_t * size);
+uint16_t  mock_sent_packet_cid(int index);
+
+// deliver L2CAP_EVENT_CAN_SEND_NOW events while requested
+void mock_process_can_send_now(void);
+
+// deliver single L2CAP_EVENT_CAN_SEND_NOW event if requested, returns 1 if delivered
+int  mock_can_send_now_event(void);
+
+void mock_simulate_l2cap_event(uint8_t * packet, uint16_t size);
+void mock_simulate_l2cap_data(uint16_t local_cid, uint8_t * packet, uint16_t size);
+
+#if defined __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,284 @@
+// *****************************************************************************
+//
+// test RFCOMM credit based flow control
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_util.h"
+#include "classic/rfcomm.h"
+
+#include "mock.h"
+
+#define TEST_L2CAP_CID       0x0041
+#define TEST_L2CAP_MTU       1000
+#define TEST_SERVER_CHANNEL  1
+#define TEST_DLCI            (TEST_SERVER_CHANNEL << 1)
+
+static bd_addr_t remote_addr = { 0xC0, 0x1b, 0xdc, 0x07, 0x32, 0xef };
+
+static uint16_t rfcomm_cid;
+static uint16_t max_frame_size;
+static int      num_received_frames;
+static uint8_t  app_data[TEST_L2CAP_MTU];
+static uint16_t app_frame_len;
+static int      app_streaming;
+
+// state of remote
+static uint16_t remote_credits;
+static int      num_processed_packets;
+static int      num_data_frames;
+static int      num_data_frames_with_credits;
+static int      num_credit_frames;
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(channel);
+    UNUSED(size);
+    switch (packet_type){
+        case RFCOMM_DATA_PACKET:
+            num_received_frames++;
+            break;
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case RFCOMM_EVENT_INCOMING_CONNECTION:
+                    rfcomm_accept_connection(rfcomm_event_incoming_connection_get_rfcomm_cid(packet));
+                    break;
+                case RFCOMM_EVENT_CHANNEL_OPENED:
+                    if (rfcomm_event_channel_opened_get_status(packet)) break;
+                    rfcomm_cid = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
+                    max_frame_size = rfcomm_event_channel_opened_get_max_frame_size(packet);
+                    break;
+                case RFCOMM_EVENT_CAN_SEND_NOW:
+                    if (!app_streaming) break;
+                    CHECK_EQUAL(0, rfcomm_send(rfcomm_cid, app_data, app_frame_len));
+                    rfcomm_request_can_send_now_event(rfcomm_cid);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// remote is initiator: C/R = 1 for commands
+static void send_frame(uint8_t dlci, uint8_t control, const uint8_t * payload, uint16_t len){
+    uint8_t frame[TEST_L2CAP_MTU];
+    uint16_t pos = 0;
+    frame[pos++] = (dlci << 2) | 0x03;
+    frame[pos++] = control;
+    frame[pos++] = (len << 1) | 1;
+    if (len){
+        memcpy(&frame[pos], payload, len);
+    }
+    pos += len;
+    frame[pos] = btstack_crc8_calc(frame, 2);
+    pos++;
+    mock_simulate_l2cap_data(TEST_L2CAP_CID, frame, pos);
+}
+
+static void send_multiplexer_command(const uint8_t * command, uint16_t len){
+    send_frame(0, BT_RFCOMM_UIH, command, len);
+}
+
+// parse frames sent by RFCOMM since last call
+static void process_sent_packets(void){
+    while (num_processed_packets < mock_num_sent_packets()){
+        uint16_t size;
+        uint8_t * frame = mock_sent_packet(num_processed_packets++, &size);
+        uint8_t dlci = frame[0] >> 2;
+        if (dlci != TEST_DLCI) continue;
+        uint8_t control = frame[1];
+        uint16_t pos;
+        uint16_t len;
+        if (frame[2] & 1){
+            len = frame[2] >> 1;
+            pos = 3;
+        } else {
+            len = (frame[2] >> 1) | (frame[3] << 7);
+            pos = 4;
+        }
+        uint8_t credits = 0;
+        if (control == BT_RFCOMM_UIH_PF){
+            credits = frame[pos];
+        }
+        remote_credits += credits;
+        if (len){
+            num_data_frames++;
+            if (credits){
+                num_data_frames_with_credits++;
+            }
+        } else if (credits){
+            num_credit_frames++;
+        }
+    }
+}
+
+static void open_channel(uint8_t outgoing_credits){
+    CHECK_EQUAL(0, rfcomm_register_service(&app_packet_handler, TEST_SERVER_CHANNEL, 0xffff));
+
+    // L2CAP connection
+    uint8_t incoming_connection[16];
+    memset(incoming_connection, 0, sizeof(incoming_connection));
+    incoming_connection[0] = L2CAP_EVENT_INCOMING_CONNECTION;
+    incoming_connection[1] = sizeof(incoming_connection) - 2;
+    reverse_bd_addr(remote_addr, &incoming_connection[2]);
+    little_endian_store_16(incoming_connection,  8, 0x0001);
+    little_endian_store_16(incoming_connection, 10, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(incoming_connection, 12, TEST_L2CAP_CID);
+    mock_simulate_l2cap_event(incoming_connection, sizeof(incoming_connection));
+
+    uint8_t channel_opened[24];
+    memset(channel_opened, 0, sizeof(channel_opened));
+    channel_opened[0] = L2CAP_EVENT_CHANNEL_OPENED;
+    channel_opened[1] = sizeof(channel_opened) - 2;
+    reverse_bd_addr(remote_addr, &channel_opened[3]);
+    little_endian_store_16(channel_opened,  9, 0x0001);
+    little_endian_store_16(channel_opened, 11, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(channel_opened, 13, TEST_L2CAP_CID);
+    little_endian_store_16(channel_opened, 17, TEST_L2CAP_MTU);
+    mock_simulate_l2cap_event(channel_opened, sizeof(channel_opened));
+
+    // multiplexer
+    send_frame(0, BT_RFCOMM_SABM, NULL, 0);
+    mock_process_can_send_now();
+
+    // parameter negotiation with credit based flow control
+    uint8_t pn[10] = { BT_RFCOMM_PN_CMD, (8 << 1) | 1, TEST_DLCI, 0xf0, 0, 0, 0, 0, 0, 0};
+    little_endian_store_16(pn, 6, TEST_L2CAP_MTU);
+    pn[9] = outgoing_credits;
+    send_multiplexer_command(pn, sizeof(pn));
+    mock_process_can_send_now();
+
+    // channel
+    send_frame(TEST_DLCI, BT_RFCOMM_SABM, NULL, 0);
+    mock_process_can_send_now();
+
+    uint8_t msc_cmd[4] = { BT_RFCOMM_MSC_CMD, (2 << 1) | 1, (TEST_DLCI << 2) | 0x03, 0x8d};
+    send_multiplexer_command(msc_cmd, sizeof(msc_cmd));
+    uint8_t msc_rsp[4] = { BT_RFCOMM_MSC_RSP, (2 << 1) | 1, (TEST_DLCI << 2) | 0x03, 0x8d};
+    send_multiplexer_command(msc_rsp, sizeof(msc_rsp));
+    mock_process_can_send_now();
+
+    CHECK(rfcomm_cid != 0);
+    process_sent_packets();
+}
+
+// remote sends data frame
+static void send_data_frame(void){
+    uint8_t data[20];
+    memset(data, 0x55, sizeof(data));
+    CHECK(remote_credits > 0);
+    remote_credits--;
+    send_frame(TEST_DLCI, BT_RFCOMM_UIH, data, sizeof(data));
+}
+
+// remote sends data while application streams frames of given size
+static void stream_in_both_directions(uint16_t frame_len, int num_frames){
+    app_frame_len = frame_len;
+    app_streaming = 1;
+    rfcomm_request_can_send_now_event(rfcomm_cid);
+    int i;
+    for (i=0;i<num_frames;i++){
+        send_data_frame();
+        // remote must not run out of credits before our response arrives
+        CHECK(remote_credits > 0);
+        // two outgoing packets per incoming one
+        mock_can_send_now_event();
+        mock_can_send_now_event();
+        process_sent_packets();
+    }
+    app_streaming = 0;
+}
+
+// remote sends data as long as it has credits while we cannot send, returns number of frames
+static int stream_until_out_of_credits(void){
+    int num_frames = 0;
+    while (remote_credits > 0){
+        send_data_frame();
+        num_frames++;
+    }
+    mock_process_can_send_now();
+    process_sent_packets();
+    return num_frames;
+}
+
+TEST_GROUP(RFCOMM_CREDITS){
+    void setup(void){
+        mock_init();
+        rfcomm_init();
+        rfcomm_cid = 0;
+        max_frame_size = 0;
+        num_received_frames = 0;
+        app_streaming = 0;
+        remote_credits = 0;
+        num_processed_packets = 0;
+        num_data_frames = 0;
+        num_data_frames_with_credits = 0;
+        num_credit_frames = 0;
+        memset(app_data, 0xaa, sizeof(app_data));
+    }
+};
+
+TEST(RFCOMM_CREDITS, Open){
+    open_channel(100);
+    CHECK_EQUAL(TEST_L2CAP_MTU - 5, max_frame_size);
+    CHECK_EQUAL(10, remote_credits);
+}
+
+TEST(RFCOMM_CREDITS, PiggybackCreditsOnSmallFrames){
+    open_channel(200);
+    stream_in_both_directions(10, 50);
+    CHECK_EQUAL(50, num_received_frames);
+    CHECK(num_data_frames_with_credits > 0);
+}
+
+TEST(RFCOMM_CREDITS, FullSizeFramesDoNotHoldBackCredits){
+    open_channel(200);
+    stream_in_both_directions(max_frame_size, 50);
+    CHECK_EQUAL(50, num_received_frames);
+    CHECK_EQUAL(0, num_data_frames_with_credits);
+    CHECK(num_credit_frames > 1);
+}
+
+TEST(RFCOMM_CREDITS, AutomaticCreditsKeepWindow){
+    open_channel(100);
+    int i;
+    for (i=0;i<100;i++){
+        send_data_frame();
+        mock_process_can_send_now();
+        process_sent_packets();
+        CHECK(remote_credits > 0);
+        CHECK(remote_credits <= 10);
+    }
+}
+
+TEST(RFCOMM_CREDITS, AutomaticCreditsGrowWindow){
+    open_channel(100);
+    CHECK_EQUAL(10, remote_credits);
+    CHECK_EQUAL(10, stream_until_out_of_credits());
+    CHECK_EQUAL(20, remote_credits);
+    CHECK_EQUAL(20, stream_until_out_of_credits());
+    CHECK_EQUAL(40, remote_credits);
+    CHECK_EQUAL(40, stream_until_out_of_credits());
+    CHECK_EQUAL(80, remote_credits);
+    // limited by RFCOMM_CREDITS_MAX
+    CHECK_EQUAL(80, stream_until_out_of_credits());
+    CHECK_EQUAL(80, remote_credits);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
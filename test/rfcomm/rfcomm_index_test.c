@@ -0,0 +1,260 @@
+// *****************************************************************************
+//
+// test RFCOMM channel and multiplexer lookup by DLCI, rfcomm_cid and l2cap_cid
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "btstack_memory.h"
+#include "btstack_util.h"
+#include "classic/rfcomm.h"
+
+#include "mock.h"
+
+#define TEST_L2CAP_MTU       1000
+#define TEST_NUM_CHANNELS    17
+
+// with default RFCOMM_CID_INDEX_SIZE of 8, these collide
+#define TEST_L2CAP_CID_A     0x0041
+#define TEST_L2CAP_CID_B     0x0049
+
+static bd_addr_t remote_addr_a = { 0xC0, 0x1b, 0xdc, 0x07, 0x32, 0xea };
+static bd_addr_t remote_addr_b = { 0xC0, 0x1b, 0xdc, 0x07, 0x32, 0xeb };
+
+static uint16_t last_opened_rfcomm_cid;
+static uint16_t last_closed_rfcomm_cid;
+static uint16_t last_data_rfcomm_cid;
+static uint8_t  last_data;
+
+static void app_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    UNUSED(size);
+    switch (packet_type){
+        case RFCOMM_DATA_PACKET:
+            last_data_rfcomm_cid = channel;
+            last_data = packet[0];
+            break;
+        case HCI_EVENT_PACKET:
+            switch (hci_event_packet_get_type(packet)){
+                case RFCOMM_EVENT_INCOMING_CONNECTION:
+                    rfcomm_accept_connection(rfcomm_event_incoming_connection_get_rfcomm_cid(packet));
+                    break;
+                case RFCOMM_EVENT_CHANNEL_OPENED:
+                    if (rfcomm_event_channel_opened_get_status(packet)) break;
+                    last_opened_rfcomm_cid = rfcomm_event_channel_opened_get_rfcomm_cid(packet);
+                    break;
+                case RFCOMM_EVENT_CHANNEL_CLOSED:
+                    last_closed_rfcomm_cid = rfcomm_event_channel_closed_get_rfcomm_cid(packet);
+                    break;
+                default:
+                    break;
+            }
+            break;
+        default:
+            break;
+    }
+}
+
+// remote is initiator: C/R = 1 for commands
+static void send_frame(uint16_t l2cap_cid, uint8_t dlci, uint8_t control, const uint8_t * payload, uint16_t len){
+    uint8_t frame[TEST_L2CAP_MTU];
+    uint16_t pos = 0;
+    frame[pos++] = (dlci << 2) | 0x03;
+    frame[pos++] = control;
+    frame[pos++] = (len << 1) | 1;
+    if (len){
+        memcpy(&frame[pos], payload, len);
+    }
+    pos += len;
+    frame[pos] = btstack_crc8_calc(frame, 2);
+    pos++;
+    mock_simulate_l2cap_data(l2cap_cid, frame, pos);
+    mock_process_can_send_now();
+}
+
+static void send_multiplexer_command(uint16_t l2cap_cid, const uint8_t * command, uint16_t len){
+    send_frame(l2cap_cid, 0, BT_RFCOMM_UIH, command, len);
+}
+
+static void open_multiplexer(bd_addr_t remote_addr, uint16_t l2cap_cid){
+    uint8_t incoming_connection[16];
+    memset(incoming_connection, 0, sizeof(incoming_connection));
+    incoming_connection[0] = L2CAP_EVENT_INCOMING_CONNECTION;
+    incoming_connection[1] = sizeof(incoming_connection) - 2;
+    reverse_bd_addr(remote_addr, &incoming_connection[2]);
+    little_endian_store_16(incoming_connection, 10, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(incoming_connection, 12, l2cap_cid);
+    mock_simulate_l2cap_event(incoming_connection, sizeof(incoming_connection));
+
+    uint8_t channel_opened[24];
+    memset(channel_opened, 0, sizeof(channel_opened));
+    channel_opened[0] = L2CAP_EVENT_CHANNEL_OPENED;
+    channel_opened[1] = sizeof(channel_opened) - 2;
+    reverse_bd_addr(remote_addr, &channel_opened[3]);
+    little_endian_store_16(channel_opened, 11, BLUETOOTH_PROTOCOL_RFCOMM);
+    little_endian_store_16(channel_opened, 13, l2cap_cid);
+    little_endian_store_16(channel_opened, 17, TEST_L2CAP_MTU);
+    mock_simulate_l2cap_event(channel_opened, sizeof(channel_opened));
+
+    send_frame(l2cap_cid, 0, BT_RFCOMM_SABM, NULL, 0);
+}
+
+static void close_multiplexer(uint16_t l2cap_cid){
+    uint8_t channel_closed[4] = { L2CAP_EVENT_CHANNEL_CLOSED, 2, 0, 0};
+    little_endian_store_16(channel_closed, 2, l2cap_cid);
+    mock_simulate_l2cap_event(channel_closed, sizeof(channel_closed));
+}
+
+// returns rfcomm_cid
+static uint16_t open_channel(uint16_t l2cap_cid, uint8_t server_channel){
+    uint8_t dlci = server_channel << 1;
+    uint8_t pn[10] = { BT_RFCOMM_PN_CMD, (8 << 1) | 1, dlci, 0xf0, 0, 0, 0, 0, 0, 10};
+    little_endian_store_16(pn, 6, TEST_L2CAP_MTU);
+    send_multiplexer_command(l2cap_cid, pn, sizeof(pn));
+    send_frame(l2cap_cid, dlci, BT_RFCOMM_SABM, NULL, 0);
+    uint8_t msc_cmd[4] = { BT_RFCOMM_MSC_CMD, (2 << 1) | 1, (uint8_t) ((dlci << 2) | 0x03), 0x8d};
+    send_multiplexer_command(l2cap_cid, msc_cmd, sizeof(msc_cmd));
+    last_opened_rfcomm_cid = 0;
+    uint8_t msc_rsp[4] = { BT_RFCOMM_MSC_RSP, (2 << 1) | 1, (uint8_t) ((dlci << 2) | 0x03), 0x8d};
+    send_multiplexer_command(l2cap_cid, msc_rsp, sizeof(msc_rsp));
+    CHECK(last_opened_rfcomm_cid != 0);
+    return last_opened_rfcomm_cid;
+}
+
+static void close_channel(uint16_t l2cap_cid, uint8_t server_channel){
+    last_closed_rfcomm_cid = 0;
+    send_frame(l2cap_cid, server_channel << 1, BT_RFCOMM_DISC, NULL, 0);
+}
+
+// remote sends data on DLCI, check that it's delivered on expected channel
+static void check_incoming_data(uint16_t l2cap_cid, uint8_t server_channel, uint16_t rfcomm_cid){
+    last_data_rfcomm_cid = 0;
+    uint8_t data = server_channel;
+    send_frame(l2cap_cid, server_channel << 1, BT_RFCOMM_UIH, &data, 1);
+    CHECK_EQUAL(rfcomm_cid, last_data_rfcomm_cid);
+    CHECK_EQUAL(server_channel, last_data);
+}
+
+// send data on rfcomm_cid, check that it goes out on expected L2CAP channel and DLCI
+static void check_outgoing_data(uint16_t rfcomm_cid, uint16_t l2cap_cid, uint8_t server_channel){
+    uint8_t data = 0x55;
+    CHECK_EQUAL(0, rfcomm_send(rfcomm_cid, &data, 1));
+    int index = mock_num_sent_packets() - 1;
+    uint16_t size;
+    uint8_t * frame = mock_sent_packet(index, &size);
+    CHECK_EQUAL(l2cap_cid, mock_sent_packet_cid(index));
+    CHECK_EQUAL(server_channel << 1, frame[0] >> 2);
+}
+
+static void check_channel(uint16_t l2cap_cid, uint8_t server_channel, uint16_t rfcomm_cid){
+    check_incoming_data(l2cap_cid, server_channel, rfcomm_cid);
+    check_outgoing_data(rfcomm_cid, l2cap_cid, server_channel);
+}
+
+static uint16_t rfcomm_cids[TEST_NUM_CHANNELS + 1];
+
+TEST_GROUP(RFCOMM_INDEX){
+    void setup(void){
+        mock_init();
+        rfcomm_init();
+        int i;
+        for (i=1;i<=TEST_NUM_CHANNELS;i++){
+            CHECK_EQUAL(0, rfcomm_register_service(&app_packet_handler, i, 0xffff));
+        }
+        memset(rfcomm_cids, 0, sizeof(rfcomm_cids));
+    }
+};
+
+TEST(RFCOMM_INDEX, CollidingRfcommCids){
+    open_multiplexer(remote_addr_a, TEST_L2CAP_CID_A);
+    int i;
+    for (i=1;i<=TEST_NUM_CHANNELS;i++){
+        rfcomm_cids[i] = open_channel(TEST_L2CAP_CID_A, i);
+    }
+    // rfcomm_cids 1, 9, 17 share a hash bucket
+    CHECK_EQUAL(1,  rfcomm_cids[1]);
+    CHECK_EQUAL(9,  rfcomm_cids[9]);
+    CHECK_EQUAL(17, rfcomm_cids[17]);
+    for (i=1;i<=TEST_NUM_CHANNELS;i++){
+        check_channel(TEST_L2CAP_CID_A, i, rfcomm_cids[i]);
+    }
+}
+
+TEST(RFCOMM_INDEX, RemoveChannels){
+    open_multiplexer(remote_addr_a, TEST_L2CAP_CID_A);
+    int i;
+    for (i=1;i<=TEST_NUM_CHANNELS;i++){
+        rfcomm_cids[i] = open_channel(TEST_L2CAP_CID_A, i);
+    }
+
+    // middle of chain
+    close_channel(TEST_L2CAP_CID_A, 9);
+    CHECK_EQUAL(rfcomm_cids[9], last_closed_rfcomm_cid);
+    uint8_t data = 0;
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, rfcomm_send(rfcomm_cids[9], &data, 1));
+    check_channel(TEST_L2CAP_CID_A, 1,  rfcomm_cids[1]);
+    check_channel(TEST_L2CAP_CID_A, 17, rfcomm_cids[17]);
+
+    // head of chain
+    close_channel(TEST_L2CAP_CID_A, 17);
+    CHECK_EQUAL(rfcomm_cids[17], last_closed_rfcomm_cid);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, rfcomm_send(rfcomm_cids[17], &data, 1));
+    check_channel(TEST_L2CAP_CID_A, 1,  rfcomm_cids[1]);
+
+    // last in chain
+    close_channel(TEST_L2CAP_CID_A, 1);
+    CHECK_EQUAL(rfcomm_cids[1], last_closed_rfcomm_cid);
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, rfcomm_send(rfcomm_cids[1], &data, 1));
+
+    // data for closed DLCI is not delivered
+    last_data_rfcomm_cid = 0;
+    data = 1;
+    send_frame(TEST_L2CAP_CID_A, 1 << 1, BT_RFCOMM_UIH, &data, 1);
+    CHECK_EQUAL(0, last_data_rfcomm_cid);
+
+    // other channels not affected
+    for (i=2;i<=TEST_NUM_CHANNELS;i++){
+        if (i == 9 || i == 17) continue;
+        check_channel(TEST_L2CAP_CID_A, i, rfcomm_cids[i]);
+    }
+
+    // DLCI can be used again
+    uint16_t rfcomm_cid = open_channel(TEST_L2CAP_CID_A, 9);
+    check_channel(TEST_L2CAP_CID_A, 9, rfcomm_cid);
+}
+
+TEST(RFCOMM_INDEX, CollidingL2capCids){
+    open_multiplexer(remote_addr_a, TEST_L2CAP_CID_A);
+    uint16_t rfcomm_cid_a = open_channel(TEST_L2CAP_CID_A, 1);
+    open_multiplexer(remote_addr_b, TEST_L2CAP_CID_B);
+    uint16_t rfcomm_cid_b = open_channel(TEST_L2CAP_CID_B, 1);
+    CHECK(rfcomm_cid_a != rfcomm_cid_b);
+
+    check_channel(TEST_L2CAP_CID_A, 1, rfcomm_cid_a);
+    check_channel(TEST_L2CAP_CID_B, 1, rfcomm_cid_b);
+
+    // L2CAP channel of first multiplexer closed
+    close_multiplexer(TEST_L2CAP_CID_A);
+    CHECK_EQUAL(rfcomm_cid_a, last_closed_rfcomm_cid);
+    uint8_t data = 0;
+    CHECK_EQUAL(ERROR_CODE_UNKNOWN_CONNECTION_IDENTIFIER, rfcomm_send(rfcomm_cid_a, &data, 1));
+    last_data_rfcomm_cid = 0;
+    data = 1;
+    send_frame(TEST_L2CAP_CID_A, 1 << 1, BT_RFCOMM_UIH, &data, 1);
+    CHECK_EQUAL(0, last_data_rfcomm_cid);
+
+    check_channel(TEST_L2CAP_CID_B, 1, rfcomm_cid_b);
+}
+
+int main (int argc, const char * argv[]){
+    btstack_memory_init();
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
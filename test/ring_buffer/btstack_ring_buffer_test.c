@@ -1,7 +1,9 @@
 #include "CppUTest/TestHarness.h"
 #include "CppUTest/CommandLineTestRunner.h"
 #include "btstack_ring_buffer.h"
+#include "btstack_ring_buffer_mirrored.h"
 #include "btstack_util.h"
+#include "hci_dump.h"
 
 static  uint8_t storage[10];
 
@@ -9,6 +11,11 @@ uint32_t btstack_min(uint32_t a, uint32_t b){
     return a < b ? a : b;
 }
 
+void hci_dump_log(int log_level, const char * format, ...){
+    (void) log_level;
+    (void) format;
+}
+
 TEST_GROUP(RingBuffer){
     btstack_ring_buffer_t ring_buffer;
     int storage_size;
@@ -93,6 +100,95 @@ TEST(RingBuffer, ReadWriteChunks){
     }
 }
 
+TEST(RingBuffer, ReadWriteSpans){
+    uint8_t test_write_data[] = {1,2,3,4,5,6,7};
+    uint8_t * span_0;
+    uint8_t * span_1;
+    uint32_t span_0_length;
+    uint32_t span_1_length;
+
+    // move indices to the middle of the storage
+    btstack_ring_buffer_write(&ring_buffer, test_write_data, 6);
+    CHECK_EQUAL(6, btstack_ring_buffer_read_spans(&ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length));
+    CHECK_EQUAL(6, span_0_length);
+    CHECK_EQUAL(0, span_1_length);
+    btstack_ring_buffer_read_commit(&ring_buffer, 6);
+    CHECK_TRUE(btstack_ring_buffer_empty(&ring_buffer));
+
+    // free space wraps around
+    CHECK_EQUAL(10, btstack_ring_buffer_write_spans(&ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length));
+    POINTERS_EQUAL(&storage[6], span_0);
+    CHECK_EQUAL(4, span_0_length);
+    POINTERS_EQUAL(&storage[0], span_1);
+    CHECK_EQUAL(6, span_1_length);
+    memcpy(span_0, test_write_data, 4);
+    memcpy(span_1, &test_write_data[4], 3);
+    btstack_ring_buffer_write_commit(&ring_buffer, 7);
+    CHECK_EQUAL(7, btstack_ring_buffer_bytes_available(&ring_buffer));
+
+    // data wraps around
+    CHECK_EQUAL(7, btstack_ring_buffer_read_spans(&ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length));
+    CHECK_EQUAL(4, span_0_length);
+    CHECK_EQUAL(3, span_1_length);
+    CHECK_EQUAL(0, memcmp(span_0, test_write_data, 4));
+    CHECK_EQUAL(0, memcmp(span_1, &test_write_data[4], 3));
+    btstack_ring_buffer_read_commit(&ring_buffer, 7);
+    CHECK_TRUE(btstack_ring_buffer_empty(&ring_buffer));
+}
+
+TEST(RingBuffer, WriteSpansFull){
+    uint8_t * span_0;
+    uint8_t * span_1;
+    uint32_t span_0_length;
+    uint32_t span_1_length;
+    btstack_ring_buffer_write_spans(&ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length);
+    btstack_ring_buffer_write_commit(&ring_buffer, span_0_length + span_1_length);
+    CHECK_EQUAL(storage_size, btstack_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(0, btstack_ring_buffer_write_spans(&ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length));
+}
+
+#ifdef __linux__
+TEST(RingBuffer, Mirrored){
+    btstack_ring_buffer_t mirrored_ring_buffer;
+    CHECK_EQUAL(0, btstack_ring_buffer_mirrored_init(&mirrored_ring_buffer, 100));
+    uint32_t size = mirrored_ring_buffer.size;
+    CHECK_TRUE(size >= 100);
+
+    // move indices close to the end of the storage
+    static uint8_t test_data[256];
+    int i;
+    for (i=0;i<256;i++){
+        test_data[i] = i;
+    }
+    uint32_t number_of_bytes_read;
+    uint8_t * span_0;
+    uint8_t * span_1;
+    uint32_t span_0_length;
+    uint32_t span_1_length;
+    btstack_ring_buffer_write_spans(&mirrored_ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length);
+    btstack_ring_buffer_write_commit(&mirrored_ring_buffer, size - 10);
+    btstack_ring_buffer_read_spans(&mirrored_ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length);
+    btstack_ring_buffer_read_commit(&mirrored_ring_buffer, size - 10);
+
+    // wrapping write and read are single spans
+    CHECK_EQUAL(0, btstack_ring_buffer_write(&mirrored_ring_buffer, test_data, sizeof(test_data)));
+    CHECK_EQUAL(sizeof(test_data), btstack_ring_buffer_read_spans(&mirrored_ring_buffer, &span_0, &span_0_length, &span_1, &span_1_length));
+    CHECK_EQUAL(sizeof(test_data), span_0_length);
+    CHECK_EQUAL(0, span_1_length);
+    CHECK_EQUAL(0, memcmp(span_0, test_data, sizeof(test_data)));
+
+    // data visible at begin of storage
+    CHECK_EQUAL(0, memcmp(mirrored_ring_buffer.storage, &test_data[10], sizeof(test_data) - 10));
+
+    uint8_t read_data[256];
+    btstack_ring_buffer_read(&mirrored_ring_buffer, read_data, sizeof(read_data), &number_of_bytes_read);
+    CHECK_EQUAL(sizeof(test_data), number_of_bytes_read);
+    CHECK_EQUAL(0, memcmp(read_data, test_data, sizeof(test_data)));
+
+    btstack_ring_buffer_mirrored_deinit(&mirrored_ring_buffer);
+}
+#endif
+
 int main (int argc, const char * argv[]){
     return CommandLineTestRunner::RunAllTests(argc, argv);
 }
\ No newline at end of file
@@ -0,0 +1,143 @@
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+#include "btstack_spsc_ring_buffer.h"
+
+#include <pthread.h>
+#include <string.h>
+
+static  uint8_t storage[10];
+
+TEST_GROUP(SPSCRingBuffer){
+    btstack_spsc_ring_buffer_t ring_buffer;
+    int storage_size;
+
+    void setup(void){
+        storage_size = sizeof(storage);
+        memset(storage, 0, storage_size);
+        btstack_spsc_ring_buffer_init(&ring_buffer, storage, storage_size);
+    }
+};
+
+TEST(SPSCRingBuffer, EmptyBuffer){
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(storage_size, btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+    uint32_t span_length = 1;
+    btstack_spsc_ring_buffer_read_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(0, span_length);
+}
+
+TEST(SPSCRingBuffer, WriteFullBuffer){    
+    uint8_t test_write_data[] = {1,2,3,4,5,6,7,8,9,10};
+    int test_data_size = sizeof(test_write_data);
+    uint8_t test_read_data[test_data_size];
+
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, test_data_size));
+    CHECK_EQUAL(test_data_size, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+    CHECK(btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, 1) != 0);
+
+    memset(test_read_data, 0, test_data_size);
+    uint32_t number_of_bytes_read = 0;
+    btstack_spsc_ring_buffer_read(&ring_buffer, test_read_data, test_data_size, &number_of_bytes_read); 
+    CHECK_EQUAL(test_data_size, number_of_bytes_read);
+    CHECK_EQUAL(0, memcmp(test_write_data, test_read_data, test_data_size));
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+}
+
+TEST(SPSCRingBuffer, ReadWriteChunks){    
+    uint8_t test_write_data[] = {1,2,3,4,5,6};
+    int test_data_size = sizeof(test_write_data);
+    uint8_t test_read_data[test_data_size];
+
+    int i;
+    for (i=0;i<30;i++){
+        CHECK_EQUAL(0, btstack_spsc_ring_buffer_write(&ring_buffer, test_write_data, test_data_size));
+        CHECK_EQUAL(test_data_size, btstack_spsc_ring_buffer_bytes_available(&ring_buffer));
+
+        memset(test_read_data, 0, test_data_size);
+        uint32_t number_of_bytes_read = 0;
+        btstack_spsc_ring_buffer_read(&ring_buffer, test_read_data, test_data_size, &number_of_bytes_read); 
+        CHECK_EQUAL(test_data_size, number_of_bytes_read);
+        CHECK_EQUAL(0, memcmp(test_write_data, test_read_data, test_data_size));
+    }
+}
+
+TEST(SPSCRingBuffer, Spans){
+    uint32_t span_length;
+    uint8_t * write_span = btstack_spsc_ring_buffer_write_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(storage_size, span_length);
+    POINTERS_EQUAL(storage, write_span);
+    memset(write_span, 0x55, 7);
+    btstack_spsc_ring_buffer_write_commit(&ring_buffer, 7);
+
+    const uint8_t * read_span = btstack_spsc_ring_buffer_read_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(7, span_length);
+    POINTERS_EQUAL(storage, read_span);
+    btstack_spsc_ring_buffer_read_commit(&ring_buffer, 5);
+
+    // free space wraps around: span ends at end of storage
+    write_span = btstack_spsc_ring_buffer_write_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(3, span_length);
+    POINTERS_EQUAL(&storage[7], write_span);
+    btstack_spsc_ring_buffer_write_commit(&ring_buffer, 3);
+
+    write_span = btstack_spsc_ring_buffer_write_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(5, span_length);
+    POINTERS_EQUAL(storage, write_span);
+    btstack_spsc_ring_buffer_write_commit(&ring_buffer, 5);
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_free(&ring_buffer));
+
+    // available data wraps around
+    read_span = btstack_spsc_ring_buffer_read_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(5, span_length);
+    POINTERS_EQUAL(&storage[5], read_span);
+    btstack_spsc_ring_buffer_read_commit(&ring_buffer, 5);
+    read_span = btstack_spsc_ring_buffer_read_span(&ring_buffer, &span_length);
+    CHECK_EQUAL(5, span_length);
+    POINTERS_EQUAL(storage, read_span);
+}
+
+// producer thread writes increasing byte sequence, consumer checks it
+#define THREAD_TEST_NUM_BYTES 1000000
+static btstack_spsc_ring_buffer_t thread_ring_buffer;
+static uint8_t thread_storage[77];
+
+static void * producer_thread(void * context){
+    (void) context;
+    uint32_t value = 0;
+    while (value < THREAD_TEST_NUM_BYTES){
+        uint32_t span_length;
+        uint8_t * span = btstack_spsc_ring_buffer_write_span(&thread_ring_buffer, &span_length);
+        uint32_t i;
+        for (i=0; i < span_length && value < THREAD_TEST_NUM_BYTES; i++){
+            span[i] = (uint8_t) value++;
+        }
+        btstack_spsc_ring_buffer_write_commit(&thread_ring_buffer, i);
+    }
+    return NULL;
+}
+
+TEST(SPSCRingBuffer, ProducerConsumerThreads){
+    btstack_spsc_ring_buffer_init(&thread_ring_buffer, thread_storage, sizeof(thread_storage));
+    pthread_t producer;
+    pthread_create(&producer, NULL, &producer_thread, NULL);
+    uint32_t expected = 0;
+    int errors = 0;
+    while (expected < THREAD_TEST_NUM_BYTES){
+        uint8_t buffer[13];
+        uint32_t number_of_bytes_read;
+        btstack_spsc_ring_buffer_read(&thread_ring_buffer, buffer, sizeof(buffer), &number_of_bytes_read);
+        uint32_t i;
+        for (i=0;i<number_of_bytes_read;i++){
+            if (buffer[i] != (uint8_t) expected) errors++;
+            expected++;
+        }
+    }
+    pthread_join(producer, NULL);
+    CHECK_EQUAL(0, errors);
+    CHECK_EQUAL(0, btstack_spsc_ring_buffer_bytes_available(&thread_ring_buffer));
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
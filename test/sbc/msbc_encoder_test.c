@@ -54,10 +54,19 @@
 
 #include "hfp_msbc.h"
 #include "btstack_sbc.h"
+#include "btstack_sbc_bludroid.h"
 #include "wav_util.h"
 
 static int16_t read_buffer[8*16*2];
+static int16_t silence_buffer[8*16*2];
 static uint8_t output_buffer[24];
+static uint8_t instance_output_buffer[24];
+
+// additional encoder instances, used to verify that concurrent streams don't affect each other
+static hfp_msbc_encoder_t msbc_encoder_instance;
+static hfp_msbc_encoder_t msbc_encoder_instance_silence;
+static bludroid_encoder_state_t msbc_encoder_storage;
+static bludroid_encoder_state_t msbc_encoder_storage_silence;
 
 int main (int argc, const char * argv[]){
     if (argc < 3){
@@ -80,7 +89,10 @@ int main (int argc, const char * argv[]){
     }
     
     hfp_msbc_init();
+    hfp_msbc_encoder_init(&msbc_encoder_instance, &msbc_encoder_storage);
+    hfp_msbc_encoder_init(&msbc_encoder_instance_silence, &msbc_encoder_storage_silence);
     int num_samples = hfp_msbc_num_audio_samples_per_frame();
+    int mismatches = 0;
 
     while (1){
         if (hfp_msbc_can_encode_audio_frame_now()){
@@ -88,13 +100,28 @@ int main (int argc, const char * argv[]){
             if (error) break;
 
             hfp_msbc_encode_audio_frame(read_buffer);
+            hfp_msbc_encoder_encode_audio_frame(&msbc_encoder_instance_silence, silence_buffer);
+            hfp_msbc_encoder_encode_audio_frame(&msbc_encoder_instance, read_buffer);
         }
         if (hfp_msbc_num_bytes_in_stream() >= sizeof(output_buffer)){
             hfp_msbc_read_from_stream(output_buffer, sizeof(output_buffer));
             fwrite(output_buffer, 1, sizeof(output_buffer), sbc_fd);
+
+            hfp_msbc_encoder_read_from_stream(&msbc_encoder_instance, instance_output_buffer, sizeof(instance_output_buffer));
+            if (memcmp(output_buffer, instance_output_buffer, sizeof(output_buffer)) != 0){
+                mismatches++;
+            }
+            hfp_msbc_encoder_read_from_stream(&msbc_encoder_instance_silence, instance_output_buffer, sizeof(instance_output_buffer));
         } 
     }
 
+    if (mismatches){
+        printf("mSBC encoder instances differ from single instance API: %d mismatches\n", mismatches);
+        wav_reader_close();
+        fclose(sbc_fd);
+        return -1;
+    }
+
     printf("Done\n");
     wav_reader_close();
     fclose(sbc_fd);
@@ -0,0 +1,205 @@
+// *****************************************************************************
+//
+// test SDP Service Search Attribute responses with continuation, with and without response cache and record index
+//
+// *****************************************************************************
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#include "bluetooth_sdp.h"
+#include "btstack_util.h"
+#include "classic/sdp_server.h"
+#include "classic/sdp_util.h"
+#include "classic/spp_server.h"
+
+#define NUM_RECORDS 4
+
+static uint8_t spp_records[NUM_RECORDS + 1][150];
+static uint8_t request[100];
+static uint8_t response[1100];
+static uint8_t attribute_lists[2000];
+
+// DES { UUID16 SerialPort }
+static const uint8_t pattern_serial_port[] = { 0x35, 0x03, 0x19, 0x11, 0x01 };
+// DES { UUID16 AudioSink }
+static const uint8_t pattern_audio_sink[]  = { 0x35, 0x03, 0x19, 0x11, 0x0b };
+// DES { UINT32 0x0000-0xffff }
+static const uint8_t attributes_all[]      = { 0x35, 0x05, 0x0a, 0x00, 0x00, 0xff, 0xff };
+// DES { UINT16 ServiceName }
+static const uint8_t attributes_name[]     = { 0x35, 0x03, 0x09, 0x01, 0x00 };
+
+// perform Service Search Attribute Request, follow continuations and collect AttributeLists
+static uint16_t query_attribute_lists(const uint8_t * pattern, uint16_t pattern_len, const uint8_t * attributes, uint16_t attributes_len, uint16_t mtu){
+    uint16_t attribute_lists_len = 0;
+    uint8_t  continuation[17];
+    continuation[0] = 0;
+    int num_responses = 0;
+    while (1){
+        uint16_t pos = 5;
+        memcpy(&request[pos], pattern, pattern_len);
+        pos += pattern_len;
+        big_endian_store_16(request, pos, 0xffff);
+        pos += 2;
+        memcpy(&request[pos], attributes, attributes_len);
+        pos += attributes_len;
+        memcpy(&request[pos], continuation, 1 + continuation[0]);
+        pos += 1 + continuation[0];
+        request[0] = SDP_ServiceSearchAttributeRequest;
+        big_endian_store_16(request, 1, 0x1234);
+        big_endian_store_16(request, 3, pos - 5);
+
+        int response_len = sdp_handle_service_search_attribute_request(request, mtu, response);
+        CHECK(response_len > 0);
+        CHECK(response_len <= mtu);
+        CHECK_EQUAL(SDP_ServiceSearchAttributeResponse, response[0]);
+        CHECK_EQUAL(0x1234, big_endian_read_16(response, 1));
+        uint16_t count = big_endian_read_16(response, 5);
+        memcpy(&attribute_lists[attribute_lists_len], &response[7], count);
+        attribute_lists_len += count;
+        memcpy(continuation, &response[7 + count], 1 + response[7 + count]);
+        num_responses++;
+        CHECK(num_responses < 100);
+        if (continuation[0] == 0) break;
+    }
+    return attribute_lists_len;
+}
+
+static int count_records(uint16_t attribute_lists_len){
+    CHECK_EQUAL(attribute_lists_len, de_get_len(attribute_lists));
+    int num_records = 0;
+    des_iterator_t it;
+    for (des_iterator_init(&it, attribute_lists); des_iterator_has_more(&it); des_iterator_next(&it)){
+        num_records++;
+    }
+    return num_records;
+}
+
+TEST_GROUP(SDPServer){
+    void setup(void){
+        int i;
+        for (i=0;i<=NUM_RECORDS;i++){
+            sdp_unregister_service(0x10001 + i);
+        }
+        for (i=0;i<NUM_RECORDS;i++){
+            spp_create_sdp_record(spp_records[i], 0x10001 + i, 1 + i, "Serial Port Profile Test Service");
+            CHECK_EQUAL(0, sdp_register_service(spp_records[i]));
+        }
+    }
+};
+
+TEST(SDPServer, AllRecordsSingleResponse){
+    uint16_t len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), 1000);
+    CHECK_EQUAL(NUM_RECORDS, count_records(len));
+}
+
+TEST(SDPServer, ContinuationMatchesSingleResponse){
+    uint8_t expected[2000];
+    uint16_t expected_len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), 1000);
+    memcpy(expected, attribute_lists, expected_len);
+    uint16_t mtu;
+    for (mtu = 48; mtu < 300; mtu += 17){
+        uint16_t len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), mtu);
+        CHECK_EQUAL(expected_len, len);
+        MEMCMP_EQUAL(expected, attribute_lists, len);
+    }
+}
+
+TEST(SDPServer, AttributeFilter){
+    uint16_t len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_name, sizeof(attributes_name), 1000);
+    CHECK_EQUAL(NUM_RECORDS, count_records(len));
+    // DES(3) + NUM_RECORDS * (DES(3) + attribute id(3) + string(2 + 32))
+    CHECK_EQUAL(3 + NUM_RECORDS * (3 + 3 + 2 + 32), len);
+}
+
+TEST(SDPServer, NoMatch){
+    uint16_t len = query_attribute_lists(pattern_audio_sink, sizeof(pattern_audio_sink), attributes_all, sizeof(attributes_all), 1000);
+    CHECK_EQUAL(3, len);
+    CHECK_EQUAL(0, count_records(len));
+}
+
+TEST(SDPServer, RegisterServiceUpdatesResponse){
+    uint16_t len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), 1000);
+    CHECK_EQUAL(NUM_RECORDS, count_records(len));
+    spp_create_sdp_record(spp_records[NUM_RECORDS], 0x10001 + NUM_RECORDS, 1 + NUM_RECORDS, "Additional Service");
+    CHECK_EQUAL(0, sdp_register_service(spp_records[NUM_RECORDS]));
+    len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), 1000);
+    CHECK_EQUAL(NUM_RECORDS + 1, count_records(len));
+    sdp_unregister_service(0x10001);
+    len = query_attribute_lists(pattern_serial_port, sizeof(pattern_serial_port), attributes_all, sizeof(attributes_all), 1000);
+    CHECK_EQUAL(NUM_RECORDS, count_records(len));
+}
+
+TEST_GROUP(SDPRecordIndex){
+    uint8_t record[150];
+    sdp_record_index_t index;
+    void setup(void){
+        spp_create_sdp_record(record, 0x10001, 1, "Serial Port Profile Test Service");
+        sdp_record_index_init(&index, record);
+    }
+};
+
+TEST(SDPRecordIndex, Init){
+    CHECK_EQUAL(1, index.valid);
+    CHECK_EQUAL(0, index.has_custom_uuids);
+    // L2CAP, RFCOMM, Public Browse Group, Serial Port
+    CHECK_EQUAL(4, index.num_uuids);
+    int i;
+    for (i=1;i<index.num_uuids;i++){
+        CHECK(index.uuids[i-1] < index.uuids[i]);
+    }
+}
+
+TEST(SDPRecordIndex, MatchesTraversal){
+    // DES { UUID16 L2CAP, UUID32 RFCOMM }, DES { UUID128 SerialPort }, DES { UUID16 SerialPort, UUID16 AudioSink }, DES { UUID128 custom }
+    static const uint8_t patterns[][20] = {
+        { 0x35, 0x08, 0x19, 0x01, 0x00, 0x1a, 0x00, 0x00, 0x00, 0x03 },
+        { 0x35, 0x11, 0x1c, 0x00, 0x00, 0x11, 0x01, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb },
+        { 0x35, 0x06, 0x19, 0x11, 0x01, 0x19, 0x11, 0x0b },
+        { 0x35, 0x11, 0x1c, 0x12, 0x34, 0x56, 0x78, 0x00, 0x00, 0x10, 0x00, 0x80, 0x00, 0x00, 0x80, 0x5f, 0x9b, 0x34, 0xfb },
+    };
+    static const int expected[] = { 1, 1, 0, 0 };
+    unsigned int i;
+    for (i=0;i<sizeof(expected)/sizeof(int);i++){
+        uint8_t * pattern = (uint8_t *) patterns[i];
+        CHECK_EQUAL(expected[i], sdp_record_matches_service_search_pattern(record, pattern));
+        CHECK_EQUAL(expected[i], sdp_record_index_matches_service_search_pattern(&index, record, pattern));
+    }
+}
+
+TEST(SDPRecordIndex, AttributesMatchTraversal){
+    uint8_t * attributes = (uint8_t *) attributes_all;
+    CHECK_EQUAL(spd_get_filtered_size(record, attributes), sdp_record_index_get_filtered_size(&index, record, attributes));
+    // offsets of all attributes
+    uint16_t attribute_id;
+    int num_attributes = 0;
+    for (attribute_id = 0; attribute_id < 0x0200; attribute_id++){
+        if (sdp_get_attribute_value_for_attribute_id(record, attribute_id) == NULL) continue;
+        CHECK(num_attributes < index.num_attributes);
+        CHECK_EQUAL(attribute_id, index.attribute_ids[num_attributes]);
+        POINTERS_EQUAL(sdp_get_attribute_value_for_attribute_id(record, attribute_id), &record[index.attribute_value_offsets[num_attributes]]);
+        num_attributes++;
+    }
+    CHECK_EQUAL(num_attributes, index.num_attributes);
+    uint8_t expected[200];
+    uint8_t buffer[200];
+    uint16_t offset;
+    for (offset = 0; offset < 150; offset += 7){
+        uint16_t expected_used;
+        uint16_t used;
+        int expected_complete = sdp_filter_attributes_in_attributeIDList(record, attributes, offset, 40, &expected_used, expected);
+        int complete = sdp_record_index_filter_attributes_in_attributeIDList(&index, record, attributes, offset, 40, &used, buffer);
+        CHECK_EQUAL(expected_complete, complete);
+        CHECK_EQUAL(expected_used, used);
+        MEMCMP_EQUAL(expected, buffer, used);
+    }
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
@@ -7,6 +7,8 @@
 #include "bluetooth.h"
 
 static btstack_packet_handler_t packet_handler;
+static uint16_t mock_local_cid = 0x40;
+static uint8_t  mock_outgoing_buffer[100];
 
 extern "C" int l2cap_can_send_packet_now(uint16_t cid){
     return 1;
@@ -19,15 +21,22 @@ extern "C" void l2cap_request_can_send_now_event(uint16_t cid){
 
 extern "C" uint8_t l2cap_create_channel(btstack_packet_handler_t handler, bd_addr_t address, uint16_t psm, uint16_t mtu, uint16_t * out_local_cid){
 	packet_handler = handler;
-    return 0x41;
+    mock_local_cid++;
+    if (out_local_cid){
+        *out_local_cid = mock_local_cid;
+    }
+    return 0;
+}
+uint16_t mock_l2cap_get_last_local_cid(void){
+    return mock_local_cid;
 }
 extern "C" void l2cap_disconnect(uint16_t local_cid, uint8_t reason){
 }
 extern "C" uint8_t *l2cap_get_outgoing_buffer(void){
-    return NULL;
+    return mock_outgoing_buffer;
 }
 extern "C" uint16_t l2cap_max_mtu(void){
-    return 0;
+    return 48;
 }
 extern "C" int l2cap_reserve_packet_buffer(void){
     return 0;
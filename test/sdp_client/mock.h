@@ -10,4 +10,7 @@ void sdp_parser_handle_service_search(uint8_t * data, uint16_t total_count, uint
 void sdp_client_query_rfcomm_init(void);
 
 void sdp_client_reset(void);
+void sdp_client_packet_handler(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size);
+
+uint16_t mock_l2cap_get_last_local_cid(void);
 
@@ -0,0 +1,141 @@
+// *****************************************************************************
+//
+// test parallel and queued sdp client queries
+//
+// *****************************************************************************
+
+#include "btstack_config.h"
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "bluetooth_sdp.h"
+#include "btstack_event.h"
+#include "classic/sdp_client.h"
+#include "classic/sdp_util.h"
+#include "l2cap.h"
+#include "mock.h"
+
+#include "CppUTest/TestHarness.h"
+#include "CppUTest/CommandLineTestRunner.h"
+
+#define NUM_QUERIES 4
+
+static bd_addr_t remote[NUM_QUERIES + 1];
+static uint16_t  query_id[NUM_QUERIES + 1];
+static uint16_t  complete_query_id;
+static uint8_t   complete_status;
+static int       num_complete;
+static int       num_attribute_bytes;
+
+static void handle_sdp_client_event(uint8_t packet_type, uint16_t channel, uint8_t *packet, uint16_t size){
+    (void) packet_type;
+    (void) size;
+    switch (hci_event_packet_get_type(packet)){
+        case SDP_EVENT_QUERY_ATTRIBUTE_VALUE:
+            CHECK_EQUAL(query_id[1], channel);
+            num_attribute_bytes++;
+            break;
+        case SDP_EVENT_QUERY_COMPLETE:
+            complete_query_id = channel;
+            complete_status = sdp_event_query_complete_get_status(packet);
+            num_complete++;
+            break;
+        default:
+            break;
+    }
+}
+
+static void emit_channel_opened(uint16_t local_cid, uint8_t status){
+    uint8_t event[24];
+    memset(event, 0, sizeof(event));
+    event[0] = L2CAP_EVENT_CHANNEL_OPENED;
+    event[1] = sizeof(event) - 2;
+    event[2] = status;
+    little_endian_store_16(event, 13, local_cid);
+    little_endian_store_16(event, 17, 48);
+    sdp_client_packet_handler(HCI_EVENT_PACKET, local_cid, event, sizeof(event));
+}
+
+static void emit_channel_closed(uint16_t local_cid){
+    uint8_t event[4];
+    event[0] = L2CAP_EVENT_CHANNEL_CLOSED;
+    event[1] = 2;
+    little_endian_store_16(event, 2, local_cid);
+    sdp_client_packet_handler(HCI_EVENT_PACKET, local_cid, event, sizeof(event));
+}
+
+// ServiceSearchAttributeResponse for first request with a single record { 0x0000 : 0x00010001 }
+static void emit_response(uint16_t local_cid){
+    static const uint8_t attribute_lists[] = { 0x35, 0x0a, 0x35, 0x08, 0x09, 0x00, 0x00, 0x0a, 0x00, 0x01, 0x00, 0x01 };
+    uint8_t response[30];
+    uint16_t pos = 0;
+    response[pos++] = SDP_ServiceSearchAttributeResponse;
+    big_endian_store_16(response, pos, 1);
+    pos += 2;
+    big_endian_store_16(response, pos, 2 + sizeof(attribute_lists) + 1);
+    pos += 2;
+    big_endian_store_16(response, pos, sizeof(attribute_lists));
+    pos += 2;
+    memcpy(&response[pos], attribute_lists, sizeof(attribute_lists));
+    pos += sizeof(attribute_lists);
+    response[pos++] = 0;
+    sdp_client_packet_handler(L2CAP_DATA_PACKET, local_cid, response, pos);
+}
+
+TEST_GROUP(SDPClientParallel){
+    void setup(void){
+        sdp_client_reset();
+        num_complete = 0;
+        num_attribute_bytes = 0;
+        int i;
+        for (i=0;i<=NUM_QUERIES;i++){
+            memset(remote[i], 0, 6);
+            remote[i][5] = i;
+        }
+    }
+};
+
+TEST(SDPClientParallel, QueueAndComplete){
+    uint16_t first_cid = mock_l2cap_get_last_local_cid() + 1;
+    int i;
+    for (i=0;i<NUM_QUERIES;i++){
+        CHECK_EQUAL(1, sdp_client_ready());
+        CHECK_EQUAL(0, sdp_client_query_with_id(&handle_sdp_client_event, remote[i], sdp_service_search_pattern_for_uuid16(0x1101 + i), (const uint8_t *) "\x35\x03\x09\x00\x00", &query_id[i]));
+    }
+    CHECK_EQUAL(0, sdp_client_ready());
+    CHECK_EQUAL(SDP_QUERY_BUSY, sdp_client_query_with_id(&handle_sdp_client_event, remote[NUM_QUERIES], sdp_service_search_pattern_for_uuid16(0x1101), (const uint8_t *) "\x35\x03\x09\x00\x00", &query_id[NUM_QUERIES]));
+
+    // only SDP_CLIENT_MAX_PARALLEL_QUERIES channels created
+    CHECK_EQUAL(first_cid + 1, mock_l2cap_get_last_local_cid());
+
+    // first query fails to connect, third query gets started
+    emit_channel_opened(first_cid, 0x04);
+    CHECK_EQUAL(1, num_complete);
+    CHECK_EQUAL(query_id[0], complete_query_id);
+    CHECK_EQUAL(0x04, complete_status);
+    CHECK_EQUAL(first_cid + 2, mock_l2cap_get_last_local_cid());
+
+    // second query completes, fourth query gets started
+    emit_channel_opened(first_cid + 1, 0);
+    emit_response(first_cid + 1);
+    CHECK_EQUAL(5, num_attribute_bytes);
+    emit_channel_closed(first_cid + 1);
+    CHECK_EQUAL(2, num_complete);
+    CHECK_EQUAL(query_id[1], complete_query_id);
+    CHECK_EQUAL(0, complete_status);
+    CHECK_EQUAL(first_cid + 3, mock_l2cap_get_last_local_cid());
+    CHECK_EQUAL(1, sdp_client_ready());
+
+    // third query closed before completion
+    emit_channel_closed(first_cid + 2);
+    CHECK_EQUAL(3, num_complete);
+    CHECK_EQUAL(query_id[2], complete_query_id);
+    CHECK_EQUAL(SDP_QUERY_INCOMPLETE, complete_status);
+}
+
+int main (int argc, const char * argv[]){
+    return CommandLineTestRunner::RunAllTests(argc, argv);
+}
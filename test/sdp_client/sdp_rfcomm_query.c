@@ -109,6 +109,7 @@ TEST_GROUP(SDPClient){
     void setup(void){
         service_index = 0;
         sdp_client_reset(); // avoid "not ready" warning
+        sdp_client_query_rfcomm_init();
         // start query using public API although data will be injected
         sdp_client_query_rfcomm_channel_and_name_for_uuid(&handle_query_rfcomm_event, address, 0x1234);
     }